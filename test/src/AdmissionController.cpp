@@ -0,0 +1,146 @@
+#include "AdmissionController.h"
+#include "RequestTrace.h"
+#include <stdio.h>
+
+AdmissionController::AdmissionController(ONNXWorker* worker, const AdmissionConfig &config)
+    :   worker(worker),
+        config(config),
+        outstanding(0),
+        correction(1.0),
+        queue(new InferenceQueue(worker, 0))
+{
+    stats = AdmissionStats();
+}
+
+AdmissionController::~AdmissionController()
+{
+    // completes everything still queued before the cache goes away
+    queue.reset();
+    for(auto &entry: cache){
+        for(OrtValue* value: entry.second){
+            worker->releaseValue(value);
+        }
+    }
+}
+
+double AdmissionController::baseLocked(double service_ms) const
+{
+    if(service_ms <= 0.0){
+        service_ms = config.initial_service_ms;
+    }
+    return (double)(outstanding + 1) * service_ms;
+}
+
+double AdmissionController::predictLocked(double service_ms) const
+{
+    return baseLocked(service_ms) * correction;
+}
+
+double AdmissionController::predictedLatencyMs() const
+{
+    double service_ms = queue->serviceTimeMs();
+    std::lock_guard<std::mutex> lock(mtx);
+    return predictLocked(service_ms);
+}
+
+AdmissionStats AdmissionController::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return stats;
+}
+
+std::future<InferenceResult> AdmissionController::submit(const std::vector<OrtValue*> &inputs, uint64_t key)
+{
+    std::shared_ptr<std::promise<InferenceResult>> promise(new std::promise<InferenceResult>);
+    std::future<InferenceResult> future = promise->get_future();
+
+    // queue lock is never taken under mtx, the queue callback takes them the other way round
+    double service_ms = queue->serviceTimeMs();
+    double base_ms = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        ++stats.submitted;
+        base_ms = baseLocked(service_ms);
+        if(base_ms * correction > config.slo_ms){
+            InferenceResult result;
+            result.status = REQUEST_REJECTED;
+            result.queue_ms = 0.0;
+            result.run_ms = 0.0;
+            result.trace_id = RequestTrace::enabled() ? RequestTrace::newRequestId() : 0;
+            auto it = config.fallback && key != 0 ? cache.find(key) : cache.end();
+            if(it != cache.end()){
+                for(OrtValue* value: it->second){
+                    result.outputs.emplace_back(worker->cloneTensor(value));
+                }
+                result.status = REQUEST_FALLBACK;
+                ++stats.fallback;
+            }
+            else{
+                ++stats.shed;
+            }
+            RequestTrace::instant(requestStatusName(result.status), result.trace_id);
+            promise->set_value(result);
+            return future;
+        }
+        ++stats.admitted;
+        ++outstanding;
+    }
+
+    InferenceQueue::Clock::time_point deadline = InferenceQueue::Clock::now() +
+        std::chrono::microseconds((long long)(config.slo_ms * 1000.0));
+    queue->submit(inputs, deadline, [this, promise, key, base_ms](InferenceResult &result){
+        done(result, key, base_ms);
+        promise->set_value(result);
+    });
+    return future;
+}
+
+void AdmissionController::done(InferenceResult &result, uint64_t key, double base_ms)
+{
+    double latency_ms = result.queue_ms + result.run_ms;
+    std::lock_guard<std::mutex> lock(mtx);
+    --outstanding;
+    if(result.status == REQUEST_OK && latency_ms <= config.slo_ms){
+        ++stats.met_slo;
+    }
+    else{
+        ++stats.missed_slo;
+    }
+    if(result.status == REQUEST_TIMEOUT){
+        // an admitted request that timed out took at least the SLO; left out,
+        // only the lucky requests would teach the correction
+        latency_ms = latency_ms > config.slo_ms ? latency_ms : config.slo_ms;
+    }
+    else if(result.status != REQUEST_OK){
+        return;
+    }
+
+    // against the uncorrected estimate, so the average settles at observed / base;
+    // a ratio to the corrected prediction would settle at its square root
+    double ratio = base_ms > 0.0 ? latency_ms / base_ms : 1.0;
+    ratio = ratio < 0.25 ? 0.25 : (ratio > 4.0 ? 4.0 : ratio);
+    correction = 0.95 * correction + 0.05 * ratio;
+    if(result.status != REQUEST_OK){
+        return;
+    }
+
+    if(config.fallback && key != 0){
+        // only flat tensor outputs can be cached
+        std::vector<OrtValue*> copies;
+        for(OrtValue* value: result.outputs){
+            OrtValue* copy = worker->cloneTensor(value);
+            if(copy == nullptr){
+                for(OrtValue* done_copy: copies){
+                    worker->releaseValue(done_copy);
+                }
+                return;
+            }
+            copies.emplace_back(copy);
+        }
+        std::vector<OrtValue*> &slot = cache[key];
+        for(OrtValue* value: slot){
+            worker->releaseValue(value);
+        }
+        slot.swap(copies);
+    }
+}
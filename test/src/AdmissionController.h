@@ -0,0 +1,69 @@
+#ifndef ADMISSIONCONTROLLER_H
+#define ADMISSIONCONTROLLER_H
+
+#include "ONNXWorker.h"
+#include "InferenceQueue.h"
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+struct AdmissionConfig{
+    double slo_ms;                  // end to end latency target per request
+    double initial_service_ms;      // service time estimate until the first run completes
+    bool fallback;                  // serve the last result of the same key instead of failing
+};
+
+struct AdmissionStats{
+    uint64_t submitted;
+    uint64_t admitted;
+    uint64_t shed;                  // fast failed with REQUEST_REJECTED
+    uint64_t fallback;              // answered from the cache with REQUEST_FALLBACK
+    uint64_t met_slo;               // admitted and REQUEST_OK within slo_ms
+    uint64_t missed_slo;            // admitted but late, timed out or failed
+};
+
+// Load shedding in front of an InferenceQueue. A request is admitted only if
+// its predicted latency, (outstanding + 1) x service time, fits the SLO. The
+// service time is the queue's live Run average, scaled by a moving average of
+// observed latency / that uncorrected estimate so that the prediction follows
+// what callers actually see. Everything else is answered immediately, either with
+// REQUEST_REJECTED or, when enabled, with a copy of the last good result of
+// the same key (a camera, a sensor...). Admitted requests carry the SLO as
+// their queue deadline, so a misprediction costs at most one SLO.
+class AdmissionController
+{
+public:
+    AdmissionController(ONNXWorker* worker, const AdmissionConfig &config);
+    ~AdmissionController();
+
+    // key = 0 disables the fallback cache for this request
+    std::future<InferenceResult> submit(const std::vector<OrtValue*> &inputs, uint64_t key);
+
+    double predictedLatencyMs() const;
+    AdmissionStats getStats() const;
+
+private:
+    // mtx held, service_ms read from the queue before taking it;
+    // base is (outstanding + 1) x service time, predict applies the correction
+    double baseLocked(double service_ms) const;
+    double predictLocked(double service_ms) const;
+    void done(InferenceResult &result, uint64_t key, double base_ms);
+
+private:
+    ONNXWorker* worker;
+    AdmissionConfig config;
+
+    mutable std::mutex mtx;
+    size_t outstanding;
+    double correction;
+    AdmissionStats stats;
+    std::map<uint64_t, std::vector<OrtValue*>> cache;
+
+    // last member, its callbacks use everything above
+    std::unique_ptr<InferenceQueue> queue;
+};
+
+#endif
@@ -0,0 +1,220 @@
+#include "BenchCompare.h"
+#include "JsonReader.h"
+#include "FastRandom.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+BenchCompare::BenchCompare(const CompareConfig &config)
+    :   config(config)
+{
+}
+
+bool BenchCompare::load(const std::string &path, std::vector<BenchSeries> &out)
+{
+    JsonValue root;
+    if(!loadJson(path, root, "BenchCompare::load()")){
+        return false;
+    }
+    const JsonValue* results = root.find("results");
+    if(results == nullptr || results->type != JsonValue::JSON_ARRAY){
+        printf("BenchCompare::load() - %s: no results array\n", path.c_str());
+        return false;
+    }
+    const JsonValue* file_unit = root.find("unit");
+    for(const JsonValue &result: results->items){
+        const JsonValue* name = result.find("name");
+        const JsonValue* samples = result.find("samples");
+        if(name == nullptr || samples == nullptr || samples->type != JsonValue::JSON_ARRAY){
+            continue;
+        }
+        BenchSeries series;
+        series.name = name->text;
+        const JsonValue* unit = result.find("unit");
+        series.unit = unit != nullptr ? unit->text : (file_unit != nullptr ? file_unit->text : "");
+        const JsonValue* better = result.find("better");
+        series.higher_is_better = better != nullptr && better->text == "higher";
+        for(const JsonValue &sample: samples->items){
+            if(sample.type == JsonValue::JSON_NUMBER){
+                series.samples.emplace_back(sample.number);
+            }
+        }
+        out.emplace_back(series);
+    }
+    return true;
+}
+
+double BenchCompare::median(std::vector<double> values)
+{
+    if(values.empty()){
+        return 0.0;
+    }
+    const size_t n = values.size();
+    std::nth_element(values.begin(), values.begin() + n / 2, values.end());
+    double upper = values[n / 2];
+    if(n % 2){
+        return upper;
+    }
+    return 0.5 * (upper + *std::max_element(values.begin(), values.begin() + n / 2));
+}
+
+double BenchCompare::mannWhitneyP(const std::vector<double> &a, const std::vector<double> &b)
+{
+    const size_t n1 = a.size(), n2 = b.size();
+    if(n1 == 0 || n2 == 0){
+        return 1.0;
+    }
+    std::vector<std::pair<double, int>> pooled;
+    pooled.reserve(n1 + n2);
+    for(double v: a){
+        pooled.emplace_back(v, 0);
+    }
+    for(double v: b){
+        pooled.emplace_back(v, 1);
+    }
+    std::sort(pooled.begin(), pooled.end());
+
+    // mid ranks for ties, the tie term shrinks the variance
+    double rank_sum_a = 0.0, tie_term = 0.0;
+    for(size_t i = 0; i < pooled.size();){
+        size_t j = i;
+        while(j < pooled.size() && pooled[j].first == pooled[i].first){
+            ++j;
+        }
+        const double rank = 0.5 * (double)(i + 1 + j);
+        for(size_t k = i; k < j; ++k){
+            if(pooled[k].second == 0){
+                rank_sum_a += rank;
+            }
+        }
+        const double t = (double)(j - i);
+        tie_term += t * t * t - t;
+        i = j;
+    }
+    const double n = (double)(n1 + n2);
+    const double u = rank_sum_a - 0.5 * n1 * (n1 + 1.0);
+    const double mean = 0.5 * n1 * n2;
+    const double var = n1 * n2 / 12.0 * ((n + 1.0) - tie_term / (n * (n - 1.0)));
+    if(var <= 0.0){
+        return 1.0;
+    }
+    // continuity correction
+    const double z = (std::fabs(u - mean) - 0.5) / std::sqrt(var);
+    return z <= 0.0 ? 1.0 : std::erfc(z / std::sqrt(2.0));
+}
+
+// percentile interval of median(b) / median(a) - 1 over independent resamples of both sides
+void BenchCompare::bootstrapChange(const std::vector<double> &a, const std::vector<double> &b, double &low, double &high) const
+{
+    FastRandom &rng = FastRandom::local();
+    std::vector<double> changes, ra(a.size()), rb(b.size());
+    for(int i = 0; i < config.bootstrap; ++i){
+        for(double &v: ra){
+            v = a[rng.below((uint32_t)a.size())];
+        }
+        for(double &v: rb){
+            v = b[rng.below((uint32_t)b.size())];
+        }
+        const double base = median(ra);
+        changes.emplace_back(base != 0.0 ? median(rb) / base - 1.0 : 0.0);
+    }
+    std::sort(changes.begin(), changes.end());
+    if(changes.empty()){
+        low = high = 0.0;
+        return;
+    }
+    low = changes[(size_t)(0.025 * (changes.size() - 1))];
+    high = changes[(size_t)(0.975 * (changes.size() - 1))];
+}
+
+const std::vector<CompareRow> &BenchCompare::compare()
+{
+    rows.clear();
+    for(const BenchSeries &a: series_a){
+        CompareRow row;
+        row.name = a.name;
+        row.unit = a.unit;
+        row.count_a = a.samples.size();
+        row.count_b = 0;
+        row.median_a = median(a.samples);
+        row.median_b = 0.0;
+        row.change = row.ci_low = row.ci_high = 0.0;
+        row.p_value = 1.0;
+        row.verdict = VERDICT_MISSING;
+        auto it = std::find_if(series_b.begin(), series_b.end(), [&a](const BenchSeries &b){ return b.name == a.name; });
+        if(it == series_b.end() || a.samples.empty() || it->samples.empty()){
+            rows.emplace_back(row);
+            continue;
+        }
+        const BenchSeries &b = *it;
+        row.count_b = b.samples.size();
+        row.median_b = median(b.samples);
+        row.change = row.median_a != 0.0 ? row.median_b / row.median_a - 1.0 : 0.0;
+        row.p_value = mannWhitneyP(a.samples, b.samples);
+        bootstrapChange(a.samples, b.samples, row.ci_low, row.ci_high);
+
+        // worse is up for times, down for throughput
+        const double sign = a.higher_is_better ? -1.0 : 1.0;
+        const double worse = sign * row.change;
+        const bool interval_worse = a.higher_is_better ? row.ci_high < 0.0 : row.ci_low > 0.0;
+        const bool interval_better = a.higher_is_better ? row.ci_low > 0.0 : row.ci_high < 0.0;
+        if(row.p_value >= config.alpha){
+            row.verdict = VERDICT_SAME;
+        }
+        else if(worse > config.threshold && interval_worse){
+            row.verdict = VERDICT_REGRESSED;
+        }
+        else if(-worse > config.threshold && interval_better){
+            row.verdict = VERDICT_IMPROVED;
+        }
+        else{
+            row.verdict = VERDICT_NOISE;
+        }
+        rows.emplace_back(row);
+    }
+    for(const BenchSeries &b: series_b){
+        auto it = std::find_if(series_a.begin(), series_a.end(), [&b](const BenchSeries &a){ return a.name == b.name; });
+        if(it == series_a.end()){
+            CompareRow row;
+            row.name = b.name;
+            row.unit = b.unit;
+            row.count_a = 0;
+            row.count_b = b.samples.size();
+            row.median_a = 0.0;
+            row.median_b = median(b.samples);
+            row.change = row.ci_low = row.ci_high = 0.0;
+            row.p_value = 1.0;
+            row.verdict = VERDICT_MISSING;
+            rows.emplace_back(row);
+        }
+    }
+    return rows;
+}
+
+size_t BenchCompare::regressions() const
+{
+    size_t count = 0;
+    for(const CompareRow &row: rows){
+        count += row.verdict == VERDICT_REGRESSED ? 1 : 0;
+    }
+    return count;
+}
+
+void BenchCompare::print(FILE* out) const
+{
+    static const char* verdicts[] = {"same", "noise", "improved", "REGRESSED", "missing"};
+    fprintf(out, "%-36s %12s %12s %8s %18s %9s  %s\n", "series", "baseline", "candidate", "change", "95% interval", "p", "verdict");
+    for(const CompareRow &row: rows){
+        if(row.verdict == VERDICT_MISSING){
+            fprintf(out, "%-36s %12s %12s %8s %18s %9s  %s %s\n", row.name.c_str(), row.count_a ? "present" : "-",
+                    row.count_b ? "present" : "-", "", "", "", verdicts[row.verdict], row.unit.c_str());
+            continue;
+        }
+        char interval[64];
+        snprintf(interval, sizeof(interval), "[%+.1f%%, %+.1f%%]", row.ci_low * 100.0, row.ci_high * 100.0);
+        fprintf(out, "%-36s %12.4g %12.4g %+7.1f%% %18s %9.2g  %s %s\n", row.name.c_str(), row.median_a, row.median_b,
+                row.change * 100.0, interval, row.p_value, verdicts[row.verdict], row.unit.c_str());
+    }
+    fprintf(out, "threshold %.1f%%, alpha %g, %d bootstrap resamples: %zu regression%s\n", config.threshold * 100.0,
+            config.alpha, config.bootstrap, regressions(), regressions() == 1 ? "" : "s");
+}
@@ -0,0 +1,83 @@
+#ifndef BENCHCOMPARE_H
+#define BENCHCOMPARE_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+struct BenchSeries{
+    std::string name;           // e.g. "mlp.onnx/latency" or a microBench name
+    std::string unit;
+    bool higher_is_better;      // throughput; latencies and times are lower is better
+    std::vector<double> samples;
+};
+
+enum CompareVerdict{
+    VERDICT_SAME = 0,           // no significant difference
+    VERDICT_NOISE,              // significant but inside the threshold
+    VERDICT_IMPROVED,
+    VERDICT_REGRESSED,
+    VERDICT_MISSING             // only one side has the series
+};
+
+struct CompareRow{
+    std::string name;
+    std::string unit;
+    size_t count_a;
+    size_t count_b;
+    double median_a;
+    double median_b;
+    double change;              // median_b / median_a - 1
+    double ci_low;              // bootstrap 95% interval of the change
+    double ci_high;
+    double p_value;             // two sided Mann-Whitney U
+    CompareVerdict verdict;
+};
+
+struct CompareConfig{
+    double threshold;           // relative change that counts, 0.05 = 5%
+    double alpha;               // significance level of the U test
+    int bootstrap;              // resamples for the interval
+
+    CompareConfig()
+        :   threshold(0.05),
+            alpha(0.01),
+            bootstrap(2000)
+    {
+    }
+};
+
+// Baseline against candidate for benchmark JSON files written by loadGen -J
+// and microBench -j. A series regresses when the U test rejects equal
+// distributions at alpha, the bootstrap interval of the median change lies
+// entirely on the worse side, and the median change exceeds the threshold.
+// Requiring both keeps a noisy series from failing a deploy on one bad sample.
+class BenchCompare
+{
+public:
+    explicit BenchCompare(const CompareConfig &config);
+
+    // series of one file, appended to side a (baseline) or b (candidate)
+    bool loadBaseline(const std::string &path) { return load(path, series_a); }
+    bool loadCandidate(const std::string &path) { return load(path, series_b); }
+
+    const std::vector<CompareRow> &compare();
+    void print(FILE* out) const;
+    size_t regressions() const;
+
+    // two sided p value of the U test with normal approximation and tie correction
+    static double mannWhitneyP(const std::vector<double> &a, const std::vector<double> &b);
+    static double median(std::vector<double> values);
+
+private:
+    static bool load(const std::string &path, std::vector<BenchSeries> &out);
+    void bootstrapChange(const std::vector<double> &a, const std::vector<double> &b, double &low, double &high) const;
+
+private:
+    CompareConfig config;
+    std::vector<BenchSeries> series_a;
+    std::vector<BenchSeries> series_b;
+    std::vector<CompareRow> rows;
+};
+
+#endif
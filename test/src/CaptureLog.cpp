@@ -0,0 +1,373 @@
+#include "CaptureLog.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+
+static size_t alignUp(size_t bytes)
+{
+    return (bytes + CAPTURE_ALIGN - 1) & ~(size_t)(CAPTURE_ALIGN - 1);
+}
+
+CaptureWriter::CaptureWriter()
+    :   fp(nullptr),
+        buffer_bytes(0),
+        current(0),
+        closing(false),
+        record_count(0),
+        dropped_count(0)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+uint64_t CaptureWriter::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool CaptureWriter::open(const std::string &path, size_t buffer_bytes, size_t buffer_count)
+{
+    if(fp != nullptr){
+        printf("CaptureWriter::open() - already open\n");
+        return false;
+    }
+    FILE* file = fopen(path.c_str(), "wb");
+    if(file == nullptr){
+        printf("CaptureWriter::open() - cannot create %s\n", path.c_str());
+        return false;
+    }
+    CaptureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = 1;
+    header.start_realtime_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    header.start_steady_ns = nowNs();
+    fwrite(&header, sizeof(header), 1, file);
+
+    this->buffer_bytes = alignUp(buffer_bytes);
+    buffer_count = buffer_count < 2 ? 2 : buffer_count;
+    buffers.assign(buffer_count, std::vector<char>(this->buffer_bytes));
+    used.assign(buffer_count, 0);
+    free_buffers.clear();
+    full_buffers.clear();
+    for(size_t i = 0; i < buffer_count; ++i){
+        free_buffers.push_back(i);
+    }
+    current = buffers.size();
+    closing = false;
+    record_count = 0;
+    dropped_count = 0;
+    // ids handed out before this open() stay valid, so every file repeats them
+    std::lock_guard<std::mutex> lock(mtx);
+    fp = file;
+    for(size_t i = 0; i < models.size(); ++i){
+        if(!appendLocked(modelHeader((uint32_t)i), nullptr, &models[i])){
+            printf("CaptureWriter::open() - could not record %s\n", models[i].c_str());
+        }
+    }
+    writer = std::thread(&CaptureWriter::writerLoop, this);
+    return true;
+}
+
+void CaptureWriter::close()
+{
+    if(fp == nullptr){
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        closing = true;
+        if(current < buffers.size()){
+            full_buffers.push_back(current);
+            current = buffers.size();
+        }
+    }
+    cv.notify_all();
+    writer.join();
+    // append() and registerModel() test fp under the mutex
+    FILE* file = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        file = fp;
+        fp = nullptr;
+    }
+    fclose(file);
+}
+
+uint32_t CaptureWriter::registerModel(const std::string &model_path)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    for(size_t i = 0; i < models.size(); ++i){
+        if(models[i] == model_path){
+            return (uint32_t)i;
+        }
+    }
+    models.emplace_back(model_path);
+    uint32_t model_id = (uint32_t)models.size() - 1;
+    // without an open file the model is recorded by the next open()
+    if(fp != nullptr && !closing && !appendLocked(modelHeader(model_id), nullptr, &model_path)){
+        printf("CaptureWriter::registerModel() - could not record %s\n", model_path.c_str());
+    }
+    return model_id;
+}
+
+CaptureRecordHeader CaptureWriter::modelHeader(uint32_t model_id) const
+{
+    CaptureRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.kind = CAPTURE_MODEL;
+    header.model_id = model_id;
+    header.timestamp_ns = nowNs();
+    header.count = (uint32_t)models[model_id].size();
+    header.bytes = sizeof(header) + alignUp(models[model_id].size());
+    return header;
+}
+
+bool CaptureWriter::append(uint32_t model_id, uint64_t timestamp_ns, const std::vector<CaptureTensor> &tensors)
+{
+    CaptureRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.kind = CAPTURE_REQUEST;
+    header.model_id = model_id;
+    header.timestamp_ns = timestamp_ns;
+    header.count = (uint32_t)tensors.size();
+    header.bytes = sizeof(header);
+    for(const auto &tensor: tensors){
+        header.bytes += sizeof(CaptureTensorHeader) + alignUp(tensor.dims.size() * sizeof(int64_t)) + alignUp(tensor.data_bytes);
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    if(fp == nullptr || closing){
+        return false;
+    }
+    if(!appendLocked(header, &tensors, nullptr)){
+        return false;
+    }
+    ++record_count;
+    return true;
+}
+
+bool CaptureWriter::appendLocked(const CaptureRecordHeader &header, const std::vector<CaptureTensor>* tensors, const std::string* path)
+{
+    if(header.bytes > buffer_bytes){
+        ++dropped_count;
+        return false;
+    }
+    if(current < buffers.size() && used[current] + header.bytes > buffer_bytes){
+        full_buffers.push_back(current);
+        current = buffers.size();
+        cv.notify_one();
+    }
+    if(current == buffers.size()){
+        if(free_buffers.empty()){
+            ++dropped_count;
+            return false;
+        }
+        current = free_buffers.front();
+        free_buffers.pop_front();
+        used[current] = 0;
+    }
+
+    char* dst = buffers[current].data() + used[current];
+    char* begin = dst;
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    if(path != nullptr){
+        memset(dst, 0, alignUp(path->size()));
+        memcpy(dst, path->data(), path->size());
+        dst += alignUp(path->size());
+    }
+    if(tensors != nullptr){
+        for(const auto &tensor: *tensors){
+            CaptureTensorHeader tensor_header;
+            tensor_header.type = (uint32_t)tensor.type;
+            tensor_header.ndims = (uint32_t)tensor.dims.size();
+            tensor_header.data_bytes = tensor.data_bytes;
+            memcpy(dst, &tensor_header, sizeof(tensor_header));
+            dst += sizeof(tensor_header);
+            size_t dims_bytes = tensor.dims.size() * sizeof(int64_t);
+            memset(dst, 0, alignUp(dims_bytes));
+            memcpy(dst, tensor.dims.data(), dims_bytes);
+            dst += alignUp(dims_bytes);
+            memcpy(dst, tensor.data, tensor.data_bytes);
+            memset(dst + tensor.data_bytes, 0, alignUp(tensor.data_bytes) - tensor.data_bytes);
+            dst += alignUp(tensor.data_bytes);
+        }
+    }
+    used[current] += (size_t)(dst - begin);
+    return true;
+}
+
+void CaptureWriter::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while(true){
+        cv.wait(lock, [&]{ return closing || !full_buffers.empty(); });
+        if(full_buffers.empty()){
+            return;
+        }
+        size_t index = full_buffers.front();
+        full_buffers.pop_front();
+        lock.unlock();
+        if(fwrite(buffers[index].data(), 1, used[index], fp) != used[index]){
+            printf("CaptureWriter::writerLoop() - short write\n");
+        }
+        lock.lock();
+        used[index] = 0;
+        free_buffers.push_back(index);
+    }
+}
+
+uint64_t CaptureWriter::records() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return record_count;
+}
+
+uint64_t CaptureWriter::dropped() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return dropped_count;
+}
+
+CaptureReader::CaptureReader()
+    :   fd(-1),
+        base(nullptr),
+        length(0),
+        file_header(nullptr)
+{
+}
+
+CaptureReader::~CaptureReader()
+{
+    close();
+}
+
+bool CaptureReader::open(const std::string &path)
+{
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CaptureFileHeader)){
+        printf("CaptureReader::open() - cannot read %s\n", path.c_str());
+        close();
+        return false;
+    }
+    length = (size_t)st.st_size;
+    void* map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map == MAP_FAILED){
+        printf("CaptureReader::open() - mmap failed\n");
+        close();
+        return false;
+    }
+    base = (const char*)map;
+    madvise(map, length, MADV_SEQUENTIAL);
+    file_header = (const CaptureFileHeader*)base;
+    if(memcmp(file_header->magic, CAPTURE_MAGIC, sizeof(file_header->magic)) != 0){
+        printf("CaptureReader::open() - %s is not a capture file\n", path.c_str());
+        close();
+        return false;
+    }
+
+    size_t offset = sizeof(CaptureFileHeader);
+    while(offset + sizeof(CaptureRecordHeader) <= length){
+        const CaptureRecordHeader* header = (const CaptureRecordHeader*)(base + offset);
+        if(header->bytes < sizeof(CaptureRecordHeader) || header->bytes > length - offset){
+            printf("CaptureReader::open() - truncated record at %zu, keeping %zu records\n", offset, records.size());
+            break;
+        }
+        const char* payload = base + offset + sizeof(CaptureRecordHeader);
+        const char* end = base + offset + header->bytes;
+        if(header->kind == CAPTURE_MODEL){
+            if(header->count > (size_t)(end - payload) || header->model_id >= CAPTURE_MAX_MODELS){
+                printf("CaptureReader::open() - bad model record at %zu, skipped\n", offset);
+            }
+            else{
+                if(models.size() <= header->model_id){
+                    models.resize(header->model_id + 1);
+                }
+                models[header->model_id].assign(payload, header->count);
+            }
+        }
+        else if(header->kind == CAPTURE_REQUEST){
+            CaptureRecord record;
+            record.model_id = header->model_id;
+            record.timestamp_ns = header->timestamp_ns;
+            if(parseTensors(payload, end, header->count, record.tensors)){
+                records.emplace_back(record);
+            }
+            else{
+                printf("CaptureReader::open() - bad request record at %zu, skipped\n", offset);
+            }
+        }
+        offset += header->bytes;
+    }
+    return true;
+}
+
+// every field is checked against the record end before it is used, a
+// corrupt count or size must not walk the record past the mapping
+bool CaptureReader::parseTensors(const char* payload, const char* end, uint32_t count, std::vector<CaptureTensor> &tensors)
+{
+    for(uint32_t i = 0; i < count; ++i){
+        if(sizeof(CaptureTensorHeader) > (size_t)(end - payload)){
+            return false;
+        }
+        const CaptureTensorHeader* tensor_header = (const CaptureTensorHeader*)payload;
+        payload += sizeof(CaptureTensorHeader);
+        size_t dims_bytes = (size_t)tensor_header->ndims * sizeof(int64_t);
+        if(alignUp(dims_bytes) > (size_t)(end - payload)){
+            return false;
+        }
+        CaptureTensor tensor;
+        tensor.type = (ONNXTensorElementDataType)tensor_header->type;
+        tensor.dims.assign((const int64_t*)payload, (const int64_t*)payload + tensor_header->ndims);
+        payload += alignUp(dims_bytes);
+        if(tensor_header->data_bytes > (uint64_t)(end - payload) || alignUp(tensor_header->data_bytes) > (size_t)(end - payload)){
+            return false;
+        }
+        tensor.data = payload;
+        tensor.data_bytes = tensor_header->data_bytes;
+        payload += alignUp(tensor_header->data_bytes);
+        tensors.emplace_back(tensor);
+    }
+    return true;
+}
+
+void CaptureReader::close()
+{
+    if(base != nullptr){
+        munmap((void*)base, length);
+        base = nullptr;
+    }
+    if(fd >= 0){
+        ::close(fd);
+        fd = -1;
+    }
+    length = 0;
+    file_header = nullptr;
+    models.clear();
+    records.clear();
+}
+
+std::string CaptureReader::modelPath(uint32_t model_id) const
+{
+    return model_id < models.size() ? models[model_id] : std::string();
+}
+
+int64_t CaptureReader::modelId(const std::string &model_path) const
+{
+    for(size_t i = 0; i < models.size(); ++i){
+        if(models[i] == model_path){
+            return (int64_t)i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,148 @@
+#ifndef CAPTURELOG_H
+#define CAPTURELOG_H
+
+#include "onnxruntime_c_api.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Capture file layout, native byte order (little endian on every target we
+// build for), every block 16 byte aligned so tensor data can be used in
+// place from a mapping:
+//
+//   FileHeader
+//   { RecordHeader, payload }*
+//     CAPTURE_MODEL:   model id + path, written once per model
+//     CAPTURE_REQUEST: timestamp, model id, then per input
+//                      TensorHeader, int64 dims[ndims], padding, data, padding
+#define CAPTURE_MAGIC "ONNXCAP1"
+#define CAPTURE_ALIGN 16
+#define CAPTURE_MAX_MODELS 65536
+
+enum CaptureRecordKind{
+    CAPTURE_MODEL = 1,
+    CAPTURE_REQUEST = 2
+};
+
+struct CaptureFileHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t start_realtime_ns;     // wall clock of the first record
+    uint64_t start_steady_ns;       // steady clock at the same moment
+};
+
+struct CaptureRecordHeader{
+    uint32_t kind;
+    uint32_t model_id;
+    uint64_t bytes;                 // whole record including this header
+    uint64_t timestamp_ns;          // steady clock
+    uint32_t count;                 // tensors, or path length for CAPTURE_MODEL
+    uint32_t reserved;
+};
+
+struct CaptureTensorHeader{
+    uint32_t type;                  // ONNXTensorElementDataType
+    uint32_t ndims;
+    uint64_t data_bytes;
+};
+
+struct CaptureTensor{
+    ONNXTensorElementDataType type;
+    std::vector<int64_t> dims;
+    const void* data;
+    size_t data_bytes;
+};
+
+// Appends requests from any thread into fixed size buffers; a background
+// thread writes full buffers to disk. append() never waits for the disk: when
+// every buffer is full the record is dropped and counted instead, so a slow
+// disk degrades the capture, not the inference.
+class CaptureWriter
+{
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+
+    bool open(const std::string &path, size_t buffer_bytes, size_t buffers);
+    // flushes everything appended so far and closes the file
+    void close();
+
+    // id for a model path, stable for the life of the writer: models may be
+    // registered before open() and are written again into every file opened
+    uint32_t registerModel(const std::string &model_path);
+    bool append(uint32_t model_id, uint64_t timestamp_ns, const std::vector<CaptureTensor> &tensors);
+
+    uint64_t records() const;
+    uint64_t dropped() const;
+
+    static uint64_t nowNs();
+
+private:
+    bool appendLocked(const CaptureRecordHeader &header, const std::vector<CaptureTensor>* tensors, const std::string* path);
+    CaptureRecordHeader modelHeader(uint32_t model_id) const;
+    void writerLoop();
+
+private:
+    FILE* fp;
+    size_t buffer_bytes;
+
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<std::vector<char>> buffers;
+    std::vector<size_t> used;
+    std::deque<size_t> free_buffers;
+    std::deque<size_t> full_buffers;
+    size_t current;                 // buffers.size() when none is being filled
+    bool closing;
+
+    std::vector<std::string> models;
+    uint64_t record_count;
+    uint64_t dropped_count;
+    std::thread writer;
+};
+
+struct CaptureRecord{
+    uint32_t model_id;
+    uint64_t timestamp_ns;
+    std::vector<CaptureTensor> tensors;     // data points into the mapping
+};
+
+// Maps a capture file read only and indexes it; tensor data is never copied.
+// Records that do not fit inside themselves are skipped, a truncated tail
+// ends the index. modelPath()/modelId() describe the file last opened.
+class CaptureReader
+{
+public:
+    CaptureReader();
+    ~CaptureReader();
+
+    bool open(const std::string &path);
+    void close();
+
+    size_t size() const { return records.size(); }
+    const CaptureRecord &record(size_t index) const { return records[index]; }
+    // path of a model id, empty if unknown
+    std::string modelPath(uint32_t model_id) const;
+    // first id registered for a path, -1 if absent
+    int64_t modelId(const std::string &model_path) const;
+    const CaptureFileHeader &header() const { return *file_header; }
+
+private:
+    static bool parseTensors(const char* payload, const char* end, uint32_t count, std::vector<CaptureTensor> &tensors);
+
+private:
+    int fd;
+    const char* base;
+    size_t length;
+    const CaptureFileHeader* file_header;
+    std::vector<std::string> models;
+    std::vector<CaptureRecord> records;
+};
+
+#endif
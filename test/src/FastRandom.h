@@ -0,0 +1,100 @@
+#ifndef FASTRANDOM_H
+#define FASTRANDOM_H
+
+#include "SimdOps.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Four interleaved xoshiro128+ generators, one per SIMD lane, so a step
+// yields four 32 bit words for a handful of vector ops. Not for anything that
+// needs cryptographic quality, plenty for benchmark inputs. One instance per
+// thread, see local().
+class FastRandom
+{
+public:
+    explicit FastRandom(uint64_t seed)
+    {
+        // splitmix64 spreads any seed over the 16 state words
+        uint32_t words[16];
+        for(int i = 0; i < 16; i += 2){
+            seed += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            z ^= z >> 31;
+            words[i] = (uint32_t)z;
+            words[i + 1] = (uint32_t)(z >> 32);
+        }
+        s0 = simd::loadU32(words);
+        s1 = simd::loadU32(words + 4);
+        s2 = simd::loadU32(words + 8);
+        s3 = simd::loadU32(words + 12);
+        cached = 4;
+    }
+
+    // per thread instance, seeded differently in every thread
+    static FastRandom &local();
+
+    simd::u32x4 next4()
+    {
+        simd::u32x4 result = simd::addU32(s0, s3);
+        simd::u32x4 t = simd::shlU32<9>(s1);
+        s2 = simd::xorU32(s2, s0);
+        s3 = simd::xorU32(s3, s1);
+        s1 = simd::xorU32(s1, s2);
+        s0 = simd::xorU32(s0, s3);
+        s2 = simd::xorU32(s2, t);
+        s3 = simd::orU32(simd::shlU32<11>(s3), simd::shrU32<21>(s3));
+        return result;
+    }
+
+    // four floats uniform in [0, 1): 23 random mantissa bits under exponent 0
+    simd::f32x4 nextUnit4()
+    {
+        simd::u32x4 bits = simd::orU32(simd::shrU32<9>(next4()), simd::set1U32(0x3F800000u));
+        return simd::sub(simd::asFloat(bits), simd::set1(1.0f));
+    }
+
+    uint32_t next()
+    {
+        if(cached == 4){
+            simd::storeU32(block, next4());
+            cached = 0;
+        }
+        return block[cached++];
+    }
+
+    // uniform in [0, n)
+    uint32_t below(uint32_t n) { return (uint32_t)(((uint64_t)next() * n) >> 32); }
+
+    void fillUniform(float* out, size_t count, float low, float high)
+    {
+        const simd::f32x4 scale = simd::set1(high - low), offset = simd::set1(low);
+        size_t i = 0;
+        for(; i + 4 <= count; i += 4){
+            simd::store(out + i, simd::madd(offset, nextUnit4(), scale));
+        }
+        if(i < count){
+            float tail[4];
+            simd::store(tail, simd::madd(offset, nextUnit4(), scale));
+            for(size_t k = 0; i < count; ++i, ++k){
+                out[i] = tail[k];
+            }
+        }
+    }
+
+private:
+    simd::u32x4 s0, s1, s2, s3;
+    uint32_t block[4];
+    int cached;
+};
+
+inline FastRandom &FastRandom::local()
+{
+    static std::atomic<uint64_t> threads(0);
+    static thread_local FastRandom rng(0x5EED5EEDULL + 0x100000001B3ULL * threads++);
+    return rng;
+}
+
+#endif
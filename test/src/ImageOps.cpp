@@ -0,0 +1,154 @@
+#include "ImageOps.h"
+#include "SimdOps.h"
+#include <cmath>
+
+void rgbToYCbCr(const uint8_t* rgb, int width, int height, float* y, float* cb, float* cr)
+{
+    const float scale = 1.0f / 255.0f;
+    const int pixels = width * height;
+    for(int i = 0; i < pixels; ++i){
+        float r = rgb[3 * i] * scale;
+        float g = rgb[3 * i + 1] * scale;
+        float b = rgb[3 * i + 2] * scale;
+        y[i] = 0.299f * r + 0.587f * g + 0.114f * b;
+        cb[i] = 0.5f - 0.168736f * r - 0.331264f * g + 0.5f * b;
+        cr[i] = 0.5f + 0.5f * r - 0.418688f * g - 0.081312f * b;
+    }
+}
+
+void yCbCrToRgb(const float* y, const float* cb, const float* cr, int width, int height, uint8_t* rgb)
+{
+    const int pixels = width * height;
+    const simd::f32x4 half = simd::set1(0.5f);
+    const simd::f32x4 full = simd::set1(255.0f);
+    const simd::f32x4 k_rv = simd::set1(1.402f * 255.0f);
+    const simd::f32x4 k_gu = simd::set1(-0.344136f * 255.0f);
+    const simd::f32x4 k_gv = simd::set1(-0.714136f * 255.0f);
+    const simd::f32x4 k_bu = simd::set1(1.772f * 255.0f);
+
+    int i = 0;
+    uint8_t r8[4], g8[4], b8[4];
+    for(; i + 4 <= pixels; i += 4){
+        simd::f32x4 vy = simd::mul(simd::load(y + i), full);
+        simd::f32x4 vu = simd::sub(simd::load(cb + i), half);
+        simd::f32x4 vv = simd::sub(simd::load(cr + i), half);
+        simd::storeU8(r8, simd::madd(vy, vv, k_rv));
+        simd::storeU8(g8, simd::madd(simd::madd(vy, vu, k_gu), vv, k_gv));
+        simd::storeU8(b8, simd::madd(vy, vu, k_bu));
+        uint8_t* dst = rgb + 3 * i;
+        for(int k = 0; k < 4; ++k){
+            dst[3 * k] = r8[k];
+            dst[3 * k + 1] = g8[k];
+            dst[3 * k + 2] = b8[k];
+        }
+    }
+    for(; i < pixels; ++i){
+        float vy = y[i] * 255.0f;
+        float vu = cb[i] - 0.5f;
+        float vv = cr[i] - 0.5f;
+        float c[3] = {vy + 1.402f * 255.0f * vv,
+                      vy - 0.344136f * 255.0f * vu - 0.714136f * 255.0f * vv,
+                      vy + 1.772f * 255.0f * vu};
+        for(int k = 0; k < 3; ++k){
+            float x = c[k] + 0.5f;
+            rgb[3 * i + k] = x <= 0.0f ? 0 : (x >= 255.0f ? 255 : (uint8_t)x);
+        }
+    }
+}
+
+/******************************************************************************************************/
+
+static float cubicWeight(float x)
+{
+    const float a = -0.5f;
+    x = std::fabs(x);
+    if(x <= 1.0f){
+        return ((a + 2.0f) * x - (a + 3.0f)) * x * x + 1.0f;
+    }
+    if(x < 2.0f){
+        return ((a * x - 5.0f * a) * x + 8.0f * a) * x - 4.0f * a;
+    }
+    return 0.0f;
+}
+
+BicubicScaler::BicubicScaler(int src_width, int src_height, int dst_width, int dst_height)
+    :   src_w(src_width),
+        src_h(src_height),
+        dst_w(dst_width),
+        dst_h(dst_height),
+        tmp((size_t)src_width * dst_height)
+{
+    buildTaps(src_w, dst_w, x_taps);
+    buildTaps(src_h, dst_h, y_taps);
+}
+
+void BicubicScaler::buildTaps(int src_size, int dst_size, Taps &taps)
+{
+    const float scale = (float)src_size / dst_size;
+    for(int k = 0; k < 4; ++k){
+        taps.index[k].resize(dst_size);
+        taps.weight[k].resize(dst_size);
+    }
+    for(int i = 0; i < dst_size; ++i){
+        float center = (i + 0.5f) * scale - 0.5f;
+        int base = (int)std::floor(center);
+        float t = center - base;
+        for(int k = 0; k < 4; ++k){
+            int idx = base - 1 + k;
+            idx = idx < 0 ? 0 : (idx >= src_size ? src_size - 1 : idx);
+            taps.index[k][i] = idx;
+            taps.weight[k][i] = cubicWeight(t + 1.0f - k);
+        }
+    }
+}
+
+void BicubicScaler::resize(const float* src, float* dst)
+{
+    // vertical pass: every output row blends 4 contiguous source rows
+    for(int y = 0; y < dst_h; ++y){
+        const float* r0 = src + (size_t)y_taps.index[0][y] * src_w;
+        const float* r1 = src + (size_t)y_taps.index[1][y] * src_w;
+        const float* r2 = src + (size_t)y_taps.index[2][y] * src_w;
+        const float* r3 = src + (size_t)y_taps.index[3][y] * src_w;
+        const float w0 = y_taps.weight[0][y], w1 = y_taps.weight[1][y];
+        const float w2 = y_taps.weight[2][y], w3 = y_taps.weight[3][y];
+        simd::f32x4 v0 = simd::set1(w0), v1 = simd::set1(w1), v2 = simd::set1(w2), v3 = simd::set1(w3);
+        float* out = &tmp[(size_t)y * src_w];
+        int x = 0;
+        for(; x + 4 <= src_w; x += 4){
+            simd::f32x4 acc = simd::mul(simd::load(r0 + x), v0);
+            acc = simd::madd(acc, simd::load(r1 + x), v1);
+            acc = simd::madd(acc, simd::load(r2 + x), v2);
+            acc = simd::madd(acc, simd::load(r3 + x), v3);
+            simd::store(out + x, acc);
+        }
+        for(; x < src_w; ++x){
+            out[x] = r0[x] * w0 + r1[x] * w1 + r2[x] * w2 + r3[x] * w3;
+        }
+    }
+
+    // horizontal pass: taps gathered per lane, weights loaded from SoA tables
+    const int* i0 = x_taps.index[0].data();
+    const int* i1 = x_taps.index[1].data();
+    const int* i2 = x_taps.index[2].data();
+    const int* i3 = x_taps.index[3].data();
+    const float* w0 = x_taps.weight[0].data();
+    const float* w1 = x_taps.weight[1].data();
+    const float* w2 = x_taps.weight[2].data();
+    const float* w3 = x_taps.weight[3].data();
+    for(int y = 0; y < dst_h; ++y){
+        const float* row = &tmp[(size_t)y * src_w];
+        float* out = dst + (size_t)y * dst_w;
+        int x = 0;
+        for(; x + 4 <= dst_w; x += 4){
+            simd::f32x4 acc = simd::mul(simd::set(row[i0[x]], row[i0[x + 1]], row[i0[x + 2]], row[i0[x + 3]]), simd::load(w0 + x));
+            acc = simd::madd(acc, simd::set(row[i1[x]], row[i1[x + 1]], row[i1[x + 2]], row[i1[x + 3]]), simd::load(w1 + x));
+            acc = simd::madd(acc, simd::set(row[i2[x]], row[i2[x + 1]], row[i2[x + 2]], row[i2[x + 3]]), simd::load(w2 + x));
+            acc = simd::madd(acc, simd::set(row[i3[x]], row[i3[x + 1]], row[i3[x + 2]], row[i3[x + 3]]), simd::load(w3 + x));
+            simd::store(out + x, acc);
+        }
+        for(; x < dst_w; ++x){
+            out[x] = row[i0[x]] * w0[x] + row[i1[x]] * w1[x] + row[i2[x]] * w2[x] + row[i3[x]] * w3[x];
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef IMAGEOPS_H
+#define IMAGEOPS_H
+
+#include <stdint.h>
+#include <vector>
+
+// Full range (JPEG) conversion, planes are normalized to [0, 1].
+void rgbToYCbCr(const uint8_t* rgb, int width, int height, float* y, float* cb, float* cr);
+// Vectorized inverse of rgbToYCbCr, writes interleaved RGB.
+void yCbCrToRgb(const float* y, const float* cb, const float* cr, int width, int height, uint8_t* rgb);
+
+// Separable Keys (a = -0.5) bicubic resize of one float plane. The tap tables are
+// built once per geometry, so keep one scaler per thread and reuse it per frame.
+class BicubicScaler
+{
+public:
+    BicubicScaler(int src_width, int src_height, int dst_width, int dst_height);
+
+    void resize(const float* src, float* dst);
+
+    int dstWidth() const { return dst_w; }
+    int dstHeight() const { return dst_h; }
+private:
+    struct Taps{
+        std::vector<int> index[4];
+        std::vector<float> weight[4];
+    };
+    static void buildTaps(int src_size, int dst_size, Taps &taps);
+
+private:
+    int src_w;
+    int src_h;
+    int dst_w;
+    int dst_h;
+    Taps x_taps;
+    Taps y_taps;
+    std::vector<float> tmp;
+};
+
+#endif
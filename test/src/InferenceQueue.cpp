@@ -0,0 +1,262 @@
+#include "InferenceQueue.h"
+#include "RequestTrace.h"
+#include <stdio.h>
+
+const char* requestStatusName(RequestStatus status)
+{
+    switch(status){
+        case REQUEST_OK: return "OK";
+        case REQUEST_TIMEOUT: return "TIMEOUT";
+        case REQUEST_REJECTED: return "REJECTED";
+        case REQUEST_ERROR: return "ERROR";
+        case REQUEST_FALLBACK: return "FALLBACK";
+        default: return "UNKNOWN";
+    }
+}
+
+InferenceQueue::InferenceQueue(ONNXWorker* worker, size_t max_depth)
+    :   worker(worker),
+        max_depth(max_depth),
+        run_options(worker->createRunOptions()),
+        stopping(false),
+        in_flight(false),
+        in_flight_terminated(false),
+        service_ms(0.0)
+{
+    stats = QueueStats();
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    const std::string model_label = MetricsRegistry::modelLabel(worker->getModelPath());
+    metric_depth = metrics.gauge("onnx_queue_depth", "Requests waiting in an InferenceQueue.", model_label);
+    metric_queue_seconds = metrics.histogram("onnx_queue_wait_seconds", "Time from submit to Run start.", model_label,
+                                             MetricHistogram::latencyBounds());
+    for(int i = REQUEST_OK; i <= REQUEST_FALLBACK; ++i){
+        metric_requests[i] = metrics.counter("onnx_requests_total", "Completed requests by status.",
+                                             model_label + "," + MetricsRegistry::label("status", requestStatusName((RequestStatus)i)));
+    }
+    run_thread = std::thread(&InferenceQueue::runLoop, this);
+    monitor_thread = std::thread(&InferenceQueue::monitorLoop, this);
+}
+
+InferenceQueue::~InferenceQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    work_cv.notify_all();
+    monitor_cv.notify_all();
+    run_thread.join();
+    monitor_thread.join();
+    for(auto &request: pending){
+        finish(*request, REQUEST_REJECTED, 0.0);
+    }
+    worker->releaseRunOptions(run_options);
+}
+
+void InferenceQueue::finish(Request &request, RequestStatus status, double run_ms)
+{
+    InferenceResult result;
+    result.status = status;
+    result.queue_ms = std::chrono::duration<double, std::milli>(Clock::now() - request.enqueue_time).count() - run_ms;
+    result.run_ms = run_ms;
+    complete(request, result);
+}
+
+void InferenceQueue::complete(Request &request, InferenceResult &result)
+{
+    result.trace_id = request.trace_id;
+    metric_requests[result.status]->inc();
+    TraceSpan span("complete", request.trace_id, nullptr, (int64_t)result.status);
+    if(request.done){
+        request.done(result);
+    }
+    else{
+        request.promise.set_value(result);
+    }
+}
+
+std::future<InferenceResult> InferenceQueue::submit(const std::vector<OrtValue*> &inputs, Clock::time_point deadline,
+                                                    const OutputSelection* selection)
+{
+    std::unique_ptr<Request> request(new Request);
+    request->inputs = inputs;
+    request->selection = selection;
+    request->enqueue_time = Clock::now();
+    request->deadline = deadline;
+    request->trace_id = RequestTrace::enabled() ? RequestTrace::newRequestId() : 0;
+    std::future<InferenceResult> future = request->promise.get_future();
+    enqueue(request);
+    return future;
+}
+
+void InferenceQueue::submit(const std::vector<OrtValue*> &inputs, Clock::time_point deadline, DoneFn done,
+                            const OutputSelection* selection)
+{
+    std::unique_ptr<Request> request(new Request);
+    request->inputs = inputs;
+    request->selection = selection;
+    request->enqueue_time = Clock::now();
+    request->deadline = deadline;
+    request->done = std::move(done);
+    request->trace_id = RequestTrace::enabled() ? RequestTrace::newRequestId() : 0;
+    enqueue(request);
+}
+
+bool InferenceQueue::enqueue(std::unique_ptr<Request> &request)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        ++stats.submitted;
+        if(stopping || (max_depth > 0 && pending.size() >= max_depth)){
+            ++stats.rejected;
+            finish(*request, REQUEST_REJECTED, 0.0);
+            return false;
+        }
+        RequestTrace::instant("enqueue", request->trace_id, nullptr, (int64_t)pending.size());
+        pending.push_back(std::move(request));
+        metric_depth->set((int64_t)pending.size());
+    }
+    work_cv.notify_one();
+    monitor_cv.notify_one();
+    return true;
+}
+
+size_t InferenceQueue::depth() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return pending.size();
+}
+
+QueueStats InferenceQueue::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return stats;
+}
+
+double InferenceQueue::serviceTimeMs() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return service_ms;
+}
+
+void InferenceQueue::runLoop()
+{
+    const size_t output_count = worker->getOutputsSignature().size();
+    std::vector<OrtValue*> outputs(output_count, nullptr);
+    while(true){
+        std::unique_ptr<Request> request;
+        // dispatch time: the deadline check and the queue time use the same clock read
+        Clock::time_point begin;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            while(true){
+                work_cv.wait(lock, [&]{ return stopping || !pending.empty(); });
+                if(stopping){
+                    return;
+                }
+                request = std::move(pending.front());
+                pending.pop_front();
+                metric_depth->set((int64_t)pending.size());
+                // expired but not swept yet, or cannot finish in time anyway
+                std::chrono::microseconds expected((long long)(service_ms * 1000.0));
+                begin = Clock::now();
+                if(request->deadline <= begin + expected){
+                    ++stats.expired_in_queue;
+                    finish(*request, REQUEST_TIMEOUT, 0.0);
+                    continue;
+                }
+                break;
+            }
+            worker->resetRunOptions(run_options);
+            in_flight = true;
+            in_flight_deadline = request->deadline;
+            in_flight_terminated = false;
+        }
+        monitor_cv.notify_one();
+
+        metric_queue_seconds->observe(std::chrono::duration<double>(begin - request->enqueue_time).count());
+        if(request->trace_id != 0){
+            RequestTrace::complete("queue", request->trace_id, RequestTrace::steadyNs(request->enqueue_time), RequestTrace::steadyNs(begin));
+        }
+        RequestTrace::setCurrent(request->trace_id);
+        // same size most of the time, so no reallocation
+        outputs.assign(request->selection != nullptr ? request->selection->names.size() : output_count, nullptr);
+        bool ok = worker->runSelected(request->inputs, request->selection, outputs, run_options);
+        RequestTrace::setCurrent(0);
+        double run_ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+
+        RequestStatus status = REQUEST_OK;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            in_flight = false;
+            if(ok){
+                ++stats.completed;
+                service_ms = service_ms > 0.0 ? 0.9 * service_ms + 0.1 * run_ms : run_ms;
+            }
+            else if(in_flight_terminated){
+                ++stats.aborted_in_flight;
+                status = REQUEST_TIMEOUT;
+                // an aborted run is a lower bound of the service time
+                service_ms = run_ms > service_ms ? run_ms : service_ms;
+            }
+            else{
+                ++stats.errors;
+                status = REQUEST_ERROR;
+            }
+        }
+        if(status == REQUEST_OK){
+            InferenceResult result;
+            result.status = REQUEST_OK;
+            result.outputs = outputs;
+            result.run_ms = run_ms;
+            result.queue_ms = std::chrono::duration<double, std::milli>(begin - request->enqueue_time).count();
+            complete(*request, result);
+        }
+        else{
+            for(auto &value: outputs){
+                worker->releaseValue(value);
+            }
+            finish(*request, status, run_ms);
+        }
+        for(auto &value: outputs){
+            value = nullptr;
+        }
+    }
+}
+
+void InferenceQueue::monitorLoop()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while(!stopping){
+        const Clock::time_point now = Clock::now();
+        Clock::time_point next = Clock::time_point::max();
+
+        for(auto it = pending.begin(); it != pending.end();){
+            if((*it)->deadline <= now){
+                ++stats.expired_in_queue;
+                finish(**it, REQUEST_TIMEOUT, 0.0);
+                it = pending.erase(it);
+                metric_depth->set((int64_t)pending.size());
+                continue;
+            }
+            next = (*it)->deadline < next ? (*it)->deadline : next;
+            ++it;
+        }
+        if(in_flight && !in_flight_terminated){
+            if(in_flight_deadline <= now){
+                worker->terminateRun(run_options);
+                in_flight_terminated = true;
+            }
+            else if(in_flight_deadline < next){
+                next = in_flight_deadline;
+            }
+        }
+
+        if(next == Clock::time_point::max()){
+            monitor_cv.wait(lock);
+        }
+        else{
+            monitor_cv.wait_until(lock, next);
+        }
+    }
+}
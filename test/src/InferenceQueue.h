@@ -0,0 +1,136 @@
+#ifndef INFERENCEQUEUE_H
+#define INFERENCEQUEUE_H
+
+#include "ONNXWorker.h"
+#include "Metrics.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+enum RequestStatus{
+    REQUEST_OK = 0,
+    REQUEST_TIMEOUT,        // expired in the queue or aborted in flight
+    REQUEST_REJECTED,       // queue full or queue shut down
+    REQUEST_ERROR,          // Run failed for another reason
+    REQUEST_FALLBACK        // shed by AdmissionController, outputs are a cached earlier result
+};
+
+const char* requestStatusName(RequestStatus status);
+
+struct InferenceResult{
+    RequestStatus status;
+    std::vector<OrtValue*> outputs;     // only set for REQUEST_OK, release with ONNXWorker::releaseValue;
+                                        // one per selected output for requests with a selection
+    double queue_ms;
+    double run_ms;
+    uint64_t trace_id;                  // RequestTrace id, 0 when tracing is off
+};
+
+struct QueueStats{
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t expired_in_queue;
+    uint64_t aborted_in_flight;
+    uint64_t rejected;
+    uint64_t errors;
+};
+
+// Asynchronous front of one ONNXWorker with per-request deadlines. A single
+// thread runs requests in FIFO order under its own OrtRunOptions. A monitor
+// thread wakes at the earliest deadline: expired queued requests are completed
+// with REQUEST_TIMEOUT without running, an expired in-flight run is aborted
+// with RunOptionsSetTerminate. Every future is completed by its deadline (plus
+// the time ORT takes to notice the terminate flag).
+//
+// A request whose remaining budget is below the running service time estimate
+// is dropped instead of started, otherwise under overload every request would
+// start just before its deadline and be aborted half way through.
+//
+// With RequestTrace enabled each request records enqueue, queue wait, Run and
+// completion delivery; result.trace_id lets the caller add its own
+// postprocessing span to the same request.
+//
+// MetricsRegistry gets the queue depth, queue wait and completed requests
+// by status, labelled with the model file name.
+class InferenceQueue
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    // Completion callback, called instead of fulfilling a future. It may run
+    // on the submitting, run or monitor thread with the queue lock held, so it
+    // must be short and must not call back into the queue.
+    typedef std::function<void(InferenceResult &result)> DoneFn;
+
+    // max_depth = 0 leaves the queue unbounded
+    InferenceQueue(ONNXWorker* worker, size_t max_depth);
+    ~InferenceQueue();
+
+    // inputs are caller owned and must stay alive until the future is ready.
+    // Clock::time_point::max() means no deadline. selection, from the worker's
+    // selectOutputs(), fetches only those outputs; nullptr fetches all.
+    std::future<InferenceResult> submit(const std::vector<OrtValue*> &inputs, Clock::time_point deadline,
+                                        const OutputSelection* selection = nullptr);
+    std::future<InferenceResult> submit(const std::vector<OrtValue*> &inputs, std::chrono::microseconds timeout,
+                                        const OutputSelection* selection = nullptr)
+    {
+        return submit(inputs, Clock::now() + timeout, selection);
+    }
+    void submit(const std::vector<OrtValue*> &inputs, Clock::time_point deadline, DoneFn done,
+                const OutputSelection* selection = nullptr);
+
+    size_t depth() const;
+    QueueStats getStats() const;
+    // moving average of successful Run durations
+    double serviceTimeMs() const;
+
+private:
+    struct Request{
+        std::vector<OrtValue*> inputs;
+        const OutputSelection* selection;
+        Clock::time_point enqueue_time;
+        Clock::time_point deadline;
+        std::promise<InferenceResult> promise;
+        DoneFn done;
+        uint64_t trace_id;
+    };
+
+    void runLoop();
+    void monitorLoop();
+    bool enqueue(std::unique_ptr<Request> &request);
+    void finish(Request &request, RequestStatus status, double run_ms);
+    void complete(Request &request, InferenceResult &result);
+
+private:
+    ONNXWorker* worker;
+    size_t max_depth;
+    OrtRunOptions* run_options;
+
+    mutable std::mutex mtx;
+    std::condition_variable work_cv;
+    std::condition_variable monitor_cv;
+    std::deque<std::unique_ptr<Request>> pending;
+    bool stopping;
+
+    // in-flight state, guarded by mtx
+    bool in_flight;
+    Clock::time_point in_flight_deadline;
+    bool in_flight_terminated;
+
+    QueueStats stats;
+    double service_ms;
+    std::thread run_thread;
+    std::thread monitor_thread;
+
+    MetricGauge* metric_depth;
+    MetricHistogram* metric_queue_seconds;
+    MetricCounter* metric_requests[REQUEST_FALLBACK + 1];   // by RequestStatus
+};
+
+#endif
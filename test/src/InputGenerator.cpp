@@ -0,0 +1,202 @@
+#include "InputGenerator.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits>
+
+InputGenerator::InputGenerator(ONNXWorker* worker, const InputSpec &spec)
+    :   worker(worker),
+        spec(spec),
+        ok(true)
+{
+    for(const IOInfo &info: worker->getInputsSignature()){
+        size_t element = ONNXWorker::elementSize(info.datatype);
+        if(element == 0){
+            printf("InputGenerator::InputGenerator() - input %s: unsupported type %d\n", info.name.c_str(), (int)info.datatype);
+            ok = false;
+            break;
+        }
+        std::vector<int64_t> dims = info.Dims.second;
+        size_t count = 1;
+        for(auto &dim: dims){
+            dim = dim > 0 ? dim : spec.dynamic_dim;
+            count *= (size_t)dim;
+        }
+        shapes.emplace_back(dims);
+        counts.emplace_back(count);
+        buffers.emplace_back((count * element + sizeof(uint64_t) - 1) / sizeof(uint64_t) + 1, 0);
+        tensors.emplace_back(worker->createTensor(buffers.back().data(), count * element, dims, info.datatype));
+        if(tensors.back() == nullptr){
+            ok = false;
+            break;
+        }
+    }
+    if(ok){
+        generate();
+    }
+}
+
+InputGenerator::~InputGenerator()
+{
+    for(OrtValue* value: tensors){
+        worker->releaseValue(value);
+    }
+}
+
+void InputGenerator::generate()
+{
+    FastRandom &rng = FastRandom::local();
+    const std::vector<IOInfo> &signature = worker->getInputsSignature();
+    for(size_t i = 0; i < tensors.size(); ++i){
+        fill(buffers[i].data(), counts[i], signature[i].datatype, spec, rng);
+    }
+}
+
+uint16_t InputGenerator::floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+    if(exponent <= 0){
+        // flush what would be subnormal, inputs never need it
+        return (uint16_t)sign;
+    }
+    if(exponent >= 31){
+        return (uint16_t)(sign | 0x7C00u);
+    }
+    // round to nearest
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    return (uint16_t)(half + ((mantissa >> 12) & 1));
+}
+
+uint16_t InputGenerator::floatToBFloat16(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits += 0x7FFFu + ((bits >> 16) & 1);
+    return (uint16_t)(bits >> 16);
+}
+
+// out of range float to integer conversions are undefined, clamp first
+template<typename T>
+static void convert(T* dst, const float* src, size_t count)
+{
+    const float lowest = (float)std::numeric_limits<T>::lowest(), highest = (float)std::numeric_limits<T>::max();
+    for(size_t i = 0; i < count; ++i){
+        float value = floorf(src[i]);
+        if(!(value > lowest)){
+            dst[i] = std::numeric_limits<T>::lowest();
+        }
+        else if(value >= highest){
+            dst[i] = std::numeric_limits<T>::max();
+        }
+        else{
+            dst[i] = (T)value;
+        }
+    }
+}
+
+static bool isInteger(ONNXTensorElementDataType type)
+{
+    switch(type){
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void InputGenerator::fill(void* data, size_t count, ONNXTensorElementDataType type, const InputSpec &spec, FastRandom &rng)
+{
+    const bool integer = isInteger(type);
+    const float low = (float)(integer ? spec.int_low : spec.low), high = (float)(integer ? spec.int_high : spec.high);
+    if(type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT && spec.pattern == INPUT_RANDOM){
+        rng.fillUniform((float*)data, count, low, high);
+        return;
+    }
+
+    // everything else goes through a float block and a conversion
+    const size_t BLOCK = 256;
+    float values[BLOCK];
+    char* dst = (char*)data;
+    const size_t element = ONNXWorker::elementSize(type);
+    for(size_t begin = 0; begin < count; begin += BLOCK){
+        size_t n = count - begin < BLOCK ? count - begin : BLOCK;
+        switch(spec.pattern){
+            case INPUT_RANDOM:
+                rng.fillUniform(values, n, low, high);
+                break;
+            case INPUT_RAMP:
+                for(size_t k = 0; k < n; ++k){
+                    values[k] = low + (high - low) * (float)((begin + k) % 256) / 256.0f;
+                }
+                break;
+            default:{
+                float constant = spec.pattern == INPUT_ZEROS ? 0.0f : (spec.pattern == INPUT_ONES ? 1.0f : (float)spec.low);
+                for(size_t k = 0; k < n; ++k){
+                    values[k] = constant;
+                }
+                break;
+            }
+        }
+
+        void* out = dst + begin * element;
+        switch(type){
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT:
+                memcpy(out, values, n * sizeof(float));
+                break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE:
+                for(size_t k = 0; k < n; ++k){
+                    ((double*)out)[k] = values[k];
+                }
+                break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16:
+                for(size_t k = 0; k < n; ++k){
+                    ((uint16_t*)out)[k] = floatToHalf(values[k]);
+                }
+                break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16:
+                for(size_t k = 0; k < n; ++k){
+                    ((uint16_t*)out)[k] = floatToBFloat16(values[k]);
+                }
+                break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL:{
+                // random: true below the middle of the range, otherwise true for non zero
+                float threshold = spec.pattern == INPUT_RANDOM ? 0.5f * (low + high) : 0.0f;
+                for(size_t k = 0; k < n; ++k){
+                    ((uint8_t*)out)[k] = spec.pattern == INPUT_RANDOM ? values[k] < threshold : values[k] != 0.0f;
+                }
+                break;
+            }
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8: convert((int8_t*)out, values, n); break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8: convert((uint8_t*)out, values, n); break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16: convert((int16_t*)out, values, n); break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16: convert((uint16_t*)out, values, n); break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32: convert((int32_t*)out, values, n); break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32: convert((uint32_t*)out, values, n); break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64: convert((int64_t*)out, values, n); break;
+            case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64: convert((uint64_t*)out, values, n); break;
+            default:
+                // complex: real part only
+                memset(out, 0, n * element);
+                for(size_t k = 0; k < n; ++k){
+                    if(element == 8){
+                        ((float*)out)[2 * k] = values[k];
+                    }
+                    else{
+                        ((double*)out)[2 * k] = values[k];
+                    }
+                }
+                break;
+        }
+    }
+}
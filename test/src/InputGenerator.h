@@ -0,0 +1,62 @@
+#ifndef INPUTGENERATOR_H
+#define INPUTGENERATOR_H
+
+#include "ONNXWorker.h"
+#include "FastRandom.h"
+#include <stdint.h>
+#include <vector>
+
+enum InputPattern{
+    INPUT_RANDOM = 0,       // uniform in [low, high), integers in [int_low, int_high), bool true below the middle
+    INPUT_ZEROS,
+    INPUT_ONES,
+    INPUT_CONSTANT,         // low everywhere
+    INPUT_RAMP              // low .. high (int_low .. int_high) over 256 elements, repeated
+};
+
+// Integer types draw from their own range, [0, 1) floored would be all zeros;
+// values outside a type's range are clamped to it.
+struct InputSpec{
+    InputPattern pattern;
+    double low;
+    double high;
+    double int_low;
+    double int_high;
+    int64_t dynamic_dim;    // value for every dimension the model leaves free
+
+    InputSpec() : pattern(INPUT_RANDOM), low(0.0), high(1.0), int_low(0.0), int_high(10.0), dynamic_dim(1) {}
+};
+
+// Inputs for any model built from its cached signature: every numeric element
+// type, any rank, dynamic dimensions resolved from the spec. Buffers and
+// OrtValues are created once, generate() only rewrites the data, so a
+// benchmark can refresh inputs between runs for about the cost of a memset.
+// String and non tensor inputs are not supported.
+class InputGenerator
+{
+public:
+    InputGenerator(ONNXWorker* worker, const InputSpec &spec);
+    ~InputGenerator();
+
+    bool valid() const { return ok; }
+    // refills every input with the thread's generator
+    void generate();
+    const std::vector<OrtValue*> &values() const { return tensors; }
+    const std::vector<int64_t> &dims(size_t input) const { return shapes[input]; }
+
+    // count elements of type at data
+    static void fill(void* data, size_t count, ONNXTensorElementDataType type, const InputSpec &spec, FastRandom &rng);
+    static uint16_t floatToHalf(float value);
+    static uint16_t floatToBFloat16(float value);
+
+private:
+    ONNXWorker* worker;
+    InputSpec spec;
+    bool ok;
+    std::vector<std::vector<int64_t>> shapes;
+    std::vector<std::vector<uint64_t>> buffers;     // uint64_t keeps every type aligned
+    std::vector<size_t> counts;
+    std::vector<OrtValue*> tensors;
+};
+
+#endif
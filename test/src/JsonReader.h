@@ -0,0 +1,201 @@
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Just enough JSON for ORT profiles and benchmark results: objects, arrays,
+// strings, numbers, literals. Strings keep escapes other than \" and \\ undecoded.
+// JsonParser needs a null terminated buffer.
+struct JsonValue{
+    enum Type{ JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+    Type type;
+    double number;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    JsonValue() : type(JSON_NULL), number(0.0) {}
+
+    const JsonValue* find(const char* key) const
+    {
+        for(const auto &member: members){
+            if(member.first == key){
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser
+{
+public:
+    JsonParser(const char* begin, const char* end)
+        :   pos(begin), end(end)
+    {
+    }
+
+    bool parse(JsonValue &value)
+    {
+        return parseValue(value, 0) && (skipSpace(), pos == end);
+    }
+
+    size_t offset(const char* begin) const { return (size_t)(pos - begin); }
+
+private:
+    void skipSpace()
+    {
+        while(pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')){
+            ++pos;
+        }
+    }
+
+    bool literal(const char* word)
+    {
+        size_t len = strlen(word);
+        if((size_t)(end - pos) < len || memcmp(pos, word, len) != 0){
+            return false;
+        }
+        pos += len;
+        return true;
+    }
+
+    bool parseString(std::string &text)
+    {
+        ++pos;
+        text.clear();
+        while(pos < end && *pos != '"'){
+            if(*pos == '\\' && pos + 1 < end){
+                ++pos;
+                if(*pos != '"' && *pos != '\\' && *pos != '/'){
+                    text.push_back('\\');
+                }
+            }
+            text.push_back(*pos++);
+        }
+        if(pos == end){
+            return false;
+        }
+        ++pos;
+        return true;
+    }
+
+    bool parseValue(JsonValue &value, int depth)
+    {
+        skipSpace();
+        if(pos == end || depth > 64){
+            return false;
+        }
+        switch(*pos){
+            case '{':{
+                value.type = JsonValue::JSON_OBJECT;
+                ++pos;
+                skipSpace();
+                if(pos < end && *pos == '}'){
+                    ++pos;
+                    return true;
+                }
+                while(true){
+                    skipSpace();
+                    if(pos == end || *pos != '"'){
+                        return false;
+                    }
+                    value.members.emplace_back(std::string(), JsonValue());
+                    if(!parseString(value.members.back().first)){
+                        return false;
+                    }
+                    skipSpace();
+                    if(pos == end || *pos++ != ':' || !parseValue(value.members.back().second, depth + 1)){
+                        return false;
+                    }
+                    skipSpace();
+                    if(pos < end && *pos == ','){
+                        ++pos;
+                        continue;
+                    }
+                    return pos < end && *pos++ == '}';
+                }
+            }
+            case '[':{
+                value.type = JsonValue::JSON_ARRAY;
+                ++pos;
+                skipSpace();
+                if(pos < end && *pos == ']'){
+                    ++pos;
+                    return true;
+                }
+                while(true){
+                    value.items.emplace_back();
+                    if(!parseValue(value.items.back(), depth + 1)){
+                        return false;
+                    }
+                    skipSpace();
+                    if(pos < end && *pos == ','){
+                        ++pos;
+                        continue;
+                    }
+                    return pos < end && *pos++ == ']';
+                }
+            }
+            case '"':
+                value.type = JsonValue::JSON_STRING;
+                return parseString(value.text);
+            case 't':
+                value.type = JsonValue::JSON_BOOL;
+                value.number = 1.0;
+                return literal("true");
+            case 'f':
+                value.type = JsonValue::JSON_BOOL;
+                return literal("false");
+            case 'n':
+                return literal("null");
+            default:{
+                // strtod stops at the end of the number, the buffer is null terminated
+                char* stop = nullptr;
+                value.type = JsonValue::JSON_NUMBER;
+                value.number = strtod(pos, &stop);
+                if(stop == pos){
+                    return false;
+                }
+                pos = stop;
+                return true;
+            }
+        }
+    }
+
+private:
+    const char* pos;
+    const char* end;
+};
+
+// Reads and parses a whole file, who prefixes the error messages.
+inline bool loadJson(const std::string &path, JsonValue &root, const char* who)
+{
+    FILE* fp = fopen(path.c_str(), "rb");
+    if(fp == nullptr){
+        printf("%s - cannot open %s\n", who, path.c_str());
+        return false;
+    }
+    std::vector<char> buffer;
+    char chunk[65536];
+    size_t got;
+    while((got = fread(chunk, 1, sizeof(chunk), fp)) > 0){
+        buffer.insert(buffer.end(), chunk, chunk + got);
+    }
+    fclose(fp);
+    buffer.push_back('\0');
+
+    JsonParser parser(buffer.data(), buffer.data() + buffer.size() - 1);
+    if(!parser.parse(root)){
+        printf("%s - %s: invalid JSON near offset %zu\n", who, path.c_str(), parser.offset(buffer.data()));
+        return false;
+    }
+    return true;
+}
+
+#endif
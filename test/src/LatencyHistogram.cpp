@@ -0,0 +1,176 @@
+#include "LatencyHistogram.h"
+#include <math.h>
+
+namespace {
+const int SUB_BITS = 7;
+const uint64_t SUB_COUNT = 1ULL << SUB_BITS;        // 128
+const uint64_t HALF_COUNT = SUB_COUNT >> 1;         // 64
+const int MAX_BITS = 40;                            // 2^40 ns ~ 18 min
+const uint64_t MAX_VALUE = (1ULL << MAX_BITS) - 1;
+const size_t BUCKETS = (size_t)(MAX_BITS - SUB_BITS + 1) * HALF_COUNT + HALF_COUNT;
+}
+
+LatencyHistogram::LatencyHistogram()
+    :   counts(BUCKETS, 0)
+{
+    reset();
+}
+
+size_t LatencyHistogram::indexOf(uint64_t value)
+{
+    if(value < SUB_COUNT){
+        return (size_t)value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (SUB_BITS - 1);
+    return (size_t)shift * HALF_COUNT + (size_t)(value >> shift);
+}
+
+uint64_t LatencyHistogram::lowestAt(size_t index)
+{
+    if(index < SUB_COUNT){
+        return index;
+    }
+    size_t shift = index / HALF_COUNT - 1;
+    return (uint64_t)(index - shift * HALF_COUNT) << shift;
+}
+
+uint64_t LatencyHistogram::highestAt(size_t index)
+{
+    if(index < SUB_COUNT){
+        return index;
+    }
+    size_t shift = index / HALF_COUNT - 1;
+    return lowestAt(index) + (1ULL << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value_ns)
+{
+    if(value_ns > MAX_VALUE){
+        value_ns = MAX_VALUE;
+    }
+    ++counts[indexOf(value_ns)];
+    ++total;
+    min_value = value_ns < min_value ? value_ns : min_value;
+    max_value = value_ns > max_value ? value_ns : max_value;
+}
+
+void LatencyHistogram::recordCorrected(uint64_t value_ns, uint64_t expected_interval_ns)
+{
+    record(value_ns);
+    if(expected_interval_ns == 0 || value_ns <= expected_interval_ns){
+        return;
+    }
+    for(uint64_t missing = value_ns - expected_interval_ns; missing >= expected_interval_ns; missing -= expected_interval_ns){
+        record(missing);
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for(size_t i = 0; i < BUCKETS; ++i){
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    if(other.total > 0){
+        min_value = other.min_value < min_value ? other.min_value : min_value;
+        max_value = other.max_value > max_value ? other.max_value : max_value;
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for(auto &count: counts){
+        count = 0;
+    }
+    total = 0;
+    min_value = UINT64_MAX;
+    max_value = 0;
+}
+
+double LatencyHistogram::mean() const
+{
+    if(total == 0){
+        return 0.0;
+    }
+    double sum = 0.0;
+    for(size_t i = 0; i < BUCKETS; ++i){
+        if(counts[i] > 0){
+            sum += (double)counts[i] * (0.5 * (double)(lowestAt(i) + highestAt(i)));
+        }
+    }
+    return sum / (double)total;
+}
+
+double LatencyHistogram::stddev() const
+{
+    if(total == 0){
+        return 0.0;
+    }
+    double avg = mean(), sum = 0.0;
+    for(size_t i = 0; i < BUCKETS; ++i){
+        if(counts[i] > 0){
+            double d = 0.5 * (double)(lowestAt(i) + highestAt(i)) - avg;
+            sum += (double)counts[i] * d * d;
+        }
+    }
+    return sqrt(sum / (double)total);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    if(total == 0){
+        return 0;
+    }
+    p = p < 0.0 ? 0.0 : (p > 100.0 ? 100.0 : p);
+    uint64_t target = (uint64_t)ceil(p / 100.0 * (double)total);
+    target = target == 0 ? 1 : target;
+    uint64_t seen = 0;
+    for(size_t i = 0; i < BUCKETS; ++i){
+        seen += counts[i];
+        if(seen >= target){
+            uint64_t value = highestAt(i);
+            return value < max_value ? value : max_value;
+        }
+    }
+    return max_value;
+}
+
+void LatencyHistogram::printDistribution(FILE* out, double unit_ns, int ticks_per_half) const
+{
+    fprintf(out, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+    if(total == 0){
+        return;
+    }
+    ticks_per_half = ticks_per_half > 0 ? ticks_per_half : 5;
+    // percentile steps halve the remaining distance to 100 every ticks_per_half lines
+    double p = 0.0;
+    uint64_t seen = 0;
+    size_t index = 0;
+    while(true){
+        uint64_t target = (uint64_t)ceil(p / 100.0 * (double)total);
+        target = target == 0 ? 1 : target;
+        while(seen + counts[index] < target){
+            seen += counts[index++];
+        }
+        double value = (double)(highestAt(index) < max_value ? highestAt(index) : max_value);
+        uint64_t count_at = seen + counts[index];
+        if(count_at >= total){
+            fprintf(out, "%12.3f %14.12f %10llu\n", value / unit_ns, 1.0, (unsigned long long)total);
+            break;
+        }
+        fprintf(out, "%12.3f %14.12f %10llu %14.2f\n", value / unit_ns, p / 100.0, (unsigned long long)count_at,
+                100.0 / (100.0 - p));
+        double half_distance = pow(2.0, floor(log2(100.0 / (100.0 - p))) + 1.0);
+        p += 100.0 / (half_distance * ticks_per_half);
+    }
+    fprintf(out, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean() / unit_ns, stddev() / unit_ns);
+    fprintf(out, "#[Max     = %12.3f, Total count    = %12llu]\n", (double)max_value / unit_ns, (unsigned long long)total);
+}
+
+void LatencyHistogram::printSummary(FILE* out, const char* label) const
+{
+    fprintf(out, "%-24s count %8llu | p50 %9.3f p90 %9.3f p99 %9.3f p99.9 %9.3f max %9.3f ms\n", label,
+            (unsigned long long)total, percentile(50.0) / 1e6, percentile(90.0) / 1e6, percentile(99.0) / 1e6,
+            percentile(99.9) / 1e6, (double)max() / 1e6);
+}
@@ -0,0 +1,51 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// Log-linear histogram in the HdrHistogram layout: 64 linear sub-buckets per
+// power of two, so any recorded value is kept within 1/64 (~1.6%) of its
+// true value from 1 ns up to ~18 minutes at a fixed 2.3k counters. Recording
+// is a couple of shifts and an increment. Not thread safe, keep one per
+// thread and merge().
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(uint64_t value_ns);
+    // Coordinated omission correction for a loop that meant to issue a request
+    // every expected_interval_ns: a stall of value_ns also delayed the requests
+    // that should have been sent meanwhile, record them too.
+    void recordCorrected(uint64_t value_ns, uint64_t expected_interval_ns);
+    void merge(const LatencyHistogram &other);
+    void reset();
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total > 0 ? min_value : 0; }
+    uint64_t max() const { return max_value; }
+    double mean() const;
+    double stddev() const;
+    // highest value equivalent to the percentile (0..100)
+    uint64_t percentile(double p) const;
+
+    // HdrHistogram percentile distribution text, values divided by unit_ns
+    void printDistribution(FILE* out, double unit_ns, int ticks_per_half) const;
+    // one line: count, p50, p90, p99, p99.9, max in ms
+    void printSummary(FILE* out, const char* label) const;
+
+private:
+    static size_t indexOf(uint64_t value);
+    static uint64_t lowestAt(size_t index);
+    static uint64_t highestAt(size_t index);
+
+private:
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t min_value;
+    uint64_t max_value;
+};
+
+#endif
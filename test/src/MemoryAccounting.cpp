@@ -0,0 +1,135 @@
+#include "MemoryAccounting.h"
+#include "Metrics.h"
+#include <stdlib.h>
+
+namespace {
+
+std::atomic<bool> accounting_on(false);
+
+void raiseTo(std::atomic<int64_t> &target, int64_t value)
+{
+    int64_t seen = target.load(std::memory_order_relaxed);
+    while(value > seen && !target.compare_exchange_weak(seen, value, std::memory_order_relaxed)){
+    }
+}
+
+void raiseTo(std::atomic<uint64_t> &target, uint64_t value)
+{
+    uint64_t seen = target.load(std::memory_order_relaxed);
+    while(value > seen && !target.compare_exchange_weak(seen, value, std::memory_order_relaxed)){
+    }
+}
+
+}
+
+thread_local MemoryScope* MemoryScope::innermost = nullptr;
+
+MemoryAccount::MemoryAccount()
+    :   heap_bytes(0),
+        heap_peak(0),
+        construct_bytes(0),
+        runs(0),
+        last_run_peak(0),
+        max_run_peak(0),
+        sum_run_peak(0),
+        metric_heap(nullptr),
+        metric_run_peak(nullptr)
+{
+}
+
+MemoryStats MemoryAccount::stats() const
+{
+    MemoryStats stats;
+    stats.heap_bytes = heap_bytes.load(std::memory_order_relaxed);
+    stats.heap_peak_bytes = heap_peak.load(std::memory_order_relaxed);
+    stats.construct_bytes = construct_bytes.load(std::memory_order_relaxed);
+    stats.runs = runs.load(std::memory_order_relaxed);
+    stats.last_run_peak = last_run_peak.load(std::memory_order_relaxed);
+    stats.max_run_peak = max_run_peak.load(std::memory_order_relaxed);
+    stats.mean_run_peak = stats.runs > 0 ? (double)sum_run_peak.load(std::memory_order_relaxed) / stats.runs : 0.0;
+    return stats;
+}
+
+MemoryScope::MemoryScope(MemoryAccount* account, bool is_run)
+    :   account(MemoryAccounting::enabled() ? account : nullptr),
+        outer(nullptr),
+        net(0),
+        peak(0),
+        is_run(is_run)
+{
+    if(this->account != nullptr){
+        outer = innermost;
+        innermost = this;
+    }
+}
+
+MemoryScope::~MemoryScope()
+{
+    end();
+}
+
+void MemoryScope::end()
+{
+    if(account == nullptr){
+        return;
+    }
+    innermost = outer;
+    commit();
+    account = nullptr;
+}
+
+void MemoryScope::commit()
+{
+    if(account == nullptr){
+        return;
+    }
+    // the level other threads left is only approximately the start of this scope
+    const int64_t start = account->heap_bytes.fetch_add(net, std::memory_order_relaxed);
+    raiseTo(account->heap_peak, start + peak);
+    if(account->metric_heap != nullptr){
+        account->metric_heap->add(net);
+    }
+    if(is_run){
+        account->runs.fetch_add(1, std::memory_order_relaxed);
+        account->last_run_peak.store((uint64_t)peak, std::memory_order_relaxed);
+        raiseTo(account->max_run_peak, (uint64_t)peak);
+        account->sum_run_peak.fetch_add((uint64_t)peak, std::memory_order_relaxed);
+        if(account->metric_run_peak != nullptr){
+            account->metric_run_peak->observe((double)peak);
+        }
+    }
+    net = 0;
+    peak = 0;
+}
+
+void MemoryAccounting::setEnabled(bool on)
+{
+    // without the wrappers a scope would only ever commit zeros
+    accounting_on.store(on && available(), std::memory_order_relaxed);
+}
+
+bool MemoryAccounting::enabled()
+{
+    return accounting_on.load(std::memory_order_relaxed);
+}
+
+bool MemoryAccounting::available()
+{
+    // a block malloc'ed inside a scope shows in the account only if the
+    // wrappers of MemoryInterposer.cpp are the malloc everyone calls
+    static const bool hooked = []{
+        const bool was_on = accounting_on.exchange(true, std::memory_order_relaxed);
+        // called through pointers: builtin malloc is assumed not to read
+        // the scope, so its store could be sunk past a direct call
+        void* (*volatile allocate)(size_t) = malloc;
+        void (*volatile release)(void*) = free;
+        MemoryAccount probe;
+        {
+            MemoryScope scope(&probe);
+            release(allocate(256));
+        }
+        accounting_on.store(was_on, std::memory_order_relaxed);
+        return probe.heap_peak.load(std::memory_order_relaxed) >= 256;
+    }();
+    return hooked;
+}
@@ -0,0 +1,106 @@
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include <stdint.h>
+#include <atomic>
+
+class MetricGauge;
+class MetricHistogram;
+
+// Heap use of one session, in malloc usable bytes. heap_bytes is what the
+// session holds now: the parsed model, initializers, kernel state, arena
+// chunks, plus ORT allocated outputs the caller has not released yet.
+// A run peak is how far the heap rose above its level at Run start; with the
+// CPU arena on a warm Run is served from arena chunks and peaks near 0, with
+// WorkerOptions::memory_arena off it is the Run's real working set.
+struct MemoryStats{
+    int64_t heap_bytes;
+    int64_t heap_peak_bytes;
+    int64_t construct_bytes;    // held when the constructor returned
+    uint64_t runs;              // runs counted while accounting was on
+    uint64_t last_run_peak;
+    uint64_t max_run_peak;
+    double mean_run_peak;
+};
+
+// Totals of one session, updated when a MemoryScope ends.
+struct MemoryAccount{
+    std::atomic<int64_t> heap_bytes;
+    std::atomic<int64_t> heap_peak;
+    std::atomic<int64_t> construct_bytes;
+    std::atomic<uint64_t> runs;
+    std::atomic<uint64_t> last_run_peak;
+    std::atomic<uint64_t> max_run_peak;
+    std::atomic<uint64_t> sum_run_peak;
+    // onnx_heap_bytes / onnx_run_peak_bytes of the model, null when metrics are off
+    MetricGauge* metric_heap;
+    MetricHistogram* metric_run_peak;
+
+    MemoryAccount();
+    MemoryStats stats() const;
+};
+
+// Attributes the calling thread's malloc, free and operator new traffic to an
+// account until the scope ends; nested scopes take over and give back. The
+// counting is done by MemoryInterposer.cpp, which replaces malloc and friends
+// with thin wrappers over glibc's __libc_* entry points, so ORT's own
+// allocations (its CPU arena included) are seen. Only binaries that link it
+// pay for the wrappers, one thread local load per call on threads without a
+// scope. Only the scoped thread is counted: allocations of ORT's intra-op
+// pool threads are not, which is everything with the default single thread.
+// Does nothing unless MemoryAccounting is enabled.
+class MemoryScope
+{
+public:
+    explicit MemoryScope(MemoryAccount* account, bool is_run = false);
+    ~MemoryScope();
+
+    // moves the tally so far into the account and starts a new one
+    void commit();
+    // ends the scope before its destructor, which then does nothing
+    void end();
+
+    // innermost scope of the calling thread, null outside any scope
+    static MemoryScope* current()
+    {
+        return innermost;
+    }
+
+    // called by the malloc wrappers
+    void add(int64_t bytes)
+    {
+        net += bytes;
+        if(net > peak){
+            peak = net;
+        }
+    }
+
+private:
+    MemoryScope(const MemoryScope &) = delete;
+    MemoryScope &operator=(const MemoryScope &) = delete;
+
+    // a plain pointer so the wrappers never allocate to reach it
+    static thread_local MemoryScope* innermost;
+
+    MemoryAccount* account;
+    MemoryScope* outer;
+    int64_t net;
+    int64_t peak;
+    bool is_run;
+};
+
+class MemoryAccounting
+{
+public:
+    // Turn on before the workers are constructed, or their construction and
+    // the values they hold are missing from the totals. Stays off when the
+    // binary does not link MemoryInterposer.cpp.
+    static void setEnabled(bool on);
+    static bool enabled();
+    // false when the malloc wrappers are not the process' malloc, e.g. a
+    // binary without MemoryInterposer.cpp, a non glibc build or this code in
+    // a library loaded after libc
+    static bool available();
+};
+
+#endif
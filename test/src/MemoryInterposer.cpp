@@ -0,0 +1,113 @@
+#include "MemoryAccounting.h"
+#include <errno.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Replaces the process' malloc family so MemoryScope can count it. Linked
+// only into the binaries that report memory; everything else keeps glibc's
+// malloc untouched and MemoryAccounting::available() returns false there.
+
+#if defined(__GLIBC__)
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+static void* counted(void* ptr)
+{
+    MemoryScope* scope = MemoryScope::current();
+    if(ptr != nullptr && scope != nullptr){
+        scope->add((int64_t)malloc_usable_size(ptr));
+    }
+    return ptr;
+}
+
+void* malloc(size_t size)
+{
+    return counted(__libc_malloc(size));
+}
+
+void* calloc(size_t count, size_t size)
+{
+    return counted(__libc_calloc(count, size));
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    return counted(__libc_memalign(alignment, size));
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    return counted(__libc_memalign(alignment, size));
+}
+
+void* valloc(size_t size)
+{
+    return counted(__libc_memalign((size_t)sysconf(_SC_PAGESIZE), size));
+}
+
+void* pvalloc(size_t size)
+{
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return counted(__libc_memalign(page, (size + page - 1) & ~(page - 1)));
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size)
+{
+    if(alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0){
+        return EINVAL;
+    }
+    void* ptr = counted(__libc_memalign(alignment, size));
+    if(ptr == nullptr){
+        return ENOMEM;
+    }
+    *out = ptr;
+    return 0;
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    MemoryScope* scope = MemoryScope::current();
+    if(scope == nullptr){
+        return __libc_realloc(ptr, size);
+    }
+    const int64_t before = ptr != nullptr ? (int64_t)malloc_usable_size(ptr) : 0;
+    void* moved = __libc_realloc(ptr, size);
+    if(moved != nullptr){
+        scope->add((int64_t)malloc_usable_size(moved) - before);
+    }
+    else if(size == 0){
+        scope->add(-before);
+    }
+    return moved;
+}
+
+// glibc's own reallocarray calls its internal realloc, past the wrapper above
+void* reallocarray(void* ptr, size_t count, size_t size)
+{
+    size_t bytes;
+    if(__builtin_mul_overflow(count, size, &bytes)){
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return realloc(ptr, bytes);
+}
+
+void free(void* ptr)
+{
+    MemoryScope* scope = MemoryScope::current();
+    if(ptr != nullptr && scope != nullptr){
+        scope->add(-(int64_t)malloc_usable_size(ptr));
+    }
+    __libc_free(ptr);
+}
+
+}
+
+#endif
@@ -0,0 +1,252 @@
+#include "Metrics.h"
+#include "ModelFiles.h"
+#include <stdio.h>
+#include <unistd.h>
+
+MetricCounter::MetricCounter()
+{
+    for(int i = 0; i < CELLS; ++i){
+        cells[i].value.store(0, std::memory_order_relaxed);
+    }
+}
+
+int MetricCounter::cellIndex()
+{
+    static std::atomic<int> next_thread(0);
+    static thread_local int index = next_thread.fetch_add(1, std::memory_order_relaxed) % CELLS;
+    return index;
+}
+
+uint64_t MetricCounter::value() const
+{
+    uint64_t total = 0;
+    for(int i = 0; i < CELLS; ++i){
+        total += cells[i].value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+MetricHistogram::MetricHistogram(const std::vector<double> &bounds)
+    :   bounds(bounds),
+        counts(new std::atomic<uint64_t>[bounds.size() + 1]),
+        sum_micro(0)
+{
+    for(size_t i = 0; i <= bounds.size(); ++i){
+        counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void MetricHistogram::snapshot(std::vector<uint64_t> &buckets, double &sum) const
+{
+    buckets.resize(bounds.size() + 1);
+    for(size_t i = 0; i <= bounds.size(); ++i){
+        buckets[i] = counts[i].load(std::memory_order_relaxed);
+    }
+    sum = (double)sum_micro.load(std::memory_order_relaxed) / 1e6;
+}
+
+std::vector<double> MetricHistogram::latencyBounds()
+{
+    return std::vector<double>{0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+                               0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0};
+}
+
+std::vector<double> MetricHistogram::byteBounds()
+{
+    std::vector<double> bounds;
+    for(double bytes = 1024.0; bytes <= 4294967296.0; bytes *= 4.0){
+        bounds.emplace_back(bytes);
+    }
+    return bounds;
+}
+
+std::vector<double> MetricHistogram::powersOfTwo(int count)
+{
+    std::vector<double> bounds;
+    for(int i = 0; i < count; ++i){
+        bounds.emplace_back((double)(1ULL << i));
+    }
+    return bounds;
+}
+
+MetricsRegistry &MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::MetricsRegistry()
+    :   on(false)
+{
+    MetricGauge* resident = gauge("process_resident_memory_bytes", "Resident memory size in bytes.");
+    MetricGauge* virtual_size = gauge("process_virtual_memory_bytes", "Virtual memory size in bytes.");
+    const long page = sysconf(_SC_PAGESIZE);
+    collectors.emplace_back([resident, virtual_size, page]{
+        FILE* fp = fopen("/proc/self/statm", "r");
+        if(fp == nullptr){
+            return;
+        }
+        unsigned long long pages = 0, resident_pages = 0;
+        if(fscanf(fp, "%llu %llu", &pages, &resident_pages) == 2){
+            virtual_size->set((int64_t)(pages * page));
+            resident->set((int64_t)(resident_pages * page));
+        }
+        fclose(fp);
+    });
+}
+
+MetricsRegistry::Entry* MetricsRegistry::find(Kind kind, const std::string &name, const std::string &labels)
+{
+    for(Entry &entry: entries){
+        if(entry.name == name && entry.labels == labels){
+            return entry.kind == kind ? &entry : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+MetricCounter* MetricsRegistry::counter(const std::string &name, const std::string &help, const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    Entry* entry = find(KIND_COUNTER, name, labels);
+    if(entry == nullptr){
+        entries.emplace_back();
+        entry = &entries.back();
+        entry->kind = KIND_COUNTER;
+        entry->name = name;
+        entry->help = help;
+        entry->labels = labels;
+        entry->counter.reset(new MetricCounter);
+    }
+    return entry->counter.get();
+}
+
+MetricGauge* MetricsRegistry::gauge(const std::string &name, const std::string &help, const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    Entry* entry = find(KIND_GAUGE, name, labels);
+    if(entry == nullptr){
+        entries.emplace_back();
+        entry = &entries.back();
+        entry->kind = KIND_GAUGE;
+        entry->name = name;
+        entry->help = help;
+        entry->labels = labels;
+        entry->gauge.reset(new MetricGauge);
+    }
+    return entry->gauge.get();
+}
+
+MetricHistogram* MetricsRegistry::histogram(const std::string &name, const std::string &help, const std::string &labels,
+                                            const std::vector<double> &bounds)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    Entry* entry = find(KIND_HISTOGRAM, name, labels);
+    if(entry == nullptr){
+        entries.emplace_back();
+        entry = &entries.back();
+        entry->kind = KIND_HISTOGRAM;
+        entry->name = name;
+        entry->help = help;
+        entry->labels = labels;
+        entry->histogram.reset(new MetricHistogram(bounds));
+    }
+    return entry->histogram.get();
+}
+
+void MetricsRegistry::addCollector(const std::function<void()> &collector)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    collectors.emplace_back(collector);
+}
+
+std::string MetricsRegistry::label(const std::string &key, const std::string &value)
+{
+    std::string text = key + "=\"";
+    for(char c: value){
+        if(c == '\\' || c == '"'){
+            text.push_back('\\');
+            text.push_back(c);
+        }
+        else if(c == '\n'){
+            text += "\\n";
+        }
+        else{
+            text.push_back(c);
+        }
+    }
+    text.push_back('"');
+    return text;
+}
+
+std::string MetricsRegistry::modelLabel(const std::string &model_path)
+{
+    return label("model", modelFileName(model_path));
+}
+
+static void appendValue(std::string &out, const std::string &name, const std::string &labels, const char* format, double value)
+{
+    char number[64];
+    snprintf(number, sizeof(number), format, value);
+    out += name;
+    if(!labels.empty()){
+        out += "{" + labels + "}";
+    }
+    out += " ";
+    out += number;
+    out += "\n";
+}
+
+void MetricsRegistry::render(std::string &out)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    for(auto &collector: collectors){
+        collector();
+    }
+    out.clear();
+    // entries of one name are written together under one HELP / TYPE
+    std::vector<bool> written(entries.size(), false);
+    std::vector<uint64_t> buckets;
+    for(size_t i = 0; i < entries.size(); ++i){
+        if(written[i]){
+            continue;
+        }
+        const Entry &first = entries[i];
+        const char* type = first.kind == KIND_COUNTER ? "counter" : (first.kind == KIND_GAUGE ? "gauge" : "histogram");
+        out += "# HELP " + first.name + " " + first.help + "\n";
+        out += "# TYPE " + first.name + " " + type + "\n";
+        for(size_t j = i; j < entries.size(); ++j){
+            const Entry &entry = entries[j];
+            if(written[j] || entry.name != first.name || entry.kind != first.kind){
+                continue;
+            }
+            written[j] = true;
+            if(entry.kind == KIND_COUNTER){
+                appendValue(out, entry.name, entry.labels, "%.0f", (double)entry.counter->value());
+            }
+            else if(entry.kind == KIND_GAUGE){
+                appendValue(out, entry.name, entry.labels, "%.0f", (double)entry.gauge->value());
+            }
+            else{
+                double sum = 0.0;
+                entry.histogram->snapshot(buckets, sum);
+                const std::vector<double> &bounds = entry.histogram->upperBounds();
+                const std::string prefix = entry.labels.empty() ? "" : entry.labels + ",";
+                uint64_t cumulative = 0;
+                char le[64];
+                for(size_t b = 0; b < buckets.size(); ++b){
+                    cumulative += buckets[b];
+                    if(b < bounds.size()){
+                        snprintf(le, sizeof(le), "le=\"%g\"", bounds[b]);
+                    }
+                    else{
+                        snprintf(le, sizeof(le), "le=\"+Inf\"");
+                    }
+                    appendValue(out, entry.name + "_bucket", prefix + le, "%.0f", (double)cumulative);
+                }
+                appendValue(out, entry.name + "_sum", entry.labels, "%.6f", sum);
+                appendValue(out, entry.name + "_count", entry.labels, "%.0f", (double)cumulative);
+            }
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Monotonic counter striped over cache lines, so threads updating the same
+// counter mostly do not share a line. inc() is one relaxed fetch_add.
+class MetricCounter
+{
+public:
+    MetricCounter();
+    void inc(uint64_t n = 1)
+    {
+        cells[cellIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t value() const;
+
+private:
+    static const int CELLS = 8;
+    struct Cell{
+        std::atomic<uint64_t> value;
+        char pad[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    static int cellIndex();
+
+    Cell cells[CELLS];
+};
+
+class MetricGauge
+{
+public:
+    MetricGauge() : current(0) {}
+    void set(int64_t value) { current.store(value, std::memory_order_relaxed); }
+    void add(int64_t delta) { current.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t value() const { return current.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> current;
+};
+
+// Fixed upper bounds (Prometheus "le"), observe() is a short search and two
+// relaxed fetch_adds. The sum is kept in millionths of the unit.
+class MetricHistogram
+{
+public:
+    explicit MetricHistogram(const std::vector<double> &bounds);
+    void observe(double value)
+    {
+        size_t i = 0;
+        while(i < bounds.size() && value > bounds[i]){
+            ++i;
+        }
+        counts[i].fetch_add(1, std::memory_order_relaxed);
+        sum_micro.fetch_add((uint64_t)(value > 0.0 ? value * 1e6 + 0.5 : 0.0), std::memory_order_relaxed);
+    }
+    const std::vector<double> &upperBounds() const { return bounds; }
+    // per bucket, not cumulative; the last entry is +Inf
+    void snapshot(std::vector<uint64_t> &buckets, double &sum) const;
+
+    static std::vector<double> latencyBounds();     // 50 us .. 10 s
+    static std::vector<double> byteBounds();        // 1 KiB .. 4 GiB, x4
+    static std::vector<double> powersOfTwo(int count);
+
+private:
+    std::vector<double> bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> counts;
+    std::atomic<uint64_t> sum_micro;
+};
+
+// Process wide registry. Metrics are created on first lookup of a
+// (name, labels) pair and live until exit, so callers keep the pointer and
+// update it without any lookup. labels is the inside of the braces, e.g.
+// model="mlp.onnx", built with label().
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry &instance();
+
+    // update paths that need a clock read check this first
+    static bool enabled() { return instance().on.load(std::memory_order_relaxed); }
+    static void setEnabled(bool value) { instance().on.store(value, std::memory_order_relaxed); }
+
+    MetricCounter* counter(const std::string &name, const std::string &help, const std::string &labels = "");
+    MetricGauge* gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+    MetricHistogram* histogram(const std::string &name, const std::string &help, const std::string &labels,
+                               const std::vector<double> &bounds);
+
+    // called before every render() to refresh gauges that are sampled
+    void addCollector(const std::function<void()> &collector);
+
+    // Prometheus text exposition format 0.0.4
+    void render(std::string &out);
+
+    static std::string label(const std::string &key, const std::string &value);
+    // model file name from a path, for model labels
+    static std::string modelLabel(const std::string &model_path);
+
+private:
+    MetricsRegistry();
+
+    enum Kind{ KIND_COUNTER, KIND_GAUGE, KIND_HISTOGRAM };
+    struct Entry{
+        Kind kind;
+        std::string name;
+        std::string help;
+        std::string labels;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        std::unique_ptr<MetricHistogram> histogram;
+    };
+    Entry* find(Kind kind, const std::string &name, const std::string &labels);
+
+    std::atomic<bool> on;
+    std::mutex mtx;
+    std::deque<Entry> entries;
+    std::vector<std::function<void()>> collectors;
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "MetricsServer.h"
+#include "Metrics.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// "GET /metrics" or "GET /", optionally with a query; not /metricsfoo
+static bool servesMetrics(const char* request)
+{
+    if(strncmp(request, "GET /", 5) != 0){
+        return false;
+    }
+    const char* end = request + 5;
+    if(strncmp(end, "metrics", 7) == 0){
+        end += 7;
+    }
+    return *end == ' ' || *end == '?' || *end == '\r' || *end == '\n' || *end == '\0';
+}
+
+MetricsServer::MetricsServer()
+    :   listen_fd(-1)
+{
+    wake_fds[0] = wake_fds[1] = -1;
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start(const std::string &address)
+{
+    if(listen_fd >= 0){
+        return false;
+    }
+    std::string path = address.compare(0, 5, "unix:") == 0 ? address.substr(5) : address;
+    if(!path.empty() && path[0] == '/'){
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if(path.size() >= sizeof(addr.sun_path)){
+            printf("MetricsServer::start() - socket path too long: %s\n", path.c_str());
+            return false;
+        }
+        strcpy(addr.sun_path, path.c_str());
+        // a stale socket of an earlier run is replaced, anything else is left alone
+        struct stat st;
+        if(lstat(path.c_str(), &st) == 0){
+            if(!S_ISSOCK(st.st_mode)){
+                printf("MetricsServer::start() - %s exists and is not a socket\n", path.c_str());
+                return false;
+            }
+            unlink(path.c_str());
+        }
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(listen_fd < 0 || bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) != 0){
+            printf("MetricsServer::start() - cannot bind %s: %s\n", path.c_str(), strerror(errno));
+            stop();
+            return false;
+        }
+        unix_path = path;
+    }
+    else{
+        size_t colon = address.find(':');
+        std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+        int port = atoi(colon == std::string::npos ? address.c_str() : address.c_str() + colon + 1);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        if(port <= 0 || port > 65535 || inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1){
+            printf("MetricsServer::start() - bad address %s\n", address.c_str());
+            return false;
+        }
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+        if(listen_fd >= 0){
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        if(listen_fd < 0 || bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) != 0){
+            printf("MetricsServer::start() - cannot bind %s: %s\n", address.c_str(), strerror(errno));
+            stop();
+            return false;
+        }
+    }
+    if(listen(listen_fd, 8) != 0 || pipe2(wake_fds, O_CLOEXEC) != 0){
+        printf("MetricsServer::start() - cannot listen on %s: %s\n", address.c_str(), strerror(errno));
+        stop();
+        return false;
+    }
+    thread = std::thread(&MetricsServer::serveLoop, this);
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if(thread.joinable()){
+        char byte = 0;
+        if(write(wake_fds[1], &byte, 1) != 1){
+            printf("MetricsServer::stop() - cannot wake server thread\n");
+        }
+        thread.join();
+    }
+    for(int &fd: wake_fds){
+        if(fd >= 0){
+            close(fd);
+            fd = -1;
+        }
+    }
+    if(listen_fd >= 0){
+        close(listen_fd);
+        listen_fd = -1;
+    }
+    if(!unix_path.empty()){
+        unlink(unix_path.c_str());
+        unix_path.clear();
+    }
+}
+
+void MetricsServer::serveLoop()
+{
+    pollfd fds[2];
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_fds[0];
+    fds[1].events = POLLIN;
+    while(true){
+        if(poll(fds, 2, -1) < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return;
+        }
+        if(fds[1].revents != 0){
+            return;
+        }
+        if(fds[0].revents & POLLIN){
+            int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if(client >= 0){
+                handle(client);
+                close(client);
+            }
+        }
+    }
+}
+
+void MetricsServer::handle(int fd)
+{
+    // a slow or silent client must not hold the endpoint
+    timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char request[4096];
+    size_t used = 0;
+    while(used < sizeof(request) - 1){
+        ssize_t got = read(fd, request + used, sizeof(request) - 1 - used);
+        if(got <= 0){
+            break;
+        }
+        used += (size_t)got;
+        request[used] = '\0';
+        if(strstr(request, "\r\n\r\n") != nullptr || strstr(request, "\n\n") != nullptr){
+            break;
+        }
+    }
+    request[used] = '\0';
+
+    std::string body;
+    const char* status = "200 OK";
+    if(servesMetrics(request)){
+        MetricsRegistry::instance().render(body);
+    }
+    else{
+        status = "404 Not Found";
+        body = "GET /metrics\n";
+    }
+    char header[256];
+    int length = snprintf(header, sizeof(header),
+                          "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                          status, body.size());
+    std::string response(header, (size_t)length);
+    response += body;
+    size_t sent = 0;
+    while(sent < response.size()){
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if(n <= 0){
+            break;
+        }
+        sent += (size_t)n;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <string>
+#include <thread>
+
+// Minimal HTTP/1.0 endpoint serving MetricsRegistry::render() on GET
+// /metrics, one connection at a time from its own thread. The address is a
+// Unix socket path ("unix:/run/onnx.sock" or "/run/onnx.sock", scraped with
+// curl --unix-socket) or a TCP port bound to loopback ("9464" or
+// "127.0.0.1:9464"). A stale socket at the path is replaced; start() fails if
+// anything else is there. Any other request target gets 404.
+class MetricsServer
+{
+public:
+    MetricsServer();
+    ~MetricsServer();
+
+    bool start(const std::string &address);
+    void stop();
+    bool running() const { return listen_fd >= 0; }
+
+private:
+    void serveLoop();
+    void handle(int fd);
+
+private:
+    int listen_fd;
+    int wake_fds[2];
+    std::string unix_path;      // unlinked on stop
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "MicroBench.h"
+#include <algorithm>
+#include <cmath>
+
+MicroBench::MicroBench(const BenchConfig &config)
+    :   config(config)
+{
+}
+
+void MicroBench::medianMad(std::vector<double> &values, double &median, double &mad)
+{
+    median = 0.0;
+    mad = 0.0;
+    if(values.empty()){
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    const size_t n = values.size();
+    median = n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+    std::vector<double> deviations;
+    for(double v: values){
+        deviations.emplace_back(std::fabs(v - median));
+    }
+    std::sort(deviations.begin(), deviations.end());
+    // 1.4826 makes the MAD a sigma estimate for normal data
+    mad = 1.4826 * (n % 2 ? deviations[n / 2] : 0.5 * (deviations[n / 2 - 1] + deviations[n / 2]));
+}
+
+// two sided 95% Student t for n - 1 degrees of freedom
+static double t95(size_t n)
+{
+    static const double table[] = {12.71, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if(n < 2){
+        return 0.0;
+    }
+    return n - 1 <= sizeof(table) / sizeof(table[0]) ? table[n - 2] : 1.96;
+}
+
+const BenchResult &MicroBench::record(const std::string &name, uint64_t calls, std::vector<double> &samples)
+{
+    BenchResult result;
+    result.name = name;
+    result.calls_per_sample = calls;
+    result.rejected = 0;
+
+    double median = 0.0, mad = 0.0;
+    medianMad(samples, median, mad);
+    // a very tight MAD would reject samples that differ by clock jitter only
+    const double limit = std::max(config.outlier_mads * mad, 0.01 * median);
+    for(double v: samples){
+        if(std::fabs(v - median) > limit){
+            ++result.rejected;
+        }
+        else{
+            result.samples.emplace_back(v);
+        }
+    }
+
+    medianMad(result.samples, result.median_ns, result.mad_ns);
+    const size_t n = result.samples.size();
+    double sum = 0.0;
+    for(double v: result.samples){
+        sum += v;
+    }
+    result.mean_ns = n > 0 ? sum / n : 0.0;
+    double var = 0.0;
+    for(double v: result.samples){
+        var += (v - result.mean_ns) * (v - result.mean_ns);
+    }
+    result.ci95_ns = n > 1 ? t95(n) * std::sqrt(var / (n - 1) / n) : 0.0;
+    result.min_ns = n > 0 ? result.samples.front() : 0.0;
+    entries.emplace_back(result);
+    return entries.back();
+}
+
+void MicroBench::print(FILE* out) const
+{
+    fprintf(out, "%-34s %12s %10s %12s %10s %8s %10s\n", "benchmark", "median ns", "MAD", "mean ns", "+-95%", "kept", "calls");
+    for(const BenchResult &r: entries){
+        fprintf(out, "%-34s %12.1f %10.1f %12.1f %10.1f %4zu/%-3zu %10llu\n", r.name.c_str(), r.median_ns, r.mad_ns,
+                r.mean_ns, r.ci95_ns, r.samples.size(), r.samples.size() + r.rejected, (unsigned long long)r.calls_per_sample);
+    }
+}
+
+bool MicroBench::writeJson(const std::string &path) const
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if(fp == nullptr){
+        printf("MicroBench::writeJson() - cannot open %s\n", path.c_str());
+        return false;
+    }
+    fprintf(fp, "{\"tool\": \"microBench\", \"unit\": \"ns\", \"results\": [");
+    for(size_t i = 0; i < entries.size(); ++i){
+        const BenchResult &r = entries[i];
+        fprintf(fp, "%s\n  {\"name\": \"%s\", \"calls_per_sample\": %llu, \"rejected\": %zu, \"median\": %.3f, \"mad\": %.3f, "
+                "\"mean\": %.3f, \"ci95\": %.3f, \"samples\": [", i ? "," : "", r.name.c_str(),
+                (unsigned long long)r.calls_per_sample, r.rejected, r.median_ns, r.mad_ns, r.mean_ns, r.ci95_ns);
+        for(size_t k = 0; k < r.samples.size(); ++k){
+            fprintf(fp, "%s%.3f", k ? ", " : "", r.samples[k]);
+        }
+        fprintf(fp, "]}");
+    }
+    fprintf(fp, "\n]}\n");
+    return fclose(fp) == 0;
+}
@@ -0,0 +1,92 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct BenchConfig{
+    int repetitions;        // samples taken after warmup
+    int warmup;             // samples thrown away
+    double sample_us;       // calls per sample are doubled until a sample lasts this long
+    double outlier_mads;    // samples further than this many scaled MADs (and 1%) from the median are dropped
+
+    BenchConfig()
+        :   repetitions(30),
+            warmup(3),
+            sample_us(200.0),
+            outlier_mads(3.5)
+    {
+    }
+};
+
+struct BenchResult{
+    std::string name;
+    uint64_t calls_per_sample;
+    std::vector<double> samples;    // ns per call, outliers removed, ascending
+    size_t rejected;
+    double median_ns;
+    double mad_ns;                  // median absolute deviation, scaled to estimate sigma
+    double mean_ns;
+    double ci95_ns;                 // half width of the 95% confidence interval of the mean
+    double min_ns;
+};
+
+// Repetition harness for short operations. A sample times a batch of calls
+// large enough to dwarf the clock read, samples are repeated, and outliers
+// (preemption, page faults, frequency changes) are rejected by distance to
+// the median in MADs before the mean and its confidence interval are taken.
+class MicroBench
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit MicroBench(const BenchConfig &config);
+
+    template<typename Fn>
+    const BenchResult &run(const std::string &name, Fn fn)
+    {
+        uint64_t calls = 1;
+        // calibration doubles as warmup
+        while(sampleNs(fn, calls) * calls < config.sample_us * 1000.0 && calls < (1ULL << 30)){
+            calls *= 2;
+        }
+        for(int i = 0; i < config.warmup; ++i){
+            sampleNs(fn, calls);
+        }
+        std::vector<double> samples;
+        for(int i = 0; i < config.repetitions; ++i){
+            samples.emplace_back(sampleNs(fn, calls));
+        }
+        return record(name, calls, samples);
+    }
+
+    const std::vector<BenchResult> &results() const { return entries; }
+    void print(FILE* out) const;
+    // {"tool": "microBench", "unit": "ns", "results": [{name, samples, ...}]}
+    bool writeJson(const std::string &path) const;
+
+    // median and scaled MAD of values, values is reordered
+    static void medianMad(std::vector<double> &values, double &median, double &mad);
+
+private:
+    template<typename Fn>
+    static double sampleNs(Fn &fn, uint64_t calls)
+    {
+        Clock::time_point begin = Clock::now();
+        for(uint64_t i = 0; i < calls; ++i){
+            fn();
+        }
+        return std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / calls;
+    }
+
+    const BenchResult &record(const std::string &name, uint64_t calls, std::vector<double> &samples);
+
+private:
+    BenchConfig config;
+    std::vector<BenchResult> entries;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#include "ModelFiles.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <algorithm>
+
+std::vector<std::string> listModels(const std::string &dir)
+{
+    std::vector<std::string> models;
+    DIR* d = opendir(dir.c_str());
+    if(d == nullptr){
+        printf("cannot open %s\n", dir.c_str());
+        return models;
+    }
+    while(dirent* entry = readdir(d)){
+        std::string name = entry->d_name;
+        if(name.size() > 5 && name.compare(name.size() - 5, 5, ".onnx") == 0){
+            models.emplace_back(dir + "/" + name);
+        }
+    }
+    closedir(d);
+    std::sort(models.begin(), models.end());
+    return models;
+}
+
+std::string modelFileName(const std::string &path)
+{
+    size_t pos = path.find_last_of('/');
+    return pos == std::string::npos ? path : path.substr(pos + 1);
+}
@@ -0,0 +1,13 @@
+#ifndef MODELFILES_H
+#define MODELFILES_H
+
+#include <string>
+#include <vector>
+
+// Paths of the .onnx files in dir, sorted; empty (and a message) if dir
+// cannot be read.
+std::vector<std::string> listModels(const std::string &dir);
+// Model file name without its directory, e.g. for report rows and labels.
+std::string modelFileName(const std::string &path);
+
+#endif
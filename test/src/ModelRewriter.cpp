@@ -0,0 +1,401 @@
+#include "ModelRewriter.h"
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+// field numbers of onnx.proto
+enum{ MODEL_GRAPH = 7 };
+enum{ GRAPH_NODE = 1, GRAPH_INITIALIZER = 5, GRAPH_INPUT = 11, GRAPH_OUTPUT = 12, GRAPH_VALUE_INFO = 13 };
+enum{ NODE_INPUT = 1, NODE_OUTPUT = 2, NODE_NAME = 3, NODE_OP_TYPE = 4, NODE_ATTRIBUTE = 5, NODE_DOMAIN = 7 };
+enum{ ATTR_NAME = 1, ATTR_I = 3, ATTR_G = 6, ATTR_INTS = 8, ATTR_STRINGS = 9, ATTR_GRAPHS = 11 };
+enum{ VALUE_NAME = 1, VALUE_TYPE = 2 };
+enum{ TYPE_TENSOR = 1 };
+enum{ TENSOR_ELEM_TYPE = 1, TENSOR_SHAPE = 2 };
+enum{ SHAPE_DIM = 1, DIM_VALUE = 1 };
+enum{ INITIALIZER_DATA_TYPE = 2, INITIALIZER_NAME = 8 };
+
+// TensorProto.DataType, the same numbers as ONNXTensorElementDataType
+enum{ ELEM_UNKNOWN = 0, ELEM_FLOAT = 1, ELEM_STRING = 8, ELEM_INT64 = 7, ELEM_BOOL = 9 };
+
+static const char* SAME_AS_FIRST_INPUT[] = {
+    "Identity", "Reshape", "Flatten", "Squeeze", "Unsqueeze", "Transpose", "Concat", "Split", "Slice", "Gather",
+    "Expand", "Tile", "Pad", "Add", "Sub", "Mul", "Div", "Pow", "MatMul", "Gemm", "Relu", "LeakyRelu", "Sigmoid",
+    "Tanh", "Softmax", "LogSoftmax", "Abs", "Neg", "Exp", "Log", "Sqrt", "Erf", "Floor", "Ceil", "Round", "Clip",
+    "Max", "Min", "Sum", "Mean", "ReduceSum", "ReduceMean", "ReduceMax", "ReduceMin", "Conv", "MaxPool",
+    "AveragePool", "GlobalAveragePool", "BatchNormalization", "Dropout", "ArrayFeatureExtractor", "Binarizer"
+};
+static const char* FLOAT_OUTPUT[] = {"Normalizer", "Scaler", "LinearRegressor", "SVMRegressor", "TreeEnsembleRegressor"};
+static const char* INT64_OUTPUT[] = {"ArgMax", "ArgMin", "Shape", "Size", "NonZero"};
+static const char* BOOL_OUTPUT[] = {"Equal", "Less", "Greater", "LessOrEqual", "GreaterOrEqual", "Not", "And", "Or", "Xor"};
+// label then float scores
+static const char* CLASSIFIERS[] = {"LinearClassifier", "SVMClassifier", "TreeEnsembleClassifier"};
+
+template<size_t N>
+static bool listed(const char* (&table)[N], const std::string &op)
+{
+    for(const char* entry: table){
+        if(op == entry){
+            return true;
+        }
+    }
+    return false;
+}
+
+static int elementType(ProtoMessage* value_info)
+{
+    ProtoField* type_field = value_info->find(VALUE_TYPE);
+    ProtoMessage* type = type_field != nullptr ? ProtoMessage::child(*type_field) : nullptr;
+    ProtoField* tensor_field = type != nullptr ? type->find(TYPE_TENSOR) : nullptr;
+    ProtoMessage* tensor = tensor_field != nullptr ? ProtoMessage::child(*tensor_field) : nullptr;
+    return tensor != nullptr ? (int)tensor->integer(TENSOR_ELEM_TYPE, ELEM_UNKNOWN) : ELEM_UNKNOWN;
+}
+
+static ProtoMessage* attribute(ProtoMessage* node, const std::string &name)
+{
+    for(ProtoField &field: node->fields){
+        if(field.number != NODE_ATTRIBUTE){
+            continue;
+        }
+        ProtoMessage* attr = ProtoMessage::child(field);
+        if(attr != nullptr && attr->text(ATTR_NAME) == name){
+            return attr;
+        }
+    }
+    return nullptr;
+}
+
+static ProtoMessage* newChild(ProtoMessage* parent, uint32_t number)
+{
+    ProtoField &field = parent->append(number, WIRE_LEN);
+    field.message = std::make_shared<ProtoMessage>();
+    return field.message.get();
+}
+
+bool ModelRewriter::load(const std::string &path)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if(!in){
+        printf("ModelRewriter::load() - cannot open %s\n", path.c_str());
+        return false;
+    }
+    std::stringstream bytes;
+    bytes << in.rdbuf();
+    zipmaps.clear();
+    skipped.clear();
+    if(!model.parse(bytes.str()) || graph() == nullptr){
+        printf("ModelRewriter::load() - %s is not an ONNX model\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ModelRewriter::save(const std::string &path) const
+{
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    const std::string bytes = model.serialize();
+    out.write(bytes.data(), (std::streamsize)bytes.size());
+    if(!out){
+        printf("ModelRewriter::save() - cannot write %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t ModelRewriter::nodeCount() const
+{
+    const ProtoField* field = model.find(MODEL_GRAPH);
+    return field != nullptr && field->message ? field->message->count(GRAPH_NODE) : 0;
+}
+
+ProtoMessage* ModelRewriter::graph()
+{
+    ProtoField* field = model.find(MODEL_GRAPH);
+    return field != nullptr ? ProtoMessage::child(*field) : nullptr;
+}
+
+std::vector<ProtoMessage*> ModelRewriter::nodes()
+{
+    std::vector<ProtoMessage*> list;
+    for(ProtoField &field: graph()->fields){
+        if(field.number == GRAPH_NODE){
+            if(ProtoMessage* node = ProtoMessage::child(field)){
+                list.emplace_back(node);
+            }
+        }
+    }
+    return list;
+}
+
+std::string ModelRewriter::nodeLabel(ProtoMessage* node)
+{
+    std::string name = node->text(NODE_NAME);
+    return name.empty() ? node->text(NODE_OP_TYPE) : name;
+}
+
+bool ModelRewriter::hasSubgraphs()
+{
+    for(ProtoMessage* node: nodes()){
+        for(ProtoField &field: node->fields){
+            ProtoMessage* attr = field.number == NODE_ATTRIBUTE ? ProtoMessage::child(field) : nullptr;
+            if(attr != nullptr && (attr->count(ATTR_G) > 0 || attr->count(ATTR_GRAPHS) > 0)){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool declares(ProtoMessage* graph, uint32_t number, const std::string &name)
+{
+    for(ProtoField &field: graph->fields){
+        if(field.number != number){
+            continue;
+        }
+        ProtoMessage* value = ProtoMessage::child(field);
+        const uint32_t name_field = number == GRAPH_INITIALIZER ? (uint32_t)INITIALIZER_NAME : (uint32_t)VALUE_NAME;
+        if(value != nullptr && value->text(name_field) == name){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ModelRewriter::isGraphInput(const std::string &name)
+{
+    return declares(graph(), GRAPH_INPUT, name);
+}
+
+bool ModelRewriter::isGraphOutput(const std::string &name)
+{
+    return declares(graph(), GRAPH_OUTPUT, name);
+}
+
+bool ModelRewriter::isInitializer(const std::string &name)
+{
+    return declares(graph(), GRAPH_INITIALIZER, name);
+}
+
+bool ModelRewriter::isConsumed(const std::string &name)
+{
+    for(ProtoMessage* node: nodes()){
+        const std::vector<std::string> inputs = node->texts(NODE_INPUT);
+        if(std::find(inputs.begin(), inputs.end(), name) != inputs.end()){
+            return true;
+        }
+    }
+    return false;
+}
+
+void ModelRewriter::renameValue(const std::string &from, const std::string &to)
+{
+    for(ProtoMessage* node: nodes()){
+        for(ProtoField &field: node->fields){
+            if((field.number == NODE_INPUT || field.number == NODE_OUTPUT) && field.data == from){
+                field.data = to;
+            }
+        }
+    }
+    for(ProtoField &field: graph()->fields){
+        ProtoMessage* value = field.number == GRAPH_VALUE_INFO ? ProtoMessage::child(field) : nullptr;
+        if(value != nullptr && value->text(VALUE_NAME) == from){
+            value->setText(VALUE_NAME, to);
+        }
+    }
+}
+
+void ModelRewriter::replaceInputs(const std::string &from, const std::string &to)
+{
+    for(ProtoMessage* node: nodes()){
+        for(ProtoField &field: node->fields){
+            if(field.number == NODE_INPUT && field.data == from){
+                field.data = to;
+            }
+        }
+    }
+}
+
+void ModelRewriter::removeValueInfo(const std::string &name)
+{
+    std::vector<ProtoField> &fields = graph()->fields;
+    fields.erase(std::remove_if(fields.begin(), fields.end(), [&name](ProtoField &field){
+        ProtoMessage* value = field.number == GRAPH_VALUE_INFO ? ProtoMessage::child(field) : nullptr;
+        return value != nullptr && value->text(VALUE_NAME) == name;
+    }), fields.end());
+}
+
+void ModelRewriter::eraseNode(ProtoMessage* node)
+{
+    std::vector<ProtoField> &fields = graph()->fields;
+    fields.erase(std::remove_if(fields.begin(), fields.end(), [node](const ProtoField &field){
+        return field.number == GRAPH_NODE && field.message.get() == node;
+    }), fields.end());
+}
+
+bool ModelRewriter::bypass(ProtoMessage* node)
+{
+    const std::vector<std::string> inputs = node->texts(NODE_INPUT);
+    const std::vector<std::string> outputs = node->texts(NODE_OUTPUT);
+    if(inputs.empty() || outputs.empty() || inputs[0].empty()){
+        return false;
+    }
+    const std::string from = inputs[0];
+    const std::string to = outputs[0];
+    if(isGraphOutput(to)){
+        // the output name is the interface, the producer of the input takes it
+        if(isGraphInput(from) || isInitializer(from) || isGraphOutput(from)){
+            skipped.emplace_back(nodeLabel(node) + ": input " + from + " is a graph input, output or initializer");
+            return false;
+        }
+        removeValueInfo(from);
+        eraseNode(node);
+        renameValue(from, to);
+    }
+    else{
+        eraseNode(node);
+        replaceInputs(to, from);
+        removeValueInfo(to);
+    }
+    return true;
+}
+
+void ModelRewriter::knownTypes(std::map<std::string, int> &types)
+{
+    types.clear();
+    for(ProtoField &field: graph()->fields){
+        if(field.number != GRAPH_INPUT && field.number != GRAPH_OUTPUT && field.number != GRAPH_VALUE_INFO &&
+           field.number != GRAPH_INITIALIZER){
+            continue;
+        }
+        ProtoMessage* value = ProtoMessage::child(field);
+        if(value == nullptr){
+            continue;
+        }
+        int type = field.number == GRAPH_INITIALIZER ? (int)value->integer(INITIALIZER_DATA_TYPE, ELEM_UNKNOWN) : elementType(value);
+        std::string name = value->text(field.number == GRAPH_INITIALIZER ? (uint32_t)INITIALIZER_NAME : (uint32_t)VALUE_NAME);
+        if(type != ELEM_UNKNOWN && !name.empty()){
+            types[name] = type;
+        }
+    }
+    // nodes are stored in topological order
+    for(ProtoMessage* node: nodes()){
+        const std::string op = node->text(NODE_OP_TYPE);
+        const std::vector<std::string> inputs = node->texts(NODE_INPUT);
+        const std::vector<std::string> outputs = node->texts(NODE_OUTPUT);
+        if(outputs.empty()){
+            continue;
+        }
+        int type = ELEM_UNKNOWN;
+        if(op == "Cast"){
+            ProtoMessage* to = attribute(node, "to");
+            type = to != nullptr ? (int)to->integer(ATTR_I, ELEM_UNKNOWN) : ELEM_UNKNOWN;
+        }
+        else if(listed(SAME_AS_FIRST_INPUT, op) && !inputs.empty() && types.count(inputs[0])){
+            type = types[inputs[0]];
+        }
+        else if(listed(FLOAT_OUTPUT, op)){
+            type = ELEM_FLOAT;
+        }
+        else if(listed(INT64_OUTPUT, op)){
+            type = ELEM_INT64;
+        }
+        else if(listed(BOOL_OUTPUT, op)){
+            type = ELEM_BOOL;
+        }
+        else if(listed(CLASSIFIERS, op)){
+            type = attribute(node, "classlabels_strings") != nullptr ? ELEM_STRING : ELEM_INT64;
+            if(outputs.size() > 1 && !types.count(outputs[1])){
+                types[outputs[1]] = ELEM_FLOAT;
+            }
+        }
+        if(type != ELEM_UNKNOWN && !types.count(outputs[0])){
+            types[outputs[0]] = type;
+        }
+    }
+}
+
+int ModelRewriter::removeZipMap()
+{
+    if(hasSubgraphs()){
+        skipped.emplace_back("graph has subgraphs, ZipMap left in place");
+        return 0;
+    }
+    int removed = 0;
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(ProtoMessage* node: nodes()){
+            if(node->text(NODE_OP_TYPE) != "ZipMap" || node->text(NODE_DOMAIN) != "ai.onnx.ml"){
+                continue;
+            }
+            const std::vector<std::string> outputs = node->texts(NODE_OUTPUT);
+            if(outputs.empty() || !isGraphOutput(outputs[0]) || isConsumed(outputs[0])){
+                continue;
+            }
+            ZipMapOutput zipmap;
+            zipmap.output = outputs[0];
+            if(ProtoMessage* labels = attribute(node, "classlabels_int64s")){
+                zipmap.int_labels = labels->integers(ATTR_INTS);
+            }
+            if(ProtoMessage* labels = attribute(node, "classlabels_strings")){
+                zipmap.string_labels = labels->texts(ATTR_STRINGS);
+            }
+            const std::string label = nodeLabel(node);
+            if(!bypass(node)){
+                continue;
+            }
+            // the output is now the float tensor [N, classes] that fed the ZipMap
+            for(ProtoField &field: graph()->fields){
+                ProtoMessage* value = field.number == GRAPH_OUTPUT ? ProtoMessage::child(field) : nullptr;
+                if(value == nullptr || value->text(VALUE_NAME) != zipmap.output){
+                    continue;
+                }
+                value->remove(VALUE_TYPE);
+                ProtoMessage* tensor = newChild(newChild(value, VALUE_TYPE), TYPE_TENSOR);
+                tensor->setInteger(TENSOR_ELEM_TYPE, ELEM_FLOAT);
+                const size_t classes = std::max(zipmap.int_labels.size(), zipmap.string_labels.size());
+                if(classes > 0){
+                    ProtoMessage* shape = newChild(tensor, TENSOR_SHAPE);
+                    newChild(shape, SHAPE_DIM);
+                    newChild(shape, SHAPE_DIM)->setInteger(DIM_VALUE, (int64_t)classes);
+                }
+            }
+            zipmaps.emplace_back(zipmap);
+            ++removed;
+            changed = true;
+            break;
+        }
+    }
+    return removed;
+}
+
+int ModelRewriter::foldCasts()
+{
+    if(hasSubgraphs()){
+        skipped.emplace_back("graph has subgraphs, Casts left in place");
+        return 0;
+    }
+    int folded = 0;
+    std::map<std::string, int> types;
+    bool changed = true;
+    while(changed){
+        changed = false;
+        knownTypes(types);
+        for(ProtoMessage* node: nodes()){
+            if(node->text(NODE_OP_TYPE) != "Cast" || !(node->text(NODE_DOMAIN).empty() || node->text(NODE_DOMAIN) == "ai.onnx")){
+                continue;
+            }
+            ProtoMessage* to = attribute(node, "to");
+            const std::vector<std::string> inputs = node->texts(NODE_INPUT);
+            if(to == nullptr || inputs.empty() || !types.count(inputs[0]) || types[inputs[0]] != (int)to->integer(ATTR_I, -1)){
+                continue;
+            }
+            if(bypass(node)){
+                ++folded;
+                changed = true;
+                break;
+            }
+        }
+    }
+    return folded;
+}
@@ -0,0 +1,65 @@
+#ifndef MODELREWRITER_H
+#define MODELREWRITER_H
+
+#include "ProtoWire.h"
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// A graph output that removeZipMap() turned from seq(map(label, float)) into
+// the float tensor [N, classes] that fed the ZipMap, columns in label order.
+struct ZipMapOutput{
+    std::string output;
+    std::vector<int64_t> int_labels;
+    std::vector<std::string> string_labels;
+};
+
+// Offline rewrites of skl2onnx style models, done on the protobuf wire format
+// (ProtoWire) so everything not touched is saved as it was loaded:
+//  - removeZipMap(): a ZipMap whose output is a graph output is dropped and
+//    the probabilities tensor takes over the output name, so callers get a
+//    plain tensor instead of a sequence of maps built per call
+//  - foldCasts(): a Cast to the type its input already has is bypassed; the
+//    types come from the graph inputs, initializers and value_info, carried
+//    forward through Cast and a table of common operators
+// Values are renamed to bypass a node, so graphs with subgraph attributes
+// (If, Loop, Scan), which may refer to outer names, are left alone.
+class ModelRewriter
+{
+public:
+    bool load(const std::string &path);
+    bool save(const std::string &path) const;
+
+    int removeZipMap();
+    int foldCasts();
+
+    size_t nodeCount() const;
+    const std::vector<ZipMapOutput> &zipMapOutputs() const { return zipmaps; }
+    // why a candidate node was kept
+    const std::vector<std::string> &notes() const { return skipped; }
+
+private:
+    ProtoMessage* graph();
+    std::vector<ProtoMessage*> nodes();
+    bool hasSubgraphs();
+    bool isGraphInput(const std::string &name);
+    bool isGraphOutput(const std::string &name);
+    bool isInitializer(const std::string &name);
+    bool isConsumed(const std::string &name);
+    void renameValue(const std::string &from, const std::string &to);
+    void replaceInputs(const std::string &from, const std::string &to);
+    void removeValueInfo(const std::string &name);
+    // removes node, wiring its first input straight to its first output
+    bool bypass(ProtoMessage* node);
+    void eraseNode(ProtoMessage* node);
+    void knownTypes(std::map<std::string, int> &types);
+    static std::string nodeLabel(ProtoMessage* node);
+
+private:
+    ProtoMessage model;
+    std::vector<ZipMapOutput> zipmaps;
+    std::vector<std::string> skipped;
+};
+
+#endif
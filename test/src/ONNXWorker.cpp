@@ -1,9 +1,23 @@
 #include "ONNXWorker.h"
+#include "FastRandom.h"
+#include "StageTimer.h"
+#include "RequestTrace.h"
+#include "ShadowProfiler.h"
+#include "PerfCounters.h"
+#include "Metrics.h"
+#include "MemoryAccounting.h"
+#include "ModelFiles.h"
 #include <cassert>
 #include <cmath>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <random>
+#include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 bool ONNXWorker::CheckStatus(OrtStatus* status)
 {
@@ -17,30 +31,113 @@ bool ONNXWorker::CheckStatus(OrtStatus* status)
 }
 
 ONNXWorker::ONNXWorker(const std::string &modelPath)
+    :   ONNXWorker(modelPath, WorkerOptions())
+{
+}
+
+ONNXWorker::ONNXWorker(const std::string &modelPath, const WorkerOptions &options)
     :   g_ort(OrtGetApiBase()->GetApi(ORT_API_VERSION)), 
         model_path(modelPath),
-        input_tensors_len(0)
+        input_tensors_len(0),
+        memory_info(nullptr),
+        profiling(!options.profile_prefix.empty()),
+        run_time_limit_ms(0.0),
+        first_run_pending(true),
+        instrumented(options.instrumented),
+        capture(nullptr),
+        capture_model_id(0),
+        shadow(nullptr)
 {
+    static std::atomic<uint64_t> next_worker_id(1);
+    worker_id = next_worker_id++;
+    perf = nullptr;
+    metric_runs = nullptr;
+    metric_errors = nullptr;
+    metric_run_seconds = nullptr;
+    metric_sessions = nullptr;
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    const std::string model_label = MetricsRegistry::modelLabel(model_path);
+    if(instrumented){
+        perf = PerfCounters::accumulator(model_path, options.intra_op_threads);
+        metric_runs = metrics.counter("onnx_runs_total", "Run calls.", model_label);
+        metric_errors = metrics.counter("onnx_run_errors_total", "Run calls that failed.", model_label);
+        metric_run_seconds = metrics.histogram("onnx_run_seconds", "Run duration.", model_label, MetricHistogram::latencyBounds());
+        metric_sessions = metrics.gauge("onnx_sessions", "Open sessions.", model_label);
+        metric_sessions->add(1);
+    }
+    if(instrumented && MemoryAccounting::enabled()){
+        memory.metric_heap = metrics.gauge("onnx_heap_bytes", "Heap bytes held by open sessions.", model_label);
+        memory.metric_run_peak = metrics.histogram("onnx_run_peak_bytes", "Heap rise above its start during Run.", model_label,
+                                                   MetricHistogram::byteBounds());
+    }
+    MemoryScope memory_scope(&memory);
+    run_tag = modelFileName(model_path) + "#" + std::to_string(worker_id);
     assert(g_ort != nullptr);
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point mark = Clock::now();
+    auto lap = [&mark]{
+        Clock::time_point now = Clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - mark).count();
+        mark = now;
+        return ms;
+    };
+    startup.first_run_ms = -1.0;
     bool ret = CheckStatus(g_ort->CreateEnv(ORT_LOGGING_LEVEL_WARNING, "ONNXWorker", &env));
     assert(ret != false && env != nullptr);
+    startup.env_ms = lap();
     ret = CheckStatus(g_ort->CreateSessionOptions(&session_options));
     assert(ret != false && session_options != nullptr);
-    ret = CheckStatus(g_ort->SetIntraOpNumThreads(session_options, 1));
+    ret = CheckStatus(g_ort->SetIntraOpNumThreads(session_options, options.intra_op_threads));
     assert(ret != false);
-    ret = CheckStatus(g_ort->SetSessionGraphOptimizationLevel(session_options, ORT_ENABLE_BASIC));
+    ret = CheckStatus(g_ort->SetSessionGraphOptimizationLevel(session_options, options.optimization));
     assert(ret != false);
+    if(profiling){
+        ret = CheckStatus(g_ort->EnableProfiling(session_options, options.profile_prefix.c_str()));
+        assert(ret != false);
+    }
+    if(!options.memory_arena){
+        ret = CheckStatus(g_ort->DisableCpuMemArena(session_options));
+        assert(ret != false);
+    }
+    startup.options_ms = lap();
     ret = CheckStatus(g_ort->CreateSession(env, model_path.c_str(), session_options, &session));
     assert(ret != false && session != nullptr);
+    startup.session_ms = lap();
     ret = CheckStatus(g_ort->GetAllocatorWithDefaultOptions(&allocator));
     assert(ret != false && allocator != nullptr);
+    ret = CheckStatus(g_ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info));
+    assert(ret != false && memory_info != nullptr);
+    startup.allocator_ms = lap();
+    ret = loadSignature();
+    assert(ret != false);
+    startup.signature_ms = lap();
+    memory_scope.commit();
+    memory.construct_bytes.store(memory.heap_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
 }
 
 ONNXWorker::~ONNXWorker()
 {
+  RunWatchdog::instance().unregisterWorker(worker_id);
+  if(metric_sessions != nullptr){
+      metric_sessions->add(-1);
+  }
+  MemoryScope memory_scope(&memory);
+  for(const char* name: input_node_names){
+      allocator->Free(allocator, (void*)name);
+  }
+  for(const char* name: output_node_names){
+      allocator->Free(allocator, (void*)name);
+  }
+  g_ort->ReleaseMemoryInfo(memory_info);
   g_ort->ReleaseSession(session);
   g_ort->ReleaseSessionOptions(session_options);
   g_ort->ReleaseEnv(env);
+  memory_scope.commit();
+  // whatever was not freed here leaves the gauge with the session
+  if(memory.metric_heap != nullptr){
+      memory.metric_heap->add(-memory.heap_bytes.load(std::memory_order_relaxed));
+  }
 }
 
 size_t ONNXWorker::getInputNodesNum()
@@ -83,6 +180,15 @@ std::vector<const char*> ONNXWorker::getInputNodesNames(size_t input_nodes_size)
     return ret;
 }
 
+void ONNXWorker::releaseNames(std::vector<const char*> &names)
+{
+    // only the pointers are released, the count stays for the callers' checks
+    for(const char* &name: names){
+        allocator->Free(allocator, (void*)name);
+        name = nullptr;
+    }
+}
+
 std::vector<ONNXType> ONNXWorker::getInputNodesONNXType(size_t input_node_size)
 {
     std::vector<ONNXType> ret;
@@ -389,18 +495,18 @@ std::vector<float> ONNXWorker::prepareSingleInputTensorData3(size_t input_tensor
 
 std::vector<float> ONNXWorker::getOutputDirect()
 {
+    StageStamp stamp(instrumented);
     printf("ONNXWorker::getOutputDirect()\n");
     int input_node_size = getInputNodesNum();
-    int output_node_size = getOutputNodesNum();
 
     std::vector<float> ret;
     size_t input_tensor_size = getInputTensorSizes(input_node_size)[0];
-    std::vector<float> input_tensor_values = prepareSingleInputTensorData(input_tensor_size);
-
-    std::vector<const char*> input_nodesnames = getInputNodesNames(input_node_size);
     std::vector<std::pair<size_t, std::vector<int64_t>>> nodes_dims = getInputNodesDims(input_node_size);
     std::vector<size_t> input_tensor_sizes = getInputTensorSizes(input_node_size);
     ONNXTensorElementDataType input_tensor_types = getInputNodesElementDataType_ONNXType_Tensor(0);
+    stamp.mark(STAGE_METADATA);
+    std::vector<float> input_tensor_values = prepareSingleInputTensorData(input_tensor_size);
+    stamp.mark(STAGE_INPUT_PREP);
 
     OrtMemoryInfo* memory_info;
     CheckStatus(g_ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info));
@@ -410,11 +516,12 @@ std::vector<float> ONNXWorker::getOutputDirect()
     CheckStatus(g_ort->IsTensor(input_tensor, &is_tensor));
     assert(is_tensor);
     g_ort->ReleaseMemoryInfo(memory_info);
+    stamp.mark(STAGE_TENSOR_CREATE);
     // score model & input tensor, get back output tensor
     OrtValue* output_tensor = NULL;
-    std::vector<const char*> input_node_names = getInputNodesNames(input_node_size);
-    std::vector<const char*> output_node_names = getOutputNodesNames(output_node_size);
+    // names cached at construction, asking ORT again allocates a copy per call
     CheckStatus(g_ort->Run(session, NULL, input_node_names.data(), (const OrtValue* const*)&input_tensor, 1, output_node_names.data(), 1, &output_tensor));
+    stamp.mark(STAGE_RUN);
     CheckStatus(g_ort->IsTensor(output_tensor, &is_tensor));
     assert(is_tensor);
 
@@ -427,8 +534,10 @@ std::vector<float> ONNXWorker::getOutputDirect()
     for (int i = 0; i < 10; i++){
         ret.emplace_back(floatarr[i]);
     }
+    stamp.mark(STAGE_OUTPUT_COPY);
     g_ort->ReleaseValue(output_tensor);
     g_ort->ReleaseValue(input_tensor);
+    stamp.mark(STAGE_RELEASE);
 
     return ret;
 }
@@ -554,6 +663,7 @@ bool ONNXWorker::getInputsInfo(std::vector<IOInfo> &rets)
 
     //get input nodes name
     std::vector<const char*> input_nodes_names = getInputNodesNames(input_nodes_num);
+    releaseNames(input_nodes_names);
     if(input_nodes_names.size() != input_nodes_num){
         printf("ONNXWorker::getInputsInfo() - get InputNodesName - ERROR\n");
         return false;
@@ -602,6 +712,7 @@ bool ONNXWorker::getOutputsInfo(std::vector<IOInfo> &rets)
 
     //get output nodes name
     std::vector<const char*> output_nodes_names = getOutputNodesNames(output_nodes_num);
+    releaseNames(output_nodes_names);
     if(output_nodes_names.size() != output_nodes_num){
         printf("ONNXWorker::getOutputsInfo() - get OutputNodesName - ERROR\n");
         return false;
@@ -639,18 +750,18 @@ bool ONNXWorker::getOutputsInfo(std::vector<IOInfo> &rets)
 
 std::vector<float> ONNXWorker::getOutputDirect2()
 {
+    StageStamp stamp(instrumented);
     printf("ONNXWorker::getOutputDirect2()\n");
     int input_node_size = getInputNodesNum();
-    int output_node_size = getOutputNodesNum();
 
     std::vector<float> ret;
     size_t input_tensor_size = 1;
-    std::vector<float> input_tensor_values = prepareSingleInputTensorData2(input_tensor_size);
-
-    std::vector<const char*> input_nodesnames = getInputNodesNames(input_node_size);
     std::vector<std::pair<size_t, std::vector<int64_t>>> nodes_dims = getInputNodesDims(input_node_size);
     // std::vector<size_t> input_tensor_sizes = getInputTensorSizes(input_node_size);
     ONNXTensorElementDataType input_tensor_types = getInputNodesElementDataType_ONNXType_Tensor(0);
+    stamp.mark(STAGE_METADATA);
+    std::vector<float> input_tensor_values = prepareSingleInputTensorData2(input_tensor_size);
+    stamp.mark(STAGE_INPUT_PREP);
 
     OrtMemoryInfo* memory_info;
     CheckStatus(g_ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info));
@@ -660,11 +771,12 @@ std::vector<float> ONNXWorker::getOutputDirect2()
     CheckStatus(g_ort->IsTensor(input_tensor, &is_tensor));
     assert(is_tensor);
     g_ort->ReleaseMemoryInfo(memory_info);
+    stamp.mark(STAGE_TENSOR_CREATE);
     // score model & input tensor, get back output tensor
     OrtValue* output_tensor = NULL;
-    std::vector<const char*> input_node_names = getInputNodesNames(input_node_size);
-    std::vector<const char*> output_node_names = getOutputNodesNames(output_node_size);
+    // names cached at construction, asking ORT again allocates a copy per call
     CheckStatus(g_ort->Run(session, NULL, input_node_names.data(), (const OrtValue* const*)&input_tensor, 1, output_node_names.data(), 1, &output_tensor));
+    stamp.mark(STAGE_RUN);
     CheckStatus(g_ort->IsTensor(output_tensor, &is_tensor));
     assert(is_tensor);
 
@@ -677,26 +789,28 @@ std::vector<float> ONNXWorker::getOutputDirect2()
     for (int i = 0; i < 1; i++){
         ret.emplace_back(floatarr[i]);
     }
+    stamp.mark(STAGE_OUTPUT_COPY);
     g_ort->ReleaseValue(output_tensor);
     g_ort->ReleaseValue(input_tensor);
+    stamp.mark(STAGE_RELEASE);
 
     return ret;
 }
 
 std::vector<float> ONNXWorker::getOutputDirect3()
 {
+    StageStamp stamp(instrumented);
     printf("ONNXWorker::getOutputDirect3()\n");
     int input_node_size = getInputNodesNum();
-    int output_node_size = getOutputNodesNum();
 
     std::vector<float> ret;
     size_t input_tensor_size = getInputTensorSizes(input_node_size)[0];
-    std::vector<float> input_tensor_values = prepareSingleInputTensorData3(input_tensor_size);
-
-    std::vector<const char*> input_nodesnames = getInputNodesNames(input_node_size);
     std::vector<std::pair<size_t, std::vector<int64_t>>> nodes_dims = getInputNodesDims(input_node_size);
     // std::vector<size_t> input_tensor_sizes = getInputTensorSizes(input_node_size);
     ONNXTensorElementDataType input_tensor_types = getInputNodesElementDataType_ONNXType_Tensor(0);
+    stamp.mark(STAGE_METADATA);
+    std::vector<float> input_tensor_values = prepareSingleInputTensorData3(input_tensor_size);
+    stamp.mark(STAGE_INPUT_PREP);
 
     OrtMemoryInfo* memory_info;
     CheckStatus(g_ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info));
@@ -706,11 +820,12 @@ std::vector<float> ONNXWorker::getOutputDirect3()
     CheckStatus(g_ort->IsTensor(input_tensor, &is_tensor));
     assert(is_tensor);
     g_ort->ReleaseMemoryInfo(memory_info);
+    stamp.mark(STAGE_TENSOR_CREATE);
     // score model & input tensor, get back output tensor
     OrtValue* output_tensor = NULL;
-    std::vector<const char*> input_node_names = getInputNodesNames(input_node_size);
-    std::vector<const char*> output_node_names = getOutputNodesNames(output_node_size);
+    // names cached at construction, asking ORT again allocates a copy per call
     CheckStatus(g_ort->Run(session, NULL, input_node_names.data(), (const OrtValue* const*)&input_tensor, 1, output_node_names.data(), 1, &output_tensor));
+    stamp.mark(STAGE_RUN);
     CheckStatus(g_ort->IsTensor(output_tensor, &is_tensor));
     assert(is_tensor);
 
@@ -723,18 +838,631 @@ std::vector<float> ONNXWorker::getOutputDirect3()
     for (int i = 0; i < 1; i++){
         ret.emplace_back(floatarr[i]);
     }
+    stamp.mark(STAGE_OUTPUT_COPY);
     g_ort->ReleaseValue(output_tensor);
     g_ort->ReleaseValue(input_tensor);
+    stamp.mark(STAGE_RELEASE);
 
     return ret;
 }
 
 int ONNXWorker::getRandomIndex(int from, int end)
 {
-    // time_t seed = time(nullptr);
-    // std::default_random_engine generator(seed);
-    // std::uniform_int_distribution<int> distribution(from, end);
-    // return distribution(generator);
-    srand(time(nullptr));
-    return rand()%10;
-}
\ No newline at end of file
+    // uniform in [from, end), per thread generator seeded once
+    return end > from ? from + (int)FastRandom::local().below((uint32_t)(end - from)) : from;
+}
+
+/******************************************************************************************************/
+
+bool ONNXWorker::loadNodeInfo(OrtTypeInfo* typeinfo, IOInfo &info)
+{
+    ONNXType type;
+    if(!CheckStatus(g_ort->GetOnnxTypeFromTypeInfo(typeinfo, &type))){
+        return false;
+    }
+    info.datatype = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+    info.Dims = std::make_pair(0, std::vector<int64_t>());
+    info.DataNums = 0;
+    if(type != ONNXType::ONNX_TYPE_TENSOR){
+        // sequence / map outputs (e.g. ZipMap) carry no static tensor shape
+        return true;
+    }
+    const OrtTensorTypeAndShapeInfo* tensor_info;
+    if(!CheckStatus(g_ort->CastTypeInfoToTensorInfo(typeinfo, &tensor_info))){
+        return false;
+    }
+    if(!CheckStatus(g_ort->GetTensorElementType(tensor_info, &info.datatype))){
+        return false;
+    }
+    size_t num_dims = 0;
+    if(!CheckStatus(g_ort->GetDimensionsCount(tensor_info, &num_dims))){
+        return false;
+    }
+    std::vector<int64_t> dims(num_dims);
+    if(!CheckStatus(g_ort->GetDimensions(tensor_info, dims.data(), num_dims))){
+        return false;
+    }
+    // dynamic dims (-1) count as 1, callers substitute the real size
+    size_t nums = 1;
+    for(const auto &dim: dims){
+        nums *= dim > 0 ? (size_t)dim : 1;
+    }
+    info.Dims = std::make_pair(num_dims, dims);
+    info.DataNums = nums;
+    return true;
+}
+
+bool ONNXWorker::loadSignature()
+{
+    size_t input_count = 0;
+    size_t output_count = 0;
+    if(!CheckStatus(g_ort->SessionGetInputCount(session, &input_count)) ||
+       !CheckStatus(g_ort->SessionGetOutputCount(session, &output_count))){
+        return false;
+    }
+    for(size_t i = 0; i < input_count; ++i){
+        char* name = nullptr;
+        OrtTypeInfo* typeinfo = nullptr;
+        if(!CheckStatus(g_ort->SessionGetInputName(session, i, allocator, &name)) ||
+           !CheckStatus(g_ort->SessionGetInputTypeInfo(session, i, &typeinfo))){
+            return false;
+        }
+        input_node_names.emplace_back(name);
+        IOInfo info;
+        info.name = name;
+        bool flag = loadNodeInfo(typeinfo, info);
+        g_ort->ReleaseTypeInfo(typeinfo);
+        if(!flag){
+            return false;
+        }
+        input_infos.emplace_back(info);
+    }
+    for(size_t i = 0; i < output_count; ++i){
+        char* name = nullptr;
+        OrtTypeInfo* typeinfo = nullptr;
+        if(!CheckStatus(g_ort->SessionGetOutputName(session, i, allocator, &name)) ||
+           !CheckStatus(g_ort->SessionGetOutputTypeInfo(session, i, &typeinfo))){
+            return false;
+        }
+        output_node_names.emplace_back(name);
+        IOInfo info;
+        info.name = name;
+        bool flag = loadNodeInfo(typeinfo, info);
+        g_ort->ReleaseTypeInfo(typeinfo);
+        if(!flag){
+            return false;
+        }
+        output_infos.emplace_back(info);
+    }
+    return true;
+}
+
+OrtValue* ONNXWorker::createTensor(void* data, size_t data_bytes, const std::vector<int64_t> &dims,
+                                   ONNXTensorElementDataType type)
+{
+    MemoryScope memory_scope(&memory);
+    OrtValue* value = nullptr;
+    if(!CheckStatus(g_ort->CreateTensorWithDataAsOrtValue(memory_info, data, data_bytes, dims.data(), dims.size(), type, &value))){
+        return nullptr;
+    }
+    return value;
+}
+
+// Wraps one Run call: watchdog slot, request trace span, perf counters,
+// metrics, first run timing and the run's heap. The memory scope ends first
+// so the bookkeeping after it is not counted as the run's heap.
+class ONNXWorker::RunScope
+{
+public:
+    // run_options null takes the watchdog slot's own options
+    RunScope(ONNXWorker* worker, OrtRunOptions* &run_options)
+        :   worker(worker),
+            slot(worker->beginWatch(run_options)),
+            run_options(run_options),
+            trace_start(worker->instrumented && RequestTrace::enabled() ? RequestTrace::nowNs() : 0),
+            metric_start(worker->instrumented && MetricsRegistry::enabled() ? RequestTrace::nowNs() : 0),
+            first_start(worker->first_run_pending.load(std::memory_order_relaxed) ? RequestTrace::nowNs() : 0),
+            counting(worker->instrumented && PerfCounters::enabled() && PerfCounters::read(perf_begin)),
+            ok(false),
+            memory_scope(&worker->memory, true)
+    {
+    }
+
+    ~RunScope()
+    {
+        memory_scope.end();
+        if(counting){
+            worker->countRun(perf_begin);
+        }
+        if(metric_start != 0){
+            worker->meterRun(ok, metric_start);
+        }
+        if(first_start != 0){
+            worker->noteFirstRun(first_start);
+        }
+        if(trace_start != 0){
+            worker->traceRun(trace_start, run_options);
+        }
+        worker->endWatch(slot);
+    }
+
+    // the Run's outcome for the metrics, passed through
+    bool ran(bool ok)
+    {
+        this->ok = ok;
+        return ok;
+    }
+
+private:
+    RunScope(const RunScope &) = delete;
+    RunScope &operator=(const RunScope &) = delete;
+
+    ONNXWorker* worker;
+    RunWatchdog::Slot* slot;
+    OrtRunOptions* run_options;
+    const uint64_t trace_start;
+    const uint64_t metric_start;
+    const uint64_t first_start;
+    PerfSample perf_begin;
+    const bool counting;
+    bool ok;
+    MemoryScope memory_scope;
+};
+
+bool ONNXWorker::run(const std::vector<OrtValue*> &inputs, std::vector<OrtValue*> &outputs)
+{
+    return run(inputs, outputs, nullptr);
+}
+
+bool ONNXWorker::run(const std::vector<OrtValue*> &inputs, std::vector<OrtValue*> &outputs, OrtRunOptions* run_options)
+{
+    if(inputs.size() != input_node_names.size() || outputs.size() != output_node_names.size()){
+        printf("ONNXWorker::run() - expect %zu inputs / %zu outputs\n", input_node_names.size(), output_node_names.size());
+        return false;
+    }
+    return runNames(inputs, output_node_names.data(), outputs, run_options);
+}
+
+const OutputSelection* ONNXWorker::selectOutputs(const std::vector<std::string> &names)
+{
+    if(names.empty()){
+        printf("ONNXWorker::selectOutputs() - no output selected\n");
+        return nullptr;
+    }
+    std::vector<size_t> indices;
+    for(const std::string &name: names){
+        size_t i = 0;
+        while(i < output_infos.size() && output_infos[i].name != name){
+            ++i;
+        }
+        if(i == output_infos.size()){
+            printf("ONNXWorker::selectOutputs() - %s has no output %s\n", model_path.c_str(), name.c_str());
+            return nullptr;
+        }
+        if(std::find(indices.begin(), indices.end(), i) != indices.end()){
+            printf("ONNXWorker::selectOutputs() - output %s selected twice\n", name.c_str());
+            return nullptr;
+        }
+        indices.emplace_back(i);
+    }
+    std::lock_guard<std::mutex> lock(selection_mtx);
+    for(const std::unique_ptr<OutputSelection> &selection: selections){
+        if(selection->indices == indices){
+            return selection.get();
+        }
+    }
+    std::unique_ptr<OutputSelection> selection(new OutputSelection);
+    selection->indices = indices;
+    for(size_t i: indices){
+        selection->names.emplace_back(output_node_names[i]);
+    }
+    selections.emplace_back(std::move(selection));
+    return selections.back().get();
+}
+
+bool ONNXWorker::runSelected(const std::vector<OrtValue*> &inputs, const OutputSelection* selection,
+                             std::vector<OrtValue*> &outputs, OrtRunOptions* run_options)
+{
+    if(selection == nullptr){
+        return run(inputs, outputs, run_options);
+    }
+    if(inputs.size() != input_node_names.size() || outputs.size() != selection->names.size()){
+        printf("ONNXWorker::runSelected() - expect %zu inputs / %zu outputs\n", input_node_names.size(), selection->names.size());
+        return false;
+    }
+    return runNames(inputs, selection->names.data(), outputs, run_options);
+}
+
+bool ONNXWorker::runNames(const std::vector<OrtValue*> &inputs, const char* const* names, std::vector<OrtValue*> &outputs,
+                          OrtRunOptions* run_options)
+{
+    StageStamp stamp(instrumented);
+    if(capture != nullptr){
+        captureInputs(inputs);
+        stamp.mark(STAGE_CAPTURE);
+    }
+    if(shadow != nullptr){
+        shadow->offer(this, inputs);
+        stamp.mark(STAGE_CAPTURE);
+    }
+    bool ret;
+    {
+        RunScope scope(this, run_options);
+        ret = scope.ran(CheckStatus(g_ort->Run(session, run_options, input_node_names.data(), inputs.data(), inputs.size(),
+                                               names, outputs.size(), outputs.data())));
+    }
+    stamp.mark(STAGE_RUN);
+    return ret;
+}
+
+std::string ONNXWorker::endProfiling()
+{
+    // only one caller ends the profile
+    if(!profiling.exchange(false)){
+        return std::string();
+    }
+    char* path = nullptr;
+    if(!CheckStatus(g_ort->SessionEndProfiling(session, allocator, &path)) || path == nullptr){
+        return std::string();
+    }
+    std::string file(path);
+    allocator->Free(allocator, path);
+    return file;
+}
+
+uint64_t ONNXWorker::getProfilingStartNs()
+{
+    uint64_t start_ns = 0;
+    if(!profiling || !CheckStatus(g_ort->SessionGetProfilingStartTimeNs(session, &start_ns))){
+        return 0;
+    }
+    return start_ns;
+}
+
+void ONNXWorker::setCapture(CaptureWriter* writer)
+{
+    if(writer != nullptr){
+        capture_model_id = writer->registerModel(model_path);
+    }
+    capture = writer;
+}
+
+void ONNXWorker::captureInputs(const std::vector<OrtValue*> &inputs)
+{
+    uint64_t timestamp = CaptureWriter::nowNs();
+    std::vector<CaptureTensor> tensors(inputs.size());
+    for(size_t i = 0; i < inputs.size(); ++i){
+        CaptureTensor &tensor = tensors[i];
+        tensor.type = getTensorElementType(inputs[i]);
+        tensor.data = getTensorData(inputs[i]);
+        if(tensor.data == nullptr || ONNXWorker::elementSize(tensor.type) == 0 || !getTensorShape(inputs[i], tensor.dims)){
+            return;
+        }
+        size_t count = 1;
+        for(int64_t dim: tensor.dims){
+            count *= (size_t)dim;
+        }
+        tensor.data_bytes = count * ONNXWorker::elementSize(tensor.type);
+    }
+    capture->append(capture_model_id, timestamp, tensors);
+}
+
+void ONNXWorker::countRun(const PerfSample &begin)
+{
+    PerfSample end;
+    if(PerfCounters::read(end)){
+        PerfCounters::accumulate(perf, PerfCounters::delta(begin, end));
+    }
+}
+
+void ONNXWorker::noteFirstRun(uint64_t begin_ns)
+{
+    // only the thread that wins the flag writes the timing
+    if(first_run_pending.exchange(false)){
+        startup.first_run_ms = (double)(RequestTrace::nowNs() - begin_ns) / 1e6;
+    }
+}
+
+void ONNXWorker::meterRun(bool ok, uint64_t begin_ns)
+{
+    metric_runs->inc();
+    if(!ok){
+        metric_errors->inc();
+    }
+    metric_run_seconds->observe((double)(RequestTrace::nowNs() - begin_ns) / 1e9);
+}
+
+void ONNXWorker::traceRun(uint64_t start_ns, OrtRunOptions* run_options)
+{
+    // the tag ORT saw, or the worker tag for untagged runs
+    const char* tag = nullptr;
+    if(run_options == nullptr || !CheckStatus(g_ort->RunOptionsGetRunTag(run_options, &tag)) || tag == nullptr || tag[0] == '\0'){
+        tag = run_tag.c_str();
+    }
+    RequestTrace::complete("run", RequestTrace::current(), start_ns, RequestTrace::nowNs(), tag);
+}
+
+RunWatchdog::Slot* ONNXWorker::beginWatch(OrtRunOptions* &run_options)
+{
+    RunWatchdog &watchdog = RunWatchdog::instance();
+    if(!watchdog.enabled()){
+        return nullptr;
+    }
+    // one slot per (worker, thread), looked up in a thread local cache that
+    // drops the slots of unregistered workers before it is searched
+    struct CachedSlot{
+        uint64_t worker_id;
+        RunWatchdog::Slot* slot;
+    };
+    static thread_local std::vector<CachedSlot> cache;
+    static thread_local uint64_t cache_unregistrations = 0;
+    static std::atomic<unsigned> next_thread_index(0);
+    static thread_local unsigned thread_index = next_thread_index++;
+    const uint64_t unregistrations = watchdog.unregistrations();
+    if(unregistrations != cache_unregistrations){
+        cache.erase(std::remove_if(cache.begin(), cache.end(), [&watchdog](const CachedSlot &cached){
+            return !watchdog.registered(cached.worker_id);
+        }), cache.end());
+        cache_unregistrations = unregistrations;
+    }
+    RunWatchdog::Slot* slot = nullptr;
+    for(const auto &cached: cache){
+        if(cached.worker_id == worker_id){
+            slot = cached.slot;
+            break;
+        }
+    }
+    if(slot == nullptr){
+        OrtRunOptions* own_options = createRunOptions();
+        if(own_options == nullptr){
+            return nullptr;
+        }
+        std::string tag = run_tag + "." + std::to_string(thread_index);
+        CheckStatus(g_ort->RunOptionsSetRunTag(own_options, tag.c_str()));
+        slot = watchdog.registerSlot(worker_id, model_path, tag, own_options, run_time_limit_ms);
+        cache.push_back(CachedSlot{worker_id, slot});
+    }
+    if(run_options == nullptr){
+        run_options = slot->own_options;
+    }
+    settleWatch(slot);
+    // options and start time first, the watchdog trusts them for this generation
+    slot->options.store(run_options);
+    slot->start_ns.store(RunWatchdog::nowNs());
+    slot->generation.fetch_add(2);
+    return slot;
+}
+
+void ONNXWorker::endWatch(RunWatchdog::Slot* slot)
+{
+    if(slot == nullptr){
+        return;
+    }
+    slot->generation.fetch_add(2);
+    settleWatch(slot);
+}
+
+// Clears a terminate the watchdog claimed on the slot's last run, once it has
+// been issued, so it cannot reach the next run on the same options.
+void ONNXWorker::settleWatch(RunWatchdog::Slot* slot)
+{
+    if((slot->generation.load() & RunWatchdog::CLAIMED) == 0){
+        return;
+    }
+    while(!slot->terminate_issued.load(std::memory_order_acquire)){
+        std::this_thread::yield();
+    }
+    resetRunOptions(slot->options.load());
+    slot->terminate_issued.store(false, std::memory_order_relaxed);
+    slot->generation.fetch_and(~RunWatchdog::CLAIMED);
+}
+
+OrtRunOptions* ONNXWorker::createRunOptions()
+{
+    OrtRunOptions* run_options = nullptr;
+    if(!CheckStatus(g_ort->CreateRunOptions(&run_options))){
+        return nullptr;
+    }
+    return run_options;
+}
+
+bool ONNXWorker::terminateRun(OrtRunOptions* run_options)
+{
+    return CheckStatus(g_ort->RunOptionsSetTerminate(run_options));
+}
+
+bool ONNXWorker::resetRunOptions(OrtRunOptions* run_options)
+{
+    return CheckStatus(g_ort->RunOptionsUnsetTerminate(run_options));
+}
+
+void ONNXWorker::releaseRunOptions(OrtRunOptions* run_options)
+{
+    if(run_options != nullptr){
+        g_ort->ReleaseRunOptions(run_options);
+    }
+}
+
+OrtIoBinding* ONNXWorker::createBinding(const std::vector<OrtValue*> &inputs)
+{
+    MemoryScope memory_scope(&memory);
+    if(inputs.size() != input_node_names.size()){
+        printf("ONNXWorker::createBinding() - expect %zu inputs\n", input_node_names.size());
+        return nullptr;
+    }
+    OrtIoBinding* binding = nullptr;
+    if(!CheckStatus(g_ort->CreateIoBinding(session, &binding))){
+        return nullptr;
+    }
+    for(size_t i = 0; i < inputs.size(); ++i){
+        if(!CheckStatus(g_ort->BindInput(binding, input_node_names[i], inputs[i]))){
+            g_ort->ReleaseIoBinding(binding);
+            return nullptr;
+        }
+    }
+    for(size_t i = 0; i < output_node_names.size(); ++i){
+        if(!CheckStatus(g_ort->BindOutputToDevice(binding, output_node_names[i], memory_info))){
+            g_ort->ReleaseIoBinding(binding);
+            return nullptr;
+        }
+    }
+    return binding;
+}
+
+bool ONNXWorker::runBinding(OrtIoBinding* binding)
+{
+    StageStamp stamp(instrumented);
+    OrtRunOptions* run_options = nullptr;
+    bool ret;
+    {
+        RunScope scope(this, run_options);
+        ret = scope.ran(CheckStatus(g_ort->RunWithBinding(session, run_options, binding)));
+    }
+    stamp.mark(STAGE_RUN);
+    return ret;
+}
+
+bool ONNXWorker::getBoundOutputs(OrtIoBinding* binding, std::vector<OrtValue*> &outputs)
+{
+    OrtValue** values = nullptr;
+    size_t count = 0;
+    if(!CheckStatus(g_ort->GetBoundOutputValues(binding, allocator, &values, &count))){
+        return false;
+    }
+    outputs.assign(values, values + count);
+    if(values != nullptr){
+        allocator->Free(allocator, values);
+    }
+    return true;
+}
+
+void ONNXWorker::releaseBinding(OrtIoBinding* binding)
+{
+    MemoryScope memory_scope(&memory);
+    if(binding != nullptr){
+        g_ort->ReleaseIoBinding(binding);
+    }
+}
+
+size_t ONNXWorker::elementSize(ONNXTensorElementDataType type)
+{
+    switch(type){
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL:
+            return 1;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16:
+            return 2;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32:
+            return 4;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64:
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_COMPLEX64:
+            return 8;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_COMPLEX128:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+float* ONNXWorker::getFloatData(OrtValue* value)
+{
+    float* data = nullptr;
+    if(value == nullptr || !CheckStatus(g_ort->GetTensorMutableData(value, (void**)&data))){
+        return nullptr;
+    }
+    return data;
+}
+
+void* ONNXWorker::getTensorData(OrtValue* value)
+{
+    void* data = nullptr;
+    if(value == nullptr || !CheckStatus(g_ort->GetTensorMutableData(value, &data))){
+        return nullptr;
+    }
+    return data;
+}
+
+ONNXTensorElementDataType ONNXWorker::getTensorElementType(OrtValue* value)
+{
+    ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+    OrtTensorTypeAndShapeInfo* shape_info = nullptr;
+    if(value == nullptr || !CheckStatus(g_ort->GetTensorTypeAndShape(value, &shape_info))){
+        return type;
+    }
+    CheckStatus(g_ort->GetTensorElementType(shape_info, &type));
+    g_ort->ReleaseTensorTypeAndShapeInfo(shape_info);
+    return type;
+}
+
+bool ONNXWorker::getTensorShape(OrtValue* value, std::vector<int64_t> &dims)
+{
+    OrtTensorTypeAndShapeInfo* shape_info = nullptr;
+    if(value == nullptr || !CheckStatus(g_ort->GetTensorTypeAndShape(value, &shape_info))){
+        return false;
+    }
+    size_t num_dims = 0;
+    bool flag = CheckStatus(g_ort->GetDimensionsCount(shape_info, &num_dims));
+    if(flag){
+        dims.resize(num_dims);
+        flag = CheckStatus(g_ort->GetDimensions(shape_info, dims.data(), num_dims));
+    }
+    g_ort->ReleaseTensorTypeAndShapeInfo(shape_info);
+    return flag;
+}
+
+OrtValue* ONNXWorker::cloneTensor(OrtValue* value)
+{
+    MemoryScope memory_scope(&memory);
+    int is_tensor = 0;
+    if(value == nullptr || !CheckStatus(g_ort->IsTensor(value, &is_tensor)) || !is_tensor){
+        return nullptr;
+    }
+    OrtTensorTypeAndShapeInfo* shape_info = nullptr;
+    if(!CheckStatus(g_ort->GetTensorTypeAndShape(value, &shape_info))){
+        return nullptr;
+    }
+    ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+    size_t num_dims = 0, count = 0;
+    std::vector<int64_t> dims;
+    bool flag = CheckStatus(g_ort->GetTensorElementType(shape_info, &type)) &&
+                CheckStatus(g_ort->GetDimensionsCount(shape_info, &num_dims)) &&
+                CheckStatus(g_ort->GetTensorShapeElementCount(shape_info, &count));
+    if(flag){
+        dims.resize(num_dims);
+        flag = CheckStatus(g_ort->GetDimensions(shape_info, dims.data(), num_dims));
+    }
+    g_ort->ReleaseTensorTypeAndShapeInfo(shape_info);
+    // strings are not laid out flat
+    if(!flag || elementSize(type) == 0){
+        return nullptr;
+    }
+
+    OrtValue* copy = nullptr;
+    void* src = nullptr;
+    void* dst = nullptr;
+    if(!CheckStatus(g_ort->CreateTensorAsOrtValue(allocator, dims.data(), dims.size(), type, &copy))){
+        return nullptr;
+    }
+    if(!CheckStatus(g_ort->GetTensorMutableData(value, &src)) || !CheckStatus(g_ort->GetTensorMutableData(copy, &dst))){
+        g_ort->ReleaseValue(copy);
+        return nullptr;
+    }
+    memcpy(dst, src, count * elementSize(type));
+    return copy;
+}
+
+void ONNXWorker::releaseValue(OrtValue* value)
+{
+    MemoryScope memory_scope(&memory);
+    if(value != nullptr){
+        g_ort->ReleaseValue(value);
+    }
+}
@@ -3,8 +3,21 @@
 
 #include <string>
 #include "onnxruntime_c_api.h"
+#include "RunWatchdog.h"
+#include "CaptureLog.h"
+#include "MemoryAccounting.h"
 #include <vector>
 #include <utility>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+class ShadowProfiler;
+class MetricCounter;
+class MetricGauge;
+class MetricHistogram;
+struct PerfAccumulator;
+struct PerfSample;
 
 struct IOInfo{
     std::string name;
@@ -13,11 +26,53 @@ struct IOInfo{
     size_t DataNums;
 };
 
+// A subset of the model outputs in the caller's order, resolved once per
+// subset by ONNXWorker::selectOutputs() and owned by the worker.
+struct OutputSelection{
+    std::vector<size_t> indices;        // into getOutputsSignature()
+    std::vector<const char*> names;     // handed to Run as is
+};
+
+// Session settings fixed at construction.
+struct WorkerOptions{
+    GraphOptimizationLevel optimization;
+    int intra_op_threads;
+    // non empty turns on ORT profiling, the file is written by endProfiling()
+    // as <profile_prefix>_<date>.json
+    std::string profile_prefix;
+    // ORT's CPU arena; off, every tensor is a malloc and the memory accounting
+    // run peak is the true working set of a Run
+    bool memory_arena;
+    // false keeps the session out of the process' visibility: no metrics,
+    // perf counters, stage timing or request trace spans. ShadowProfiler's
+    // sessions, whose sampled and profiled runs are not production traffic.
+    bool instrumented;
+
+    WorkerOptions()
+        :   optimization(ORT_ENABLE_BASIC),
+            intra_op_threads(1),
+            memory_arena(true),
+            instrumented(true)
+    {
+    }
+};
+
+// Time spent in each phase of the constructor, in ms. first_run_ms is set by
+// the first run() or runBinding() and stays negative until then.
+struct StartupTiming{
+    double env_ms;          // CreateEnv
+    double options_ms;      // CreateSessionOptions and its settings
+    double session_ms;      // CreateSession: model parse, graph optimization, kernel creation
+    double allocator_ms;    // default allocator and CPU memory info
+    double signature_ms;    // input / output names, types and shapes
+    double first_run_ms;
+};
 
 class ONNXWorker
 {
 public:
     ONNXWorker(const std::string &modelPath);
+    ONNXWorker(const std::string &modelPath, const WorkerOptions &options);
     ~ONNXWorker();
 
     bool getInputsInfo(std::vector<IOInfo> &rets);
@@ -26,11 +81,87 @@ public:
     std::vector<float> getOutputDirect();
     std::vector<float> getOutputDirect2();
     std::vector<float> getOutputDirect3();
+
+    // Signature cached at construction, no ORT queries involved.
+    const std::vector<IOInfo> &getInputsSignature() const { return input_infos; }
+    const std::vector<IOInfo> &getOutputsSignature() const { return output_infos; }
+
+    // Wraps a caller owned buffer as a CPU tensor. Release with releaseValue().
+    OrtValue* createTensor(void* data, size_t data_bytes, const std::vector<int64_t> &dims,
+                           ONNXTensorElementDataType type);
+    // Runs the session on all inputs. outputs must hold one entry per model output,
+    // a non null entry is used as a preallocated destination, a null entry is
+    // filled with a tensor allocated by ORT that the caller must release.
+    bool run(const std::vector<OrtValue*> &inputs, std::vector<OrtValue*> &outputs);
+    // Same, under run options that another thread may terminate.
+    bool run(const std::vector<OrtValue*> &inputs, std::vector<OrtValue*> &outputs, OrtRunOptions* run_options);
+
+    // Resolves output names once; the same subset returns the same cached
+    // selection. nullptr if the list is empty, names an output twice or a
+    // name is not a model output. Thread safe.
+    const OutputSelection* selectOutputs(const std::vector<std::string> &names);
+    // run() fetching only the selected outputs, one outputs entry per selected
+    // name. Outputs left out are not fetched, outputSelect measures the saving.
+    bool runSelected(const std::vector<OrtValue*> &inputs, const OutputSelection* selection,
+                     std::vector<OrtValue*> &outputs, OrtRunOptions* run_options = nullptr);
+
+    OrtRunOptions* createRunOptions();
+    // Aborts every Run currently using these options, safe from any thread.
+    bool terminateRun(OrtRunOptions* run_options);
+    // Clears a previous terminate so the options can be used again.
+    bool resetRunOptions(OrtRunOptions* run_options);
+    void releaseRunOptions(OrtRunOptions* run_options);
+
+    // Per-run limit enforced by RunWatchdog once it is started, 0 uses the
+    // watchdog default. Applies to threads that run on this worker afterwards.
+    void setRunTimeLimit(double limit_ms) { run_time_limit_ms = limit_ms; }
+    const std::string &getModelPath() const { return model_path; }
+    const StartupTiming &getStartupTiming() const { return startup; }
+    // heap held by this session and per Run peaks, all zero unless
+    // MemoryAccounting was enabled before construction
+    MemoryStats getMemoryStats() const { return memory.stats(); }
+
+    // Profiling mode: ORT records every Run until endProfiling() writes the
+    // profile and returns its path, empty if profiling was not on.
+    bool isProfiling() const { return profiling.load(); }
+    std::string endProfiling();
+    // profiling start in ns since the epoch (ORT's high resolution clock, the
+    // system clock with libstdc++); profile ts values are us after it.
+    // 0 if not profiling
+    uint64_t getProfilingStartNs();
+
+    // Offers the inputs of every run() to a shadow profiling session, nullptr
+    // stops. The worker must outlive the profiler.
+    void setShadow(ShadowProfiler* profiler) { shadow = profiler; }
+
+    // Appends the inputs of every run() to the capture log, nullptr stops.
+    // The writer must outlive the capture.
+    void setCapture(CaptureWriter* writer);
+
+    // IoBinding over fixed input tensors, outputs bound to CPU memory. The
+    // binding is created once and reused by every runBinding() call.
+    OrtIoBinding* createBinding(const std::vector<OrtValue*> &inputs);
+    bool runBinding(OrtIoBinding* binding);
+    // outputs of the last runBinding(), release each value with releaseValue()
+    bool getBoundOutputs(OrtIoBinding* binding, std::vector<OrtValue*> &outputs);
+    void releaseBinding(OrtIoBinding* binding);
+
+    static size_t elementSize(ONNXTensorElementDataType type);
+    float* getFloatData(OrtValue* value);
+    void* getTensorData(OrtValue* value);
+    ONNXTensorElementDataType getTensorElementType(OrtValue* value);
+    bool getTensorShape(OrtValue* value, std::vector<int64_t> &dims);
+    // Deep copy of a numeric tensor into ORT allocated memory, nullptr for
+    // non tensor or string values. Release with releaseValue().
+    OrtValue* cloneTensor(OrtValue* value);
+    void releaseValue(OrtValue* value);
 private:
     size_t getInputNodesNum();
     size_t getOutputNodesNum();
 
     std::vector<const char*> getInputNodesNames(size_t input_nodes_size);
+    // frees names from get*NodesNames() with the allocator that made them
+    void releaseNames(std::vector<const char*> &names);
     std::vector<ONNXType> getInputNodesONNXType(size_t input_node_size);
     ONNXTensorElementDataType getInputNodesElementDataType_ONNXType_Tensor(int index);
     std::vector<std::pair<size_t, std::vector<int64_t>>> getInputNodesDims(size_t input_node_size);
@@ -52,8 +183,23 @@ private:
     void getOutputNodesType_ONNXTYPE_IS_SEQUENCE();
 
 private:
+    // per-run instrumentation shared by runNames() and runBinding()
+    class RunScope;
+
     bool CheckStatus(OrtStatus* status);
     int getRandomIndex(int from, int end);
+    bool loadSignature();
+    bool loadNodeInfo(OrtTypeInfo* typeinfo, IOInfo &info);
+    bool runNames(const std::vector<OrtValue*> &inputs, const char* const* names, std::vector<OrtValue*> &outputs,
+                  OrtRunOptions* run_options);
+    RunWatchdog::Slot* beginWatch(OrtRunOptions* &run_options);
+    void endWatch(RunWatchdog::Slot* slot);
+    void settleWatch(RunWatchdog::Slot* slot);
+    void captureInputs(const std::vector<OrtValue*> &inputs);
+    void traceRun(uint64_t start_ns, OrtRunOptions* run_options);
+    void countRun(const PerfSample &begin);
+    void meterRun(bool ok, uint64_t begin_ns);
+    void noteFirstRun(uint64_t begin_ns);
 
 private:
     const OrtApi* g_ort;
@@ -67,6 +213,33 @@ private:
     
     std::vector<OrtValue*> input_tensors;
 
+    OrtMemoryInfo* memory_info;
+    std::vector<const char*> input_node_names;
+    std::vector<const char*> output_node_names;
+    std::vector<IOInfo> input_infos;
+    std::vector<IOInfo> output_infos;
+    std::mutex selection_mtx;
+    std::vector<std::unique_ptr<OutputSelection>> selections;
+
+    std::atomic<bool> profiling;    // endProfiling() may race run() threads reading it
+    uint64_t worker_id;
+    std::string run_tag;            // "<model file>#<worker id>", RequestTrace and watchdog tags
+    double run_time_limit_ms;
+    StartupTiming startup;
+    std::atomic<bool> first_run_pending;
+    bool instrumented;              // WorkerOptions::instrumented
+
+    CaptureWriter* capture;
+    uint32_t capture_model_id;
+    ShadowProfiler* shadow;
+    PerfAccumulator* perf;          // PerfCounters totals of this model, null if not instrumented
+
+    // MetricsRegistry entries of this model, null if not instrumented
+    MetricCounter* metric_runs;
+    MetricCounter* metric_errors;
+    MetricHistogram* metric_run_seconds;
+    MetricGauge* metric_sessions;
+    MemoryAccount memory;
 
     ONNXTensorElementDataType datatype;
 };
@@ -0,0 +1,331 @@
+#include "OutputCompare.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <vector>
+
+namespace {
+
+const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+
+bool succeeded(OrtStatus* status)
+{
+    if(status != nullptr){
+        printf("OutputCompare - %s\n", g_ort->GetErrorMessage(status));
+        g_ort->ReleaseStatus(status);
+        return false;
+    }
+    return true;
+}
+
+// one map of the sequence, label -> score
+template<typename Label>
+bool mapEntries(OrtValue* keys, const float* scores, size_t entries, std::map<Label, float> &by_label);
+
+template<>
+bool mapEntries<int64_t>(OrtValue* keys, const float* scores, size_t entries, std::map<int64_t, float> &by_label)
+{
+    int64_t* labels = nullptr;
+    if(!succeeded(g_ort->GetTensorMutableData(keys, (void**)&labels))){
+        return false;
+    }
+    for(size_t i = 0; i < entries; ++i){
+        by_label[labels[i]] = scores[i];
+    }
+    return true;
+}
+
+template<>
+bool mapEntries<std::string>(OrtValue* keys, const float* scores, size_t entries, std::map<std::string, float> &by_label)
+{
+    size_t bytes = 0;
+    if(!succeeded(g_ort->GetStringTensorDataLength(keys, &bytes))){
+        return false;
+    }
+    std::vector<char> text(bytes + 1, '\0');
+    std::vector<size_t> offsets(entries, 0);
+    if(!succeeded(g_ort->GetStringTensorContent(keys, text.data(), bytes, offsets.data(), entries))){
+        return false;
+    }
+    for(size_t i = 0; i < entries; ++i){
+        const size_t end = i + 1 < entries ? offsets[i + 1] : bytes;
+        by_label[std::string(text.data() + offsets[i], end - offsets[i])] = scores[i];
+    }
+    return true;
+}
+
+template<typename Label>
+bool zipMapTable(OrtValue* sequence, OrtAllocator* allocator, size_t count, std::vector<Label> labels,
+                 std::vector<float> &rows, size_t &classes)
+{
+    rows.clear();
+    classes = labels.size();
+    for(size_t r = 0; r < count; ++r){
+        OrtValue* map = nullptr;
+        OrtValue* keys = nullptr;
+        OrtValue* values = nullptr;
+        OrtTensorTypeAndShapeInfo* info = nullptr;
+        size_t entries = 0;
+        float* scores = nullptr;
+        std::map<Label, float> by_label;
+        bool ok = succeeded(g_ort->GetValue(sequence, (int)r, allocator, &map)) &&
+                  succeeded(g_ort->GetValue(map, 0, allocator, &keys)) &&
+                  succeeded(g_ort->GetValue(map, 1, allocator, &values)) &&
+                  succeeded(g_ort->GetTensorTypeAndShape(values, &info)) &&
+                  succeeded(g_ort->GetTensorShapeElementCount(info, &entries)) &&
+                  succeeded(g_ort->GetTensorMutableData(values, (void**)&scores)) &&
+                  mapEntries<Label>(keys, scores, entries, by_label);
+        if(info != nullptr){
+            g_ort->ReleaseTensorTypeAndShapeInfo(info);
+        }
+        g_ort->ReleaseValue(values);
+        g_ort->ReleaseValue(keys);
+        g_ort->ReleaseValue(map);
+        if(!ok){
+            return false;
+        }
+        if(r == 0 && labels.empty()){
+            for(const auto &entry: by_label){
+                labels.emplace_back(entry.first);
+            }
+            classes = labels.size();
+            rows.reserve(count * classes);
+        }
+        for(const Label &label: labels){
+            rows.emplace_back(by_label[label]);
+        }
+    }
+    return true;
+}
+
+}
+
+void AccuracyStats::reset()
+{
+    max_abs = 0.0;
+    max_rel = 0.0;
+    float_elements = 0;
+    rows = 0;
+    top1_agree = 0;
+    topk_overlap = 0.0;
+    exact_elements = 0;
+    exact_equal = 0;
+    mismatched_shapes = 0;
+    skipped = 0;
+}
+
+OutputCompare::OutputCompare(double rel_floor)
+    :   rel_floor(rel_floor)
+{
+}
+
+float OutputCompare::halfToFloat(uint16_t half)
+{
+    const uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+    if(exponent == 0x1F){
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    }
+    else if(exponent != 0){
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if(mantissa == 0){
+        bits = sign;
+    }
+    else{
+        // subnormal: normalise into a float exponent
+        exponent = 113;
+        while((mantissa & 0x400) == 0){
+            mantissa <<= 1;
+            --exponent;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool OutputCompare::isFloatType(ONNXTensorElementDataType type)
+{
+    return type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT || type == ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE ||
+           type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16 || type == ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16;
+}
+
+bool OutputCompare::elementAt(const void* data, ONNXTensorElementDataType type, size_t i, double &out)
+{
+    switch(type){
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT: out = ((const float*)data)[i]; return true;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE: out = ((const double*)data)[i]; return true;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16: out = halfToFloat(((const uint16_t*)data)[i]); return true;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16:{
+            uint32_t bits = (uint32_t)((const uint16_t*)data)[i] << 16;
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            out = value;
+            return true;
+        }
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8: out = ((const int8_t*)data)[i]; return true;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8: out = ((const uint8_t*)data)[i]; return true;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16: out = ((const int16_t*)data)[i]; return true;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16: out = ((const uint16_t*)data)[i]; return true;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32: out = ((const int32_t*)data)[i]; return true;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32: out = ((const uint32_t*)data)[i]; return true;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64: out = (double)((const int64_t*)data)[i]; return true;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64: out = (double)((const uint64_t*)data)[i]; return true;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL: out = ((const bool*)data)[i] ? 1.0 : 0.0; return true;
+        default: return false;
+    }
+}
+
+// indices of the k largest values, largest first, ties to the lower index
+static void topIndices(const std::vector<double> &row, size_t k, std::vector<size_t> &out)
+{
+    out.resize(row.size());
+    for(size_t i = 0; i < row.size(); ++i){
+        out[i] = i;
+    }
+    std::partial_sort(out.begin(), out.begin() + k, out.end(), [&row](size_t a, size_t b){
+        return row[a] > row[b] || (row[a] == row[b] && a < b);
+    });
+    out.resize(k);
+}
+
+bool OutputCompare::isSequence(OrtValue* value)
+{
+    ONNXType kind = ONNX_TYPE_UNKNOWN;
+    return value != nullptr && succeeded(g_ort->GetValueType(value, &kind)) && kind == ONNX_TYPE_SEQUENCE;
+}
+
+bool OutputCompare::zipMapRows(OrtValue* sequence, const std::vector<int64_t> &int_labels,
+                               const std::vector<std::string> &string_labels, std::vector<float> &rows, size_t &classes)
+{
+    rows.clear();
+    classes = 0;
+    OrtAllocator* allocator = nullptr;
+    size_t count = 0;
+    if(!isSequence(sequence) || !succeeded(g_ort->GetAllocatorWithDefaultOptions(&allocator)) ||
+       !succeeded(g_ort->GetValueCount(sequence, &count))){
+        return false;
+    }
+    if(count == 0){
+        classes = int_labels.empty() ? string_labels.size() : int_labels.size();
+        return true;
+    }
+    // the key type of the first map decides
+    OrtValue* map = nullptr;
+    OrtValue* keys = nullptr;
+    OrtTensorTypeAndShapeInfo* info = nullptr;
+    ONNXTensorElementDataType key_type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+    bool ok = succeeded(g_ort->GetValue(sequence, 0, allocator, &map)) &&
+              succeeded(g_ort->GetValue(map, 0, allocator, &keys)) &&
+              succeeded(g_ort->GetTensorTypeAndShape(keys, &info)) &&
+              succeeded(g_ort->GetTensorElementType(info, &key_type));
+    if(info != nullptr){
+        g_ort->ReleaseTensorTypeAndShapeInfo(info);
+    }
+    g_ort->ReleaseValue(keys);
+    g_ort->ReleaseValue(map);
+    if(!ok){
+        return false;
+    }
+    if(key_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64 && string_labels.empty()){
+        return zipMapTable<int64_t>(sequence, allocator, count, int_labels, rows, classes);
+    }
+    if(key_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_STRING && int_labels.empty()){
+        return zipMapTable<std::string>(sequence, allocator, count, string_labels, rows, classes);
+    }
+    return false;
+}
+
+void OutputCompare::add(ONNXWorker* worker, const CaptureTensor &golden, OrtValue* value, AccuracyStats &stats) const
+{
+    if(golden.type == ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED || golden.type == ONNX_TENSOR_ELEMENT_DATA_TYPE_STRING ||
+       value == nullptr){
+        ++stats.skipped;
+        return;
+    }
+    std::vector<int64_t> dims;
+    std::vector<float> rows;
+    ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+    const void* data = nullptr;
+    if(isSequence(value)){
+        size_t classes = 0;
+        if(!zipMapRows(value, std::vector<int64_t>(), std::vector<std::string>(), rows, classes)){
+            ++stats.skipped;
+            return;
+        }
+        dims = {(int64_t)(classes > 0 ? rows.size() / classes : 0), (int64_t)classes};
+        data = rows.data();
+    }
+    else{
+        if(!worker->getTensorShape(value, dims)){
+            ++stats.skipped;
+            return;
+        }
+        type = worker->getTensorElementType(value);
+        data = worker->getTensorData(value);
+    }
+    const size_t element_bytes = ONNXWorker::elementSize(type);
+    if(type != golden.type || dims != golden.dims || element_bytes == 0){
+        ++stats.mismatched_shapes;
+        return;
+    }
+    const size_t count = golden.data_bytes / element_bytes;
+
+    if(!isFloatType(type)){
+        for(size_t i = 0; i < count; ++i){
+            double a = 0.0, b = 0.0;
+            elementAt(golden.data, type, i, a);
+            elementAt(data, type, i, b);
+            stats.exact_equal += a == b ? 1 : 0;
+        }
+        stats.exact_elements += count;
+        return;
+    }
+
+    std::vector<double> expected(count), actual(count);
+    for(size_t i = 0; i < count; ++i){
+        elementAt(golden.data, type, i, expected[i]);
+        elementAt(data, type, i, actual[i]);
+        const double a = expected[i], b = actual[i];
+        double diff = std::fabs(a - b);
+        if(std::isnan(a) != std::isnan(b)){
+            diff = std::numeric_limits<double>::infinity();
+        }
+        else if(std::isnan(a) || a == b){
+            diff = 0.0;
+        }
+        stats.max_abs = std::max(stats.max_abs, diff);
+        if(std::fabs(a) > rel_floor){
+            stats.max_rel = std::max(stats.max_rel, diff / std::fabs(a));
+        }
+    }
+    stats.float_elements += count;
+
+    const size_t classes = dims.empty() ? 0 : (size_t)dims.back();
+    if(dims.size() > 2 || classes < 2){
+        return;
+    }
+    const size_t k = std::min<size_t>(5, classes);
+    std::vector<double> row_a, row_b;
+    std::vector<size_t> top_a, top_b;
+    for(size_t r = 0; r + classes <= count; r += classes){
+        row_a.assign(expected.begin() + r, expected.begin() + r + classes);
+        row_b.assign(actual.begin() + r, actual.begin() + r + classes);
+        topIndices(row_a, k, top_a);
+        topIndices(row_b, k, top_b);
+        stats.top1_agree += top_a[0] == top_b[0] ? 1 : 0;
+        size_t shared = 0;
+        for(size_t index: top_a){
+            shared += std::find(top_b.begin(), top_b.end(), index) != top_b.end() ? 1 : 0;
+        }
+        stats.topk_overlap += (double)shared / k;
+        ++stats.rows;
+    }
+}
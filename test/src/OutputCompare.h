@@ -0,0 +1,61 @@
+#ifndef OUTPUTCOMPARE_H
+#define OUTPUTCOMPARE_H
+
+#include "ONNXWorker.h"
+#include "CaptureLog.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Agreement of one configuration's outputs with golden outputs, accumulated
+// over every sample. Floating point outputs give the largest absolute and
+// relative error; relative error only counts golden values above rel_floor,
+// where it means something. Score-like outputs (rank 1 or 2, last dimension
+// > 1) also give per row top-1 agreement and top-k overlap. Integer and bool
+// outputs, labels, must match exactly. A ZipMap output, seq(map(label,
+// float)), is compared as the float tensor [N, classes] of zipMapRows().
+struct AccuracyStats{
+    double max_abs;
+    double max_rel;
+    uint64_t float_elements;
+    uint64_t rows;
+    uint64_t top1_agree;
+    double topk_overlap;        // summed per row, k = min(5, classes)
+    uint64_t exact_elements;
+    uint64_t exact_equal;
+    uint64_t mismatched_shapes;
+    uint64_t skipped;           // non tensor or string outputs
+
+    AccuracyStats() { reset(); }
+    void reset();
+
+    double top1Rate() const { return rows > 0 ? (double)top1_agree / rows : 1.0; }
+    double topkRate() const { return rows > 0 ? topk_overlap / rows : 1.0; }
+    double exactRate() const { return exact_elements > 0 ? (double)exact_equal / exact_elements : 1.0; }
+};
+
+class OutputCompare
+{
+public:
+    explicit OutputCompare(double rel_floor = 1e-3);
+
+    // golden: a tensor from a golden capture record; value: the same output
+    // of the run under test
+    void add(ONNXWorker* worker, const CaptureTensor &golden, OrtValue* value, AccuracyStats &stats) const;
+
+    static bool isSequence(OrtValue* value);
+    // seq(map(label, float)) as rows of floats, one column per label in the
+    // order given (int64 or string labels); with both lists empty the labels
+    // of the first map in ascending order
+    static bool zipMapRows(OrtValue* sequence, const std::vector<int64_t> &int_labels,
+                           const std::vector<std::string> &string_labels, std::vector<float> &rows, size_t &classes);
+
+    // element i of a numeric tensor as double, false for strings and unknown types
+    static bool elementAt(const void* data, ONNXTensorElementDataType type, size_t i, double &out);
+    static bool isFloatType(ONNXTensorElementDataType type);
+    static float halfToFloat(uint16_t half);
+
+private:
+    double rel_floor;
+};
+
+#endif
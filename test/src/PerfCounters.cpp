@@ -0,0 +1,316 @@
+#include "PerfCounters.h"
+#include "ModelFiles.h"
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+struct PerfAccumulator{
+    std::string model;
+    std::atomic<uint64_t> runs;
+    std::atomic<uint64_t> values[PERF_COUNTERS];
+    std::atomic<uint32_t> valid;
+    std::atomic<bool> partial;
+
+    explicit PerfAccumulator(const std::string &model)
+        :   model(model),
+            runs(0),
+            valid(0),
+            partial(false)
+    {
+        for(int i = 0; i < PERF_COUNTERS; ++i){
+            values[i].store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+namespace {
+
+struct Registry{
+    std::mutex mtx;
+    std::deque<std::unique_ptr<PerfAccumulator>> accumulators;
+    std::atomic<bool> enabled;
+    std::string reason;
+
+    Registry() : enabled(false) {}
+};
+
+Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+long perfEventOpen(perf_event_attr* attr, int group_fd)
+{
+    return syscall(SYS_perf_event_open, attr, 0, -1, group_fd, 0);
+}
+
+struct ThreadGroup{
+    bool tried;
+    int leader;
+    int fds[PERF_COUNTERS];
+    uint64_t ids[PERF_COUNTERS];
+    uint32_t valid;
+
+    ThreadGroup()
+        :   tried(false), leader(-1), valid(0)
+    {
+        for(int i = 0; i < PERF_COUNTERS; ++i){
+            fds[i] = -1;
+            ids[i] = 0;
+        }
+    }
+
+    ~ThreadGroup()
+    {
+        for(int i = 0; i < PERF_COUNTERS; ++i){
+            if(fds[i] >= 0){
+                close(fds[i]);
+            }
+        }
+    }
+
+    int openCounter(uint32_t type, uint64_t config)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return (int)perfEventOpen(&attr, leader);
+    }
+
+    void open()
+    {
+        tried = true;
+        const uint64_t llc_read_miss = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        int first_errno = 0;
+        for(int i = 0; i < PERF_COUNTERS; ++i){
+            int fd = -1;
+            switch(i){
+                case PERF_CYCLES: fd = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES); break;
+                case PERF_INSTRUCTIONS: fd = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS); break;
+                case PERF_LLC_MISSES:
+                    fd = openCounter(PERF_TYPE_HW_CACHE, llc_read_miss);
+                    if(fd < 0){
+                        fd = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+                    }
+                    break;
+                case PERF_BRANCH_MISSES: fd = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES); break;
+            }
+            if(fd < 0){
+                first_errno = first_errno != 0 ? first_errno : errno;
+                continue;
+            }
+            if(ioctl(fd, PERF_EVENT_IOC_ID, &ids[i]) != 0){
+                close(fd);
+                continue;
+            }
+            fds[i] = fd;
+            valid |= 1u << i;
+            // the first counter that opens leads the group
+            leader = leader < 0 ? fd : leader;
+        }
+        if(leader < 0){
+            Registry &reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mtx);
+            if(reg.reason.empty()){
+                reg.reason = std::string("perf_event_open: ") + strerror(first_errno);
+                FILE* fp = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+                int paranoid = 0;
+                if(fp != nullptr){
+                    if(fscanf(fp, "%d", &paranoid) == 1){
+                        reg.reason += " (perf_event_paranoid " + std::to_string(paranoid) + ")";
+                    }
+                    fclose(fp);
+                }
+            }
+        }
+    }
+};
+
+thread_local ThreadGroup group;
+
+}
+
+void PerfCounters::setEnabled(bool on)
+{
+    registry().enabled.store(on, std::memory_order_relaxed);
+}
+
+bool PerfCounters::enabled()
+{
+    return registry().enabled.load(std::memory_order_relaxed);
+}
+
+bool PerfCounters::read(PerfSample &sample)
+{
+    if(!group.tried){
+        group.open();
+    }
+    if(group.leader < 0){
+        return false;
+    }
+    // nr, time_enabled, time_running, then {value, id} per counter
+    uint64_t buffer[3 + 2 * PERF_COUNTERS];
+    ssize_t got = ::read(group.leader, buffer, sizeof(buffer));
+    if(got < (ssize_t)(3 * sizeof(uint64_t))){
+        return false;
+    }
+    memset(&sample, 0, sizeof(sample));
+    sample.time_enabled = buffer[1];
+    sample.time_running = buffer[2];
+    for(uint64_t n = 0; n < buffer[0] && n < PERF_COUNTERS; ++n){
+        for(int i = 0; i < PERF_COUNTERS; ++i){
+            if((group.valid & (1u << i)) && group.ids[i] == buffer[4 + 2 * n]){
+                sample.values[i] = buffer[3 + 2 * n];
+                sample.valid |= 1u << i;
+            }
+        }
+    }
+    return true;
+}
+
+PerfSample PerfCounters::delta(const PerfSample &begin, const PerfSample &end)
+{
+    PerfSample result;
+    memset(&result, 0, sizeof(result));
+    result.time_enabled = end.time_enabled - begin.time_enabled;
+    result.time_running = end.time_running - begin.time_running;
+    if(result.time_running == 0){
+        // the group was never on a PMU in between
+        return result;
+    }
+    const double scale = (double)result.time_enabled / (double)result.time_running;
+    result.valid = begin.valid & end.valid;
+    for(int i = 0; i < PERF_COUNTERS; ++i){
+        if(result.valid & (1u << i)){
+            uint64_t value = end.values[i] - begin.values[i];
+            result.values[i] = scale > 1.0 ? (uint64_t)((double)value * scale) : value;
+        }
+    }
+    return result;
+}
+
+const char* PerfCounters::unavailableReason()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx);
+    return reg.reason.empty() ? nullptr : reg.reason.c_str();
+}
+
+const char* PerfCounters::counterName(PerfCounter counter)
+{
+    switch(counter){
+        case PERF_CYCLES: return "cycles";
+        case PERF_INSTRUCTIONS: return "instructions";
+        case PERF_LLC_MISSES: return "llc_misses";
+        case PERF_BRANCH_MISSES: return "branch_misses";
+        default: return "unknown";
+    }
+}
+
+PerfAccumulator* PerfCounters::accumulator(const std::string &model, int intra_op_threads)
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx);
+    PerfAccumulator* target = nullptr;
+    for(auto &entry: reg.accumulators){
+        if(entry->model == model){
+            target = entry.get();
+            break;
+        }
+    }
+    if(target == nullptr){
+        reg.accumulators.emplace_back(new PerfAccumulator(model));
+        target = reg.accumulators.back().get();
+    }
+    if(intra_op_threads != 1 && !target->partial.exchange(true) && reg.enabled.load(std::memory_order_relaxed)){
+        printf("PerfCounters::accumulator() - %s uses intra_op_threads %d, only the thread calling Run is counted\n",
+               model.c_str(), intra_op_threads);
+    }
+    return target;
+}
+
+void PerfCounters::accumulate(PerfAccumulator* target, const PerfSample &delta)
+{
+    if(delta.valid == 0){
+        return;
+    }
+    target->runs.fetch_add(1, std::memory_order_relaxed);
+    for(int i = 0; i < PERF_COUNTERS; ++i){
+        if(delta.valid & (1u << i)){
+            target->values[i].fetch_add(delta.values[i], std::memory_order_relaxed);
+        }
+    }
+    target->valid.fetch_or(delta.valid, std::memory_order_relaxed);
+}
+
+void PerfCounters::summary(std::vector<PerfModelStats> &models)
+{
+    models.clear();
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx);
+    for(auto &entry: reg.accumulators){
+        PerfModelStats stats;
+        stats.model = entry->model;
+        stats.runs = entry->runs.load(std::memory_order_relaxed);
+        stats.valid = entry->valid.load(std::memory_order_relaxed);
+        stats.partial = entry->partial.load(std::memory_order_relaxed);
+        for(int i = 0; i < PERF_COUNTERS; ++i){
+            stats.values[i] = entry->values[i].load(std::memory_order_relaxed);
+        }
+        if(stats.runs > 0){
+            models.emplace_back(stats);
+        }
+    }
+}
+
+void PerfCounters::report(FILE* out)
+{
+    std::vector<PerfModelStats> models;
+    summary(models);
+    if(models.empty()){
+        const char* reason = unavailableReason();
+        fprintf(out, "no counted runs%s%s\n", reason != nullptr ? ": " : "", reason != nullptr ? reason : "");
+        return;
+    }
+    fprintf(out, "%-28s %8s %14s %14s %6s %12s %8s %12s\n", "model", "runs", "cycles/run", "instr/run", "IPC",
+            "llc miss/run", "llc MPKI", "br miss/run");
+    bool any_partial = false;
+    for(const PerfModelStats &stats: models){
+        std::string name = modelFileName(stats.model);
+        if(stats.partial){
+            name += " *";
+            any_partial = true;
+        }
+        const double runs = (double)stats.runs;
+        const bool cycles = stats.valid & (1u << PERF_CYCLES);
+        const bool instructions = stats.valid & (1u << PERF_INSTRUCTIONS);
+        const bool llc = stats.valid & (1u << PERF_LLC_MISSES);
+        const bool branch = stats.valid & (1u << PERF_BRANCH_MISSES);
+        fprintf(out, "%-28s %8llu ", name.c_str(), (unsigned long long)stats.runs);
+        cycles ? fprintf(out, "%14.0f ", stats.values[PERF_CYCLES] / runs) : fprintf(out, "%14s ", "n/a");
+        instructions ? fprintf(out, "%14.0f ", stats.values[PERF_INSTRUCTIONS] / runs) : fprintf(out, "%14s ", "n/a");
+        cycles && instructions && stats.values[PERF_CYCLES] > 0 ?
+            fprintf(out, "%6.2f ", (double)stats.values[PERF_INSTRUCTIONS] / stats.values[PERF_CYCLES]) : fprintf(out, "%6s ", "n/a");
+        llc ? fprintf(out, "%12.1f ", stats.values[PERF_LLC_MISSES] / runs) : fprintf(out, "%12s ", "n/a");
+        llc && instructions && stats.values[PERF_INSTRUCTIONS] > 0 ?
+            fprintf(out, "%8.2f ", 1000.0 * stats.values[PERF_LLC_MISSES] / stats.values[PERF_INSTRUCTIONS]) : fprintf(out, "%8s ", "n/a");
+        branch ? fprintf(out, "%12.1f\n", stats.values[PERF_BRANCH_MISSES] / runs) : fprintf(out, "%12s\n", "n/a");
+    }
+    if(any_partial){
+        fprintf(out, "* ran on intra-op pool threads, counts cover the thread calling Run only\n");
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+enum PerfCounter{
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,        // last level cache read misses, generic cache misses where not supported
+    PERF_BRANCH_MISSES,
+    PERF_COUNTERS
+};
+
+struct PerfSample{
+    uint64_t values[PERF_COUNTERS];
+    uint32_t valid;         // bit per PerfCounter that could be opened
+    uint64_t time_enabled;  // ns, for multiplexing
+    uint64_t time_running;
+};
+
+struct PerfModelStats{
+    std::string model;
+    uint64_t runs;
+    uint64_t values[PERF_COUNTERS];
+    uint32_t valid;
+    bool partial;           // some session of the model ran on more than one intra-op thread
+};
+
+struct PerfAccumulator;
+
+// Hardware counters around every Run, per model. Each thread that runs a
+// model opens its own perf_event_open group (user space only, so
+// perf_event_paranoid <= 2 is enough) on first use and reads it with one
+// read() before and after Run; deltas are scaled when the kernel multiplexes
+// the group. Counters a core does not have are left out; when none can be
+// opened (no PMU in a VM, paranoid 3, seccomp) reads fail, runs are not
+// counted and unavailableReason() says why.
+//
+// The group counts the thread that calls Run only (pid 0, no inherit). With
+// intra_op_threads other than 1 ORT runs most kernels on its pool threads,
+// which are not counted: such models are flagged partial, a warning is
+// printed when one registers while counting is on and report() marks them. Count with
+// intra_op_threads = 1 for numbers that cover the whole Run.
+class PerfCounters
+{
+public:
+    static void setEnabled(bool on);
+    static bool enabled();
+
+    // opens the calling thread's group if needed
+    static bool read(PerfSample &sample);
+    static PerfSample delta(const PerfSample &begin, const PerfSample &end);
+    static const char* unavailableReason();
+    static const char* counterName(PerfCounter counter);
+
+    // one accumulator per model path, kept for the life of the process;
+    // intra_op_threads != 1 (0 is ORT's default pool) marks it partial
+    static PerfAccumulator* accumulator(const std::string &model, int intra_op_threads = 1);
+    static void accumulate(PerfAccumulator* target, const PerfSample &delta);
+
+    // models with at least one counted run
+    static void summary(std::vector<PerfModelStats> &models);
+    // IPC, misses per run and per 1000 instructions
+    static void report(FILE* out);
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "Postprocess.h"
+#include "SimdOps.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+float maxValue(const float* scores, size_t count)
+{
+    size_t i = 0;
+    float best = scores[0];
+    if(count >= 16){
+        simd::f32x4 m0 = simd::load(scores);
+        simd::f32x4 m1 = simd::load(scores + 4);
+        simd::f32x4 m2 = simd::load(scores + 8);
+        simd::f32x4 m3 = simd::load(scores + 12);
+        for(i = 16; i + 16 <= count; i += 16){
+            m0 = simd::max(m0, simd::load(scores + i));
+            m1 = simd::max(m1, simd::load(scores + i + 4));
+            m2 = simd::max(m2, simd::load(scores + i + 8));
+            m3 = simd::max(m3, simd::load(scores + i + 12));
+        }
+        best = simd::hmax(simd::max(simd::max(m0, m1), simd::max(m2, m3)));
+    }
+    for(; i < count; ++i){
+        best = scores[i] > best ? scores[i] : best;
+    }
+    return best;
+}
+
+// min-heap on score, on equal scores the higher index is "smaller" so it is evicted first
+inline bool worse(const ScoredClass &a, const ScoredClass &b)
+{
+    return a.score < b.score || (a.score == b.score && a.index > b.index);
+}
+
+inline bool heapLess(const ScoredClass &a, const ScoredClass &b)
+{
+    return worse(b, a);
+}
+
+}
+
+size_t argmax(const float* scores, size_t count)
+{
+    if(count == 0){
+        return 0;
+    }
+    // a vectorized max pass, then a scan for its first position
+    const float best = maxValue(scores, count);
+    for(size_t i = 0; i < count; ++i){
+        if(scores[i] == best){
+            return i;
+        }
+    }
+    return 0;
+}
+
+size_t topK(const float* scores, size_t count, size_t k, ScoredClass* out)
+{
+    if(k > count){
+        k = count;
+    }
+    if(k == 0){
+        return 0;
+    }
+    if(k <= 8){
+        // tiny k: a sorted k-entry buffer with insertion beats heap bookkeeping
+        size_t filled = 0;
+        for(size_t i = 0; i < count; ++i){
+            const float score = scores[i];
+            if(filled == k && score <= out[k - 1].score){
+                continue;
+            }
+            size_t pos = filled < k ? filled++ : k - 1;
+            while(pos > 0 && out[pos - 1].score < score){
+                out[pos] = out[pos - 1];
+                --pos;
+            }
+            out[pos].index = (int)i;
+            out[pos].score = score;
+        }
+        return k;
+    }
+    for(size_t i = 0; i < k; ++i){
+        out[i].index = (int)i;
+        out[i].score = scores[i];
+    }
+    std::make_heap(out, out + k, heapLess);
+    float floor = out[0].score;
+    for(size_t i = k; i < count; ++i){
+        // most candidates lose against the current k-th best, one compare each
+        if(scores[i] <= floor){
+            continue;
+        }
+        std::pop_heap(out, out + k, heapLess);
+        out[k - 1].index = (int)i;
+        out[k - 1].score = scores[i];
+        std::push_heap(out, out + k, heapLess);
+        floor = out[0].score;
+    }
+    std::sort_heap(out, out + k, heapLess);
+    return k;
+}
+
+void softmaxInPlace(float* scores, size_t count)
+{
+    if(count == 0){
+        return;
+    }
+    const float best = maxValue(scores, count);
+    float sum = 0.0f;
+    for(size_t i = 0; i < count; ++i){
+        scores[i] = std::exp(scores[i] - best);
+        sum += scores[i];
+    }
+    const float inv = 1.0f / sum;
+    const simd::f32x4 vinv = simd::set1(inv);
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        simd::store(scores + i, simd::mul(simd::load(scores + i), vinv));
+    }
+    for(; i < count; ++i){
+        scores[i] *= inv;
+    }
+}
+
+size_t filterThreshold(const float* scores, size_t count, float threshold, ScoredClass* out, size_t capacity)
+{
+    size_t found = 0;
+    size_t i = 0;
+    for(; i + 4 <= count && found < capacity; i += 4){
+        // skip blocks where no lane reaches the threshold
+        if(simd::hmax(simd::load(scores + i)) < threshold){
+            continue;
+        }
+        for(size_t j = i; j < i + 4 && found < capacity; ++j){
+            if(scores[j] >= threshold){
+                out[found].index = (int)j;
+                out[found].score = scores[j];
+                ++found;
+            }
+        }
+    }
+    for(; i < count && found < capacity; ++i){
+        if(scores[i] >= threshold){
+            out[found].index = (int)i;
+            out[found].score = scores[i];
+            ++found;
+        }
+    }
+    return found;
+}
+
+void argmaxBatch(const float* scores, size_t rows, size_t cols, size_t* out)
+{
+    for(size_t r = 0; r < rows; ++r){
+        out[r] = argmax(scores + r * cols, cols);
+    }
+}
+
+void topKBatch(const float* scores, size_t rows, size_t cols, size_t k, ScoredClass* out)
+{
+    for(size_t r = 0; r < rows; ++r){
+        topK(scores + r * cols, cols, k, out + r * k);
+    }
+}
+
+void softmaxBatch(float* scores, size_t rows, size_t cols)
+{
+    for(size_t r = 0; r < rows; ++r){
+        softmaxInPlace(scores + r * cols, cols);
+    }
+}
+
+void filterThresholdBatch(const float* scores, size_t rows, size_t cols, float threshold,
+                          ScoredClass* out, size_t capacity, size_t* counts)
+{
+    for(size_t r = 0; r < rows; ++r){
+        counts[r] = filterThreshold(scores + r * cols, cols, threshold, out + r * capacity, capacity);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+
+#include <stddef.h>
+
+// Postprocessing that reads (or, for softmax, rewrites) output tensor data in
+// place, e.g. straight from ONNXWorker::getFloatData(). Nothing here allocates.
+
+struct ScoredClass{
+    int index;
+    float score;
+};
+
+// Index of the first maximum, 0 for an empty range.
+size_t argmax(const float* scores, size_t count);
+// The k best scores in descending order (ties keep the lower index), selected
+// in a fixed k-entry buffer in out: sorted insertion for k <= 8, a min-heap
+// above that. Returns min(k, count).
+size_t topK(const float* scores, size_t count, size_t k, ScoredClass* out);
+void softmaxInPlace(float* scores, size_t count);
+// Writes every class with score >= threshold, up to capacity, in index order.
+// Returns how many were written.
+size_t filterThreshold(const float* scores, size_t count, float threshold, ScoredClass* out, size_t capacity);
+
+// Batched variants over a [rows, cols] tensor.
+void argmaxBatch(const float* scores, size_t rows, size_t cols, size_t* out);
+// out holds rows * k entries, row r starts at out + r * k
+void topKBatch(const float* scores, size_t rows, size_t cols, size_t k, ScoredClass* out);
+void softmaxBatch(float* scores, size_t rows, size_t cols);
+// out holds rows * capacity entries, counts[r] receives the per-row hit count
+void filterThresholdBatch(const float* scores, size_t rows, size_t cols, float threshold,
+                          ScoredClass* out, size_t capacity, size_t* counts);
+
+#endif
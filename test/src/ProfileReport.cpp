@@ -0,0 +1,174 @@
+#include "ProfileReport.h"
+#include "JsonReader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+
+namespace {
+
+const char KERNEL_SUFFIX[] = "_kernel_time";
+
+void finalize(std::map<std::string, ProfileEntry> &entries, double kernel_us, std::vector<ProfileEntry> &out)
+{
+    out.clear();
+    for(auto &entry: entries){
+        entry.second.share = kernel_us > 0.0 ? entry.second.total_us / kernel_us : 0.0;
+        out.emplace_back(entry.second);
+    }
+    std::sort(out.begin(), out.end(), [](const ProfileEntry &a, const ProfileEntry &b){
+        return a.total_us > b.total_us;
+    });
+}
+
+}
+
+ProfileReport::ProfileReport()
+    :   run_count(0),
+        run_us(0.0),
+        kernel_us(0.0)
+{
+}
+
+bool ProfileReport::load(const std::string &path)
+{
+    JsonValue root;
+    if(!loadJson(path, root, "ProfileReport::load()")){
+        return false;
+    }
+    // a bare event array, or a Chrome trace object around it
+    const JsonValue* events = &root;
+    if(root.type == JsonValue::JSON_OBJECT){
+        events = root.find("traceEvents");
+    }
+    if(events == nullptr || events->type != JsonValue::JSON_ARRAY){
+        printf("ProfileReport::load() - %s: no event array\n", path.c_str());
+        return false;
+    }
+
+    std::map<std::string, ProfileEntry> ops, nodes;
+    run_count = 0;
+    run_us = 0.0;
+    kernel_us = 0.0;
+    for(const JsonValue &event: events->items){
+        const JsonValue* name = event.find("name");
+        const JsonValue* dur = event.find("dur");
+        const JsonValue* cat = event.find("cat");
+        if(name == nullptr || dur == nullptr || name->type != JsonValue::JSON_STRING){
+            continue;
+        }
+        if(cat != nullptr && cat->text == "Session"){
+            if(name->text == "model_run"){
+                ++run_count;
+                run_us += dur->number;
+            }
+            continue;
+        }
+        const std::string &full = name->text;
+        const size_t suffix = sizeof(KERNEL_SUFFIX) - 1;
+        if(full.size() <= suffix || full.compare(full.size() - suffix, suffix, KERNEL_SUFFIX) != 0){
+            continue;
+        }
+        const JsonValue* args = event.find("args");
+        const JsonValue* op_name = args != nullptr ? args->find("op_name") : nullptr;
+        std::string op = op_name != nullptr ? op_name->text : std::string("?");
+        std::string node = full.substr(0, full.size() - suffix);
+
+        ProfileEntry &op_entry = ops[op];
+        op_entry.name = op;
+        op_entry.op = op;
+        ++op_entry.calls;
+        op_entry.total_us += dur->number;
+        ProfileEntry &node_entry = nodes[node];
+        node_entry.name = node;
+        node_entry.op = op;
+        ++node_entry.calls;
+        node_entry.total_us += dur->number;
+        kernel_us += dur->number;
+    }
+    finalize(ops, kernel_us, op_entries);
+    finalize(nodes, kernel_us, node_entries);
+    return true;
+}
+
+void ProfileReport::print(FILE* out, size_t top) const
+{
+    const double runs = run_count > 0 ? (double)run_count : 1.0;
+    fprintf(out, "%llu runs, run %.1f us, kernels %.1f us per run (%.1f%% of run)\n", (unsigned long long)run_count,
+            run_us / runs, kernel_us / runs, run_us > 0.0 ? 100.0 * kernel_us / run_us : 0.0);
+    fprintf(out, "%-24s %8s %10s %12s %8s\n", "operator", "nodes", "calls/run", "us/run", "share");
+    for(const ProfileEntry &entry: op_entries){
+        size_t node_count = 0;
+        for(const ProfileEntry &node: node_entries){
+            node_count += node.op == entry.op ? 1 : 0;
+        }
+        fprintf(out, "%-24s %8zu %10.1f %12.2f %7.1f%%\n", entry.name.c_str(), node_count,
+                (double)entry.calls / runs, entry.total_us / runs, 100.0 * entry.share);
+    }
+    size_t count = top > 0 && top < node_entries.size() ? top : node_entries.size();
+    fprintf(out, "%-32s %-16s %10s %12s %8s\n", "node", "operator", "calls/run", "us/run", "share");
+    for(size_t i = 0; i < count; ++i){
+        const ProfileEntry &entry = node_entries[i];
+        fprintf(out, "%-32s %-16s %10.1f %12.2f %7.1f%%\n", entry.name.c_str(), entry.op.c_str(),
+                (double)entry.calls / runs, entry.total_us / runs, 100.0 * entry.share);
+    }
+}
+
+void ProfileReport::compare(FILE* out, const ProfileReport &a, const ProfileReport &b,
+                            const std::string &label_a, const std::string &label_b)
+{
+    const double runs_a = a.run_count > 0 ? (double)a.run_count : 1.0;
+    const double runs_b = b.run_count > 0 ? (double)b.run_count : 1.0;
+    std::map<std::string, std::pair<double, double>> ops;
+    for(const ProfileEntry &entry: a.op_entries){
+        ops[entry.name].first = entry.total_us / runs_a;
+    }
+    for(const ProfileEntry &entry: b.op_entries){
+        ops[entry.name].second = entry.total_us / runs_b;
+    }
+    std::vector<std::pair<std::string, std::pair<double, double>>> rows(ops.begin(), ops.end());
+    std::sort(rows.begin(), rows.end(), [](const std::pair<std::string, std::pair<double, double>> &x,
+                                           const std::pair<std::string, std::pair<double, double>> &y){
+        return std::max(x.second.first, x.second.second) > std::max(y.second.first, y.second.second);
+    });
+
+    fprintf(out, "%-24s %12s %12s %12s %8s   (us per run)\n", "operator", label_a.c_str(), label_b.c_str(), "delta", "ratio");
+    for(const auto &row: rows){
+        double us_a = row.second.first, us_b = row.second.second;
+        fprintf(out, "%-24s %12.2f %12.2f %+12.2f ", row.first.c_str(), us_a, us_b, us_b - us_a);
+        if(us_a > 0.0){
+            fprintf(out, "%7.2fx\n", us_b / us_a);
+        }
+        else{
+            fprintf(out, "%8s\n", "new");
+        }
+    }
+    fprintf(out, "%-24s %12.2f %12.2f %+12.2f\n", "kernels", a.kernel_us / runs_a, b.kernel_us / runs_b,
+            b.kernel_us / runs_b - a.kernel_us / runs_a);
+    fprintf(out, "%-24s %12.2f %12.2f %+12.2f\n", "run", a.run_us / runs_a, b.run_us / runs_b,
+            b.run_us / runs_b - a.run_us / runs_a);
+
+    // nodes present on one side only: what the optimizer fused away or added
+    for(int side = 0; side < 2; ++side){
+        const ProfileReport &self = side == 0 ? a : b;
+        const ProfileReport &other = side == 0 ? b : a;
+        std::vector<const ProfileEntry*> only;
+        for(const ProfileEntry &entry: self.node_entries){
+            bool found = false;
+            for(const ProfileEntry &match: other.node_entries){
+                if(match.name == entry.name){
+                    found = true;
+                    break;
+                }
+            }
+            if(!found){
+                only.emplace_back(&entry);
+            }
+        }
+        fprintf(out, "%zu nodes only in %s", only.size(), (side == 0 ? label_a : label_b).c_str());
+        for(size_t i = 0; i < only.size() && i < 8; ++i){
+            fprintf(out, "%s %s(%s)", i == 0 ? ":" : ",", only[i]->name.c_str(), only[i]->op.c_str());
+        }
+        fprintf(out, only.size() > 8 ? ", ...\n" : "\n");
+    }
+}
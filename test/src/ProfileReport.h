@@ -0,0 +1,49 @@
+#ifndef PROFILEREPORT_H
+#define PROFILEREPORT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+struct ProfileEntry{
+    std::string name;       // operator type, or node name for per-node entries
+    std::string op;         // operator type of a node
+    uint64_t calls;
+    double total_us;
+    double share;           // of the summed kernel time
+};
+
+// Per operator and per node aggregation of an ORT profile (the JSON array
+// written by SessionEndProfiling). Only "<node>_kernel_time" events count as
+// operator time; model_run events give the number of runs and the time spent
+// outside kernels. Entries are sorted by total time, largest first.
+class ProfileReport
+{
+public:
+    ProfileReport();
+
+    bool load(const std::string &path);
+
+    const std::vector<ProfileEntry> &ops() const { return op_entries; }
+    const std::vector<ProfileEntry> &nodes() const { return node_entries; }
+    uint64_t runs() const { return run_count; }
+    double runUs() const { return run_us; }
+    double kernelUs() const { return kernel_us; }
+
+    // top = 0 prints every node
+    void print(FILE* out, size_t top) const;
+    // per operator time per run of b against a, and nodes only one side has
+    // (fused or inserted by the optimizer)
+    static void compare(FILE* out, const ProfileReport &a, const ProfileReport &b,
+                        const std::string &label_a, const std::string &label_b);
+
+private:
+    std::vector<ProfileEntry> op_entries;
+    std::vector<ProfileEntry> node_entries;
+    uint64_t run_count;
+    double run_us;
+    double kernel_us;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "ProtoWire.h"
+#include <string.h>
+
+static bool readVarint(const uint8_t* &p, const uint8_t* end, uint64_t &value)
+{
+    value = 0;
+    for(int shift = 0; shift < 64 && p < end; shift += 7){
+        const uint8_t byte = *p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+static void writeVarint(std::string &out, uint64_t value)
+{
+    while(value >= 0x80){
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+// wire integers are little endian whatever the host
+static uint64_t readFixed(const uint8_t* p, int bytes)
+{
+    uint64_t value = 0;
+    for(int i = bytes - 1; i >= 0; --i){
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static void writeFixed(std::string &out, uint64_t value, int bytes)
+{
+    for(int i = 0; i < bytes; ++i){
+        out.push_back((char)(value >> (8 * i)));
+    }
+}
+
+bool ProtoMessage::parse(const char* data, size_t size)
+{
+    fields.clear();
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* end = p + size;
+    while(p < end){
+        uint64_t key = 0;
+        if(!readVarint(p, end, key) || (key >> 3) == 0){
+            return false;
+        }
+        ProtoField field;
+        field.number = (uint32_t)(key >> 3);
+        field.wire = (uint32_t)(key & 7);
+        field.value = 0;
+        switch(field.wire){
+            case WIRE_VARINT:
+                if(!readVarint(p, end, field.value)){
+                    return false;
+                }
+                break;
+            case WIRE_FIXED64:
+            case WIRE_FIXED32:{
+                const int bytes = field.wire == WIRE_FIXED64 ? 8 : 4;
+                if(end - p < bytes){
+                    return false;
+                }
+                field.value = readFixed(p, bytes);
+                p += bytes;
+                break;
+            }
+            case WIRE_LEN:{
+                uint64_t length = 0;
+                if(!readVarint(p, end, length) || length > (uint64_t)(end - p)){
+                    return false;
+                }
+                field.data.assign((const char*)p, (size_t)length);
+                p += length;
+                break;
+            }
+            default:
+                return false;
+        }
+        fields.emplace_back(std::move(field));
+    }
+    return true;
+}
+
+void ProtoMessage::serializeTo(std::string &out) const
+{
+    std::string nested;
+    for(const ProtoField &field: fields){
+        writeVarint(out, ((uint64_t)field.number << 3) | field.wire);
+        switch(field.wire){
+            case WIRE_VARINT: writeVarint(out, field.value); break;
+            case WIRE_FIXED64: writeFixed(out, field.value, 8); break;
+            case WIRE_FIXED32: writeFixed(out, field.value, 4); break;
+            default:
+                if(field.message){
+                    nested.clear();
+                    field.message->serializeTo(nested);
+                    writeVarint(out, nested.size());
+                    out += nested;
+                }
+                else{
+                    writeVarint(out, field.data.size());
+                    out += field.data;
+                }
+                break;
+        }
+    }
+}
+
+std::string ProtoMessage::serialize() const
+{
+    std::string out;
+    serializeTo(out);
+    return out;
+}
+
+ProtoMessage* ProtoMessage::child(ProtoField &field)
+{
+    if(field.wire != WIRE_LEN){
+        return nullptr;
+    }
+    if(!field.message){
+        std::shared_ptr<ProtoMessage> message = std::make_shared<ProtoMessage>();
+        if(!message->parse(field.data)){
+            return nullptr;
+        }
+        field.message = message;
+        field.data.clear();
+    }
+    return field.message.get();
+}
+
+ProtoField* ProtoMessage::find(uint32_t number)
+{
+    for(ProtoField &field: fields){
+        if(field.number == number){
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+const ProtoField* ProtoMessage::find(uint32_t number) const
+{
+    for(const ProtoField &field: fields){
+        if(field.number == number){
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+size_t ProtoMessage::count(uint32_t number) const
+{
+    size_t n = 0;
+    for(const ProtoField &field: fields){
+        n += field.number == number ? 1 : 0;
+    }
+    return n;
+}
+
+// LEN payload bytes, re-encoded if child() has parsed the field
+static std::string payload(const ProtoField &field)
+{
+    return field.message ? field.message->serialize() : field.data;
+}
+
+std::string ProtoMessage::text(uint32_t number) const
+{
+    const ProtoField* field = find(number);
+    return field != nullptr && field->wire == WIRE_LEN ? payload(*field) : std::string();
+}
+
+std::vector<std::string> ProtoMessage::texts(uint32_t number) const
+{
+    std::vector<std::string> values;
+    for(const ProtoField &field: fields){
+        if(field.number == number && field.wire == WIRE_LEN){
+            values.emplace_back(payload(field));
+        }
+    }
+    return values;
+}
+
+int64_t ProtoMessage::integer(uint32_t number, int64_t fallback) const
+{
+    const ProtoField* field = find(number);
+    return field != nullptr && field->wire == WIRE_VARINT ? (int64_t)field->value : fallback;
+}
+
+std::vector<int64_t> ProtoMessage::integers(uint32_t number) const
+{
+    std::vector<int64_t> values;
+    for(const ProtoField &field: fields){
+        if(field.number != number){
+            continue;
+        }
+        if(field.wire == WIRE_VARINT){
+            values.emplace_back((int64_t)field.value);
+        }
+        else if(field.wire == WIRE_LEN){
+            const std::string packed = payload(field);
+            const uint8_t* p = (const uint8_t*)packed.data();
+            const uint8_t* end = p + packed.size();
+            uint64_t value = 0;
+            while(p < end && readVarint(p, end, value)){
+                values.emplace_back((int64_t)value);
+            }
+        }
+    }
+    return values;
+}
+
+void ProtoMessage::setText(uint32_t number, const std::string &value)
+{
+    ProtoField* field = find(number);
+    if(field == nullptr){
+        field = &append(number, WIRE_LEN);
+    }
+    field->wire = WIRE_LEN;
+    field->data = value;
+    field->message.reset();
+}
+
+void ProtoMessage::setInteger(uint32_t number, int64_t value)
+{
+    ProtoField* field = find(number);
+    if(field == nullptr){
+        field = &append(number, WIRE_VARINT);
+    }
+    field->wire = WIRE_VARINT;
+    field->value = (uint64_t)value;
+    field->data.clear();
+    field->message.reset();
+}
+
+ProtoField &ProtoMessage::append(uint32_t number, uint32_t wire)
+{
+    ProtoField field;
+    field.number = number;
+    field.wire = wire;
+    field.value = 0;
+    fields.emplace_back(std::move(field));
+    return fields.back();
+}
+
+void ProtoMessage::remove(uint32_t number)
+{
+    std::vector<ProtoField> kept;
+    for(ProtoField &field: fields){
+        if(field.number != number){
+            kept.emplace_back(std::move(field));
+        }
+    }
+    fields.swap(kept);
+}
@@ -0,0 +1,68 @@
+#ifndef PROTOWIRE_H
+#define PROTOWIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Protocol buffers wire format without generated code or libprotobuf: a
+// message is its fields in file order, so anything not edited, unknown
+// fields included, is written back byte for byte. Nested messages stay raw
+// bytes until child() parses them; only those are re-encoded on serialize().
+// Groups (wire types 3 and 4, unused by ONNX) do not parse.
+enum ProtoWireType{
+    WIRE_VARINT = 0,
+    WIRE_FIXED64 = 1,
+    WIRE_LEN = 2,
+    WIRE_FIXED32 = 5
+};
+
+class ProtoMessage;
+
+struct ProtoField{
+    uint32_t number;
+    uint32_t wire;
+    uint64_t value;                         // VARINT, FIXED64 and FIXED32 payloads
+    std::string data;                       // LEN payload
+    std::shared_ptr<ProtoMessage> message;  // LEN payload once parsed by child(), written instead of data
+};
+
+class ProtoMessage
+{
+public:
+    bool parse(const char* data, size_t size);
+    bool parse(const std::string &data) { return parse(data.data(), data.size()); }
+    std::string serialize() const;
+
+    // nested message of a LEN field, parsed on first use; nullptr if the
+    // payload is not a message
+    static ProtoMessage* child(ProtoField &field);
+
+    ProtoField* find(uint32_t number);
+    const ProtoField* find(uint32_t number) const;
+    size_t count(uint32_t number) const;
+    // first LEN field as a string, empty if absent; a field child() has
+    // parsed is serialized again
+    std::string text(uint32_t number) const;
+    // every LEN field with number, e.g. repeated string
+    std::vector<std::string> texts(uint32_t number) const;
+    // first VARINT field, fallback if absent
+    int64_t integer(uint32_t number, int64_t fallback) const;
+    // repeated int64, packed or not
+    std::vector<int64_t> integers(uint32_t number) const;
+
+    // replace the first field with number, or append one
+    void setText(uint32_t number, const std::string &value);
+    void setInteger(uint32_t number, int64_t value);
+    ProtoField &append(uint32_t number, uint32_t wire);
+    void remove(uint32_t number);
+
+    std::vector<ProtoField> fields;
+
+private:
+    void serializeTo(std::string &out) const;
+};
+
+#endif
@@ -0,0 +1,308 @@
+#include "RequestTrace.h"
+#include <pthread.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct TraceEvent{
+    const char* name;
+    uint64_t request;
+    uint64_t start_ns;
+    uint64_t dur_ns;
+    int64_t arg;
+    char phase;             // 'X' complete, 'i' instant
+    char tag[32];
+};
+
+struct TraceSlot{
+    std::atomic<uint64_t> seq;      // 2 * index + 1 while written, 2 * index + 2 once done
+    TraceEvent event;
+};
+
+struct ThreadRing{
+    std::unique_ptr<TraceSlot[]> slots;
+    uint64_t mask;
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> floor;    // events before it were cleared
+    long tid;
+    char thread_name[16];
+
+    explicit ThreadRing(size_t capacity)
+        :   slots(new TraceSlot[capacity]),
+            mask(capacity - 1),
+            head(0),
+            floor(0),
+            tid(syscall(SYS_gettid))
+    {
+        for(size_t i = 0; i < capacity; ++i){
+            slots[i].seq.store(0, std::memory_order_relaxed);
+        }
+        if(pthread_getname_np(pthread_self(), thread_name, sizeof(thread_name)) != 0){
+            thread_name[0] = '\0';
+        }
+    }
+};
+
+struct Registry{
+    std::mutex mtx;
+    std::vector<ThreadRing*> rings;     // kept after their thread exits, the events still matter
+    std::atomic<bool> enabled;
+    std::atomic<size_t> capacity;
+    std::atomic<uint64_t> next_request;
+    uint64_t anchor_steady_ns;
+    uint64_t anchor_wall_ns;
+
+    Registry()
+        :   enabled(false),
+            capacity(1 << 16),
+            next_request(1)
+    {
+        anchor_steady_ns = RequestTrace::nowNs();
+        anchor_wall_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+};
+
+Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+thread_local uint64_t current_request = 0;
+
+ThreadRing &localRing()
+{
+    static thread_local ThreadRing* ring = nullptr;
+    if(ring == nullptr){
+        Registry &reg = registry();
+        size_t size = 2;
+        while(size < reg.capacity.load(std::memory_order_relaxed)){
+            size <<= 1;
+        }
+        ring = new ThreadRing(size);
+        std::lock_guard<std::mutex> lock(reg.mtx);
+        reg.rings.emplace_back(ring);
+    }
+    return *ring;
+}
+
+void append(char phase, const char* name, uint64_t request, uint64_t start_ns, uint64_t dur_ns, const char* tag, int64_t arg)
+{
+    ThreadRing &ring = localRing();
+    const uint64_t index = ring.head.load(std::memory_order_relaxed);
+    TraceSlot &slot = ring.slots[index & ring.mask];
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceEvent &event = slot.event;
+    event.name = name;
+    event.request = request;
+    event.start_ns = start_ns;
+    event.dur_ns = dur_ns;
+    event.arg = arg;
+    event.phase = phase;
+    if(tag != nullptr){
+        strncpy(event.tag, tag, sizeof(event.tag) - 1);
+        event.tag[sizeof(event.tag) - 1] = '\0';
+    }
+    else{
+        event.tag[0] = '\0';
+    }
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+    ring.head.store(index + 1, std::memory_order_release);
+}
+
+// consistent copies of the events still in the ring
+void snapshot(ThreadRing &ring, std::vector<TraceEvent> &events)
+{
+    events.clear();
+    const uint64_t capacity = ring.mask + 1;
+    const uint64_t head = ring.head.load(std::memory_order_acquire);
+    uint64_t begin = ring.floor.load(std::memory_order_relaxed);
+    if(head > capacity && head - capacity > begin){
+        begin = head - capacity;
+    }
+    for(uint64_t index = begin; index < head; ++index){
+        TraceSlot &slot = ring.slots[index & ring.mask];
+        if(slot.seq.load(std::memory_order_acquire) != 2 * index + 2){
+            continue;
+        }
+        TraceEvent event;
+        memcpy(&event, &slot.event, sizeof(event));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.seq.load(std::memory_order_relaxed) != 2 * index + 2){
+            continue;
+        }
+        events.emplace_back(event);
+    }
+}
+
+void writeString(FILE* out, const char* text)
+{
+    fputc('"', out);
+    for(const char* c = text; *c != '\0'; ++c){
+        if(*c == '"' || *c == '\\'){
+            fputc('\\', out);
+            fputc(*c, out);
+        }
+        else if((unsigned char)*c < 0x20){
+            fprintf(out, "\\u%04x", (unsigned)(unsigned char)*c);
+        }
+        else{
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+}
+
+void RequestTrace::setEnabled(bool on, size_t events_per_thread)
+{
+    Registry &reg = registry();
+    reg.capacity.store(events_per_thread, std::memory_order_relaxed);
+    reg.enabled.store(on, std::memory_order_relaxed);
+}
+
+bool RequestTrace::enabled()
+{
+    return registry().enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t RequestTrace::newRequestId()
+{
+    return registry().next_request.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t RequestTrace::nowNs()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void RequestTrace::setCurrent(uint64_t request)
+{
+    current_request = request;
+}
+
+uint64_t RequestTrace::current()
+{
+    return current_request;
+}
+
+void RequestTrace::instant(const char* name, uint64_t request, const char* tag, int64_t arg)
+{
+    if(enabled()){
+        append('i', name, request, nowNs(), 0, tag, arg);
+    }
+}
+
+void RequestTrace::complete(const char* name, uint64_t request, uint64_t start_ns, uint64_t end_ns, const char* tag, int64_t arg)
+{
+    if(enabled()){
+        append('X', name, request, start_ns, end_ns > start_ns ? end_ns - start_ns : 0, tag, arg);
+    }
+}
+
+uint64_t RequestTrace::wallNs(uint64_t steady_ns)
+{
+    Registry &reg = registry();
+    return reg.anchor_wall_ns + (steady_ns - reg.anchor_steady_ns);
+}
+
+bool RequestTrace::exportChrome(const char* path, uint64_t origin_wall_ns)
+{
+    FILE* out = fopen(path, "w");
+    if(out == nullptr){
+        printf("RequestTrace::exportChrome() - cannot open %s\n", path);
+        return false;
+    }
+    bool ok = exportChrome(out, origin_wall_ns);
+    return fclose(out) == 0 && ok;
+}
+
+bool RequestTrace::exportChrome(FILE* out, uint64_t origin_wall_ns)
+{
+    Registry &reg = registry();
+    std::vector<ThreadRing*> rings;
+    {
+        std::lock_guard<std::mutex> lock(reg.mtx);
+        rings = reg.rings;
+    }
+    const int pid = (int)getpid();
+    std::vector<TraceEvent> events;
+    bool first = true;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for(ThreadRing* ring: rings){
+        fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%ld,\"args\":{\"name\":",
+                first ? "" : ",", pid, ring->tid);
+        writeString(out, ring->thread_name[0] != '\0' ? ring->thread_name : "thread");
+        fprintf(out, "}}");
+        first = false;
+
+        snapshot(*ring, events);
+        for(const TraceEvent &event: events){
+            // signed, events may predate the origin
+            double ts_us = (double)(int64_t)(wallNs(event.start_ns) - origin_wall_ns) / 1000.0;
+            fprintf(out, ",\n{\"name\":");
+            writeString(out, event.name);
+            fprintf(out, ",\"cat\":\"request\",\"ph\":\"%c\",\"ts\":%.3f,", event.phase, ts_us);
+            if(event.phase == 'X'){
+                fprintf(out, "\"dur\":%.3f,", (double)event.dur_ns / 1000.0);
+            }
+            else{
+                fprintf(out, "\"s\":\"t\",");
+            }
+            fprintf(out, "\"pid\":%d,\"tid\":%ld,\"args\":{\"request\":%llu", pid, ring->tid, (unsigned long long)event.request);
+            if(event.tag[0] != '\0'){
+                fprintf(out, ",\"tag\":");
+                writeString(out, event.tag);
+            }
+            if(event.arg >= 0){
+                fprintf(out, ",\"arg\":%lld", (long long)event.arg);
+            }
+            fprintf(out, "}}");
+        }
+    }
+    fprintf(out, "\n]}\n");
+    return ferror(out) == 0;
+}
+
+void RequestTrace::clear()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx);
+    for(ThreadRing* ring: reg.rings){
+        ring->floor.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+uint64_t RequestTrace::recorded()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx);
+    uint64_t total = 0;
+    for(ThreadRing* ring: reg.rings){
+        total += ring->head.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t RequestTrace::overwritten()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx);
+    uint64_t total = 0;
+    for(ThreadRing* ring: reg.rings){
+        uint64_t live = ring->head.load(std::memory_order_relaxed) - ring->floor.load(std::memory_order_relaxed);
+        total += live > ring->mask + 1 ? live - (ring->mask + 1) : 0;
+    }
+    return total;
+}
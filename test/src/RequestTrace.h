@@ -0,0 +1,83 @@
+#ifndef REQUESTTRACE_H
+#define REQUESTTRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+
+// Opt-in per-request timeline. Every thread appends events to its own ring
+// (overwriting the oldest once full) with plain stores and a per-slot
+// sequence number, so recording never blocks and never shares a cache line;
+// exportChrome() copies the rings and writes Chrome trace JSON, which loads
+// in chrome://tracing or Perfetto next to an ORT profile.
+//
+// Events carry the request id, so a request can be followed from enqueue
+// through batch formation, Run and postprocessing across threads, and the
+// run events carry the ORT run tag of the Run call they time.
+// Timestamps are steady clock ns, converted to wall clock on export.
+class RequestTrace
+{
+public:
+    // events_per_thread is rounded up to a power of two and applies to rings
+    // created after the call
+    static void setEnabled(bool on, size_t events_per_thread = 1 << 16);
+    static bool enabled();
+
+    static uint64_t newRequestId();
+    static uint64_t nowNs();
+    // a steady clock time point on the nowNs() time line
+    static uint64_t steadyNs(std::chrono::steady_clock::time_point time)
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+
+    // request the calling thread works on, picked up by ONNXWorker::run
+    static void setCurrent(uint64_t request);
+    static uint64_t current();
+
+    // tag is copied (truncated to 31 chars), arg < 0 is left out of the export
+    static void instant(const char* name, uint64_t request, const char* tag = nullptr, int64_t arg = -1);
+    static void complete(const char* name, uint64_t request, uint64_t start_ns, uint64_t end_ns,
+                         const char* tag = nullptr, int64_t arg = -1);
+
+    // ts is written in us since origin_wall_ns (ns since the Unix epoch,
+    // 0 writes absolute time), e.g. an ORT profiling start time
+    static bool exportChrome(const char* path, uint64_t origin_wall_ns = 0);
+    static bool exportChrome(FILE* out, uint64_t origin_wall_ns = 0);
+    static uint64_t wallNs(uint64_t steady_ns);
+    // forgets recorded events, rings stay allocated
+    static void clear();
+    // events recorded and overwritten before export
+    static uint64_t recorded();
+    static uint64_t overwritten();
+};
+
+// Times the enclosing scope as a complete event when tracing is on.
+class TraceSpan
+{
+public:
+    TraceSpan(const char* name, uint64_t request, const char* tag = nullptr, int64_t arg = -1)
+        :   name(name), request(request), tag(tag), arg(arg),
+            start(RequestTrace::enabled() ? RequestTrace::nowNs() : 0)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if(start != 0){
+            RequestTrace::complete(name, request, start, RequestTrace::nowNs(), tag, arg);
+        }
+    }
+
+private:
+    TraceSpan(const TraceSpan &);
+    TraceSpan &operator=(const TraceSpan &);
+
+    const char* name;
+    uint64_t request;
+    const char* tag;
+    int64_t arg;
+    uint64_t start;
+};
+
+#endif
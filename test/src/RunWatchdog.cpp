@@ -0,0 +1,163 @@
+#include "RunWatchdog.h"
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+RunWatchdog &RunWatchdog::instance()
+{
+    static RunWatchdog watchdog;
+    return watchdog;
+}
+
+RunWatchdog::RunWatchdog()
+    :   g_ort(OrtGetApiBase()->GetApi(ORT_API_VERSION)),
+        running(false),
+        unregistered(0),
+        default_limit_ns(0),
+        poll_ns(0)
+{
+}
+
+RunWatchdog::~RunWatchdog()
+{
+    stop();
+    for(Slot* slot: slots){
+        g_ort->ReleaseRunOptions(slot->own_options);
+        delete slot;
+    }
+}
+
+uint64_t RunWatchdog::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void RunWatchdog::start(double default_limit_ms, double poll_ms)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    default_limit_ns = (uint64_t)(default_limit_ms * 1e6);
+    poll_ns = (uint64_t)(poll_ms * 1e6);
+    if(poll_ns == 0){
+        poll_ns = 1000000;
+    }
+    if(running.load(std::memory_order_relaxed)){
+        return;
+    }
+    running.store(true, std::memory_order_relaxed);
+    thread = std::thread(&RunWatchdog::loop, this);
+}
+
+void RunWatchdog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(!running.load(std::memory_order_relaxed)){
+            return;
+        }
+        running.store(false, std::memory_order_relaxed);
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+RunWatchdog::Slot* RunWatchdog::registerSlot(uint64_t worker_id, const std::string &model, const std::string &tag,
+                                             OrtRunOptions* own_options, double limit_ms)
+{
+    Slot* slot = new Slot;
+    slot->generation.store(0);
+    slot->start_ns.store(0);
+    slot->options.store(own_options);
+    slot->terminate_issued.store(false);
+    slot->own_options = own_options;
+    slot->worker_id = worker_id;
+    slot->limit_ns = (uint64_t)(limit_ms * 1e6);
+    slot->model = model;
+    slot->tag = tag;
+    std::lock_guard<std::mutex> lock(mtx);
+    slots.push_back(slot);
+    return slot;
+}
+
+void RunWatchdog::unregisterWorker(uint64_t worker_id)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    for(auto it = slots.begin(); it != slots.end();){
+        if((*it)->worker_id == worker_id){
+            g_ort->ReleaseRunOptions((*it)->own_options);
+            delete *it;
+            it = slots.erase(it);
+        }
+        else{
+            ++it;
+        }
+    }
+    unregistered.fetch_add(1, std::memory_order_release);
+}
+
+bool RunWatchdog::registered(uint64_t worker_id) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    for(const Slot* slot: slots){
+        if(slot->worker_id == worker_id){
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<WatchdogEvent> RunWatchdog::getEvents() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return events;
+}
+
+uint64_t RunWatchdog::terminations() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return events.size();
+}
+
+void RunWatchdog::loop()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while(running.load(std::memory_order_relaxed)){
+        const uint64_t now = nowNs();
+        for(Slot* slot: slots){
+            // the start time and options read after the generation belong to
+            // that run as long as the generation has not moved since
+            uint64_t generation = slot->generation.load();
+            uint64_t start = slot->start_ns.load();
+            OrtRunOptions* options = slot->options.load();
+            uint64_t limit = slot->limit_ns > 0 ? slot->limit_ns : default_limit_ns;
+            if(((generation >> 1) & 1) == 0 || (generation & CLAIMED) != 0 || limit == 0 || now < start + limit){
+                continue;
+            }
+            if(!slot->generation.compare_exchange_strong(generation, generation | CLAIMED)){
+                continue;
+            }
+            // caller supplied options keep their own tag; read before the run
+            // side is released, the caller may free its options after that
+            WatchdogEvent event;
+            event.model = slot->model;
+            const char* tag = nullptr;
+            OrtStatus* status = options != slot->own_options ? g_ort->RunOptionsGetRunTag(options, &tag) : NULL;
+            if(status != NULL){
+                g_ort->ReleaseStatus(status);
+                tag = nullptr;
+            }
+            event.tag = tag != nullptr && tag[0] != '\0' ? tag : slot->tag;
+            status = g_ort->RunOptionsSetTerminate(options);
+            if(status != NULL){
+                g_ort->ReleaseStatus(status);
+            }
+            slot->terminate_issued.store(true, std::memory_order_release);
+            event.elapsed_ms = (now - start) / 1e6;
+            event.limit_ms = limit / 1e6;
+            events.push_back(event);
+            printf("RunWatchdog::loop() - terminate run %s (%s) after %.2f ms, limit %.2f ms\n",
+                   event.tag.c_str(), event.model.c_str(), event.elapsed_ms, event.limit_ms);
+        }
+        cv.wait_for(lock, std::chrono::nanoseconds(poll_ns));
+    }
+}
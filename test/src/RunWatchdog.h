@@ -0,0 +1,89 @@
+#ifndef RUNWATCHDOG_H
+#define RUNWATCHDOG_H
+
+#include "onnxruntime_c_api.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct WatchdogEvent{
+    std::string model;
+    std::string tag;
+    double elapsed_ms;
+    double limit_ms;
+};
+
+// Process wide watchdog for hung Run calls. Every (ONNXWorker, thread) pair
+// owns one slot; ONNXWorker::run stores the options and start time in it and
+// bumps the slot generation before Run, and bumps it again afterwards, that is
+// the whole hot path cost. The watchdog thread polls the slots and calls
+// RunOptionsSetTerminate on any run older than its limit, recording the model
+// and the run tag (the caller's own tag when it passed run options).
+//
+// A run may end, and the next one start, between the watchdog's check and its
+// terminate. So the watchdog first claims the run with a compare-and-swap on
+// the generation it read, which fails once the run side has moved on, and the
+// run side waits for a claimed terminate to be issued and clears it before the
+// next run on those options.
+class RunWatchdog
+{
+public:
+    struct Slot{
+        // +2 at every run begin and end, so (generation >> 1) is odd while a run
+        // is in progress; bit 0 is set by the watchdog when it claims the run
+        std::atomic<uint64_t> generation;
+        std::atomic<uint64_t> start_ns;
+        std::atomic<OrtRunOptions*> options;        // options of the current run
+        std::atomic<bool> terminate_issued;         // RunOptionsSetTerminate done for the claimed run
+        OrtRunOptions* own_options;                 // tagged, used when the caller passes none
+        uint64_t worker_id;
+        uint64_t limit_ns;                          // 0 = watchdog default
+        std::string model;
+        std::string tag;
+    };
+
+    static const uint64_t CLAIMED = 1;
+
+    static RunWatchdog &instance();
+
+    void start(double default_limit_ms, double poll_ms);
+    void stop();
+    bool enabled() const { return running.load(std::memory_order_relaxed); }
+
+    Slot* registerSlot(uint64_t worker_id, const std::string &model, const std::string &tag,
+                       OrtRunOptions* own_options, double limit_ms);
+    // drops every slot of a worker and releases their run options
+    void unregisterWorker(uint64_t worker_id);
+    // bumped by every unregisterWorker(), tells thread local slot caches to prune
+    uint64_t unregistrations() const { return unregistered.load(std::memory_order_acquire); }
+    bool registered(uint64_t worker_id) const;
+
+    std::vector<WatchdogEvent> getEvents() const;
+    uint64_t terminations() const;
+
+    static uint64_t nowNs();
+
+private:
+    RunWatchdog();
+    ~RunWatchdog();
+    void loop();
+
+private:
+    const OrtApi* g_ort;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> unregistered;
+    uint64_t default_limit_ns;
+    uint64_t poll_ns;
+
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<Slot*> slots;
+    std::vector<WatchdogEvent> events;
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,335 @@
+#include "Scheduler.h"
+#include "RequestTrace.h"
+#include <stdio.h>
+#include <algorithm>
+
+const char* schedPriorityName(SchedPriority priority)
+{
+    switch(priority){
+        case SCHED_HIGH: return "high";
+        case SCHED_NORMAL: return "normal";
+        case SCHED_LOW: return "low";
+        default: return "unknown";
+    }
+}
+
+Scheduler::Scheduler(size_t run_threads, int64_t chunk_rows, double quantum_ms)
+    :   run_threads(run_threads > 0 ? run_threads : 1),
+        chunk_rows(chunk_rows),
+        quantum_ms(quantum_ms),
+        stopping(false)
+{
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    for(int i = 0; i < SCHED_CLASSES; ++i){
+        waiting[i] = 0;
+        const std::string class_label = MetricsRegistry::label("class", schedPriorityName((SchedPriority)i));
+        metric_pending[i] = metrics.gauge("onnx_scheduler_pending", "Scheduler jobs waiting to run a chunk.", class_label);
+        metric_latency[i] = metrics.histogram("onnx_scheduler_latency_seconds", "Scheduler submit to completion of successful jobs.",
+                                              class_label, MetricHistogram::latencyBounds());
+    }
+    if(!(quantum_ms > 0.0)){
+        printf("Scheduler::Scheduler() - quantum_ms must be positive, got %f\n", quantum_ms);
+        stopping = true;
+        return;
+    }
+    for(size_t i = 0; i < this->run_threads; ++i){
+        threads.emplace_back(&Scheduler::runLoop, this);
+    }
+}
+
+Scheduler::~Scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    for(auto &thread: threads){
+        thread.join();
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    for(Job* job: high){
+        finishLocked(job, REQUEST_REJECTED);
+    }
+    for(auto &tenant: tenants){
+        for(int i = 0; i < SCHED_CLASSES; ++i){
+            for(Job* job: tenant.queues[i]){
+                finishLocked(job, REQUEST_REJECTED);
+            }
+        }
+    }
+}
+
+int Scheduler::addModel(ONNXWorker* worker)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    models.emplace_back(worker);
+    metric_chunk_rows.emplace_back(MetricsRegistry::instance().histogram("onnx_scheduler_chunk_rows", "Rows per Scheduler chunk.",
+                                                                         MetricsRegistry::modelLabel(worker->getModelPath()),
+                                                                         MetricHistogram::powersOfTwo(12)));
+    return (int)models.size() - 1;
+}
+
+int Scheduler::addTenant(const std::string &name, double weight)
+{
+    if(!(weight > 0.0)){
+        printf("Scheduler::addTenant() - weight of %s must be positive, got %f\n", name.c_str(), weight);
+        return -1;
+    }
+    Tenant tenant;
+    tenant.name = name;
+    tenant.weight = weight;
+    for(int i = 0; i < SCHED_CLASSES; ++i){
+        tenant.deficit_ms[i] = 0.0;
+        tenant.active[i] = false;
+        tenant.running[i] = 0;
+    }
+    tenant.run_ms = 0.0;
+    std::lock_guard<std::mutex> lock(mtx);
+    tenants.emplace_back(tenant);
+    return (int)tenants.size() - 1;
+}
+
+std::future<SchedResult> Scheduler::submit(int model, int tenant, SchedPriority priority, const std::vector<OrtValue*> &inputs)
+{
+    Job* job = new Job;
+    job->model = model;
+    job->tenant = tenant;
+    job->priority = priority;
+    job->inputs = inputs;
+    job->rows = 0;
+    job->next_row = 0;
+    job->enqueue_time = Clock::now();
+    job->first_start = job->enqueue_time;
+    job->result.status = REQUEST_OK;
+    job->result.queue_ms = 0.0;
+    job->result.run_ms = 0.0;
+    job->result.latency_ms = 0.0;
+    job->result.trace_id = RequestTrace::enabled() ? RequestTrace::newRequestId() : 0;
+    std::future<SchedResult> future = job->promise.get_future();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if(stopping || model < 0 || model >= (int)models.size() || tenant < 0 || tenant >= (int)tenants.size() ||
+       priority < SCHED_HIGH || priority >= SCHED_CLASSES){
+        printf("Scheduler::submit() - rejected model %d tenant %d priority %d\n", model, tenant, (int)priority);
+        job->priority = SCHED_CLASSES;
+        finishLocked(job, REQUEST_REJECTED);
+        return future;
+    }
+
+    // chunk only if every input shares a leading batch dimension
+    if(priority != SCHED_HIGH && chunk_rows > 0 && !inputs.empty()){
+        ONNXWorker* worker = models[model];
+        int64_t rows = -1;
+        std::vector<int64_t> dims;
+        for(OrtValue* value: inputs){
+            if(!worker->getTensorShape(value, dims) || dims.empty() ||
+               ONNXWorker::elementSize(worker->getTensorElementType(value)) == 0 || (rows >= 0 && dims[0] != rows)){
+                rows = -1;
+                break;
+            }
+            rows = dims[0];
+        }
+        job->rows = rows > chunk_rows ? rows : 0;
+    }
+    RequestTrace::instant("enqueue", job->result.trace_id, schedPriorityName(priority), job->rows);
+    pushLocked(job, false);
+    cv.notify_one();
+    return future;
+}
+
+void Scheduler::pushLocked(Job* job, bool front)
+{
+    metric_pending[job->priority]->add(1);
+    if(job->priority == SCHED_HIGH){
+        high.push_back(job);
+        return;
+    }
+    Tenant &tenant = tenants[job->tenant];
+    std::deque<Job*> &queue = tenant.queues[job->priority];
+    front ? queue.push_front(job) : queue.push_back(job);
+    ++waiting[job->priority];
+    if(!tenant.active[job->priority]){
+        tenant.active[job->priority] = true;
+        rounds[job->priority].push_back(job->tenant);
+    }
+}
+
+Scheduler::Job* Scheduler::pickLocked()
+{
+    if(!high.empty()){
+        Job* job = high.front();
+        high.pop_front();
+        metric_pending[SCHED_HIGH]->add(-1);
+        return job;
+    }
+    for(int cls = SCHED_NORMAL; cls < SCHED_CLASSES; ++cls){
+        if(waiting[cls] == 0){
+            continue;
+        }
+        // terminates: some listed tenant has queued work and gains credit every turn
+        std::deque<int> &round = rounds[cls];
+        while(true){
+            int index = round.front();
+            Tenant &tenant = tenants[index];
+            round.pop_front();
+            if(tenant.queues[cls].empty()){
+                if(tenant.running[cls] == 0){
+                    // idle tenants do not bank credit
+                    tenant.active[cls] = false;
+                    tenant.deficit_ms[cls] = 0.0;
+                }
+                else{
+                    round.push_back(index);
+                }
+                continue;
+            }
+            if(tenant.deficit_ms[cls] <= 0.0){
+                tenant.deficit_ms[cls] += quantum_ms * tenant.weight;
+                round.push_back(index);
+                continue;
+            }
+            // keeps its turn while credit lasts
+            round.push_front(index);
+            Job* job = tenant.queues[cls].front();
+            tenant.queues[cls].pop_front();
+            --waiting[cls];
+            metric_pending[cls]->add(-1);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+bool Scheduler::runChunk(Job* job, double &run_ms)
+{
+    ONNXWorker* worker = models[job->model];
+    std::vector<OrtValue*> outputs(worker->getOutputsSignature().size(), nullptr);
+    std::vector<OrtValue*> views;
+    int64_t rows = 0;
+    const uint64_t trace_id = job->result.trace_id;
+    if(job->rows > 0){
+        rows = std::min(chunk_rows, job->rows - job->next_row);
+        TraceSpan span("batch", trace_id, nullptr, rows);
+        metric_chunk_rows[job->model]->observe((double)rows);
+        std::vector<int64_t> dims;
+        for(OrtValue* value: job->inputs){
+            worker->getTensorShape(value, dims);
+            size_t row_bytes = ONNXWorker::elementSize(worker->getTensorElementType(value));
+            for(size_t i = 1; i < dims.size(); ++i){
+                row_bytes *= (size_t)dims[i];
+            }
+            dims[0] = rows;
+            char* data = (char*)worker->getTensorData(value) + (size_t)job->next_row * row_bytes;
+            views.emplace_back(worker->createTensor(data, (size_t)rows * row_bytes, dims, worker->getTensorElementType(value)));
+        }
+    }
+
+    Clock::time_point begin = Clock::now();
+    RequestTrace::setCurrent(trace_id);
+    bool ok = worker->run(job->rows > 0 ? views : job->inputs, outputs);
+    RequestTrace::setCurrent(0);
+    run_ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+
+    for(OrtValue* view: views){
+        worker->releaseValue(view);
+    }
+    if(ok){
+        job->result.outputs.emplace_back(outputs);
+    }
+    else{
+        for(OrtValue* value: outputs){
+            worker->releaseValue(value);
+        }
+    }
+    job->next_row += rows;
+    return ok;
+}
+
+void Scheduler::finishLocked(Job* job, RequestStatus status)
+{
+    Clock::time_point now = Clock::now();
+    TraceSpan span("complete", job->result.trace_id, nullptr, (int64_t)status);
+    job->result.status = status;
+    job->result.latency_ms = std::chrono::duration<double, std::milli>(now - job->enqueue_time).count();
+    job->result.queue_ms = std::chrono::duration<double, std::milli>(job->first_start - job->enqueue_time).count();
+    if(status != REQUEST_OK){
+        for(auto &chunk: job->result.outputs){
+            for(OrtValue* value: chunk){
+                models[job->model]->releaseValue(value);
+            }
+        }
+        job->result.outputs.clear();
+    }
+    else{
+        latency[job->priority].record((uint64_t)(job->result.latency_ms * 1e6));
+        metric_latency[job->priority]->observe(job->result.latency_ms / 1000.0);
+    }
+    job->promise.set_value(job->result);
+    delete job;
+}
+
+void Scheduler::runLoop()
+{
+    while(true){
+        Job* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&]{ return stopping || !high.empty() || waiting[SCHED_NORMAL] > 0 || waiting[SCHED_LOW] > 0; });
+            if(stopping){
+                return;
+            }
+            job = pickLocked();
+            if(job->next_row == 0 && job->result.outputs.empty()){
+                job->first_start = Clock::now();
+                if(job->result.trace_id != 0){
+                    RequestTrace::complete("queue", job->result.trace_id, RequestTrace::steadyNs(job->enqueue_time), RequestTrace::steadyNs(job->first_start),
+                                           schedPriorityName(job->priority));
+                }
+            }
+            if(job->priority != SCHED_HIGH){
+                ++tenants[job->tenant].running[job->priority];
+            }
+        }
+
+        double run_ms = 0.0;
+        bool ok = runChunk(job, run_ms);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        Tenant &tenant = tenants[job->tenant];
+        tenant.run_ms += run_ms;
+        job->result.run_ms += run_ms;
+        if(job->priority != SCHED_HIGH){
+            --tenant.running[job->priority];
+            tenant.deficit_ms[job->priority] -= run_ms;
+        }
+        if(!ok){
+            finishLocked(job, REQUEST_ERROR);
+        }
+        else if(job->rows > 0 && job->next_row < job->rows){
+            pushLocked(job, true);
+            cv.notify_one();
+        }
+        else{
+            finishLocked(job, REQUEST_OK);
+        }
+    }
+}
+
+SchedClassStats Scheduler::getClassStats(SchedPriority priority) const
+{
+    SchedClassStats stats = SchedClassStats();
+    std::lock_guard<std::mutex> lock(mtx);
+    const LatencyHistogram &histogram = latency[priority];
+    stats.count = histogram.count();
+    stats.p50_ms = histogram.percentile(50.0) / 1e6;
+    stats.p99_ms = histogram.percentile(99.0) / 1e6;
+    stats.max_ms = histogram.max() / 1e6;
+    return stats;
+}
+
+double Scheduler::tenantRunMs(int tenant) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return tenants[tenant].run_ms;
+}
@@ -0,0 +1,137 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "ONNXWorker.h"
+#include "InferenceQueue.h"
+#include "LatencyHistogram.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum SchedPriority{
+    SCHED_HIGH = 0,         // strict priority, FIFO, never chunked
+    SCHED_NORMAL,
+    SCHED_LOW,
+    SCHED_CLASSES
+};
+
+const char* schedPriorityName(SchedPriority priority);
+
+struct SchedResult{
+    RequestStatus status;
+    // one entry per chunk in row order, each holding one value per model
+    // output; release every value with ONNXWorker::releaseValue
+    std::vector<std::vector<OrtValue*>> outputs;
+    double queue_ms;        // submit to first chunk start
+    double run_ms;          // sum of chunk Run durations
+    double latency_ms;      // submit to completion
+    uint64_t trace_id;      // RequestTrace id, 0 when tracing is off
+};
+
+struct SchedClassStats{
+    uint64_t count;
+    double p50_ms;
+    double p99_ms;
+    double max_ms;
+};
+
+// Central scheduler for several ONNXWorker sessions sharing the CPU.
+// run_threads threads pick work in class order: any SCHED_HIGH request first,
+// then SCHED_NORMAL, then SCHED_LOW. Inside a class, tenants are served by
+// deficit round robin on measured Run time, so over time each backlogged
+// tenant gets CPU in proportion to its weight whatever model it runs.
+//
+// NORMAL and LOW requests whose inputs share a leading batch dimension larger
+// than chunk_rows are run chunk_rows rows at a time, each chunk a separate
+// scheduling decision, so a high priority request waits for at most one chunk.
+// With RequestTrace enabled, chunk formation is traced as "batch" events.
+// MetricsRegistry gets the queued jobs and the latency per class and the
+// chunk sizes per model.
+class Scheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // chunk_rows = 0 disables chunking, quantum_ms is the DRR credit of a
+    // weight 1 tenant per round. A non positive quantum would never let a
+    // tenant's deficit grow: such a scheduler is not ready and rejects every
+    // request.
+    Scheduler(size_t run_threads, int64_t chunk_rows, double quantum_ms);
+    ~Scheduler();
+
+    bool isReady() const { return !threads.empty(); }
+
+    // register everything before the first submit(); addTenant() returns -1
+    // for a non positive weight
+    int addModel(ONNXWorker* worker);
+    int addTenant(const std::string &name, double weight);
+
+    // inputs are caller owned and must stay alive until the future is ready
+    std::future<SchedResult> submit(int model, int tenant, SchedPriority priority, const std::vector<OrtValue*> &inputs);
+
+    SchedClassStats getClassStats(SchedPriority priority) const;
+    // Run time consumed by a tenant so far
+    double tenantRunMs(int tenant) const;
+    const std::string &tenantName(int tenant) const { return tenants[tenant].name; }
+
+private:
+    struct Job{
+        int model;
+        int tenant;
+        SchedPriority priority;
+        std::vector<OrtValue*> inputs;
+        int64_t rows;               // 0 when the job runs in one piece
+        int64_t next_row;
+        Clock::time_point enqueue_time;
+        Clock::time_point first_start;
+        SchedResult result;
+        std::promise<SchedResult> promise;
+    };
+
+    struct Tenant{
+        std::string name;
+        double weight;
+        std::deque<Job*> queues[SCHED_CLASSES];
+        double deficit_ms[SCHED_CLASSES];
+        bool active[SCHED_CLASSES];         // listed in rounds[]
+        int running[SCHED_CLASSES];         // chunks in flight
+        double run_ms;
+    };
+
+    void runLoop();
+    Job* pickLocked();
+    void pushLocked(Job* job, bool front);
+    bool runChunk(Job* job, double &run_ms);
+    void finishLocked(Job* job, RequestStatus status);
+
+private:
+    size_t run_threads;
+    int64_t chunk_rows;
+    double quantum_ms;
+
+    std::vector<ONNXWorker*> models;
+    std::vector<Tenant> tenants;
+
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<Job*> high;
+    // tenants with queued work, per class, in round robin order
+    std::deque<int> rounds[SCHED_CLASSES];
+    size_t waiting[SCHED_CLASSES];
+    bool stopping;
+
+    LatencyHistogram latency[SCHED_CLASSES];    // ns, completed requests
+    std::vector<std::thread> threads;
+
+    MetricGauge* metric_pending[SCHED_CLASSES];
+    MetricHistogram* metric_latency[SCHED_CLASSES];
+    std::vector<MetricHistogram*> metric_chunk_rows;    // per model
+};
+
+#endif
@@ -0,0 +1,295 @@
+#include "ShadowProfiler.h"
+#include "FastRandom.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+ShadowProfiler::ShadowProfiler(const std::string &model_path, const ShadowConfig &config)
+    :   model_path(model_path),
+        config(config),
+        stopping(false),
+        offered(0),
+        sampled(0),
+        dropped(0),
+        failed(0),
+        session_runs(0),
+        file_index(0)
+{
+    double rate = config.sample_rate < 0.0 ? 0.0 : (config.sample_rate > 1.0 ? 1.0 : config.sample_rate);
+    threshold = (uint32_t)(rate * (double)(1u << 24));
+    this->config.runs_per_file = config.runs_per_file > 0 ? config.runs_per_file : 1;
+    this->config.max_pending = config.max_pending > 0 ? config.max_pending : 1;
+    stats = ShadowStats();
+    thread = std::thread(&ShadowProfiler::shadowLoop, this);
+}
+
+ShadowProfiler::~ShadowProfiler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    thread.join();
+    for(Mirror &mirror: pending){
+        releaseMirror(mirror);
+    }
+}
+
+void ShadowProfiler::offer(ONNXWorker* source, const std::vector<OrtValue*> &inputs)
+{
+    offered.fetch_add(1, std::memory_order_relaxed);
+    if(threshold == 0 || FastRandom::local().below(1u << 24) >= threshold){
+        return;
+    }
+    sampled.fetch_add(1, std::memory_order_relaxed);
+    {
+        // check before the copy, the copy is the expensive part
+        std::lock_guard<std::mutex> lock(mtx);
+        if(stopping || pending.size() >= config.max_pending){
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    Mirror mirror;
+    mirror.source = source;
+    for(OrtValue* value: inputs){
+        OrtValue* copy = source->cloneTensor(value);
+        if(copy == nullptr){
+            failed.fetch_add(1, std::memory_order_relaxed);
+            releaseMirror(mirror);
+            return;
+        }
+        mirror.inputs.emplace_back(copy);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(stopping || pending.size() >= config.max_pending){
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        else{
+            pending.emplace_back(mirror);
+            mirror.inputs.clear();
+        }
+    }
+    releaseMirror(mirror);
+    cv.notify_one();
+}
+
+void ShadowProfiler::releaseMirror(Mirror &mirror)
+{
+    for(OrtValue* value: mirror.inputs){
+        mirror.source->releaseValue(value);
+    }
+    mirror.inputs.clear();
+}
+
+ShadowStats ShadowProfiler::getStats() const
+{
+    ShadowStats copy;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        copy = stats;
+    }
+    copy.offered = offered.load(std::memory_order_relaxed);
+    copy.sampled = sampled.load(std::memory_order_relaxed);
+    copy.dropped = dropped.load(std::memory_order_relaxed);
+    copy.failed = failed.load(std::memory_order_relaxed);
+    return copy;
+}
+
+std::vector<std::string> ShadowProfiler::files() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return finished;
+}
+
+bool ShadowProfiler::openSession()
+{
+    WorkerOptions options = config.options;
+    options.profile_prefix = config.prefix + "_raw";
+    // sampled, profiled runs must not show up as the model's production traffic
+    options.instrumented = false;
+    session.reset(new ONNXWorker(model_path, options));
+    session_runs = 0;
+    session_start = std::chrono::steady_clock::now();
+    return session->isProfiling();
+}
+
+void ShadowProfiler::closeSession()
+{
+    if(!session){
+        return;
+    }
+    uint64_t start_ns = session->getProfilingStartNs();
+    std::string raw = session->endProfiling();
+    session.reset();
+    if(raw.empty() || session_runs == 0){
+        if(!raw.empty()){
+            unlink(raw.c_str());
+        }
+        return;
+    }
+    std::string path = config.prefix + "_" + std::to_string(file_index++) + ".json";
+    if(!rebaseProfile(raw, path, start_ns)){
+        return;
+    }
+    unlink(raw.c_str());
+
+    std::string oldest;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        finished.emplace_back(path);
+        ++stats.files;
+        if(config.max_files > 0 && finished.size() > config.max_files){
+            oldest = finished.front();
+            finished.erase(finished.begin());
+        }
+    }
+    if(!oldest.empty()){
+        unlink(oldest.c_str());
+    }
+}
+
+// Copies an ORT profile, replacing the value t (us after start_ns) of every
+// "ts" key with start_ns / 1000 + t. Strings are skipped whole, so "ts" only
+// matches as a key, never inside a name or an argument value. Everything else
+// is copied byte for byte.
+bool ShadowProfiler::rebaseProfile(const std::string &from, const std::string &to, uint64_t start_ns)
+{
+    FILE* in = fopen(from.c_str(), "rb");
+    if(in == nullptr){
+        printf("ShadowProfiler::rebaseProfile() - cannot open %s\n", from.c_str());
+        return false;
+    }
+    std::vector<char> text;
+    char chunk[65536];
+    size_t got;
+    while((got = fread(chunk, 1, sizeof(chunk), in)) > 0){
+        text.insert(text.end(), chunk, chunk + got);
+    }
+    fclose(in);
+    text.push_back('\0');
+
+    FILE* out = fopen(to.c_str(), "wb");
+    if(out == nullptr){
+        printf("ShadowProfiler::rebaseProfile() - cannot create %s\n", to.c_str());
+        return false;
+    }
+    const double base_us = (double)(start_ns / 1000) + (double)(start_ns % 1000) / 1000.0;
+    const char* pos = text.data();
+    const char* end = text.data() + text.size() - 1;
+    const char* scan = pos;
+    while(scan < end){
+        if(*scan != '"'){
+            ++scan;
+            continue;
+        }
+        const char* close = scan + 1;
+        while(close < end && *close != '"'){
+            close += *close == '\\' ? 2 : 1;
+        }
+        if(close >= end){
+            break;
+        }
+        bool ts_key = close - scan == 3 && scan[1] == 't' && scan[2] == 's';
+        scan = close + 1;
+        if(!ts_key){
+            continue;
+        }
+        const char* value = scan;
+        while(*value == ' ' || *value == '\t' || *value == '\r' || *value == '\n'){
+            ++value;
+        }
+        if(*value != ':'){
+            continue;
+        }
+        ++value;
+        while(*value == ' ' || *value == '\t' || *value == '\r' || *value == '\n'){
+            ++value;
+        }
+        char* stop = nullptr;
+        double ts = strtod(value, &stop);
+        if(stop == value){
+            continue;
+        }
+        fwrite(pos, 1, (size_t)(value - pos), out);
+        fprintf(out, "%.3f", base_us + ts);
+        pos = scan = stop;
+    }
+    fwrite(pos, 1, (size_t)(end - pos), out);
+    return fclose(out) == 0;
+}
+
+void ShadowProfiler::shadowLoop()
+{
+    if(config.cpu >= 0){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(config.cpu, &set);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0){
+            printf("ShadowProfiler::shadowLoop() - cannot pin to cpu %d\n", config.cpu);
+        }
+    }
+    // per thread on Linux
+    if(setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), config.nice) != 0){
+        printf("ShadowProfiler::shadowLoop() - cannot set nice %d\n", config.nice);
+    }
+
+    const std::chrono::microseconds file_time((long long)(config.seconds_per_file * 1e6));
+    while(true){
+        Mirror mirror;
+        bool stop = false;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            if(session && config.seconds_per_file > 0.0){
+                cv.wait_until(lock, session_start + file_time, [&]{ return stopping || !pending.empty(); });
+            }
+            else{
+                cv.wait(lock, [&]{ return stopping || !pending.empty(); });
+            }
+            stop = stopping;
+            if(!stop && !pending.empty()){
+                mirror = pending.front();
+                pending.pop_front();
+            }
+        }
+        if(stop){
+            closeSession();
+            return;
+        }
+        if(session && config.seconds_per_file > 0.0 && std::chrono::steady_clock::now() >= session_start + file_time){
+            closeSession();
+        }
+        if(mirror.inputs.empty()){
+            continue;
+        }
+        if(!session && !openSession()){
+            failed.fetch_add(1, std::memory_order_relaxed);
+            session.reset();
+            releaseMirror(mirror);
+            continue;
+        }
+        std::vector<OrtValue*> outputs(session->getOutputsSignature().size(), nullptr);
+        bool ok = session->run(mirror.inputs, outputs);
+        for(OrtValue* value: outputs){
+            session->releaseValue(value);
+        }
+        releaseMirror(mirror);
+        if(ok){
+            ++session_runs;
+            std::lock_guard<std::mutex> lock(mtx);
+            ++stats.runs;
+        }
+        else{
+            failed.fetch_add(1, std::memory_order_relaxed);
+        }
+        if(session_runs >= config.runs_per_file){
+            closeSession();
+        }
+    }
+}
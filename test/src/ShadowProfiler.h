@@ -0,0 +1,114 @@
+#ifndef SHADOWPROFILER_H
+#define SHADOWPROFILER_H
+
+#include "ONNXWorker.h"
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ShadowConfig{
+    double sample_rate;         // fraction of run() calls mirrored, 0..1
+    size_t max_pending;         // mirrored requests waiting, more are dropped
+    size_t runs_per_file;       // rotate after this many shadow runs ...
+    double seconds_per_file;    // ... or this long, whichever comes first (0 = runs only)
+    size_t max_files;           // oldest profiles are deleted beyond this, 0 keeps all
+    std::string prefix;         // profiles are <prefix>_<n>.json
+    WorkerOptions options;      // shadow session settings, profile_prefix is set per file
+    int cpu;                    // pin the shadow thread, -1 = no pinning
+    int nice;                   // shadow thread niceness
+
+    ShadowConfig()
+        :   sample_rate(0.01),
+            max_pending(4),
+            runs_per_file(1000),
+            seconds_per_file(60.0),
+            max_files(10),
+            prefix("shadow"),
+            cpu(-1),
+            nice(10)
+    {
+    }
+};
+
+struct ShadowStats{
+    uint64_t offered;
+    uint64_t sampled;
+    uint64_t dropped;           // queue full
+    uint64_t failed;            // input copy, shadow session or shadow run failed
+    uint64_t runs;              // sampled = dropped + failed + runs once drained
+    uint64_t files;
+};
+
+// Continuous operator level profiling without profiling the serving session.
+// A fraction of the requests of an ONNXWorker (see ONNXWorker::setShadow) is
+// copied into a bounded queue and run again on a background thread by a second,
+// profiling enabled session of the same model. The primary path only pays for
+// the sampling decision and, for sampled requests, one input copy.
+// Shadow sessions are built with WorkerOptions::instrumented off, so their
+// runs stay out of the model's metrics, perf counters and stage timings.
+//
+// ORT profiling is one shot per session, so each file gets a fresh shadow
+// session. ORT writes ts relative to the session's profiling start; the files
+// are rewritten with ts in us since the Unix epoch
+// (SessionGetProfilingStartTimeNs + ts), so every file and a RequestTrace
+// export with origin 0 share one time axis.
+class ShadowProfiler
+{
+public:
+    ShadowProfiler(const std::string &model_path, const ShadowConfig &config);
+    // finishes the current file
+    ~ShadowProfiler();
+
+    // Called by ONNXWorker::run with the request inputs, copies them if sampled.
+    // Workers attached with setShadow() must outlive the profiler.
+    void offer(ONNXWorker* source, const std::vector<OrtValue*> &inputs);
+
+    ShadowStats getStats() const;
+    // finished profiles, oldest first
+    std::vector<std::string> files() const;
+
+private:
+    struct Mirror{
+        std::vector<OrtValue*> inputs;      // deep copies
+        ONNXWorker* source;                 // made the copies
+    };
+
+    void shadowLoop();
+    bool openSession();
+    void closeSession();
+    static void releaseMirror(Mirror &mirror);
+    static bool rebaseProfile(const std::string &from, const std::string &to, uint64_t start_ns);
+
+private:
+    std::string model_path;
+    ShadowConfig config;
+    uint32_t threshold;                     // sample when a 24 bit random draw is below
+
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<Mirror> pending;
+    bool stopping;
+    ShadowStats stats;                      // runs and files, offered / sampled / dropped / failed below
+    std::atomic<uint64_t> offered;
+    std::atomic<uint64_t> sampled;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> failed;
+    std::vector<std::string> finished;
+
+    // shadow thread only
+    std::unique_ptr<ONNXWorker> session;
+    size_t session_runs;
+    std::chrono::steady_clock::time_point session_start;
+    uint64_t file_index;
+
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef SIMDOPS_H
+#define SIMDOPS_H
+
+// 4 x float and 4 x uint32 helpers over NEON (the box), SSE2 (x86 host) or plain C.
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMDOPS_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMDOPS_SSE2 1
+#endif
+
+#include <stdint.h>
+
+namespace simd {
+
+#if defined(SIMDOPS_NEON)
+typedef float32x4_t f32x4;
+
+inline f32x4 load(const float* p) { return vld1q_f32(p); }
+inline void store(float* p, f32x4 v) { vst1q_f32(p, v); }
+inline f32x4 set1(float v) { return vdupq_n_f32(v); }
+inline f32x4 set(float a, float b, float c, float d)
+{
+    float tmp[4] = {a, b, c, d};
+    return vld1q_f32(tmp);
+}
+inline f32x4 add(f32x4 a, f32x4 b) { return vaddq_f32(a, b); }
+inline f32x4 sub(f32x4 a, f32x4 b) { return vsubq_f32(a, b); }
+inline f32x4 mul(f32x4 a, f32x4 b) { return vmulq_f32(a, b); }
+inline f32x4 madd(f32x4 acc, f32x4 a, f32x4 b) { return vmlaq_f32(acc, a, b); }
+inline f32x4 min(f32x4 a, f32x4 b) { return vminq_f32(a, b); }
+inline f32x4 max(f32x4 a, f32x4 b) { return vmaxq_f32(a, b); }
+inline float hmax(f32x4 v)
+{
+    float32x2_t m = vpmax_f32(vget_low_f32(v), vget_high_f32(v));
+    m = vpmax_f32(m, m);
+    return vget_lane_f32(m, 0);
+}
+inline float hadd(f32x4 v)
+{
+    float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    s = vpadd_f32(s, s);
+    return vget_lane_f32(s, 0);
+}
+// rounds to nearest and saturates to [0, 255]
+inline void storeU8(uint8_t* dst, f32x4 v)
+{
+    int32x4_t i = vcvtq_s32_f32(vaddq_f32(v, vdupq_n_f32(0.5f)));
+    int32_t tmp[4];
+    vst1q_s32(tmp, vminq_s32(vmaxq_s32(i, vdupq_n_s32(0)), vdupq_n_s32(255)));
+    dst[0] = (uint8_t)tmp[0];
+    dst[1] = (uint8_t)tmp[1];
+    dst[2] = (uint8_t)tmp[2];
+    dst[3] = (uint8_t)tmp[3];
+}
+
+typedef uint32x4_t u32x4;
+
+inline u32x4 loadU32(const uint32_t* p) { return vld1q_u32(p); }
+inline void storeU32(uint32_t* p, u32x4 v) { vst1q_u32(p, v); }
+inline u32x4 addU32(u32x4 a, u32x4 b) { return vaddq_u32(a, b); }
+inline u32x4 xorU32(u32x4 a, u32x4 b) { return veorq_u32(a, b); }
+inline u32x4 orU32(u32x4 a, u32x4 b) { return vorrq_u32(a, b); }
+template<int N> inline u32x4 shlU32(u32x4 v) { return vshlq_n_u32(v, N); }
+template<int N> inline u32x4 shrU32(u32x4 v) { return vshrq_n_u32(v, N); }
+inline u32x4 set1U32(uint32_t v) { return vdupq_n_u32(v); }
+// bit pattern reinterpretation, no conversion
+inline f32x4 asFloat(u32x4 v) { return vreinterpretq_f32_u32(v); }
+
+#elif defined(SIMDOPS_SSE2)
+typedef __m128 f32x4;
+
+inline f32x4 load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, f32x4 v) { _mm_storeu_ps(p, v); }
+inline f32x4 set1(float v) { return _mm_set1_ps(v); }
+inline f32x4 set(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+inline f32x4 add(f32x4 a, f32x4 b) { return _mm_add_ps(a, b); }
+inline f32x4 sub(f32x4 a, f32x4 b) { return _mm_sub_ps(a, b); }
+inline f32x4 mul(f32x4 a, f32x4 b) { return _mm_mul_ps(a, b); }
+inline f32x4 madd(f32x4 acc, f32x4 a, f32x4 b) { return _mm_add_ps(acc, _mm_mul_ps(a, b)); }
+inline f32x4 min(f32x4 a, f32x4 b) { return _mm_min_ps(a, b); }
+inline f32x4 max(f32x4 a, f32x4 b) { return _mm_max_ps(a, b); }
+inline float hmax(f32x4 v)
+{
+    f32x4 m = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(m);
+}
+inline float hadd(f32x4 v)
+{
+    f32x4 s = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    s = _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(s);
+}
+// +0.5 and truncation like the NEON and scalar paths, not cvtps' round to even
+inline void storeU8(uint8_t* dst, f32x4 v)
+{
+    __m128i i = _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(0.5f)));
+    i = _mm_packs_epi32(i, i);
+    i = _mm_packus_epi16(i, i);
+    int32_t packed = _mm_cvtsi128_si32(i);
+    dst[0] = (uint8_t)(packed);
+    dst[1] = (uint8_t)(packed >> 8);
+    dst[2] = (uint8_t)(packed >> 16);
+    dst[3] = (uint8_t)(packed >> 24);
+}
+
+typedef __m128i u32x4;
+
+inline u32x4 loadU32(const uint32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+inline void storeU32(uint32_t* p, u32x4 v) { _mm_storeu_si128((__m128i*)p, v); }
+inline u32x4 addU32(u32x4 a, u32x4 b) { return _mm_add_epi32(a, b); }
+inline u32x4 xorU32(u32x4 a, u32x4 b) { return _mm_xor_si128(a, b); }
+inline u32x4 orU32(u32x4 a, u32x4 b) { return _mm_or_si128(a, b); }
+template<int N> inline u32x4 shlU32(u32x4 v) { return _mm_slli_epi32(v, N); }
+template<int N> inline u32x4 shrU32(u32x4 v) { return _mm_srli_epi32(v, N); }
+inline u32x4 set1U32(uint32_t v) { return _mm_set1_epi32((int)v); }
+inline f32x4 asFloat(u32x4 v) { return _mm_castsi128_ps(v); }
+
+#else
+struct f32x4 { float v[4]; };
+
+inline f32x4 load(const float* p) { f32x4 r = {{p[0], p[1], p[2], p[3]}}; return r; }
+inline void store(float* p, f32x4 a) { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3]; }
+inline f32x4 set1(float x) { f32x4 r = {{x, x, x, x}}; return r; }
+inline f32x4 set(float a, float b, float c, float d) { f32x4 r = {{a, b, c, d}}; return r; }
+inline f32x4 add(f32x4 a, f32x4 b) { for(int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+inline f32x4 sub(f32x4 a, f32x4 b) { for(int i = 0; i < 4; ++i) a.v[i] -= b.v[i]; return a; }
+inline f32x4 mul(f32x4 a, f32x4 b) { for(int i = 0; i < 4; ++i) a.v[i] *= b.v[i]; return a; }
+inline f32x4 madd(f32x4 acc, f32x4 a, f32x4 b) { for(int i = 0; i < 4; ++i) acc.v[i] += a.v[i] * b.v[i]; return acc; }
+inline f32x4 min(f32x4 a, f32x4 b) { for(int i = 0; i < 4; ++i) a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline f32x4 max(f32x4 a, f32x4 b) { for(int i = 0; i < 4; ++i) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline float hmax(f32x4 a)
+{
+    float m = a.v[0];
+    for(int i = 1; i < 4; ++i) m = a.v[i] > m ? a.v[i] : m;
+    return m;
+}
+inline float hadd(f32x4 a) { return a.v[0] + a.v[1] + a.v[2] + a.v[3]; }
+inline void storeU8(uint8_t* dst, f32x4 a)
+{
+    for(int i = 0; i < 4; ++i){
+        float x = a.v[i] + 0.5f;
+        dst[i] = x <= 0.0f ? 0 : (x >= 255.0f ? 255 : (uint8_t)x);
+    }
+}
+
+struct u32x4 { uint32_t v[4]; };
+
+inline u32x4 loadU32(const uint32_t* p) { u32x4 r = {{p[0], p[1], p[2], p[3]}}; return r; }
+inline void storeU32(uint32_t* p, u32x4 a) { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3]; }
+inline u32x4 addU32(u32x4 a, u32x4 b) { for(int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+inline u32x4 xorU32(u32x4 a, u32x4 b) { for(int i = 0; i < 4; ++i) a.v[i] ^= b.v[i]; return a; }
+inline u32x4 orU32(u32x4 a, u32x4 b) { for(int i = 0; i < 4; ++i) a.v[i] |= b.v[i]; return a; }
+template<int N> inline u32x4 shlU32(u32x4 a) { for(int i = 0; i < 4; ++i) a.v[i] <<= N; return a; }
+template<int N> inline u32x4 shrU32(u32x4 a) { for(int i = 0; i < 4; ++i) a.v[i] >>= N; return a; }
+inline u32x4 set1U32(uint32_t x) { u32x4 r = {{x, x, x, x}}; return r; }
+inline f32x4 asFloat(u32x4 a)
+{
+    f32x4 r;
+    for(int i = 0; i < 4; ++i){
+        union { uint32_t u; float f; } bits;
+        bits.u = a.v[i];
+        r.v[i] = bits.f;
+    }
+    return r;
+}
+#endif
+
+} // namespace simd
+
+#endif
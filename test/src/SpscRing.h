@@ -0,0 +1,79 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <vector>
+
+// Bounded single producer / single consumer ring. Capacity is rounded up to a
+// power of two. Each side caches the other side's index so the common case
+// touches only its own cache line.
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity)
+        :   head(0), tail(0), cached_head(0), cached_tail(0)
+    {
+        size_t size = 2;
+        while(size < capacity){
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    // producer side
+    bool tryPush(const T &item)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if(t - cached_head > mask){
+            cached_head = head.load(std::memory_order_acquire);
+            if(t - cached_head > mask){
+                return false;
+            }
+        }
+        slots[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool tryPop(T &item)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if(h == cached_tail){
+            cached_tail = tail.load(std::memory_order_acquire);
+            if(h == cached_tail){
+                return false;
+            }
+        }
+        item = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // approximate when called concurrently, exact from either side
+    size_t size() const
+    {
+        const size_t h = head.load(std::memory_order_acquire);
+        return tail.load(std::memory_order_acquire) - h;
+    }
+    size_t capacity() const { return mask + 1; }
+
+private:
+    // padding instead of alignas: C++11 operator new ignores extended alignment
+    std::vector<T> slots;
+    size_t mask;
+    char pad0[64];
+    std::atomic<size_t> head;
+    char pad1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;
+    char pad2[64 - sizeof(std::atomic<size_t>)];
+    size_t cached_head;     // producer only
+    char pad3[64 - sizeof(size_t)];
+    size_t cached_tail;     // consumer only
+    char pad4[64 - sizeof(size_t)];
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "StageTimer.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+const int BUCKETS = 256;
+
+struct ThreadBlock{
+    std::atomic<uint64_t> buckets[STAGE_COUNT][BUCKETS];
+    std::atomic<uint64_t> count[STAGE_COUNT];
+    std::atomic<uint64_t> sum[STAGE_COUNT];
+    std::atomic<uint64_t> max[STAGE_COUNT];
+
+    ThreadBlock()
+    {
+        for(int s = 0; s < STAGE_COUNT; ++s){
+            for(int b = 0; b < BUCKETS; ++b){
+                buckets[s][b].store(0, std::memory_order_relaxed);
+            }
+            count[s].store(0, std::memory_order_relaxed);
+            sum[s].store(0, std::memory_order_relaxed);
+            max[s].store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+struct Registry{
+    std::mutex mtx;
+    std::vector<ThreadBlock*> blocks;       // kept after their thread exits, the counts still matter
+    std::atomic<bool> enabled;
+    uint64_t anchor_ticks;
+    std::chrono::steady_clock::time_point anchor_time;
+
+    std::mutex dump_mtx;
+    std::condition_variable dump_cv;
+    std::thread dump_thread;
+    bool dump_stop;
+
+    Registry()
+        :   enabled(true),
+            anchor_ticks(StageTimer::ticks()),
+            anchor_time(std::chrono::steady_clock::now()),
+            dump_stop(false)
+    {
+    }
+};
+
+Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+ThreadBlock &localBlock()
+{
+    static thread_local ThreadBlock* block = nullptr;
+    if(block == nullptr){
+        block = new ThreadBlock;
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mtx);
+        reg.blocks.emplace_back(block);
+    }
+    return *block;
+}
+
+inline int bucketOf(uint64_t ticks)
+{
+    if(ticks < 4){
+        return (int)ticks;
+    }
+    int msb = 63 - __builtin_clzll(ticks);
+    return msb * 4 + (int)((ticks >> (msb - 2)) & 3);
+}
+
+inline uint64_t bucketHigh(int index)
+{
+    if(index < 8){
+        return (uint64_t)index;
+    }
+    int msb = index / 4;
+    uint64_t low = (uint64_t)(4 + index % 4) << (msb - 2);
+    return low + (1ULL << (msb - 2)) - 1;
+}
+
+// single writer per block, so load + store instead of a locked add
+inline void bump(std::atomic<uint64_t> &counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+}
+
+bool StageTimer::enabled()
+{
+    return registry().enabled.load(std::memory_order_relaxed);
+}
+
+void StageTimer::setEnabled(bool on)
+{
+    registry().enabled.store(on, std::memory_order_relaxed);
+}
+
+double StageTimer::nsPerTick()
+{
+    Registry &reg = registry();
+    // the longer since the anchor, the better the estimate; wait at least 1 ms
+    uint64_t now_ticks;
+    std::chrono::steady_clock::time_point now;
+    do{
+        now_ticks = ticks();
+        now = std::chrono::steady_clock::now();
+    }while(now - reg.anchor_time < std::chrono::milliseconds(1));
+    double ns = std::chrono::duration<double, std::nano>(now - reg.anchor_time).count();
+    return now_ticks > reg.anchor_ticks ? ns / (double)(now_ticks - reg.anchor_ticks) : 1.0;
+}
+
+void StageTimer::record(RunStage stage, uint64_t elapsed)
+{
+    ThreadBlock &block = localBlock();
+    bump(block.buckets[stage][bucketOf(elapsed)], 1);
+    bump(block.count[stage], 1);
+    bump(block.sum[stage], elapsed);
+    if(elapsed > block.max[stage].load(std::memory_order_relaxed)){
+        block.max[stage].store(elapsed, std::memory_order_relaxed);
+    }
+}
+
+const char* StageTimer::stageName(RunStage stage)
+{
+    switch(stage){
+        case STAGE_METADATA: return "metadata";
+        case STAGE_INPUT_PREP: return "input_prep";
+        case STAGE_TENSOR_CREATE: return "tensor_create";
+        case STAGE_CAPTURE: return "capture";
+        case STAGE_RUN: return "run";
+        case STAGE_OUTPUT_COPY: return "output_copy";
+        case STAGE_RELEASE: return "release";
+        case STAGE_TOTAL: return "total";
+        default: return "unknown";
+    }
+}
+
+void StageTimer::summary(std::vector<StageSummary> &stages)
+{
+    stages.clear();
+    const double us_per_tick = nsPerTick() / 1000.0;
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx);
+    for(int s = 0; s < STAGE_COUNT; ++s){
+        uint64_t buckets[BUCKETS] = {0};
+        uint64_t count = 0, sum = 0, max = 0;
+        for(ThreadBlock* block: reg.blocks){
+            for(int b = 0; b < BUCKETS; ++b){
+                buckets[b] += block->buckets[s][b].load(std::memory_order_relaxed);
+            }
+            count += block->count[s].load(std::memory_order_relaxed);
+            sum += block->sum[s].load(std::memory_order_relaxed);
+            uint64_t block_max = block->max[s].load(std::memory_order_relaxed);
+            max = block_max > max ? block_max : max;
+        }
+        if(count == 0){
+            continue;
+        }
+        // readers race with writers, bucket totals may differ from count by a few
+        uint64_t total = 0;
+        for(int b = 0; b < BUCKETS; ++b){
+            total += buckets[b];
+        }
+        double p50 = 0.0, p99 = 0.0;
+        uint64_t seen = 0;
+        bool have_p50 = false;
+        for(int b = 0; b < BUCKETS && total > 0; ++b){
+            seen += buckets[b];
+            if(!have_p50 && seen * 2 >= total){
+                p50 = (double)bucketHigh(b);
+                have_p50 = true;
+            }
+            if(seen * 100 >= total * 99){
+                p99 = (double)bucketHigh(b);
+                break;
+            }
+        }
+        StageSummary summary;
+        summary.name = stageName((RunStage)s);
+        summary.count = count;
+        summary.mean_us = (double)sum / (double)count * us_per_tick;
+        summary.p50_us = (p50 < (double)max ? p50 : (double)max) * us_per_tick;
+        summary.p99_us = (p99 < (double)max ? p99 : (double)max) * us_per_tick;
+        summary.max_us = (double)max * us_per_tick;
+        stages.emplace_back(summary);
+    }
+}
+
+void StageTimer::dump(FILE* out)
+{
+    std::vector<StageSummary> stages;
+    summary(stages);
+    fprintf(out, "%-14s %10s %12s %12s %12s %12s\n", "stage", "count", "mean us", "p50 us", "p99 us", "max us");
+    for(const auto &stage: stages){
+        fprintf(out, "%-14s %10llu %12.2f %12.2f %12.2f %12.2f\n", stage.name, (unsigned long long)stage.count,
+                stage.mean_us, stage.p50_us, stage.p99_us, stage.max_us);
+    }
+    fflush(out);
+}
+
+bool StageTimer::startDump(FILE* out, double interval_ms)
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.dump_mtx);
+    if(reg.dump_thread.joinable()){
+        return false;
+    }
+    reg.dump_stop = false;
+    reg.dump_thread = std::thread([&reg, out, interval_ms]{
+        std::unique_lock<std::mutex> lock(reg.dump_mtx);
+        std::chrono::microseconds interval((long long)(interval_ms * 1000.0));
+        while(!reg.dump_cv.wait_for(lock, interval, [&reg]{ return reg.dump_stop; })){
+            lock.unlock();
+            dump(out);
+            lock.lock();
+        }
+    });
+    return true;
+}
+
+void StageTimer::stopDump()
+{
+    Registry &reg = registry();
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(reg.dump_mtx);
+        reg.dump_stop = true;
+        thread.swap(reg.dump_thread);
+    }
+    reg.dump_cv.notify_all();
+    if(thread.joinable()){
+        thread.join();
+    }
+}
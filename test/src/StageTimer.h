@@ -0,0 +1,125 @@
+#ifndef STAGETIMER_H
+#define STAGETIMER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+enum RunStage{
+    STAGE_METADATA = 0,     // session input / output queries
+    STAGE_INPUT_PREP,       // filling input buffers
+    STAGE_TENSOR_CREATE,    // wrapping buffers as OrtValues
+    STAGE_CAPTURE,          // ONNXWorker::setCapture logging, setShadow copies
+    STAGE_RUN,              // OrtApi::Run
+    STAGE_OUTPUT_COPY,      // reading outputs back
+    STAGE_RELEASE,          // releasing OrtValues
+    STAGE_TOTAL,            // whole call
+    STAGE_COUNT
+};
+
+struct StageSummary{
+    const char* name;
+    uint64_t count;
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double max_us;
+};
+
+// Process wide per-stage latency of the inference paths. Each thread records
+// into its own block of histograms (log2 buckets with 4 linear steps, ~19%
+// resolution) with plain relaxed stores, no locked instruction and no shared
+// cache line on the hot path; readers sum the blocks. Time is taken from the
+// cycle counter (TSC on x86, CNTVCT on aarch64) and converted to ns at read
+// time against the steady clock, so recording is a counter read and a few
+// adds per stage.
+class StageTimer
+{
+public:
+    static bool enabled();
+    static void setEnabled(bool on);
+
+    static inline uint64_t ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t value;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+        return value;
+#else
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+    static double nsPerTick();
+
+    static void record(RunStage stage, uint64_t ticks);
+    static const char* stageName(RunStage stage);
+
+    // one entry per stage that recorded anything
+    static void summary(std::vector<StageSummary> &stages);
+    static void dump(FILE* out);
+    // dump every interval_ms from a background thread until stopDump()
+    static bool startDump(FILE* out, double interval_ms);
+    static void stopDump();
+};
+
+// Stamps of one call: mark(stage) charges the time since the previous mark to
+// stage, the destructor records every stage touched plus STAGE_TOTAL.
+// counted = false stamps nothing, for calls kept out of the totals.
+class StageStamp
+{
+public:
+    explicit StageStamp(bool counted = true)
+        :   on(counted && StageTimer::enabled())
+    {
+        if(on){
+            for(int i = 0; i < STAGE_COUNT; ++i){
+                spent[i] = 0;
+            }
+            touched = 0;
+            start = last = StageTimer::ticks();
+        }
+    }
+
+    ~StageStamp()
+    {
+        if(!on){
+            return;
+        }
+        for(int i = 0; i < STAGE_TOTAL; ++i){
+            if(touched & (1u << i)){
+                StageTimer::record((RunStage)i, spent[i]);
+            }
+        }
+        StageTimer::record(STAGE_TOTAL, last - start);
+    }
+
+    void mark(RunStage stage)
+    {
+        if(on){
+            uint64_t now = StageTimer::ticks();
+            spent[stage] += now - last;
+            touched |= 1u << stage;
+            last = now;
+        }
+    }
+
+private:
+    StageStamp(const StageStamp &);
+    StageStamp &operator=(const StageStamp &);
+
+    bool on;
+    uint32_t touched;
+    uint64_t start;
+    uint64_t last;
+    uint64_t spent[STAGE_COUNT];
+};
+
+#endif
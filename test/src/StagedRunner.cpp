@@ -0,0 +1,167 @@
+#include "StagedRunner.h"
+#include <stdio.h>
+#include <chrono>
+
+namespace {
+
+uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+StagedRunner::StagedRunner(ONNXWorker* worker, size_t slot_count, const ResultFn &on_result)
+    :   worker(worker),
+        on_result(on_result),
+        ready(false),
+        closing(false),
+        runs(0),
+        busy_ns(0),
+        idle_ns(0),
+        producer_wait_ns(0)
+{
+    const std::vector<IOInfo> &inputs = worker->getInputsSignature();
+    for(const auto &info: inputs){
+        size_t element = ONNXWorker::elementSize(info.datatype);
+        if(element == 0){
+            printf("StagedRunner::StagedRunner() - unsupported input type %d for %s\n", info.datatype, info.name.c_str());
+            return;
+        }
+        input_bytes.emplace_back(info.DataNums * element);
+    }
+    slots.resize(slot_count < 1 ? 1 : slot_count);
+    for(size_t s = 0; s < slots.size(); ++s){
+        Slot &slot = slots[s];
+        slot.binding = nullptr;
+        slot.buffers.resize(inputs.size());
+        for(size_t i = 0; i < inputs.size(); ++i){
+            std::vector<int64_t> dims = inputs[i].Dims.second;
+            for(auto &dim: dims){
+                dim = dim > 0 ? dim : 1;
+            }
+            slot.buffers[i].resize(input_bytes[i]);
+            OrtValue* value = worker->createTensor(slot.buffers[i].data(), input_bytes[i], dims, inputs[i].datatype);
+            if(value == nullptr){
+                return;
+            }
+            slot.values.emplace_back(value);
+        }
+        slot.binding = worker->createBinding(slot.values);
+        if(slot.binding == nullptr){
+            return;
+        }
+        free_slots.push_back((int)s);
+    }
+    inference_thread = std::thread(&StagedRunner::inferenceLoop, this);
+    ready = true;
+}
+
+StagedRunner::~StagedRunner()
+{
+    close();
+    for(auto &slot: slots){
+        worker->releaseBinding(slot.binding);
+        for(OrtValue* value: slot.values){
+            worker->releaseValue(value);
+        }
+    }
+}
+
+int StagedRunner::acquire()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    if(free_slots.empty()){
+        uint64_t begin = nowNs();
+        free_cv.wait(lock, [&]{ return closing || !free_slots.empty(); });
+        producer_wait_ns += nowNs() - begin;
+    }
+    if(closing){
+        return -1;
+    }
+    int slot = free_slots.front();
+    free_slots.pop_front();
+    return slot;
+}
+
+void* StagedRunner::inputBuffer(int slot, size_t input_index)
+{
+    return slots[slot].buffers[input_index].data();
+}
+
+void StagedRunner::commit(int slot)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        committed_slots.push_back(slot);
+    }
+    committed_cv.notify_one();
+}
+
+void StagedRunner::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        closing = true;
+    }
+    committed_cv.notify_all();
+    free_cv.notify_all();
+    if(inference_thread.joinable()){
+        inference_thread.join();
+    }
+}
+
+void StagedRunner::inferenceLoop()
+{
+    std::vector<OrtValue*> outputs;
+    while(true){
+        int slot = -1;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            uint64_t begin = nowNs();
+            committed_cv.wait(lock, [&]{ return closing || !committed_slots.empty(); });
+            // the first wait is start-up, not idle time
+            if(runs > 0){
+                idle_ns += nowNs() - begin;
+            }
+            if(committed_slots.empty()){
+                return;
+            }
+            slot = committed_slots.front();
+            committed_slots.pop_front();
+        }
+
+        uint64_t begin = nowNs();
+        bool ok = worker->runBinding(slots[slot].binding);
+        uint64_t spent = nowNs() - begin;
+        outputs.clear();
+        if(ok){
+            ok = worker->getBoundOutputs(slots[slot].binding, outputs);
+        }
+        on_result(slot, outputs, ok);
+        for(OrtValue* value: outputs){
+            worker->releaseValue(value);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            ++runs;
+            busy_ns += spent;
+            free_slots.push_back(slot);
+        }
+        free_cv.notify_one();
+    }
+}
+
+StagingStats StagedRunner::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    StagingStats stats;
+    stats.runs = runs;
+    stats.busy_ms = busy_ns / 1e6;
+    stats.idle_ms = idle_ns / 1e6;
+    stats.producer_wait_ms = producer_wait_ns / 1e6;
+    stats.utilization = busy_ns + idle_ns > 0 ? (double)busy_ns / (busy_ns + idle_ns) : 0.0;
+    return stats;
+}
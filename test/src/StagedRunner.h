@@ -0,0 +1,82 @@
+#ifndef STAGEDRUNNER_H
+#define STAGEDRUNNER_H
+
+#include "ONNXWorker.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+struct StagingStats{
+    uint64_t runs;
+    double busy_ms;             // inference thread inside RunWithBinding
+    double idle_ms;             // inference thread waiting for a committed slot
+    double producer_wait_ms;    // producer waiting for a free slot
+    double utilization;         // busy / (busy + idle)
+};
+
+// N-buffer input staging. Every slot owns its input buffers, input tensors and
+// an IoBinding, all created once. The producer fills a free slot while the
+// inference thread runs the previously committed one:
+//
+//     int slot = runner.acquire();
+//     fill(runner.inputBuffer(slot, 0));
+//     runner.commit(slot);
+//
+// Results are handed to the callback on the inference thread; the output
+// values are released once it returns and the slot goes back to the free list.
+class StagedRunner
+{
+public:
+    typedef std::function<void(int slot, const std::vector<OrtValue*> &outputs, bool ok)> ResultFn;
+
+    StagedRunner(ONNXWorker* worker, size_t slots, const ResultFn &on_result);
+    ~StagedRunner();
+
+    bool isReady() const { return ready; }
+    size_t slotCount() const { return slots.size(); }
+
+    // Blocks until a slot is free, -1 once closed.
+    int acquire();
+    void* inputBuffer(int slot, size_t input_index);
+    size_t inputBytes(size_t input_index) const { return input_bytes[input_index]; }
+    void commit(int slot);
+    // Waits for every committed slot to finish, then stops the inference thread.
+    void close();
+
+    StagingStats getStats() const;
+
+private:
+    struct Slot{
+        std::vector<std::vector<uint8_t>> buffers;
+        std::vector<OrtValue*> values;
+        OrtIoBinding* binding;
+    };
+
+    void inferenceLoop();
+
+private:
+    ONNXWorker* worker;
+    ResultFn on_result;
+    bool ready;
+    std::vector<Slot> slots;
+    std::vector<size_t> input_bytes;
+
+    mutable std::mutex mtx;
+    std::condition_variable free_cv;
+    std::condition_variable committed_cv;
+    std::deque<int> free_slots;
+    std::deque<int> committed_slots;
+    bool closing;
+    std::thread inference_thread;
+
+    uint64_t runs;
+    uint64_t busy_ns;
+    uint64_t idle_ns;
+    uint64_t producer_wait_ns;
+};
+
+#endif
@@ -0,0 +1,325 @@
+#include "StreamPipeline.h"
+#include <stdio.h>
+#include <chrono>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+namespace {
+
+const char* kStageNames[STREAM_STAGE_NUM] = {"acquire", "preprocess", "inference", "postprocess"};
+
+// ring polls before a stage parks, a few microseconds
+const int kSpinTries = 4096;
+
+uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+StreamPipeline::StreamPipeline(ONNXWorker* worker, const StreamPipelineConfig &config)
+    :   worker(worker),
+        config(config),
+        ready(false),
+        stopping(false),
+        wall_begin_ns(0)
+{
+    for(int i = 0; i < STREAM_STAGE_NUM; ++i){
+        links[i] = nullptr;
+        not_empty[i].waiters = 0;
+        not_full[i].waiters = 0;
+    }
+    const long online = sysconf(_SC_NPROCESSORS_ONLN);
+    for(int stage = 0; stage < STREAM_STAGE_NUM; ++stage){
+        const int cpu = config.stage_cpu[stage];
+        if(cpu < -1 || cpu >= CPU_SETSIZE || (cpu >= 0 && online > 0 && cpu >= online)){
+            printf("StreamPipeline::StreamPipeline() - cpu %d for %s is not one of the %ld online cpus\n",
+                   cpu, kStageNames[stage], online);
+            return;
+        }
+    }
+    const std::vector<IOInfo> &inputs = worker->getInputsSignature();
+    if(inputs.size() != 1 || inputs[0].datatype != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT){
+        printf("StreamPipeline::StreamPipeline() - only single float input models are supported\n");
+        return;
+    }
+    if(this->config.frames == 0){
+        this->config.frames = 1;
+    }
+    if(this->config.ring_capacity == 0){
+        this->config.ring_capacity = this->config.frames;
+    }
+    for(int i = 0; i < STREAM_STAGE_NUM - 1; ++i){
+        links[i] = new SpscRing<StreamFrame*>(this->config.ring_capacity);
+    }
+    // the recycle link must always take every frame back
+    links[STREAM_POSTPROCESS] = new SpscRing<StreamFrame*>(this->config.frames);
+
+    std::vector<int64_t> dims = inputs[0].Dims.second;
+    for(auto &dim: dims){
+        dim = dim > 0 ? dim : 1;
+    }
+    const IOInfo &out0 = worker->getOutputsSignature()[0];
+    bool static_output = out0.datatype == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT && !out0.Dims.second.empty();
+    for(const auto &dim: out0.Dims.second){
+        static_output = static_output && dim > 0;
+    }
+    frames.resize(this->config.frames);
+    for(size_t i = 0; i < frames.size(); ++i){
+        StreamFrame &frame = frames[i];
+        frame.seq = 0;
+        frame.acquire_ns = 0;
+        frame.ok = false;
+        frame.input.resize(inputs[0].DataNums);
+        frame.input_value = worker->createTensor(frame.input.data(), frame.input.size() * sizeof(float), dims,
+                                                 ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+        frame.output_value = nullptr;
+        if(static_output){
+            frame.output.resize(out0.DataNums);
+            frame.output_value = worker->createTensor(frame.output.data(), frame.output.size() * sizeof(float),
+                                                      out0.Dims.second, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+        }
+        if(frame.input_value == nullptr || (static_output && frame.output_value == nullptr)){
+            return;
+        }
+    }
+    run_inputs.resize(1, nullptr);
+    outputs.resize(worker->getOutputsSignature().size(), nullptr);
+    reset();
+    ready = true;
+}
+
+StreamPipeline::~StreamPipeline()
+{
+    for(auto &frame: frames){
+        worker->releaseValue(frame.input_value);
+        worker->releaseValue(frame.output_value);
+    }
+    for(int i = 0; i < STREAM_STAGE_NUM; ++i){
+        delete links[i];
+    }
+}
+
+void StreamPipeline::pinCurrentThread(int stage)
+{
+    int cpu = config.stage_cpu[stage];
+    if(cpu < 0){
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0){
+        printf("StreamPipeline::pinCurrentThread() - cannot pin %s to cpu %d\n", kStageNames[stage], cpu);
+    }
+}
+
+bool StreamPipeline::processFrame(int stage, StreamFrame* frame)
+{
+    switch(stage){
+        case STREAM_ACQUIRE:
+            if(stopping.load(std::memory_order_relaxed)){
+                return false;
+            }
+            frame->acquire_ns = nowNs();
+            return acquire_fn(*frame);
+        case STREAM_PREPROCESS:
+            preprocess_fn(*frame);
+            return true;
+        case STREAM_INFERENCE:{
+            run_inputs[0] = frame->input_value;
+            outputs[0] = frame->output_value;
+            frame->ok = worker->run(run_inputs, outputs);
+            if(frame->output_value != nullptr){
+                outputs[0] = nullptr;
+            }
+            else if(frame->ok){
+                std::vector<int64_t> dims;
+                float* data = worker->getFloatData(outputs[0]);
+                if(data != nullptr && worker->getTensorShape(outputs[0], dims)){
+                    size_t count = 1;
+                    for(const auto &dim: dims){
+                        count *= (size_t)dim;
+                    }
+                    frame->output.assign(data, data + count);
+                }
+            }
+            else{
+                frame->output.clear();
+            }
+            for(auto &value: outputs){
+                worker->releaseValue(value);
+                value = nullptr;
+            }
+            return true;
+        }
+        case STREAM_POSTPROCESS:
+            postprocess_fn(*frame);
+            return true;
+        default:
+            return false;
+    }
+}
+
+template<typename Fn>
+void StreamPipeline::await(Parking &parking, Fn ready)
+{
+    for(int i = 0; i < kSpinTries; ++i){
+        if(ready()){
+            return;
+        }
+    }
+    std::unique_lock<std::mutex> lock(parking.mtx);
+    parking.waiters.fetch_add(1, std::memory_order_relaxed);
+    // pairs with the fence in wake(): either the other side sees the waiter,
+    // or the check below sees its ring update
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while(!ready()){
+        parking.cv.wait(lock);
+    }
+    parking.waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void StreamPipeline::wake(Parking &parking)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(parking.waiters.load(std::memory_order_relaxed) > 0){
+        // the waiter holds the mutex from its last check until it sleeps
+        std::lock_guard<std::mutex> lock(parking.mtx);
+        parking.cv.notify_one();
+    }
+}
+
+void StreamPipeline::stageLoop(int stage)
+{
+    pinCurrentThread(stage);
+    StageCounters &c = counters[stage];
+    // acquisition takes recycled frames from the last link
+    const int in_link = stage == STREAM_ACQUIRE ? STREAM_POSTPROCESS : stage - 1;
+    SpscRing<StreamFrame*>* in = links[in_link];
+    SpscRing<StreamFrame*>* out = links[stage];
+    while(true){
+        StreamFrame* frame = nullptr;
+        if(!in->tryPop(frame)){
+            uint64_t begin = nowNs();
+            await(not_empty[in_link], [&]{ return in->tryPop(frame); });
+            c.starved_ns.fetch_add(nowNs() - begin, std::memory_order_relaxed);
+        }
+        wake(not_full[in_link]);
+
+        // a null frame marks the end of the stream and is passed downstream
+        if(frame != nullptr){
+            uint64_t begin = nowNs();
+            bool keep = processFrame(stage, frame);
+            c.busy_ns.fetch_add(nowNs() - begin, std::memory_order_relaxed);
+            if(keep){
+                c.items.fetch_add(1, std::memory_order_relaxed);
+            }
+            else{
+                frame = nullptr;
+            }
+        }
+        if(frame == nullptr && stage == STREAM_POSTPROCESS){
+            return;
+        }
+
+        c.queue_sum.fetch_add(out->size(), std::memory_order_relaxed);
+        if(!out->tryPush(frame)){
+            c.blocked_events.fetch_add(1, std::memory_order_relaxed);
+            uint64_t begin = nowNs();
+            await(not_full[stage], [&]{ return out->tryPush(frame); });
+            c.blocked_ns.fetch_add(nowNs() - begin, std::memory_order_relaxed);
+        }
+        wake(not_empty[stage]);
+        if(frame == nullptr){
+            return;
+        }
+    }
+}
+
+// Puts every frame back on the recycle ring and zeroes the counters. A run
+// ends with frames still in the rings and the one acquisition held dropped.
+void StreamPipeline::reset()
+{
+    StreamFrame* frame = nullptr;
+    for(int i = 0; i < STREAM_STAGE_NUM; ++i){
+        while(links[i]->tryPop(frame)){
+        }
+    }
+    for(auto &f: frames){
+        links[STREAM_POSTPROCESS]->tryPush(&f);
+    }
+    for(int i = 0; i < STREAM_STAGE_NUM; ++i){
+        counters[i].items = 0;
+        counters[i].busy_ns = 0;
+        counters[i].starved_ns = 0;
+        counters[i].blocked_ns = 0;
+        counters[i].blocked_events = 0;
+        counters[i].queue_sum = 0;
+    }
+}
+
+bool StreamPipeline::run(const AcquireFn &acquire, const StageFn &preprocess, const StageFn &postprocess)
+{
+    if(!ready){
+        return false;
+    }
+    reset();
+    acquire_fn = acquire;
+    preprocess_fn = preprocess;
+    postprocess_fn = postprocess;
+    stopping.store(false, std::memory_order_relaxed);
+    wall_begin_ns = nowNs();
+
+    std::thread threads[STREAM_STAGE_NUM];
+    for(int stage = 0; stage < STREAM_STAGE_NUM; ++stage){
+        threads[stage] = std::thread(&StreamPipeline::stageLoop, this, stage);
+    }
+    for(auto &thread: threads){
+        thread.join();
+    }
+    return true;
+}
+
+std::vector<StreamStageStats> StreamPipeline::getStats() const
+{
+    std::vector<StreamStageStats> ret;
+    for(int stage = 0; stage < STREAM_STAGE_NUM; ++stage){
+        const StageCounters &c = counters[stage];
+        StreamStageStats s;
+        s.name = kStageNames[stage];
+        s.items = c.items.load(std::memory_order_relaxed);
+        s.busy_ms = c.busy_ns.load(std::memory_order_relaxed) / 1e6;
+        s.starved_ms = c.starved_ns.load(std::memory_order_relaxed) / 1e6;
+        s.blocked_ms = c.blocked_ns.load(std::memory_order_relaxed) / 1e6;
+        s.blocked_events = c.blocked_events.load(std::memory_order_relaxed);
+        s.avg_out_queue = s.items > 0 ? (double)c.queue_sum.load(std::memory_order_relaxed) / s.items : 0.0;
+        s.out_queue_capacity = links[stage] != nullptr ? links[stage]->capacity() : 0;
+        ret.emplace_back(s);
+    }
+    return ret;
+}
+
+void StreamPipeline::printStats() const
+{
+    std::vector<StreamStageStats> stats = getStats();
+    double wall_ms = (nowNs() - wall_begin_ns) / 1e6;
+    int bottleneck = 0;
+    printf("%-12s %10s %8s %10s %10s %10s %10s %12s\n",
+           "stage", "items", "busy%", "us/item", "starved_ms", "blocked_ms", "blocked#", "out_queue");
+    for(size_t i = 0; i < stats.size(); ++i){
+        const StreamStageStats &s = stats[i];
+        if(s.busy_ms > stats[bottleneck].busy_ms){
+            bottleneck = (int)i;
+        }
+        printf("%-12s %10llu %7.1f%% %10.2f %10.2f %10.2f %10llu %6.2f/%-5zu\n",
+               s.name, (unsigned long long)s.items, wall_ms > 0 ? 100.0 * s.busy_ms / wall_ms : 0.0,
+               s.items > 0 ? 1000.0 * s.busy_ms / s.items : 0.0,
+               s.starved_ms, s.blocked_ms, (unsigned long long)s.blocked_events,
+               s.avg_out_queue, s.out_queue_capacity);
+    }
+    printf("bottleneck: %s\n", stats[bottleneck].name);
+}
@@ -0,0 +1,125 @@
+#ifndef STREAMPIPELINE_H
+#define STREAMPIPELINE_H
+
+#include "ONNXWorker.h"
+#include "SpscRing.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// One sample travelling through the pipeline. Frames are preallocated and
+// recycled from postprocessing back to acquisition. When output 0 is a float
+// tensor of static shape Run writes straight into the frame, and nothing is
+// allocated per sample by the pipeline; a dynamic output 0, and any further
+// outputs, are allocated by ORT on every run and copied or released.
+struct StreamFrame{
+    uint64_t seq;
+    uint64_t acquire_ns;
+    std::vector<float> raw;         // filled by acquire
+    std::vector<float> input;       // filled by preprocess, wrapped by the input tensor
+    std::vector<float> output;      // output 0, filled by the inference stage
+    OrtValue* input_value;
+    OrtValue* output_value;         // wraps output, nullptr if output 0 is dynamic
+    bool ok;
+};
+
+struct StreamPipelineConfig{
+    size_t frames;              // frames in flight
+    size_t ring_capacity;       // bound of each stage-to-stage ring
+    int stage_cpu[4];           // acquire, preprocess, inference, postprocess; -1 = not pinned, else an online cpu
+};
+
+enum StreamStage{
+    STREAM_ACQUIRE = 0,
+    STREAM_PREPROCESS,
+    STREAM_INFERENCE,
+    STREAM_POSTPROCESS,
+    STREAM_STAGE_NUM
+};
+
+// Snapshot of one stage. busy is time spent in the stage body, starved is time
+// waiting on an empty upstream ring, blocked is time waiting on a full
+// downstream ring (backpressure). The bottleneck is the stage with the highest
+// busy share, its upstream neighbours show blocked time, downstream ones starve.
+struct StreamStageStats{
+    const char* name;
+    uint64_t items;
+    double busy_ms;
+    double starved_ms;
+    double blocked_ms;
+    uint64_t blocked_events;
+    double avg_out_queue;       // mean depth of the downstream ring seen at push
+    size_t out_queue_capacity;
+};
+
+class StreamPipeline
+{
+public:
+    typedef std::function<bool(StreamFrame &)> AcquireFn;       // false ends the stream
+    typedef std::function<void(StreamFrame &)> StageFn;
+
+    StreamPipeline(ONNXWorker* worker, const StreamPipelineConfig &config);
+    ~StreamPipeline();
+
+    bool isReady() const { return ready; }
+
+    // Runs until acquire returns false or stop() is called and every frame drained.
+    // May be called again once it returned; counters restart with each run.
+    bool run(const AcquireFn &acquire, const StageFn &preprocess, const StageFn &postprocess);
+    void stop() { stopping.store(true, std::memory_order_relaxed); }
+
+    // Safe to call while run() is in progress.
+    std::vector<StreamStageStats> getStats() const;
+    void printStats() const;
+
+private:
+    struct StageCounters{
+        std::atomic<uint64_t> items;
+        std::atomic<uint64_t> busy_ns;
+        std::atomic<uint64_t> starved_ns;
+        std::atomic<uint64_t> blocked_ns;
+        std::atomic<uint64_t> blocked_events;
+        std::atomic<uint64_t> queue_sum;
+    };
+
+    // Where a stage sleeps once a bounded spin on a ring made no progress; the
+    // other side of the ring only takes the mutex when someone is parked.
+    struct Parking{
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::atomic<int> waiters;
+    };
+
+    template<typename Fn>
+    static void await(Parking &parking, Fn ready);
+    static void wake(Parking &parking);
+    void stageLoop(int stage);
+    bool processFrame(int stage, StreamFrame* frame);
+    void reset();
+    void pinCurrentThread(int stage);
+
+private:
+    ONNXWorker* worker;
+    StreamPipelineConfig config;
+    bool ready;
+    std::vector<StreamFrame> frames;
+    // links[i] feeds stage i + 1, links[3] recycles frames to acquisition
+    SpscRing<StreamFrame*>* links[STREAM_STAGE_NUM];
+    Parking not_empty[STREAM_STAGE_NUM];    // consumer of links[i] waiting for a frame
+    Parking not_full[STREAM_STAGE_NUM];     // producer of links[i] waiting for room
+    StageCounters counters[STREAM_STAGE_NUM];
+    std::atomic<bool> stopping;
+    uint64_t wall_begin_ns;
+
+    AcquireFn acquire_fn;
+    StageFn preprocess_fn;
+    StageFn postprocess_fn;
+    std::vector<OrtValue*> run_inputs;     // inference thread only
+    std::vector<OrtValue*> outputs;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "SuperResolutionPipeline.h"
+#include <stdio.h>
+#include <chrono>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(const Clock::time_point &from, const Clock::time_point &to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+}
+
+SuperResolutionPipeline::SuperResolutionPipeline(ONNXWorker* worker)
+    :   worker(worker),
+        ready(false),
+        in_w(0), in_h(0), out_w(0), out_h(0),
+        generation(0),
+        pending(0),
+        stopping(false)
+{
+    scalers[0] = scalers[1] = nullptr;
+    const std::vector<IOInfo> &inputs = worker->getInputsSignature();
+    const std::vector<IOInfo> &outputs = worker->getOutputsSignature();
+    if(inputs.size() != 1 || outputs.size() != 1 ||
+       inputs[0].Dims.first != 4 || outputs[0].Dims.first != 4 ||
+       inputs[0].datatype != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT){
+        printf("SuperResolutionPipeline::SuperResolutionPipeline() - expect one NCHW float input and output\n");
+        return;
+    }
+    std::vector<int64_t> in_dims = inputs[0].Dims.second;
+    std::vector<int64_t> out_dims = outputs[0].Dims.second;
+    in_dims[0] = out_dims[0] = 1;
+    in_h = (int)in_dims[2];
+    in_w = (int)in_dims[3];
+    out_h = (int)out_dims[2];
+    out_w = (int)out_dims[3];
+    if(in_w <= 0 || in_h <= 0 || out_w <= 0 || out_h <= 0){
+        printf("SuperResolutionPipeline::SuperResolutionPipeline() - dynamic spatial dims are not supported\n");
+        return;
+    }
+
+    y_in.resize((size_t)in_w * in_h);
+    y_out.resize((size_t)out_w * out_h);
+    for(int c = 0; c < 2; ++c){
+        chroma_in[c].resize(y_in.size());
+        chroma_out[c].resize(y_out.size());
+        scalers[c] = new BicubicScaler(in_w, in_h, out_w, out_h);
+        chroma_ms[c] = 0.0;
+    }
+
+    // tensors wrap the plane buffers once, Run writes Y straight into y_out
+    input_values.push_back(worker->createTensor(y_in.data(), y_in.size() * sizeof(float), in_dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT));
+    output_values.push_back(worker->createTensor(y_out.data(), y_out.size() * sizeof(float), out_dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT));
+    if(input_values[0] == nullptr || output_values[0] == nullptr){
+        return;
+    }
+
+    for(int c = 0; c < 2; ++c){
+        helpers[c] = std::thread(&SuperResolutionPipeline::helperLoop, this, c);
+    }
+    ready = true;
+}
+
+SuperResolutionPipeline::~SuperResolutionPipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    start_cv.notify_all();
+    for(int c = 0; c < 2; ++c){
+        if(helpers[c].joinable()){
+            helpers[c].join();
+        }
+        delete scalers[c];
+    }
+    for(OrtValue* value: input_values){
+        worker->releaseValue(value);
+    }
+    for(OrtValue* value: output_values){
+        worker->releaseValue(value);
+    }
+}
+
+void SuperResolutionPipeline::helperLoop(int channel)
+{
+    unsigned long seen = 0;
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            start_cv.wait(lock, [&]{ return stopping || generation != seen; });
+            if(stopping){
+                return;
+            }
+            seen = generation;
+        }
+        Clock::time_point begin = Clock::now();
+        scalers[channel]->resize(chroma_in[channel].data(), chroma_out[channel].data());
+        chroma_ms[channel] = elapsedMs(begin, Clock::now());
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            --pending;
+        }
+        done_cv.notify_one();
+    }
+}
+
+bool SuperResolutionPipeline::process(const uint8_t* rgb, uint8_t* rgb_out, SRStageTimes* times)
+{
+    if(!ready){
+        return false;
+    }
+    Clock::time_point t0 = Clock::now();
+    rgbToYCbCr(rgb, in_w, in_h, y_in.data(), chroma_in[0].data(), chroma_in[1].data());
+    Clock::time_point t1 = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        pending = 2;
+        ++generation;
+    }
+    start_cv.notify_all();
+
+    bool ret = worker->run(input_values, output_values);
+    Clock::time_point t2 = Clock::now();
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        done_cv.wait(lock, [&]{ return pending == 0; });
+    }
+    Clock::time_point t3 = Clock::now();
+    if(ret){
+        yCbCrToRgb(y_out.data(), chroma_out[0].data(), chroma_out[1].data(), out_w, out_h, rgb_out);
+    }
+    Clock::time_point t4 = Clock::now();
+
+    if(times != nullptr){
+        times->to_ycbcr_ms = elapsedMs(t0, t1);
+        times->inference_ms = elapsedMs(t1, t2);
+        times->chroma_ms = chroma_ms[0] > chroma_ms[1] ? chroma_ms[0] : chroma_ms[1];
+        times->chroma_wait_ms = elapsedMs(t2, t3);
+        times->merge_ms = elapsedMs(t3, t4);
+        times->total_ms = elapsedMs(t0, t4);
+    }
+    return ret;
+}
+
+bool SuperResolutionPipeline::processSequential(const uint8_t* rgb, uint8_t* rgb_out, SRStageTimes* times)
+{
+    if(!ready){
+        return false;
+    }
+    Clock::time_point t0 = Clock::now();
+    rgbToYCbCr(rgb, in_w, in_h, y_in.data(), chroma_in[0].data(), chroma_in[1].data());
+    Clock::time_point t1 = Clock::now();
+    bool ret = worker->run(input_values, output_values);
+    Clock::time_point t2 = Clock::now();
+    scalers[0]->resize(chroma_in[0].data(), chroma_out[0].data());
+    scalers[1]->resize(chroma_in[1].data(), chroma_out[1].data());
+    Clock::time_point t3 = Clock::now();
+    if(ret){
+        yCbCrToRgb(y_out.data(), chroma_out[0].data(), chroma_out[1].data(), out_w, out_h, rgb_out);
+    }
+    Clock::time_point t4 = Clock::now();
+
+    if(times != nullptr){
+        times->to_ycbcr_ms = elapsedMs(t0, t1);
+        times->inference_ms = elapsedMs(t1, t2);
+        times->chroma_ms = elapsedMs(t2, t3);
+        times->chroma_wait_ms = times->chroma_ms;
+        times->merge_ms = elapsedMs(t3, t4);
+        times->total_ms = elapsedMs(t0, t4);
+    }
+    return ret;
+}
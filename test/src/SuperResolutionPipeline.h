@@ -0,0 +1,73 @@
+#ifndef SUPERRESOLUTIONPIPELINE_H
+#define SUPERRESOLUTIONPIPELINE_H
+
+#include "ONNXWorker.h"
+#include "ImageOps.h"
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Wall time of each stage of one frame, in milliseconds. chroma_ms is the
+// slower of the two helper threads, chroma_wait_ms is how long the frame
+// stalled on them after Run returned (0 when fully overlapped).
+struct SRStageTimes{
+    double to_ycbcr_ms;
+    double inference_ms;
+    double chroma_ms;
+    double chroma_wait_ms;
+    double merge_ms;
+    double total_ms;
+};
+
+// super_resolution.onnx only upscales Y. Cb and Cr are bicubic upscaled on two
+// helper threads while Run works on Y, then the three planes are merged to RGB.
+class SuperResolutionPipeline
+{
+public:
+    SuperResolutionPipeline(ONNXWorker* worker);
+    ~SuperResolutionPipeline();
+
+    bool isReady() const { return ready; }
+    int inputWidth() const { return in_w; }
+    int inputHeight() const { return in_h; }
+    int outputWidth() const { return out_w; }
+    int outputHeight() const { return out_h; }
+
+    // rgb is in_w x in_h interleaved, rgb_out is out_w x out_h interleaved
+    bool process(const uint8_t* rgb, uint8_t* rgb_out, SRStageTimes* times);
+    // same work without the helper threads, for comparison
+    bool processSequential(const uint8_t* rgb, uint8_t* rgb_out, SRStageTimes* times);
+
+private:
+    void helperLoop(int channel);
+
+private:
+    ONNXWorker* worker;
+    bool ready;
+    int in_w;
+    int in_h;
+    int out_w;
+    int out_h;
+
+    std::vector<float> y_in;
+    std::vector<float> y_out;
+    std::vector<float> chroma_in[2];
+    std::vector<float> chroma_out[2];
+    BicubicScaler* scalers[2];
+    double chroma_ms[2];
+
+    std::vector<OrtValue*> input_values;
+    std::vector<OrtValue*> output_values;
+
+    std::thread helpers[2];
+    std::mutex mtx;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    unsigned long generation;
+    int pending;
+    bool stopping;
+};
+
+#endif
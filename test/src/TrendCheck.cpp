@@ -0,0 +1,93 @@
+#include "TrendCheck.h"
+#include <algorithm>
+#include <cmath>
+
+static double medianOf(std::vector<double> &values)
+{
+    if(values.empty()){
+        return 0.0;
+    }
+    const size_t n = values.size();
+    std::nth_element(values.begin(), values.begin() + n / 2, values.end());
+    double upper = values[n / 2];
+    if(n % 2){
+        return upper;
+    }
+    return 0.5 * (upper + *std::max_element(values.begin(), values.begin() + n / 2));
+}
+
+double TrendCheck::theilSenSlope(const std::vector<double> &x, const std::vector<double> &y)
+{
+    const size_t n = std::min(x.size(), y.size());
+    if(n < 2){
+        return 0.0;
+    }
+    std::vector<double> slopes;
+    slopes.reserve(n * (n - 1) / 2);
+    for(size_t i = 0; i < n; ++i){
+        for(size_t j = i + 1; j < n; ++j){
+            if(x[j] != x[i]){
+                slopes.emplace_back((y[j] - y[i]) / (x[j] - x[i]));
+            }
+        }
+    }
+    return medianOf(slopes);
+}
+
+double TrendCheck::mannKendallP(const std::vector<double> &y)
+{
+    const size_t n = y.size();
+    if(n < 3){
+        return 1.0;
+    }
+    double s = 0.0;
+    for(size_t i = 0; i < n; ++i){
+        for(size_t j = i + 1; j < n; ++j){
+            s += y[j] > y[i] ? 1.0 : (y[j] < y[i] ? -1.0 : 0.0);
+        }
+    }
+    // groups of equal values shrink the variance
+    std::vector<double> sorted(y);
+    std::sort(sorted.begin(), sorted.end());
+    double tie_term = 0.0;
+    for(size_t i = 0; i < n;){
+        size_t j = i;
+        while(j < n && sorted[j] == sorted[i]){
+            ++j;
+        }
+        const double t = (double)(j - i);
+        tie_term += t * (t - 1.0) * (2.0 * t + 5.0);
+        i = j;
+    }
+    const double nn = (double)n;
+    const double var = (nn * (nn - 1.0) * (2.0 * nn + 5.0) - tie_term) / 18.0;
+    if(var <= 0.0 || s <= 0.0){
+        return 1.0;
+    }
+    // continuity correction, upper tail only
+    const double z = (s - 1.0) / std::sqrt(var);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+TrendResult TrendCheck::fit(const std::vector<double> &x, const std::vector<double> &y)
+{
+    TrendResult result;
+    result.samples = std::min(x.size(), y.size());
+    result.slope = result.start = result.end = 0.0;
+    result.p_value = 1.0;
+    if(result.samples < 2){
+        result.start = result.end = result.samples == 1 ? y[0] : 0.0;
+        return result;
+    }
+    result.slope = theilSenSlope(x, y);
+    // the line goes through the median of y - slope * x
+    std::vector<double> offsets(result.samples);
+    for(size_t i = 0; i < result.samples; ++i){
+        offsets[i] = y[i] - result.slope * x[i];
+    }
+    const double intercept = medianOf(offsets);
+    result.start = intercept + result.slope * x.front();
+    result.end = intercept + result.slope * x[result.samples - 1];
+    result.p_value = mannKendallP(std::vector<double>(y.begin(), y.begin() + result.samples));
+    return result;
+}
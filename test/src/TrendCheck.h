@@ -0,0 +1,31 @@
+#ifndef TRENDCHECK_H
+#define TRENDCHECK_H
+
+#include <stddef.h>
+#include <vector>
+
+// Upward trend of a series sampled over time, e.g. RSS or p99 every minute of
+// a soak. The slope is Theil-Sen (median of pairwise slopes), so a few
+// outliers such as a GC-like pause or a one-off arena extension do not tilt
+// it. The p value is a one-sided Mann-Kendall test with the tie correction:
+// the chance of seeing this much "later is higher" in a series without trend.
+struct TrendResult{
+    size_t samples;
+    double slope;           // per unit of x
+    double start;           // fitted value at the first x
+    double end;             // fitted value at the last x
+    double p_value;
+
+    double change() const { return end - start; }
+    double relativeChange() const { return start > 0.0 ? (end - start) / start : 0.0; }
+};
+
+class TrendCheck
+{
+public:
+    static TrendResult fit(const std::vector<double> &x, const std::vector<double> &y);
+    static double theilSenSlope(const std::vector<double> &x, const std::vector<double> &y);
+    static double mannKendallP(const std::vector<double> &y);
+};
+
+#endif
@@ -0,0 +1,317 @@
+#include "ONNXWorker.h"
+#include "InputGenerator.h"
+#include "CaptureLog.h"
+#include "OutputCompare.h"
+#include "ModelFiles.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MODEL_DIR "/usr/IDAS/ONNX/model"
+
+typedef std::chrono::steady_clock Clock;
+
+// Golden files reuse the capture format: one CAPTURE_REQUEST record per
+// sample holding the model's inputs followed by its outputs, produced with
+// every graph optimization off. A ZipMap output, seq(map(label, float)), is
+// stored as the float tensor [N, classes] of OutputCompare::zipMapRows() in
+// ascending label order and compared that way. Other outputs that are not
+// numeric tensors (strings) are stored as empty UNDEFINED placeholders so the
+// positions still line up with the signature.
+
+struct CheckConfig{
+    std::string name;
+    std::string model;          // empty = the golden model itself
+    WorkerOptions options;
+};
+
+struct Tolerance{
+    double max_abs;
+    double min_top1;            // also the minimum exact match rate of integer outputs
+};
+
+static void releaseOutputs(ONNXWorker* worker, std::vector<OrtValue*> &outputs)
+{
+    for(OrtValue* &value: outputs){
+        worker->releaseValue(value);
+        value = nullptr;
+    }
+}
+
+// a numeric tensor in place, a ZipMap table in rows, or the UNDEFINED placeholder
+static CaptureTensor describe(ONNXWorker* worker, OrtValue* value, const IOInfo &info, std::vector<float> &rows)
+{
+    CaptureTensor tensor;
+    tensor.type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+    tensor.data = nullptr;
+    tensor.data_bytes = 0;
+    size_t classes = 0;
+    if(OutputCompare::isSequence(value)){
+        if(OutputCompare::zipMapRows(value, std::vector<int64_t>(), std::vector<std::string>(), rows, classes)){
+            tensor.type = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+            tensor.dims = {(int64_t)(classes > 0 ? rows.size() / classes : 0), (int64_t)classes};
+            tensor.data = rows.data();
+            tensor.data_bytes = rows.size() * sizeof(float);
+        }
+        return tensor;
+    }
+    if(info.datatype == ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED || info.datatype == ONNX_TENSOR_ELEMENT_DATA_TYPE_STRING ||
+       !worker->getTensorShape(value, tensor.dims)){
+        tensor.dims.clear();
+        return tensor;
+    }
+    tensor.type = worker->getTensorElementType(value);
+    size_t count = 1;
+    for(int64_t d: tensor.dims){
+        count *= (size_t)d;
+    }
+    tensor.data = worker->getTensorData(value);
+    tensor.data_bytes = count * ONNXWorker::elementSize(tensor.type);
+    return tensor;
+}
+
+static bool record(const std::string &model, const std::string &golden, int samples)
+{
+    WorkerOptions reference;
+    reference.optimization = ORT_DISABLE_ALL;
+    ONNXWorker worker(model, reference);
+    InputGenerator inputs(&worker, InputSpec());
+    if(!inputs.valid()){
+        printf("%s: inputs not supported, no golden file\n", model.c_str());
+        return false;
+    }
+    const std::vector<IOInfo> &in_infos = worker.getInputsSignature();
+    const std::vector<IOInfo> &out_infos = worker.getOutputsSignature();
+    std::vector<OrtValue*> outputs(out_infos.size(), nullptr);
+    std::vector<std::vector<float>> rows(in_infos.size() + out_infos.size());
+
+    CaptureWriter writer;
+    uint32_t model_id = 0;
+    for(int s = 0; s < samples; ++s){
+        inputs.generate();
+        if(!worker.run(inputs.values(), outputs)){
+            printf("%s: reference run failed\n", model.c_str());
+            releaseOutputs(&worker, outputs);
+            return false;
+        }
+        std::vector<CaptureTensor> tensors;
+        size_t bytes = 4096;
+        for(size_t i = 0; i < in_infos.size(); ++i){
+            tensors.emplace_back(describe(&worker, inputs.values()[i], in_infos[i], rows[i]));
+        }
+        for(size_t i = 0; i < out_infos.size(); ++i){
+            tensors.emplace_back(describe(&worker, outputs[i], out_infos[i], rows[in_infos.size() + i]));
+        }
+        for(const CaptureTensor &tensor: tensors){
+            bytes += 64 + tensor.dims.size() * sizeof(int64_t) + tensor.data_bytes;
+        }
+        // a buffer fits two samples; sizes are fixed by the first one
+        if(s == 0){
+            if(!writer.open(golden, 2 * bytes + model.size(), 4)){
+                releaseOutputs(&worker, outputs);
+                return false;
+            }
+            model_id = writer.registerModel(model);
+        }
+        // append() drops when every buffer is queued for the disk, wait instead
+        int tries = 0;
+        while(!writer.append(model_id, CaptureWriter::nowNs(), tensors) && ++tries < 1000){
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        releaseOutputs(&worker, outputs);
+        if(tries == 1000){
+            printf("%s: cannot write %s\n", model.c_str(), golden.c_str());
+            return false;
+        }
+    }
+    writer.close();
+    printf("%s: %d golden samples in %s\n", model.c_str(), samples, golden.c_str());
+    return true;
+}
+
+static bool check(const std::string &model, const std::string &golden, const std::vector<CheckConfig> &configs,
+                  int timed_runs, const Tolerance &tolerance)
+{
+    CaptureReader reader;
+    if(!reader.open(golden) || reader.size() == 0){
+        printf("%s: no golden samples in %s, run accuracyCheck record first\n", model.c_str(), golden.c_str());
+        return false;
+    }
+    // inputs of every sample wrap the mapped golden data, owned by this worker
+    ONNXWorker owner(model);
+    const size_t input_count = owner.getInputsSignature().size();
+    const size_t output_count = owner.getOutputsSignature().size();
+    std::vector<std::vector<OrtValue*>> samples;
+    for(size_t r = 0; r < reader.size(); ++r){
+        const CaptureRecord &rec = reader.record(r);
+        if(rec.tensors.size() != input_count + output_count){
+            printf("%s: golden record %zu does not match the model signature\n", model.c_str(), r);
+            return false;
+        }
+        std::vector<OrtValue*> values;
+        for(size_t i = 0; i < input_count; ++i){
+            const CaptureTensor &t = rec.tensors[i];
+            values.emplace_back(owner.createTensor(const_cast<void*>(t.data), t.data_bytes, t.dims, t.type));
+        }
+        samples.emplace_back(values);
+    }
+
+    printf("\n%s, %zu golden samples, %d timed runs\n", model.c_str(), samples.size(), timed_runs);
+    printf("  %-22s %10s %10s %7s %7s %7s %10s %8s\n", "config", "max abs", "max rel", "top1", "top5", "exact", "ms/run", "speedup");
+    OutputCompare compare;
+    bool ok = true;
+    double reference_ms = 0.0;
+    for(const CheckConfig &config: configs){
+        ONNXWorker worker(config.model.empty() ? model : config.model, config.options);
+        if(worker.getInputsSignature().size() != input_count || worker.getOutputsSignature().size() != output_count){
+            printf("  %-22s signature differs from %s\n", config.name.c_str(), modelFileName(model).c_str());
+            ok = false;
+            continue;
+        }
+        std::vector<OrtValue*> outputs(output_count, nullptr);
+        AccuracyStats stats;
+        bool ran = true;
+        for(size_t s = 0; s < samples.size() && ran; ++s){
+            ran = worker.run(samples[s], outputs);
+            for(size_t i = 0; ran && i < output_count; ++i){
+                compare.add(&worker, reader.record(s).tensors[input_count + i], outputs[i], stats);
+            }
+            releaseOutputs(&worker, outputs);
+        }
+        if(!ran){
+            printf("  %-22s Run failed\n", config.name.c_str());
+            ok = false;
+            continue;
+        }
+
+        for(int i = 0; i < 3; ++i){
+            worker.run(samples[i % samples.size()], outputs);
+            releaseOutputs(&worker, outputs);
+        }
+        Clock::time_point begin = Clock::now();
+        for(int i = 0; i < timed_runs; ++i){
+            worker.run(samples[i % samples.size()], outputs);
+            releaseOutputs(&worker, outputs);
+        }
+        const double ms = timed_runs > 0 ? std::chrono::duration<double, std::milli>(Clock::now() - begin).count() / timed_runs : 0.0;
+        reference_ms = reference_ms > 0.0 ? reference_ms : ms;
+
+        const bool pass = stats.mismatched_shapes == 0 && stats.max_abs <= tolerance.max_abs &&
+                          stats.top1Rate() >= tolerance.min_top1 && stats.exactRate() >= tolerance.min_top1;
+        ok = ok && pass;
+        char top1[16] = "-", topk[16] = "-", exact[16] = "-";
+        if(stats.rows > 0){
+            snprintf(top1, sizeof(top1), "%.1f%%", stats.top1Rate() * 100.0);
+            snprintf(topk, sizeof(topk), "%.1f%%", stats.topkRate() * 100.0);
+        }
+        if(stats.exact_elements > 0){
+            snprintf(exact, sizeof(exact), "%.1f%%", stats.exactRate() * 100.0);
+        }
+        printf("  %-22s %10.3g %10.3g %7s %7s %7s %10.4f %7.2fx%s", config.name.c_str(), stats.max_abs, stats.max_rel,
+               top1, topk, exact, ms, ms > 0.0 ? reference_ms / ms : 0.0, pass ? "" : "  FAIL");
+        if(stats.mismatched_shapes > 0){
+            printf(" (%llu outputs changed type or shape)", (unsigned long long)stats.mismatched_shapes);
+        }
+        if(stats.skipped > 0){
+            printf(" (%llu non tensor outputs not compared)", (unsigned long long)(stats.skipped / samples.size()));
+        }
+        printf("\n");
+    }
+    for(auto &values: samples){
+        for(OrtValue* value: values){
+            owner.releaseValue(value);
+        }
+    }
+    return ok;
+}
+
+static void usage()
+{
+    printf("usage: accuracyCheck record [-d model_dir] [-g golden_dir] [-n samples]\n"
+           "       accuracyCheck check [-d model_dir] [-g golden_dir] [-r timed_runs] [-e max_abs] [-k min_top1]\n"
+           "                           [-v model.onnx=variant.onnx]...\n"
+           "  record keeps inputs and outputs of every model with all graph optimizations off\n"
+           "  check runs the golden inputs under each optimization level, 4 intra-op threads and\n"
+           "  any variants (e.g. quantized builds) and compares against the golden outputs;\n"
+           "  exit status 1 if a configuration exceeds max_abs (default 1e-3) or agrees on\n"
+           "  fewer than min_top1 (default 0.99) of the top-1 classes or integer outputs\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2 || (strcmp(argv[1], "record") != 0 && strcmp(argv[1], "check") != 0)){
+        usage();
+        return 2;
+    }
+    const bool recording = strcmp(argv[1], "record") == 0;
+    std::string model_dir = MODEL_DIR;
+    std::string golden_dir = "golden";
+    int samples = 16;
+    int timed_runs = 200;
+    Tolerance tolerance = {1e-3, 0.99};
+    std::map<std::string, std::vector<std::string>> variants;
+    int opt;
+    optind = 2;
+    while((opt = getopt(argc, argv, "d:g:n:r:e:k:v:h")) != -1){
+        switch(opt){
+            case 'd': model_dir = optarg; break;
+            case 'g': golden_dir = optarg; break;
+            case 'n': samples = atoi(optarg); break;
+            case 'r': timed_runs = atoi(optarg); break;
+            case 'e': tolerance.max_abs = atof(optarg); break;
+            case 'k': tolerance.min_top1 = atof(optarg); break;
+            case 'v':{
+                const char* eq = strchr(optarg, '=');
+                if(eq == nullptr){
+                    usage();
+                    return 2;
+                }
+                variants[std::string(optarg, (size_t)(eq - optarg))].emplace_back(eq + 1);
+                break;
+            }
+            default: usage(); return 2;
+        }
+    }
+    samples = samples > 0 ? samples : 1;
+    mkdir(golden_dir.c_str(), 0755);
+
+    bool ok = true;
+    for(const std::string &model: listModels(model_dir)){
+        const std::string golden = golden_dir + "/" + modelFileName(model) + ".golden";
+        if(recording){
+            ok = record(model, golden, samples) && ok;
+            continue;
+        }
+        std::vector<CheckConfig> configs;
+        const GraphOptimizationLevel levels[] = {ORT_DISABLE_ALL, ORT_ENABLE_BASIC, ORT_ENABLE_EXTENDED, ORT_ENABLE_ALL};
+        const char* names[] = {"disable_all (golden)", "basic", "extended", "all"};
+        for(int i = 0; i < 4; ++i){
+            CheckConfig config;
+            config.name = names[i];
+            config.options.optimization = levels[i];
+            configs.emplace_back(config);
+        }
+        CheckConfig threads;
+        threads.name = "all, 4 threads";
+        threads.options.optimization = ORT_ENABLE_ALL;
+        threads.options.intra_op_threads = 4;
+        configs.emplace_back(threads);
+        for(const std::string &variant: variants[modelFileName(model)]){
+            CheckConfig config;
+            config.name = modelFileName(variant);
+            config.model = variant[0] == '/' ? variant : model_dir + "/" + variant;
+            config.options.optimization = ORT_ENABLE_ALL;
+            configs.emplace_back(config);
+        }
+        ok = check(model, golden, configs, timed_runs, tolerance) && ok;
+    }
+    return ok ? 0 : 1;
+}
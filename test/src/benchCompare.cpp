@@ -0,0 +1,47 @@
+#include "BenchCompare.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static void usage()
+{
+    printf("usage: benchCompare [-t threshold_pct] [-a alpha] [-B resamples] [-m] baseline.json candidate.json\n"
+           "                    [baseline2.json candidate2.json ...]\n"
+           "  inputs are written by loadGen -J or microBench -j, one pair per run being compared\n"
+           "  -t relative median change that counts as a regression, default 5%%\n"
+           "  -a significance level of the Mann-Whitney U test, default 0.01\n"
+           "  -m also fails when a series is missing on one side\n"
+           "  exit status: 0 no regression, 1 regression, 2 bad input\n");
+}
+
+int main(int argc, char *argv[])
+{
+    CompareConfig config;
+    bool strict = false;
+    int opt;
+    while((opt = getopt(argc, argv, "t:a:B:mh")) != -1){
+        switch(opt){
+            case 't': config.threshold = atof(optarg) / 100.0; break;
+            case 'a': config.alpha = atof(optarg); break;
+            case 'B': config.bootstrap = atoi(optarg); break;
+            case 'm': strict = true; break;
+            default: usage(); return 2;
+        }
+    }
+    if(argc - optind < 2 || (argc - optind) % 2 != 0 || config.bootstrap < 100){
+        usage();
+        return 2;
+    }
+    BenchCompare bench(config);
+    for(int i = optind; i < argc; i += 2){
+        if(!bench.loadBaseline(argv[i]) || !bench.loadCandidate(argv[i + 1])){
+            return 2;
+        }
+    }
+    bool missing = false;
+    for(const CompareRow &row: bench.compare()){
+        missing |= row.verdict == VERDICT_MISSING;
+    }
+    bench.print(stdout);
+    return bench.regressions() > 0 || (strict && missing) ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+#include "Postprocess.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// ns per call, best of 5 rounds
+static double timeNs(const std::function<void()> &fn, int iters)
+{
+    double best = 1e30;
+    for(int round = 0; round < 5; ++round){
+        Clock::time_point begin = Clock::now();
+        for(int i = 0; i < iters; ++i){
+            fn();
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / iters;
+        best = ns < best ? ns : best;
+    }
+    return best;
+}
+
+// what callers did with getOutputDirect(): copy, then std::partial_sort the pairs
+static void baselineTopK(const float* scores, size_t count, size_t k, std::vector<std::pair<float, int>> &tmp)
+{
+    tmp.clear();
+    for(size_t i = 0; i < count; ++i){
+        tmp.emplace_back(scores[i], (int)i);
+    }
+    std::partial_sort(tmp.begin(), tmp.begin() + k, tmp.end(),
+                      [](const std::pair<float, int> &a, const std::pair<float, int> &b){
+                          return a.first > b.first || (a.first == b.first && a.second < b.second);
+                      });
+}
+
+int main(int argc, char const *argv[])
+{
+    const size_t sizes[] = {3, 10, 1000, 21843};
+    const size_t k = argc > 1 ? (size_t)atoi(argv[1]) : 5;
+    const size_t batch = 32;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-8.0f, 8.0f);
+    volatile size_t sink = 0;
+
+    printf("%8s %12s %12s %12s %12s %12s\n", "classes", "argmax", "max_element", "topK", "partial_sort", "topKBatch/row");
+    for(size_t n: sizes){
+        std::vector<float> scores(n * batch);
+        for(auto &v: scores){
+            v = dist(rng);
+        }
+        size_t kk = k < n ? k : n;
+        int iters = (int)(2000000 / n) + 10;
+        std::vector<ScoredClass> top(kk * batch);
+        std::vector<std::pair<float, int>> tmp;
+        tmp.reserve(n);
+
+        // results of every row must agree with the scalar reference before timings mean anything
+        std::vector<size_t> maxes(batch);
+        std::vector<ScoredClass> single(kk);
+        topKBatch(scores.data(), batch, n, kk, top.data());
+        argmaxBatch(scores.data(), batch, n, maxes.data());
+        for(size_t r = 0; r < batch; ++r){
+            const float* row = scores.data() + r * n;
+            baselineTopK(row, n, kk, tmp);
+            for(size_t i = 0; i < kk; ++i){
+                if(top[r * kk + i].index != tmp[i].second){
+                    printf("topKBatch mismatch at n=%zu row %zu rank %zu\n", n, r, i);
+                    return 1;
+                }
+            }
+            const size_t expected = (size_t)(std::max_element(row, row + n) - row);
+            if(maxes[r] != expected || argmax(row, n) != expected){
+                printf("argmax mismatch at n=%zu row %zu\n", n, r);
+                return 1;
+            }
+            topK(row, n, kk, single.data());
+            for(size_t i = 0; i < kk; ++i){
+                if(single[i].index != tmp[i].second){
+                    printf("topK mismatch at n=%zu row %zu rank %zu\n", n, r, i);
+                    return 1;
+                }
+            }
+        }
+
+        double t_argmax = timeNs([&]{ sink += argmax(scores.data(), n); }, iters);
+        double t_maxel = timeNs([&]{ sink += std::max_element(scores.begin(), scores.begin() + n) - scores.begin(); }, iters);
+        double t_topk = timeNs([&]{ sink += topK(scores.data(), n, kk, top.data()); }, iters);
+        double t_psort = timeNs([&]{ baselineTopK(scores.data(), n, kk, tmp); sink += tmp[0].second; }, iters);
+        double t_batch = timeNs([&]{ topKBatch(scores.data(), batch, n, kk, top.data()); sink += top[0].index; }, iters / (int)batch + 1) / batch;
+        printf("%8zu %10.1fns %10.1fns %10.1fns %10.1fns %10.1fns\n", n, t_argmax, t_maxel, t_topk, t_psort, t_batch);
+    }
+
+    std::vector<float> probs(1000);
+    for(auto &v: probs){
+        v = dist(rng);
+    }
+    softmaxInPlace(probs.data(), probs.size());
+    ScoredClass hits[16];
+    size_t found = filterThreshold(probs.data(), probs.size(), 0.01f, hits, 16);
+    printf("softmax + threshold(0.01): %zu classes kept\n", found);
+    // keeps the timed results observable
+    printf("checksum %zu\n", (size_t)sink);
+    return 0;
+}
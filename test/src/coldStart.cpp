@@ -0,0 +1,229 @@
+#include "ModelFiles.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define MODEL_DIR "/usr/IDAS/ONNX/model"
+
+// Cold-start benchmark. Every sample is a fresh coldStartChild process that
+// builds one ONNXWorker and runs it once; this driver does not link ORT, so
+// it keeps no pages of the library mapped itself. "cold" samples first drop
+// the model, libonnxruntime and the child binary from the page cache with
+// posix_fadvise(DONTNEED), which needs no privileges but cannot drop pages
+// another process still maps. The resident share of those files right after
+// the drop is reported as a check.
+
+static const char* PHASES[] = {"exec+load", "CreateEnv", "options", "CreateSession", "allocator",
+                               "signature", "first Run", "total"};
+static const int PHASE_COUNT = 8;
+
+struct Sample{
+    double phases[PHASE_COUNT];
+};
+
+static uint64_t monotonicNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// fraction of the file's pages in the page cache, -1 if it cannot be mapped
+static double residentFraction(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return -1.0;
+    }
+    struct stat st;
+    double fraction = -1.0;
+    if(fstat(fd, &st) == 0 && st.st_size > 0){
+        void* map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if(map != MAP_FAILED){
+            const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+            std::vector<unsigned char> pages(((size_t)st.st_size + page - 1) / page);
+            if(mincore(map, (size_t)st.st_size, pages.data()) == 0){
+                size_t resident = 0;
+                for(unsigned char p: pages){
+                    resident += p & 1;
+                }
+                fraction = (double)resident / pages.size();
+            }
+            munmap(map, (size_t)st.st_size);
+        }
+    }
+    close(fd);
+    return fraction;
+}
+
+static void dropFromCache(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+// runs the child and parses its "startup" line
+static bool launch(const std::string &child, const std::string &model, Sample &sample, std::string &library)
+{
+    int fds[2];
+    if(pipe2(fds, O_CLOEXEC) != 0){
+        return false;
+    }
+    const std::string spawn = std::to_string(monotonicNs());
+    pid_t pid = fork();
+    if(pid == 0){
+        dup2(fds[1], STDOUT_FILENO);
+        execl(child.c_str(), child.c_str(), model.c_str(), spawn.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    close(fds[1]);
+    if(pid < 0){
+        close(fds[0]);
+        return false;
+    }
+    std::string output;
+    char buffer[4096];
+    ssize_t got;
+    while((got = read(fds[0], buffer, sizeof(buffer))) > 0){
+        output.append(buffer, (size_t)got);
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    size_t pos = output.find("startup ");
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0 || pos == std::string::npos){
+        printf("%s failed on %s (status %d)\n", child.c_str(), model.c_str(), status);
+        return false;
+    }
+    const char* text = output.c_str() + pos + 8;
+    char* end = nullptr;
+    for(int i = 0; i < PHASE_COUNT; ++i){
+        sample.phases[i] = strtod(text, &end);
+        if(end == text){
+            return false;
+        }
+        text = end;
+    }
+    while(*text == ' '){
+        ++text;
+    }
+    library.assign(text, strcspn(text, "\n"));
+    return true;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(p / 100.0 * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+static void report(const std::string &model, const char* mode, const std::vector<Sample> &samples, double resident)
+{
+    printf("%s, %s cache, %zu runs", model.c_str(), mode, samples.size());
+    if(resident >= 0.0){
+        printf(", %.0f%% of model + library resident after drop", resident * 100.0);
+    }
+    printf("\n  %-14s %9s %9s %9s %9s   (ms)\n", "phase", "min", "p50", "p90", "max");
+    if(samples.empty()){
+        return;
+    }
+    for(int i = 0; i < PHASE_COUNT; ++i){
+        std::vector<double> values;
+        for(const Sample &sample: samples){
+            if(sample.phases[i] >= 0.0){
+                values.emplace_back(sample.phases[i]);
+            }
+        }
+        if(values.empty()){
+            printf("  %-14s %9s\n", PHASES[i], "-");
+            continue;
+        }
+        printf("  %-14s %9.3f %9.3f %9.3f %9.3f\n", PHASES[i], percentile(values, 0.0), percentile(values, 50.0),
+               percentile(values, 90.0), percentile(values, 100.0));
+    }
+}
+
+static void usage()
+{
+    printf("usage: coldStart [-n runs] [-d model_dir] [-c warm|cold|both] [-x coldStartChild]\n"
+           "  -n launches per model and mode, default 20\n"
+           "  -d directory of .onnx models, default %s\n"
+           "  -c which samples to take, default both\n"
+           "  -x child binary, default coldStartChild next to this binary\n", MODEL_DIR);
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = 20;
+    std::string dir = MODEL_DIR;
+    std::string mode = "both";
+    std::string child;
+    int opt;
+    while((opt = getopt(argc, argv, "n:d:c:x:h")) != -1){
+        switch(opt){
+            case 'n': runs = atoi(optarg); break;
+            case 'd': dir = optarg; break;
+            case 'c': mode = optarg; break;
+            case 'x': child = optarg; break;
+            default: usage(); return 2;
+        }
+    }
+    if(optind != argc || runs < 0 || (mode != "warm" && mode != "cold" && mode != "both")){
+        usage();
+        return 2;
+    }
+    if(child.empty()){
+        // built next to this binary
+        char self[4096];
+        ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+        self[len > 0 ? len : 0] = '\0';
+        std::string path = self;
+        size_t slash = path.find_last_of('/');
+        child = (slash == std::string::npos ? std::string(".") : path.substr(0, slash)) + "/coldStartChild";
+    }
+
+    for(const std::string &model: listModels(dir)){
+        // the first launch warms the cache and tells where the library is
+        Sample sample;
+        std::string library;
+        if(!launch(child, model, sample, library)){
+            continue;
+        }
+        for(int cold = 0; cold < 2; ++cold){
+            if((cold && mode == "warm") || (!cold && mode == "cold")){
+                continue;
+            }
+            std::vector<Sample> samples;
+            double resident_sum = 0.0;
+            for(int r = 0; r < runs; ++r){
+                if(cold){
+                    dropFromCache(model);
+                    dropFromCache(library);
+                    dropFromCache(child);
+                    resident_sum += (residentFraction(model) + residentFraction(library)) / 2.0;
+                }
+                std::string unused;
+                if(launch(child, model, sample, unused)){
+                    samples.emplace_back(sample);
+                }
+            }
+            report(model, cold ? "cold" : "warm", samples, cold && runs > 0 ? resident_sum / runs : -1.0);
+        }
+    }
+    return 0;
+}
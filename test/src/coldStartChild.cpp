@@ -0,0 +1,53 @@
+#include "ONNXWorker.h"
+#include "InputGenerator.h"
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+static uint64_t monotonicNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// One cold start, launched by coldStart: build the worker, run it once and
+// print the phases on a single "startup" line. spawn_ns is the parent's
+// CLOCK_MONOTONIC just before fork, so exec_ms covers fork, exec, dynamic
+// loading of libonnxruntime and static initialisation.
+// usage: coldStartChild model.onnx [spawn_ns]
+int main(int argc, char const *argv[])
+{
+    const uint64_t entry_ns = monotonicNs();
+    if(argc < 2){
+        printf("usage: coldStartChild model.onnx [spawn_ns]\n");
+        return 2;
+    }
+    const uint64_t spawn_ns = argc > 2 ? strtoull(argv[2], nullptr, 10) : entry_ns;
+
+    StartupTiming timing;
+    uint64_t ready_ns = 0;
+    {
+        ONNXWorker worker(argv[1]);
+        InputGenerator inputs(&worker, InputSpec());
+        if(inputs.valid()){
+            std::vector<OrtValue*> outputs(worker.getOutputsSignature().size(), nullptr);
+            worker.run(inputs.values(), outputs);
+            for(OrtValue* value: outputs){
+                worker.releaseValue(value);
+            }
+        }
+        ready_ns = monotonicNs();
+        timing = worker.getStartupTiming();
+    }
+
+    // the parent drops the library from the page cache for cold runs
+    Dl_info info;
+    const char* library = dladdr((void*)&OrtGetApiBase, &info) != 0 && info.dli_fname != nullptr ? info.dli_fname : "-";
+    printf("startup %.3f %.3f %.3f %.3f %.3f %.3f %.3f %.3f %s\n",
+           (double)(entry_ns - spawn_ns) / 1e6, timing.env_ms, timing.options_ms, timing.session_ms,
+           timing.allocator_ms, timing.signature_ms, timing.first_run_ms, (double)(ready_ns - spawn_ns) / 1e6, library);
+    return 0;
+}
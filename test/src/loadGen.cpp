@@ -0,0 +1,466 @@
+#include "ONNXWorker.h"
+#include "LatencyHistogram.h"
+#include "CaptureLog.h"
+#include "InputGenerator.h"
+#include "ModelFiles.h"
+#include "RequestTrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+typedef std::chrono::steady_clock Clock;
+
+struct LoadConfig{
+    std::string model;
+    std::string arrival;        // fixed, poisson, bursty, trace, replay, closed
+    double rate;                // requests per second, closed loop: 0 = as fast as possible
+    double seconds;
+    int workers;                // sessions in the pool
+    int concurrency;            // closed loop threads
+    int burst;                  // requests per burst for bursty arrivals
+    std::string trace;
+    std::string replay;         // capture file, arrivals and inputs from it
+    double speed;               // trace / replay time scale, 2 = twice as fast
+    bool hdr;
+    std::string timeline;       // Chrome trace output, empty = no tracing
+    std::string results;        // benchCompare JSON output, empty = none
+};
+
+static void releaseOutputs(ONNXWorker* worker, std::vector<OrtValue*> &outputs)
+{
+    for(auto &value: outputs){
+        worker->releaseValue(value);
+        value = nullptr;
+    }
+}
+
+// Arrival offsets from the start of the run, in ns.
+static bool makeSchedule(const LoadConfig &config, std::vector<uint64_t> &schedule)
+{
+    const uint64_t end_ns = (uint64_t)(config.seconds * 1e9);
+    std::mt19937_64 gen(12345);
+    if(config.arrival == "trace"){
+        // one arrival per line, offset in microseconds, anything after it ignored
+        FILE* fp = fopen(config.trace.c_str(), "r");
+        if(fp == nullptr){
+            printf("loadGen - cannot open trace %s\n", config.trace.c_str());
+            return false;
+        }
+        char line[256];
+        double first = 0.0;
+        while(fgets(line, sizeof(line), fp) != nullptr){
+            if(line[0] == '#'){
+                continue;
+            }
+            double us = atof(line);
+            first = schedule.empty() ? us : first;
+            // an offset before the first one arrives with it, not 2^64 ns later
+            double ns = (us - first) * 1000.0 / config.speed;
+            schedule.emplace_back(ns > 0.0 ? (uint64_t)ns : 0);
+        }
+        fclose(fp);
+        return !schedule.empty();
+    }
+    if(config.rate <= 0.0){
+        printf("loadGen - open loop needs a rate\n");
+        return false;
+    }
+    double t = 0.0;
+    const double mean_ns = 1e9 / config.rate;
+    if(config.arrival == "fixed"){
+        for(; t < end_ns; t += mean_ns){
+            schedule.emplace_back((uint64_t)t);
+        }
+    }
+    else if(config.arrival == "poisson"){
+        std::exponential_distribution<double> gap(1.0 / mean_ns);
+        for(t = gap(gen); t < end_ns; t += gap(gen)){
+            schedule.emplace_back((uint64_t)t);
+        }
+    }
+    else if(config.arrival == "bursty"){
+        // Poisson bursts of `burst` simultaneous requests, same mean rate
+        std::exponential_distribution<double> gap(1.0 / (mean_ns * config.burst));
+        for(t = gap(gen); t < end_ns; t += gap(gen)){
+            for(int i = 0; i < config.burst; ++i){
+                schedule.emplace_back((uint64_t)t);
+            }
+        }
+    }
+    else{
+        printf("loadGen - unknown arrival %s\n", config.arrival.c_str());
+        return false;
+    }
+    return true;
+}
+
+struct Completion{
+    uint64_t end_ns;                // steady clock
+    uint64_t latency_ns;
+    uint64_t service_ns;
+};
+
+struct ThreadStats{
+    LatencyHistogram latency;       // from the intended start
+    LatencyHistogram service;       // Run only
+    LatencyHistogram corrected;     // closed loop, coordinated omission corrected
+    std::vector<Completion> completions;    // only kept for -J
+    uint64_t errors;
+    ThreadStats() : errors(0) {}
+};
+
+// Replay: arrival offsets from the capture timestamps, inputs wrap the mapped
+// tensors in place. Only records of the pool's model are used.
+static bool makeReplay(const LoadConfig &config, const CaptureReader &reader, ONNXWorker* worker,
+                       std::vector<uint64_t> &schedule, std::vector<std::vector<OrtValue*>> &replay)
+{
+    int64_t model_id = reader.modelId(config.model);
+    if(model_id < 0){
+        printf("loadGen - %s not in capture %s\n", config.model.c_str(), config.replay.c_str());
+        return false;
+    }
+    uint64_t first = 0;
+    for(size_t i = 0; i < reader.size(); ++i){
+        const CaptureRecord &record = reader.record(i);
+        if(record.model_id != (uint32_t)model_id){
+            continue;
+        }
+        // records of several threads are not strictly in time order
+        first = schedule.empty() ? record.timestamp_ns : first;
+        schedule.emplace_back(record.timestamp_ns > first ? (uint64_t)((record.timestamp_ns - first) / config.speed) : 0);
+        std::vector<OrtValue*> values;
+        for(const CaptureTensor &tensor: record.tensors){
+            // ORT does not write to inputs, the read only mapping is fine
+            values.emplace_back(worker->createTensor(const_cast<void*>(tensor.data), tensor.data_bytes, tensor.dims, tensor.type));
+        }
+        replay.emplace_back(values);
+    }
+    return !schedule.empty();
+}
+
+// Open loop: a dispatcher releases requests at their scheduled times into a
+// queue served by one thread per session. Latency is taken from the scheduled
+// time, so a slow system is charged for the requests it kept waiting, which
+// is what a closed loop measurement omits.
+static void openLoop(const LoadConfig &config, std::vector<ONNXWorker*> &pool, std::vector<InputGenerator*> &inputs,
+                     const std::vector<uint64_t> &schedule, const std::vector<std::vector<OrtValue*>> &replay,
+                     std::vector<ThreadStats> &stats)
+{
+    std::mutex mtx;
+    std::condition_variable cv;
+    struct Arrival{
+        Clock::time_point at;
+        size_t index;
+        uint64_t trace_id;
+    };
+    std::deque<Arrival> pending;
+    bool finished = false;
+
+    std::vector<std::thread> threads;
+    for(size_t w = 0; w < pool.size(); ++w){
+        threads.emplace_back([&, w]{
+            ONNXWorker* worker = pool[w];
+            std::vector<OrtValue*> outputs(worker->getOutputsSignature().size(), nullptr);
+            while(true){
+                Arrival arrival;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, [&]{ return finished || !pending.empty(); });
+                    if(pending.empty()){
+                        return;
+                    }
+                    arrival = pending.front();
+                    pending.pop_front();
+                }
+                const Clock::time_point intended = arrival.at;
+                Clock::time_point begin = Clock::now();
+                if(arrival.trace_id != 0){
+                    RequestTrace::complete("queue", arrival.trace_id, RequestTrace::steadyNs(intended), RequestTrace::steadyNs(begin));
+                }
+                RequestTrace::setCurrent(arrival.trace_id);
+                bool ok = worker->run(replay.empty() ? inputs[w]->values() : replay[arrival.index], outputs);
+                RequestTrace::setCurrent(0);
+                Clock::time_point end = Clock::now();
+                {
+                    TraceSpan span("release", arrival.trace_id);
+                    releaseOutputs(worker, outputs);
+                }
+                if(!ok){
+                    ++stats[w].errors;
+                    continue;
+                }
+                const uint64_t service_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+                const uint64_t latency_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - intended).count();
+                stats[w].service.record(service_ns);
+                stats[w].latency.record(latency_ns);
+                if(!config.results.empty()){
+                    stats[w].completions.push_back({RequestTrace::steadyNs(end), latency_ns, service_ns});
+                }
+            }
+        });
+    }
+
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < schedule.size(); ++i){
+        Clock::time_point at = start + std::chrono::nanoseconds(schedule[i]);
+        std::this_thread::sleep_until(at);
+        Arrival arrival = {at, i, RequestTrace::enabled() ? RequestTrace::newRequestId() : 0};
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            RequestTrace::instant("enqueue", arrival.trace_id, nullptr, (int64_t)pending.size());
+            pending.push_back(arrival);
+        }
+        cv.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        finished = true;
+    }
+    cv.notify_all();
+    for(auto &thread: threads){
+        thread.join();
+    }
+}
+
+// Closed loop: each thread sends its next request when the previous one is
+// done, paced to rate / concurrency if a rate is given. Raw latency hides the
+// requests a stall prevented, the corrected histogram adds them back.
+static void closedLoop(const LoadConfig &config, std::vector<ONNXWorker*> &pool, std::vector<InputGenerator*> &inputs,
+                       std::vector<ThreadStats> &stats)
+{
+    const uint64_t interval_ns = config.rate > 0.0 ? (uint64_t)(1e9 * config.concurrency / config.rate) : 0;
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::nanoseconds((uint64_t)(config.seconds * 1e9));
+    std::vector<std::thread> threads;
+    for(int c = 0; c < config.concurrency; ++c){
+        threads.emplace_back([&, c]{
+            size_t w = (size_t)c % pool.size();
+            ONNXWorker* worker = pool[w];
+            std::vector<OrtValue*> outputs(worker->getOutputsSignature().size(), nullptr);
+            Clock::time_point next = start;
+            while(next < end){
+                if(interval_ns > 0){
+                    std::this_thread::sleep_until(next);
+                }
+                Clock::time_point begin = Clock::now();
+                bool ok = worker->run(inputs[w]->values(), outputs);
+                Clock::time_point done = Clock::now();
+                releaseOutputs(worker, outputs);
+                if(!ok){
+                    ++stats[c].errors;
+                }
+                else{
+                    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(done - begin).count();
+                    stats[c].service.record(ns);
+                    stats[c].latency.record(ns);
+                    stats[c].corrected.recordCorrected(ns, interval_ns);
+                    if(!config.results.empty()){
+                        stats[c].completions.push_back({RequestTrace::steadyNs(done), ns, ns});
+                    }
+                }
+                next = interval_ns > 0 ? next + std::chrono::nanoseconds(interval_ns) : done;
+                // behind schedule: skip the missed slots, the correction accounts for them
+                if(interval_ns > 0 && next < done){
+                    next = done;
+                }
+            }
+        });
+    }
+    for(auto &thread: threads){
+        thread.join();
+    }
+}
+
+static void writeSamples(FILE* fp, const char* name, const char* unit, const char* better, const std::vector<double> &samples,
+                         bool last)
+{
+    fprintf(fp, "  {\"name\": \"%s\", \"unit\": \"%s\", \"better\": \"%s\", \"samples\": [", name, unit, better);
+    for(size_t i = 0; i < samples.size(); ++i){
+        fprintf(fp, "%s%.4f", i ? ", " : "", samples[i]);
+    }
+    fprintf(fp, "]}%s\n", last ? "" : ",");
+}
+
+// Samples for benchCompare: latency and Run time per request (evenly thinned
+// to at most 50000) and throughput per window, about 20 windows per run.
+static bool writeResults(const LoadConfig &config, const std::vector<ThreadStats> &stats, Clock::time_point start, double elapsed)
+{
+    std::vector<Completion> all;
+    for(const ThreadStats &s: stats){
+        all.insert(all.end(), s.completions.begin(), s.completions.end());
+    }
+    const size_t limit = 50000;
+    const double stride = all.size() > limit ? (double)all.size() / limit : 1.0;
+    std::vector<double> latency, service;
+    for(double i = 0.0; i < (double)all.size(); i += stride){
+        latency.emplace_back(all[(size_t)i].latency_ns / 1e6);
+        service.emplace_back(all[(size_t)i].service_ns / 1e6);
+    }
+    const double window_s = elapsed / 20.0 > 0.1 ? elapsed / 20.0 : 0.1;
+    std::vector<double> throughput((size_t)(elapsed / window_s), 0.0);
+    const uint64_t start_ns = RequestTrace::steadyNs(start);
+    for(const Completion &c: all){
+        size_t window = (size_t)((c.end_ns - start_ns) / 1e9 / window_s);
+        if(window < throughput.size()){
+            throughput[window] += 1.0 / window_s;
+        }
+    }
+
+    FILE* fp = fopen(config.results.c_str(), "w");
+    if(fp == nullptr){
+        printf("loadGen - cannot open %s\n", config.results.c_str());
+        return false;
+    }
+    const std::string model = modelFileName(config.model);
+    fprintf(fp, "{\"tool\": \"loadGen\", \"model\": \"%s\", \"arrival\": \"%s\", \"rate\": %.3f, \"results\": [\n",
+            model.c_str(), config.arrival.c_str(), config.rate);
+    writeSamples(fp, (model + "/latency").c_str(), "ms", "lower", latency, false);
+    writeSamples(fp, (model + "/run").c_str(), "ms", "lower", service, false);
+    writeSamples(fp, (model + "/throughput").c_str(), "req/s", "higher", throughput, true);
+    fprintf(fp, "]}\n");
+    return fclose(fp) == 0;
+}
+
+static void usage()
+{
+    printf("usage: loadGen [-m model] [-a fixed|poisson|bursty|trace|closed] [-r rate] [-d seconds]\n"
+           "               [-w workers] [-c concurrency] [-b burst] [-t trace_file] [-R capture_file] [-s speed] [-H]\n"
+           "               [-T timeline.json] [-J results.json]\n"
+           "  trace_file: one arrival offset in microseconds per line\n"
+           "  capture_file: requests recorded with ONNXWorker::setCapture, replayed with their inputs\n"
+           "  -H prints the full HdrHistogram style percentile distribution\n"
+           "  -T writes a per-request Chrome trace (open loop: enqueue, queue, run, release)\n"
+           "  -J writes latency, Run time and throughput samples for benchCompare\n");
+}
+
+int main(int argc, char *argv[])
+{
+    LoadConfig config;
+    config.model = MODEL_PATH_6;
+    config.arrival = "poisson";
+    config.rate = 100.0;
+    config.seconds = 10.0;
+    config.workers = 1;
+    config.concurrency = 1;
+    config.burst = 10;
+    config.speed = 1.0;
+    config.hdr = false;
+
+    int opt;
+    while((opt = getopt(argc, argv, "m:a:r:d:w:c:b:t:R:s:T:J:Hh")) != -1){
+        switch(opt){
+            case 'm': config.model = optarg; break;
+            case 'a': config.arrival = optarg; break;
+            case 'r': config.rate = atof(optarg); break;
+            case 'd': config.seconds = atof(optarg); break;
+            case 'w': config.workers = atoi(optarg); break;
+            case 'c': config.concurrency = atoi(optarg); break;
+            case 'b': config.burst = atoi(optarg); break;
+            case 't': config.trace = optarg; config.arrival = "trace"; break;
+            case 'R': config.replay = optarg; config.arrival = "replay"; break;
+            case 's': config.speed = atof(optarg); break;
+            case 'H': config.hdr = true; break;
+            case 'T': config.timeline = optarg; break;
+            case 'J': config.results = optarg; break;
+            default: usage(); return 1;
+        }
+    }
+    config.workers = config.workers > 0 ? config.workers : 1;
+    config.concurrency = config.concurrency > 0 ? config.concurrency : 1;
+    config.burst = config.burst > 0 ? config.burst : 1;
+    config.speed = config.speed > 0.0 ? config.speed : 1.0;
+    if(!config.timeline.empty()){
+        RequestTrace::setEnabled(true);
+    }
+
+    std::vector<ONNXWorker*> pool;
+    std::vector<InputGenerator*> inputs;
+    for(int w = 0; w < config.workers; ++w){
+        pool.emplace_back(new ONNXWorker(config.model));
+        inputs.emplace_back(new InputGenerator(pool.back(), InputSpec()));
+        if(!inputs.back()->valid()){
+            return 1;
+        }
+    }
+
+    bool closed = config.arrival == "closed";
+    std::vector<uint64_t> schedule;
+    std::vector<std::vector<OrtValue*>> replay;
+    CaptureReader reader;
+    if(!config.replay.empty()){
+        if(closed || !reader.open(config.replay) || !makeReplay(config, reader, pool[0], schedule, replay)){
+            return 1;
+        }
+    }
+    else if(!closed && !makeSchedule(config, schedule)){
+        return 1;
+    }
+    std::vector<ThreadStats> stats(closed ? config.concurrency : config.workers);
+    printf("model %s, %s arrivals, %d sessions", config.model.c_str(), config.arrival.c_str(), config.workers);
+    if(closed){
+        printf(", %d threads, target %.1f/s\n", config.concurrency, config.rate);
+    }
+    else{
+        printf(", %zu requests scheduled\n", schedule.size());
+    }
+
+    Clock::time_point start = Clock::now();
+    if(closed){
+        closedLoop(config, pool, inputs, stats);
+    }
+    else{
+        openLoop(config, pool, inputs, schedule, replay, stats);
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    ThreadStats total;
+    for(auto &s: stats){
+        total.latency.merge(s.latency);
+        total.service.merge(s.service);
+        total.corrected.merge(s.corrected);
+        total.errors += s.errors;
+    }
+    printf("completed %llu in %.2f s (%.1f/s), errors %llu\n", (unsigned long long)total.latency.count(), elapsed,
+           total.latency.count() / elapsed, (unsigned long long)total.errors);
+    total.service.printSummary(stdout, "service (Run)");
+    total.latency.printSummary(stdout, closed ? "latency (raw)" : "latency (from schedule)");
+    if(closed && total.corrected.count() > 0){
+        total.corrected.printSummary(stdout, "latency (CO corrected)");
+    }
+    if(config.hdr){
+        printf("\n");
+        (closed && total.corrected.count() > 0 ? total.corrected : total.latency).printDistribution(stdout, 1e6, 5);
+    }
+
+    if(!config.results.empty() && writeResults(config, stats, start, elapsed)){
+        printf("results %s\n", config.results.c_str());
+    }
+
+    if(!config.timeline.empty()){
+        RequestTrace::exportChrome(config.timeline.c_str());
+        printf("timeline %s: %llu events, %llu overwritten\n", config.timeline.c_str(),
+               (unsigned long long)RequestTrace::recorded(), (unsigned long long)RequestTrace::overwritten());
+    }
+
+    for(auto &values: replay){
+        for(OrtValue* value: values){
+            pool[0]->releaseValue(value);
+        }
+    }
+    for(size_t w = 0; w < pool.size(); ++w){
+        delete inputs[w];
+        delete pool[w];
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "ONNXWorker.h"
+#include "InputGenerator.h"
+#include "MemoryAccounting.h"
+#include "Metrics.h"
+#include "ModelFiles.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define MODEL_DIR "/usr/IDAS/ONNX/model"
+
+// Heap per model for capacity planning. Every model is loaded twice, with
+// ORT's CPU arena and without. Without the arena each tensor is a malloc of
+// its own, so the largest Run peak is the memory a Run really uses; with it,
+// what the session keeps after the runs beyond its construction is what the
+// arena reserved for them. ORT 1.8 has no allocator statistics in the C API,
+// the two sessions stand in for them.
+// usage: memoryReport [-d model_dir] [-n runs] [-M]
+
+struct ModelMemory{
+    MemoryStats stats;
+    bool ok;
+};
+
+static ModelMemory measure(const std::string &model, bool arena, int runs)
+{
+    ModelMemory result;
+    WorkerOptions options;
+    options.memory_arena = arena;
+    ONNXWorker worker(model, options);
+    InputGenerator inputs(&worker, InputSpec());
+    result.ok = inputs.valid();
+    std::vector<OrtValue*> outputs(worker.getOutputsSignature().size(), nullptr);
+    for(int r = 0; r < runs && result.ok; ++r){
+        inputs.generate();
+        result.ok = worker.run(inputs.values(), outputs);
+        for(OrtValue* &value: outputs){
+            worker.releaseValue(value);
+            value = nullptr;
+        }
+    }
+    result.stats = worker.getMemoryStats();
+    return result;
+}
+
+static double mib(double bytes)
+{
+    return bytes / 1048576.0;
+}
+
+int main(int argc, char const *argv[])
+{
+    std::string dir = MODEL_DIR;
+    int runs = 20;
+    bool show_metrics = false;
+    for(int i = 1; i < argc; ++i){
+        if(strcmp(argv[i], "-d") == 0 && i + 1 < argc){
+            dir = argv[++i];
+        }
+        else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc){
+            runs = std::max(1, atoi(argv[++i]));
+        }
+        else if(strcmp(argv[i], "-M") == 0){
+            show_metrics = true;
+        }
+    }
+    if(!MemoryAccounting::available()){
+        printf("malloc is not interposed in this build, no memory accounting\n");
+        return 1;
+    }
+    MemoryAccounting::setEnabled(true);
+    MetricsRegistry::setEnabled(show_metrics);
+
+    printf("%-26s %10s %10s %10s %10s %10s %8s\n", "model (MiB)", "session", "arena", "held", "run used", "run peak", "reserved");
+    printf("%-26s %10s %10s %10s %10s %10s %8s\n", "", "construct", "reserved", "w/ arena", "no arena", "w/ arena", "/ used");
+    for(const std::string &model: listModels(dir)){
+        ModelMemory with_arena = measure(model, true, runs);
+        ModelMemory without = measure(model, false, runs);
+        const std::string name = modelFileName(model);
+        if(!with_arena.ok || !without.ok){
+            printf("%-26s inputs not supported or run failed\n", name.c_str());
+            continue;
+        }
+        const MemoryStats &a = with_arena.stats;
+        const MemoryStats &b = without.stats;
+        const double reserved = (double)std::max<int64_t>(0, a.heap_bytes - a.construct_bytes);
+        const double used = (double)b.max_run_peak;
+        char ratio[32];
+        if(used > 0.0){
+            snprintf(ratio, sizeof(ratio), "%.2f", reserved / used);
+        }
+        else{
+            snprintf(ratio, sizeof(ratio), "-");
+        }
+        printf("%-26s %10.3f %10.3f %10.3f %10.3f %10.3f %8s\n", name.c_str(), mib((double)a.construct_bytes), mib(reserved),
+               mib((double)a.heap_bytes), mib(used), mib((double)a.max_run_peak), ratio);
+    }
+    if(show_metrics){
+        std::string text;
+        MetricsRegistry::instance().render(text);
+        fwrite(text.data(), 1, text.size(), stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,209 @@
+#include "ONNXWorker.h"
+#include "MicroBench.h"
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+static const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+
+// keeps results alive so calls are not optimised away
+static volatile uintptr_t sink;
+
+// getInputsInfo() / getOutputsInfo() log every query; the log goes to
+// /dev/null while they are timed so the table stays readable
+class QuietStdout
+{
+public:
+    QuietStdout()
+    {
+        fflush(stdout);
+        saved = dup(STDOUT_FILENO);
+        int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if(null_fd >= 0){
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        }
+    }
+    ~QuietStdout()
+    {
+        fflush(stdout);
+        if(saved >= 0){
+            dup2(saved, STDOUT_FILENO);
+            close(saved);
+        }
+    }
+
+private:
+    int saved;
+};
+
+static void usage()
+{
+    printf("usage: microBench [-m tiny_model] [-r repetitions] [-s sample_us] [-c cpu] [-f filter] [-j results.json]\n"
+           "  -m model with one float input and one output, default %s\n"
+           "  -r samples per benchmark, default 30\n"
+           "  -s minimum sample length in us, default 200\n"
+           "  -c cpu to pin to, default none\n"
+           "  -f only benchmarks whose name contains filter\n"
+           "  -j also write the results as JSON\n", MODEL_PATH_6);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string model = MODEL_PATH_6;
+    std::string filter;
+    std::string json;
+    BenchConfig config;
+    int cpu = -1;
+    int opt;
+    while((opt = getopt(argc, argv, "m:r:s:c:f:j:h")) != -1){
+        switch(opt){
+            case 'm': model = optarg; break;
+            case 'r': config.repetitions = atoi(optarg); break;
+            case 's': config.sample_us = atof(optarg); break;
+            case 'c': cpu = atoi(optarg); break;
+            case 'f': filter = optarg; break;
+            case 'j': json = optarg; break;
+            default: usage(); return 2;
+        }
+    }
+    if(optind != argc || config.repetitions <= 0 || config.sample_us <= 0.0){
+        usage();
+        return 2;
+    }
+    if(cpu >= 0){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if(sched_setaffinity(0, sizeof(set), &set) != 0){
+            printf("cannot pin to cpu %d\n", cpu);
+        }
+    }
+
+    ONNXWorker worker(model);
+    if(worker.getInputsSignature().size() != 1 || worker.getOutputsSignature().size() != 1 ||
+       worker.getInputsSignature()[0].datatype != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT){
+        printf("%s: need a model with one float input and one output\n", model.c_str());
+        return 1;
+    }
+    std::vector<int64_t> dims = worker.getInputsSignature()[0].Dims.second;
+    for(int64_t &d: dims){
+        d = d > 0 ? d : 1;
+    }
+    size_t count = 1;
+    for(int64_t d: dims){
+        count *= (size_t)d;
+    }
+    std::vector<float> data(count, 0.5f);
+    OrtValue* input = worker.createTensor(data.data(), data.size() * sizeof(float), dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+    std::vector<OrtValue*> inputs(1, input);
+    std::vector<OrtValue*> outputs(1, nullptr);
+    if(!worker.run(inputs, outputs) || outputs[0] == nullptr){
+        printf("%s: warm-up run failed\n", model.c_str());
+        worker.releaseValue(input);
+        return 1;
+    }
+    OrtValue* output = outputs[0];
+    outputs[0] = nullptr;
+
+    // preallocated destination of the output's shape
+    std::vector<int64_t> out_dims;
+    worker.getTensorShape(output, out_dims);
+    size_t out_count = 1;
+    for(int64_t d: out_dims){
+        out_count *= (size_t)d;
+    }
+    std::vector<float> out_data(out_count);
+    OrtValue* out_buffer = worker.createTensor(out_data.data(), out_data.size() * sizeof(float), out_dims,
+                                               ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+
+    MicroBench bench(config);
+    auto wanted = [&filter](const char* name){
+        return filter.empty() || strstr(name, filter.c_str()) != nullptr;
+    };
+
+    if(wanted("empty call")){
+        bench.run("empty call", []{ sink = sink + 1; });
+    }
+    // signature: ORT queries against the cached copy
+    if(wanted("getInputsInfo (ORT query)")){
+        std::vector<IOInfo> infos;
+        QuietStdout quiet;
+        bench.run("getInputsInfo (ORT query)", [&]{ infos.clear(); worker.getInputsInfo(infos); sink = infos.size(); });
+    }
+    if(wanted("getOutputsInfo (ORT query)")){
+        std::vector<IOInfo> infos;
+        QuietStdout quiet;
+        bench.run("getOutputsInfo (ORT query)", [&]{ infos.clear(); worker.getOutputsInfo(infos); sink = infos.size(); });
+    }
+    if(wanted("getInputsSignature (cached)")){
+        bench.run("getInputsSignature (cached)", [&]{ sink = worker.getInputsSignature()[0].DataNums; });
+    }
+    if(wanted("CreateTensorWithDataAsOrtValue")){
+        bench.run("CreateTensorWithDataAsOrtValue", [&]{
+            OrtValue* value = worker.createTensor(data.data(), data.size() * sizeof(float), dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+            sink = (uintptr_t)value;
+            worker.releaseValue(value);
+        });
+    }
+    if(wanted("IsTensor")){
+        bench.run("IsTensor", [&]{
+            int is_tensor = 0;
+            OrtStatus* status = g_ort->IsTensor(input, &is_tensor);
+            sink = (uintptr_t)status + (uintptr_t)is_tensor;
+        });
+    }
+    if(wanted("CreateCpuMemoryInfo")){
+        bench.run("CreateCpuMemoryInfo", [&]{
+            OrtMemoryInfo* info = nullptr;
+            OrtStatus* status = g_ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &info);
+            sink = (uintptr_t)status + (uintptr_t)info;
+            g_ort->ReleaseMemoryInfo(info);
+        });
+    }
+    if(wanted("Run, ORT allocated output")){
+        bench.run("Run, ORT allocated output", [&]{
+            worker.run(inputs, outputs);
+            sink = (uintptr_t)outputs[0];
+            worker.releaseValue(outputs[0]);
+            outputs[0] = nullptr;
+        });
+    }
+    if(wanted("Run, preallocated output")){
+        std::vector<OrtValue*> bound(1, out_buffer);
+        bench.run("Run, preallocated output", [&]{ worker.run(inputs, bound); sink = (uintptr_t)bound[0]; });
+    }
+    if(wanted("output data pointer")){
+        bench.run("output data pointer", [&]{ sink = (uintptr_t)worker.getFloatData(output); });
+    }
+    if(wanted("output shape + type")){
+        std::vector<int64_t> shape;
+        bench.run("output shape + type", [&]{
+            worker.getTensorShape(output, shape);
+            sink = shape.size() + (uintptr_t)worker.getTensorElementType(output);
+        });
+    }
+    if(wanted("output copy to std::vector")){
+        std::vector<float> copy;
+        bench.run("output copy to std::vector", [&]{
+            const float* values = worker.getFloatData(output);
+            copy.assign(values, values + out_count);
+            sink = (uintptr_t)copy.data();
+        });
+    }
+
+    printf("%s, %d repetitions of >= %.0f us, outliers beyond %.1f MADs dropped\n", model.c_str(), config.repetitions,
+           config.sample_us, config.outlier_mads);
+    bench.print(stdout);
+    worker.releaseValue(out_buffer);
+    worker.releaseValue(output);
+    worker.releaseValue(input);
+    return json.empty() || bench.writeJson(json) ? 0 : 1;
+}
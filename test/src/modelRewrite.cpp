@@ -0,0 +1,237 @@
+#include "ModelRewriter.h"
+#include "ONNXWorker.h"
+#include "InputGenerator.h"
+#include "CaptureLog.h"
+#include "OutputCompare.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// Offline rewrite of an skl2onnx model: ZipMap outputs become the float
+// probability tensors that fed them, no-op Casts are folded, and the lighter
+// model is saved. The rewritten model is then run beside the original on the
+// same generated inputs; tensor outputs must agree within max_abs and labels
+// exactly, a former ZipMap output is compared column by column in label order.
+// usage: modelRewrite [-z] [-c] [-n samples] [-r timed_runs] [-e max_abs] in.onnx out.onnx
+
+static const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+
+static bool succeeded(OrtStatus* status)
+{
+    if(status != nullptr){
+        printf("%s\n", g_ort->GetErrorMessage(status));
+        g_ort->ReleaseStatus(status);
+        return false;
+    }
+    return true;
+}
+
+static long fileSize(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? (long)st.st_size : -1;
+}
+
+static void releaseOutputs(ONNXWorker* worker, std::vector<OrtValue*> &outputs)
+{
+    for(OrtValue* &value: outputs){
+        worker->releaseValue(value);
+        value = nullptr;
+    }
+}
+
+// original output as the reference tensor; rows backs a former ZipMap output
+static bool reference(ONNXWorker* worker, OrtValue* value, const ZipMapOutput* zipmap, std::vector<float> &rows,
+                      CaptureTensor &tensor)
+{
+    tensor.type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+    tensor.data = nullptr;
+    tensor.data_bytes = 0;
+    tensor.dims.clear();
+    ONNXType kind = ONNX_TYPE_UNKNOWN;
+    if(!succeeded(g_ort->GetValueType(value, &kind))){
+        return false;
+    }
+    if(zipmap != nullptr && kind == ONNX_TYPE_SEQUENCE){
+        size_t classes = 0;
+        if(!OutputCompare::zipMapRows(value, zipmap->int_labels, zipmap->string_labels, rows, classes)){
+            return false;
+        }
+        tensor.type = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+        tensor.dims = {(int64_t)(classes > 0 ? rows.size() / classes : 0), (int64_t)classes};
+        tensor.data = rows.data();
+        tensor.data_bytes = rows.size() * sizeof(float);
+        return true;
+    }
+    if(kind != ONNX_TYPE_TENSOR){
+        return true;
+    }
+    tensor.type = worker->getTensorElementType(value);
+    if(tensor.type == ONNX_TENSOR_ELEMENT_DATA_TYPE_STRING || !worker->getTensorShape(value, tensor.dims)){
+        tensor.type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+        tensor.dims.clear();
+        return true;
+    }
+    size_t count = 1;
+    for(int64_t d: tensor.dims){
+        count *= (size_t)d;
+    }
+    tensor.data = worker->getTensorData(value);
+    tensor.data_bytes = count * ONNXWorker::elementSize(tensor.type);
+    return true;
+}
+
+static double timeRuns(ONNXWorker &worker, InputGenerator &inputs, int runs)
+{
+    std::vector<OrtValue*> outputs(worker.getOutputsSignature().size(), nullptr);
+    for(int i = 0; i < 3; ++i){
+        worker.run(inputs.values(), outputs);
+        releaseOutputs(&worker, outputs);
+    }
+    Clock::time_point begin = Clock::now();
+    for(int i = 0; i < runs; ++i){
+        worker.run(inputs.values(), outputs);
+        releaseOutputs(&worker, outputs);
+    }
+    return runs > 0 ? std::chrono::duration<double, std::milli>(Clock::now() - begin).count() / runs : 0.0;
+}
+
+// exit status: 0 equivalent, 1 outputs differ, 2 not checked
+static int equivalence(const std::string &original, const std::string &rewritten, const ModelRewriter &rewriter,
+                       int samples, int timed_runs, double max_abs)
+{
+    ONNXWorker before(original);
+    ONNXWorker after(rewritten);
+    const std::vector<IOInfo> &outputs_before = before.getOutputsSignature();
+    const std::vector<IOInfo> &outputs_after = after.getOutputsSignature();
+    if(before.getInputsSignature().size() != after.getInputsSignature().size() || outputs_before.size() != outputs_after.size()){
+        printf("signature differs: %zu/%zu inputs, %zu/%zu outputs\n", before.getInputsSignature().size(),
+               after.getInputsSignature().size(), outputs_before.size(), outputs_after.size());
+        return 1;
+    }
+    for(size_t i = 0; i < outputs_before.size(); ++i){
+        if(outputs_before[i].name != outputs_after[i].name){
+            printf("output %zu renamed: %s -> %s\n", i, outputs_before[i].name.c_str(), outputs_after[i].name.c_str());
+            return 1;
+        }
+    }
+    // both sessions see the inputs built for the original
+    InputGenerator inputs(&before, InputSpec());
+    if(!inputs.valid()){
+        printf("inputs not supported, equivalence not checked\n");
+        return 2;
+    }
+
+    std::vector<const ZipMapOutput*> zipmaps(outputs_before.size(), nullptr);
+    for(const ZipMapOutput &zipmap: rewriter.zipMapOutputs()){
+        for(size_t i = 0; i < outputs_before.size(); ++i){
+            zipmaps[i] = outputs_before[i].name == zipmap.output ? &zipmap : zipmaps[i];
+        }
+    }
+    OutputCompare compare;
+    AccuracyStats stats;
+    std::vector<OrtValue*> values_before(outputs_before.size(), nullptr);
+    std::vector<OrtValue*> values_after(outputs_after.size(), nullptr);
+    std::vector<float> rows;
+    bool ran = true;
+    for(int s = 0; s < samples && ran; ++s){
+        inputs.generate();
+        ran = before.run(inputs.values(), values_before) && after.run(inputs.values(), values_after);
+        for(size_t i = 0; ran && i < outputs_before.size(); ++i){
+            CaptureTensor golden;
+            ran = reference(&before, values_before[i], zipmaps[i], rows, golden);
+            if(ran){
+                compare.add(&after, golden, values_after[i], stats);
+            }
+        }
+        releaseOutputs(&before, values_before);
+        releaseOutputs(&after, values_after);
+    }
+    if(!ran){
+        printf("Run failed, equivalence not checked\n");
+        return 2;
+    }
+
+    const bool pass = stats.mismatched_shapes == 0 && stats.max_abs <= max_abs && stats.exactRate() == 1.0;
+    printf("%d samples: max abs %.3g, max rel %.3g", samples, stats.max_abs, stats.max_rel);
+    if(stats.exact_elements > 0){
+        printf(", labels %.1f%% equal", stats.exactRate() * 100.0);
+    }
+    if(stats.mismatched_shapes > 0){
+        printf(", %llu outputs changed type or shape", (unsigned long long)stats.mismatched_shapes);
+    }
+    if(stats.skipped > 0){
+        printf(", %llu non tensor outputs not compared", (unsigned long long)(stats.skipped / samples));
+    }
+    printf(" - %s\n", pass ? "equivalent" : "FAIL");
+
+    const double ms_before = timeRuns(before, inputs, timed_runs);
+    const double ms_after = timeRuns(after, inputs, timed_runs);
+    printf("%.4f ms/run -> %.4f ms/run (%.2fx), outputs released each run\n", ms_before, ms_after,
+           ms_after > 0.0 ? ms_before / ms_after : 0.0);
+    return pass ? 0 : 1;
+}
+
+static void usage()
+{
+    printf("usage: modelRewrite [-z] [-c] [-n samples] [-r timed_runs] [-e max_abs] in.onnx out.onnx\n"
+           "  -z keep ZipMap outputs, -c keep no-op Casts\n"
+           "  the rewritten model is run against the original on n (default 16) generated inputs;\n"
+           "  exit status 1 if outputs differ by more than max_abs (default 1e-6) or labels change,\n"
+           "  2 on bad arguments, an unreadable model or when the models cannot be run\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bool zipmap = true;
+    bool casts = true;
+    int samples = 16;
+    int timed_runs = 200;
+    double max_abs = 1e-6;
+    int opt;
+    while((opt = getopt(argc, argv, "zcn:r:e:h")) != -1){
+        switch(opt){
+            case 'z': zipmap = false; break;
+            case 'c': casts = false; break;
+            case 'n': samples = atoi(optarg); break;
+            case 'r': timed_runs = atoi(optarg); break;
+            case 'e': max_abs = atof(optarg); break;
+            default: usage(); return 2;
+        }
+    }
+    if(argc - optind != 2){
+        usage();
+        return 2;
+    }
+    const std::string in = argv[optind];
+    const std::string out = argv[optind + 1];
+    samples = samples > 0 ? samples : 1;
+
+    ModelRewriter rewriter;
+    if(!rewriter.load(in)){
+        return 2;
+    }
+    const size_t nodes = rewriter.nodeCount();
+    const int zipmaps = zipmap ? rewriter.removeZipMap() : 0;
+    const int folded = casts ? rewriter.foldCasts() : 0;
+    for(const std::string &note: rewriter.notes()){
+        printf("kept %s\n", note.c_str());
+    }
+    if(!rewriter.save(out)){
+        return 2;
+    }
+    printf("%s: %zu -> %zu nodes (%d ZipMap, %d Cast removed), %ld -> %ld bytes\n", in.c_str(), nodes,
+           rewriter.nodeCount(), zipmaps, folded, fileSize(in), fileSize(out));
+    for(const ZipMapOutput &output: rewriter.zipMapOutputs()){
+        printf("  %s is now float [N, %zu], columns in label order\n", output.output.c_str(),
+               output.int_labels.empty() ? output.string_labels.size() : output.int_labels.size());
+    }
+    return equivalence(in, out, rewriter, samples, timed_runs, max_abs);
+}
@@ -0,0 +1,106 @@
+#include "ONNXWorker.h"
+#include "InputGenerator.h"
+#include "MicroBench.h"
+#include "ModelFiles.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define MODEL_DIR "/usr/IDAS/ONNX/model"
+
+// Run cost per output subset of every multi-output model: all outputs, then
+// each output alone through a cached OutputSelection. Inputs are generated
+// once, outputs are released inside the timed call since a caller has to.
+
+static void benchModel(MicroBench &bench, const std::string &model)
+{
+    ONNXWorker worker(model);
+    const std::vector<IOInfo> &signature = worker.getOutputsSignature();
+    if(signature.size() < 2){
+        return;
+    }
+    InputGenerator inputs(&worker, InputSpec());
+    if(!inputs.valid()){
+        printf("%s: inputs not supported\n", model.c_str());
+        return;
+    }
+    inputs.generate();
+    const std::string name = modelFileName(model);
+
+    std::vector<OrtValue*> all(signature.size(), nullptr);
+    bench.run(name + "/all outputs", [&]{
+        worker.run(inputs.values(), all);
+        for(OrtValue* &value: all){
+            worker.releaseValue(value);
+            value = nullptr;
+        }
+    });
+    for(const IOInfo &info: signature){
+        const OutputSelection* selection = worker.selectOutputs(std::vector<std::string>(1, info.name));
+        if(selection == nullptr){
+            continue;
+        }
+        std::vector<OrtValue*> one(1, nullptr);
+        if(!worker.runSelected(inputs.values(), selection, one)){
+            printf("%s: cannot run with output %s only\n", name.c_str(), info.name.c_str());
+            continue;
+        }
+        worker.releaseValue(one[0]);
+        one[0] = nullptr;
+        bench.run(name + "/" + info.name, [&]{
+            worker.runSelected(inputs.values(), selection, one);
+            worker.releaseValue(one[0]);
+            one[0] = nullptr;
+        });
+    }
+}
+
+static void usage()
+{
+    printf("usage: outputSelect [-d model_dir] [-m model.onnx] [-r repetitions] [-s sample_us] [-j results.json]\n"
+           "  -d directory of .onnx models, default %s\n"
+           "  -m only this model, default every multi-output model in the directory\n"
+           "  -r samples per benchmark, default 30\n"
+           "  -s minimum sample length in us, default 200\n"
+           "  -j also write the results as JSON\n", MODEL_DIR);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string dir = MODEL_DIR;
+    std::string model;
+    std::string json;
+    BenchConfig config;
+    int opt;
+    while((opt = getopt(argc, argv, "d:m:r:s:j:h")) != -1){
+        switch(opt){
+            case 'd': dir = optarg; break;
+            case 'm': model = optarg; break;
+            case 'r': config.repetitions = atoi(optarg); break;
+            case 's': config.sample_us = atof(optarg); break;
+            case 'j': json = optarg; break;
+            default: usage(); return 2;
+        }
+    }
+    if(optind != argc || config.repetitions <= 0 || config.sample_us <= 0.0){
+        usage();
+        return 2;
+    }
+
+    MicroBench bench(config);
+    std::vector<std::string> models = model.empty() ? listModels(dir) : std::vector<std::string>(1, model);
+    for(const std::string &path: models){
+        benchModel(bench, path);
+    }
+    if(bench.results().empty()){
+        printf("no multi-output model to benchmark\n");
+        return 1;
+    }
+    printf("%d repetitions of >= %.0f us, outliers beyond %.1f MADs dropped\n", config.repetitions, config.sample_us,
+           config.outlier_mads);
+    bench.print(stdout);
+    return json.empty() || bench.writeJson(json) ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+#include "ONNXWorker.h"
+#include "InputGenerator.h"
+#include "ProfileReport.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+// Runs the model with ORT profiling on and returns the profile path.
+static std::string profileModel(const std::string &model, GraphOptimizationLevel level, const std::string &prefix, int runs)
+{
+    WorkerOptions options;
+    options.optimization = level;
+    options.profile_prefix = prefix;
+    ONNXWorker worker(model, options);
+    std::string path;
+    {
+        InputGenerator inputs(&worker, InputSpec());
+        if(!inputs.valid()){
+            return path;
+        }
+        std::vector<OrtValue*> outputs(worker.getOutputsSignature().size(), nullptr);
+        for(int i = 0; i < runs; ++i){
+            worker.run(inputs.values(), outputs);
+            for(OrtValue* &value: outputs){
+                worker.releaseValue(value);
+                value = nullptr;
+            }
+        }
+    }
+    path = worker.endProfiling();
+    printf("%s: %s\n", prefix.c_str(), path.c_str());
+    return path;
+}
+
+static void usage()
+{
+    printf("usage: profileReport [-n top] profile.json [other.json]\n"
+           "       profileReport -m model.onnx [-r runs] [-n top]\n"
+           "  one profile: per operator and per node time, calls and share\n"
+           "  two profiles: both reports, then the second compared to the first\n"
+           "  -m profiles the model with BASIC and ALL graph optimization and compares them\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string model;
+    int runs = 20;
+    size_t top = 15;
+    int opt;
+    while((opt = getopt(argc, argv, "m:r:n:h")) != -1){
+        switch(opt){
+            case 'm': model = optarg; break;
+            case 'r': runs = atoi(optarg); break;
+            case 'n': top = (size_t)atol(optarg); break;
+            default: usage(); return 1;
+        }
+    }
+
+    std::vector<std::string> paths, labels;
+    if(!model.empty()){
+        paths.emplace_back(profileModel(model, ORT_ENABLE_BASIC, "profile_basic", runs));
+        paths.emplace_back(profileModel(model, ORT_ENABLE_ALL, "profile_all", runs));
+        labels.emplace_back("basic");
+        labels.emplace_back("all");
+    }
+    else{
+        for(int i = optind; i < argc && paths.size() < 2; ++i){
+            paths.emplace_back(argv[i]);
+            labels.emplace_back(paths.size() == 1 ? "first" : "second");
+        }
+    }
+    if(paths.empty()){
+        usage();
+        return 1;
+    }
+
+    std::vector<ProfileReport> reports(paths.size());
+    for(size_t i = 0; i < paths.size(); ++i){
+        if(paths[i].empty() || !reports[i].load(paths[i])){
+            return 1;
+        }
+        printf("\n== %s (%s)\n", labels[i].c_str(), paths[i].c_str());
+        reports[i].print(stdout, top);
+    }
+    if(reports.size() == 2){
+        printf("\n== %s vs %s\n", labels[1].c_str(), labels[0].c_str());
+        ProfileReport::compare(stdout, reports[0], reports[1], labels[0], labels[1]);
+    }
+    return 0;
+}
@@ -0,0 +1,321 @@
+#include "ONNXWorker.h"
+#include "InputGenerator.h"
+#include "LatencyHistogram.h"
+#include "MemoryAccounting.h"
+#include "TrendCheck.h"
+#include "ModelFiles.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MODEL_DIR "/usr/IDAS/ONNX/model"
+
+typedef std::chrono::steady_clock Clock;
+
+// Soak: every model runs at a steady rate on its own thread for hours while
+// the main thread samples RSS, each session's heap (MemoryAccounting) and each
+// model's p99 every interval. After a warm-up share of the samples is
+// dropped, a series fails when it trends up (Mann-Kendall p below alpha) by
+// more than the allowed share over the run (Theil-Sen fit), so a leak of a
+// few bytes per Run or a slow latency creep fails while a step during
+// warm-up or a noisy minute does not. SIGINT / SIGTERM end the run early and
+// still judge what was sampled. Exit status: 0 pass, 1 fail, 2 too few samples
+// or bad arguments.
+
+struct SoakConfig{
+    std::string dir;
+    double seconds;
+    double interval;
+    double rate;                // runs per second per model
+    double warmup;              // share of samples dropped
+    double growth;              // allowed memory growth over the run
+    double drift;               // allowed p99 growth over the run
+    double alpha;
+    std::string csv;
+};
+
+struct SoakModel{
+    std::string name;
+    std::unique_ptr<ONNXWorker> worker;
+    std::unique_ptr<InputGenerator> inputs;
+
+    std::mutex mtx;             // guards the interval counters
+    LatencyHistogram interval;
+    uint64_t runs;
+    uint64_t errors;
+
+    uint64_t total_runs;        // sampler side
+    uint64_t total_errors;
+    std::vector<double> p99_ms;
+    std::vector<double> heap_mib;
+
+    SoakModel() : runs(0), errors(0), total_runs(0), total_errors(0) {}
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void onSignal(int)
+{
+    stop_requested = 1;
+}
+
+static void usage()
+{
+    printf("usage: soakTest [-d model_dir] [-t duration] [-i interval_s] [-r runs_per_s] [-w warmup_share]\n"
+           "                [-g growth_pct] [-l latency_drift_pct] [-a alpha] [-o samples.csv]\n"
+           "  -t run time, plain seconds or with s / m / h, default 2h\n"
+           "  -i seconds between samples, default 60\n"
+           "  -r steady rate of every model, default 20\n"
+           "  -w share of the first samples left out of the verdict, default 0.1\n"
+           "  -g allowed RSS / heap growth over the run, default 5%%\n"
+           "  -l allowed p99 growth over the run, default 25%%\n"
+           "  exit status: 0 pass, 1 growth, drift or run errors, 2 too few samples\n");
+}
+
+static double parseDuration(const char* text)
+{
+    char* end = nullptr;
+    double value = strtod(text, &end);
+    if(end != nullptr && *end == 'm'){
+        value *= 60.0;
+    }
+    else if(end != nullptr && *end == 'h'){
+        value *= 3600.0;
+    }
+    return value;
+}
+
+static double residentMiB()
+{
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if(fp == nullptr){
+        return 0.0;
+    }
+    unsigned long long pages = 0, resident_pages = 0;
+    if(fscanf(fp, "%llu %llu", &pages, &resident_pages) != 2){
+        resident_pages = 0;
+    }
+    fclose(fp);
+    return (double)resident_pages * (double)sysconf(_SC_PAGESIZE) / 1048576.0;
+}
+
+static void drive(SoakModel* model, double rate, const std::atomic<bool> &done)
+{
+    const uint64_t period_ns = (uint64_t)(1e9 / rate);
+    const Clock::duration period = std::chrono::nanoseconds(period_ns);
+    std::vector<OrtValue*> outputs(model->worker->getOutputsSignature().size(), nullptr);
+    Clock::time_point next = Clock::now();
+    while(!done.load(std::memory_order_relaxed)){
+        next += period;
+        std::this_thread::sleep_until(next);
+        model->inputs->generate();
+        Clock::time_point begin = Clock::now();
+        bool ok = model->worker->run(model->inputs->values(), outputs);
+        Clock::time_point end = Clock::now();
+        for(OrtValue* &value: outputs){
+            model->worker->releaseValue(value);
+            value = nullptr;
+        }
+        {
+            std::lock_guard<std::mutex> lock(model->mtx);
+            model->interval.recordCorrected((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count(),
+                                            period_ns);
+            ++model->runs;
+            model->errors += ok ? 0 : 1;
+        }
+        // keep a steady rate after a stall instead of catching up in a burst
+        if(end - next > std::chrono::seconds(1)){
+            next = end;
+        }
+    }
+}
+
+// false when the series grew by more than allowed, with significance
+static bool judge(const char* series, const std::vector<double> &x, const std::vector<double> &y, double allowed,
+                  double floor, double alpha)
+{
+    TrendResult trend = TrendCheck::fit(x, y);
+    const double hours = (x.back() - x.front()) / 3600.0;
+    const bool grew = trend.p_value < alpha && trend.relativeChange() > allowed && trend.change() > floor;
+    printf("  %-34s %10.3f %10.3f %+8.1f%% %10.3f %9.2g  %s\n", series, trend.start, trend.end,
+           trend.relativeChange() * 100.0, hours > 0.0 ? trend.change() / hours : 0.0, trend.p_value, grew ? "FAIL" : "ok");
+    return !grew;
+}
+
+int main(int argc, char *argv[])
+{
+    SoakConfig config;
+    config.dir = MODEL_DIR;
+    config.seconds = 7200.0;
+    config.interval = 60.0;
+    config.rate = 20.0;
+    config.warmup = 0.1;
+    config.growth = 0.05;
+    config.drift = 0.25;
+    config.alpha = 0.01;
+
+    int opt;
+    while((opt = getopt(argc, argv, "d:t:i:r:w:g:l:a:o:h")) != -1){
+        switch(opt){
+            case 'd': config.dir = optarg; break;
+            case 't': config.seconds = parseDuration(optarg); break;
+            case 'i': config.interval = atof(optarg); break;
+            case 'r': config.rate = atof(optarg); break;
+            case 'w': config.warmup = atof(optarg); break;
+            case 'g': config.growth = atof(optarg) / 100.0; break;
+            case 'l': config.drift = atof(optarg) / 100.0; break;
+            case 'a': config.alpha = atof(optarg); break;
+            case 'o': config.csv = optarg; break;
+            default: usage(); return 2;
+        }
+    }
+    if(config.seconds <= 0.0 || config.interval <= 0.0 || config.rate <= 0.0 || config.warmup < 0.0 || config.warmup >= 1.0){
+        usage();
+        return 2;
+    }
+
+    // before the workers, so their construction is counted
+    const bool accounting = MemoryAccounting::available();
+    MemoryAccounting::setEnabled(accounting);
+
+    std::vector<std::unique_ptr<SoakModel>> models;
+    for(const std::string &path: listModels(config.dir)){
+        std::unique_ptr<SoakModel> model(new SoakModel);
+        model->name = modelFileName(path);
+        model->worker.reset(new ONNXWorker(path));
+        model->inputs.reset(new InputGenerator(model->worker.get(), InputSpec()));
+        if(!model->inputs->valid()){
+            printf("%s: inputs not supported, not soaked\n", model->name.c_str());
+            continue;
+        }
+        models.emplace_back(std::move(model));
+    }
+    if(models.empty()){
+        printf("no models to soak in %s\n", config.dir.c_str());
+        return 2;
+    }
+
+    FILE* csv = nullptr;
+    if(!config.csv.empty()){
+        csv = fopen(config.csv.c_str(), "w");
+        if(csv == nullptr){
+            printf("cannot write %s\n", config.csv.c_str());
+            return 2;
+        }
+        fprintf(csv, "elapsed_s,rss_mib");
+        for(const std::unique_ptr<SoakModel> &model: models){
+            fprintf(csv, ",%s_runs,%s_errors,%s_p50_ms,%s_p99_ms,%s_heap_mib", model->name.c_str(), model->name.c_str(),
+                    model->name.c_str(), model->name.c_str(), model->name.c_str());
+        }
+        fprintf(csv, "\n");
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    printf("soaking %zu models at %.1f runs/s each for %.0f s, a sample every %.0f s%s\n", models.size(), config.rate,
+           config.seconds, config.interval, accounting ? "" : " (no heap accounting, malloc not interposed)");
+
+    std::atomic<bool> done(false);
+    std::vector<std::thread> drivers;
+    for(const std::unique_ptr<SoakModel> &model: models){
+        drivers.emplace_back(drive, model.get(), config.rate, std::cref(done));
+    }
+
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point finish = start + std::chrono::microseconds((int64_t)(config.seconds * 1e6));
+    std::vector<double> elapsed, rss;
+    Clock::time_point next_sample = start;
+    while(!stop_requested){
+        next_sample += std::chrono::microseconds((int64_t)(config.interval * 1e6));
+        if(next_sample > finish){
+            break;
+        }
+        // short naps so a signal ends the run promptly
+        while(!stop_requested && Clock::now() < next_sample){
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        if(stop_requested){
+            break;
+        }
+        const double t = std::chrono::duration<double>(Clock::now() - start).count();
+        elapsed.emplace_back(t);
+        rss.emplace_back(residentMiB());
+        int hours = (int)(t / 3600.0), minutes = (int)(t / 60.0) % 60, seconds = (int)t % 60;
+        printf("[%3d:%02d:%02d] rss %8.2f MiB", hours, minutes, seconds, rss.back());
+        if(csv != nullptr){
+            fprintf(csv, "%.1f,%.3f", t, rss.back());
+        }
+        for(const std::unique_ptr<SoakModel> &model: models){
+            LatencyHistogram snapshot;
+            uint64_t runs = 0, errors = 0;
+            {
+                std::lock_guard<std::mutex> lock(model->mtx);
+                snapshot.merge(model->interval);
+                model->interval.reset();
+                std::swap(runs, model->runs);
+                std::swap(errors, model->errors);
+            }
+            model->total_runs += runs;
+            model->total_errors += errors;
+            model->p99_ms.emplace_back((double)snapshot.percentile(99.0) / 1e6);
+            model->heap_mib.emplace_back((double)model->worker->getMemoryStats().heap_bytes / 1048576.0);
+            printf(" | %s p99 %.3f ms", model->name.c_str(), model->p99_ms.back());
+            if(csv != nullptr){
+                fprintf(csv, ",%llu,%llu,%.4f,%.4f,%.4f", (unsigned long long)runs, (unsigned long long)errors,
+                        (double)snapshot.percentile(50.0) / 1e6, model->p99_ms.back(), model->heap_mib.back());
+            }
+        }
+        printf("\n");
+        fflush(stdout);
+        if(csv != nullptr){
+            fprintf(csv, "\n");
+            fflush(csv);
+        }
+    }
+    done.store(true);
+    for(std::thread &driver: drivers){
+        driver.join();
+    }
+    if(csv != nullptr){
+        fclose(csv);
+    }
+
+    const size_t skip = (size_t)(config.warmup * elapsed.size());
+    const size_t kept = elapsed.size() - skip;
+    if(kept < 8){
+        printf("%zu samples after warm-up, need at least 8 for a verdict\n", kept);
+        return 2;
+    }
+    std::vector<double> x(elapsed.begin() + skip, elapsed.end());
+    auto tail = [skip](const std::vector<double> &series){
+        return std::vector<double>(series.begin() + skip, series.end());
+    };
+
+    printf("\n%zu samples judged after %zu warm-up, growth limit %.1f%%, p99 drift limit %.1f%%, alpha %g\n", kept, skip,
+           config.growth * 100.0, config.drift * 100.0, config.alpha);
+    printf("  %-34s %10s %10s %9s %10s %9s  %s\n", "series", "start", "end", "change", "per hour", "p", "verdict");
+    bool pass = judge("rss MiB", x, tail(rss), config.growth, 1.0, config.alpha);
+    for(const std::unique_ptr<SoakModel> &model: models){
+        if(accounting){
+            pass &= judge((model->name + " heap MiB").c_str(), x, tail(model->heap_mib), config.growth, 0.25, config.alpha);
+        }
+        pass &= judge((model->name + " p99 ms").c_str(), x, tail(model->p99_ms), config.drift, 0.0, config.alpha);
+        if(model->total_errors > 0){
+            printf("  %-34s %llu of %llu runs failed  FAIL\n", model->name.c_str(), (unsigned long long)model->total_errors,
+                   (unsigned long long)model->total_runs);
+            pass = false;
+        }
+    }
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
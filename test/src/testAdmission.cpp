@@ -0,0 +1,160 @@
+#include "ONNXWorker.h"
+#include "InferenceQueue.h"
+#include "AdmissionController.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+typedef InferenceQueue::Clock Clock;
+
+static const uint64_t STREAMS = 4;
+
+static double percentile(std::vector<double> &values, double p)
+{
+    if(values.empty()){
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(p * (values.size() - 1));
+    return values[index];
+}
+
+struct OverloadResult{
+    double throughput;      // REQUEST_OK results per second
+    double goodput;         // fresh results within the SLO per second
+    double ok_p99_ms;       // latency of the REQUEST_OK results
+};
+
+// Open loop arrivals at a fixed interval, into the admission controller or,
+// when it is null, straight into the plain queue. Goodput counts fresh
+// results that met the SLO, fallbacks are reported separately.
+static OverloadResult overload(ONNXWorker* worker, AdmissionController* admission, InferenceQueue* plain,
+                               std::vector<OrtValue*> &inputs, std::chrono::microseconds interval, double slo_ms,
+                               const char* label)
+{
+    std::vector<std::future<InferenceResult>> futures;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < inputs.size(); ++i){
+        std::this_thread::sleep_until(start + interval * (long)i);
+        std::vector<OrtValue*> request(1, inputs[i]);
+        futures.emplace_back(admission != nullptr ? admission->submit(request, i % STREAMS + 1)
+                                                  : plain->submit(request, Clock::time_point::max()));
+    }
+
+    std::vector<double> latency;
+    size_t counts[5] = {0, 0, 0, 0, 0};
+    size_t good = 0;
+    for(auto &future: futures){
+        InferenceResult result = future.get();
+        double ms = result.queue_ms + result.run_ms;
+        ++counts[result.status];
+        if(result.status == REQUEST_OK){
+            latency.emplace_back(ms);
+            good += ms <= slo_ms ? 1 : 0;
+        }
+        for(OrtValue* value: result.outputs){
+            worker->releaseValue(value);
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    double p50 = percentile(latency, 0.50), p99 = percentile(latency, 0.99);
+    printf("%-20s ok %5zu shed %5zu fallback %5zu timeout %4zu | goodput %8.1f/s (%5.1f%%) | ok latency p50 %8.2f p99 %8.2f ms\n",
+           label, counts[REQUEST_OK], counts[REQUEST_REJECTED], counts[REQUEST_FALLBACK], counts[REQUEST_TIMEOUT],
+           good / seconds, 100.0 * good / inputs.size(), p50, p99);
+    OverloadResult result;
+    result.throughput = counts[REQUEST_OK] / seconds;
+    result.goodput = good / seconds;
+    result.ok_p99_ms = p99;
+    return result;
+}
+
+// With admission the admitted requests must keep their p99 within the SLO,
+// give or take 10% of Run time jitter, and goodput must stay near capacity,
+// what the saturated queue completes without admission, instead of
+// collapsing. A Run of a few microseconds costs less than handing a request
+// over, capacity is then the queue's and goodput is not checked.
+static bool withinSlo(const OverloadResult &result, double slo_ms, double service_ms, double capacity)
+{
+    const double min_goodput = service_ms >= 0.02 ? 0.7 * capacity : 0.0;
+    const bool pass = result.ok_p99_ms <= slo_ms * 1.1 && result.goodput >= min_goodput;
+    printf("  admitted p99 %.2f ms (slo %.2f), goodput %.1f/s (min %.1f): %s\n", result.ok_p99_ms, slo_ms,
+           result.goodput, min_goodput, pass ? "ok" : "FAIL");
+    return pass;
+}
+
+// usage: testAdmission [requests] [overload_factor] [slo_x_service_time]
+int main(int argc, char const *argv[])
+{
+    size_t requests = argc > 1 ? (size_t)atol(argv[1]) : 2000;
+    double factor = argc > 2 ? atof(argv[2]) : 2.0;
+    double slo_factor = argc > 3 ? atof(argv[3]) : 5.0;
+    ONNXWorker *worker = new ONNXWorker(MODEL_PATH_6);
+
+    std::vector<float> data(requests);
+    std::vector<OrtValue*> inputs;
+    std::vector<int64_t> dims = {1, 1};
+    for(size_t i = 0; i < requests; ++i){
+        data[i] = 13.0f + (float)(i % 66);
+        inputs.emplace_back(worker->createTensor(&data[i], sizeof(float), dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT));
+    }
+
+    // service time from an unloaded queue
+    double service_ms = 0.0;
+    {
+        InferenceQueue queue(worker, 0);
+        const int probes = 50;
+        for(int i = 0; i < probes; ++i){
+            InferenceResult result = queue.submit(std::vector<OrtValue*>(1, inputs[i % requests]), Clock::time_point::max()).get();
+            service_ms += result.run_ms;
+            for(OrtValue* value: result.outputs){
+                worker->releaseValue(value);
+            }
+        }
+        service_ms /= probes;
+    }
+    // a sub-millisecond SLO would be below the scheduler's wake-up jitter
+    double slo_ms = std::max(service_ms * slo_factor, 1.0);
+    // a sub-microsecond service time on a fast box must not become a zero interval
+    std::chrono::microseconds interval(std::max<long long>(1, (long long)(service_ms * 1000.0 / factor)));
+    printf("service %.3f ms, capacity %.1f/s, offered %.1f/s (%.1fx), slo %.2f ms\n",
+           service_ms, 1000.0 / service_ms, 1e6 / interval.count(), factor, slo_ms);
+
+    double capacity = 0.0;
+    {
+        InferenceQueue plain(worker, 0);
+        capacity = overload(worker, nullptr, &plain, inputs, interval, slo_ms, "no admission").throughput;
+    }
+    bool pass = true;
+
+    AdmissionConfig config;
+    config.slo_ms = slo_ms;
+    config.initial_service_ms = service_ms;
+    config.fallback = false;
+    {
+        AdmissionController admission(worker, config);
+        OverloadResult result = overload(worker, &admission, nullptr, inputs, interval, slo_ms, "fast fail");
+        AdmissionStats stats = admission.getStats();
+        printf("  admitted %llu, met slo %llu, missed %llu\n", (unsigned long long)stats.admitted,
+               (unsigned long long)stats.met_slo, (unsigned long long)stats.missed_slo);
+        pass = withinSlo(result, slo_ms, service_ms, capacity) && pass;
+    }
+    config.fallback = true;
+    {
+        AdmissionController admission(worker, config);
+        OverloadResult result = overload(worker, &admission, nullptr, inputs, interval, slo_ms, "cached fallback");
+        AdmissionStats stats = admission.getStats();
+        printf("  admitted %llu, met slo %llu, missed %llu\n", (unsigned long long)stats.admitted,
+               (unsigned long long)stats.met_slo, (unsigned long long)stats.missed_slo);
+        pass = withinSlo(result, slo_ms, service_ms, capacity) && pass;
+    }
+
+    for(OrtValue* value: inputs){
+        worker->releaseValue(value);
+    }
+    delete worker;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+#include "ONNXWorker.h"
+#include "CaptureLog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define MODEL_PATH_5 "/usr/IDAS/ONNX/model/super_resolution.onnx"
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+typedef std::chrono::steady_clock Clock;
+
+// Input i of a model is filled with i so the capture can be checked afterwards.
+static void fill(std::vector<float> &data, size_t i)
+{
+    for(size_t k = 0; k < data.size(); ++k){
+        data[k] = (float)i + (float)(k % 7) * 0.125f;
+    }
+}
+
+static double runMany(ONNXWorker* worker, const std::vector<int64_t> &dims, size_t runs)
+{
+    size_t count = 1;
+    for(int64_t dim: dims){
+        count *= (size_t)dim;
+    }
+    std::vector<float> data(count);
+    std::vector<OrtValue*> outputs(worker->getOutputsSignature().size(), nullptr);
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < runs; ++i){
+        fill(data, i);
+        std::vector<OrtValue*> inputs(1, worker->createTensor(data.data(), data.size() * sizeof(float), dims,
+                                                              ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT));
+        worker->run(inputs, outputs);
+        worker->releaseValue(inputs[0]);
+        for(OrtValue* &value: outputs){
+            worker->releaseValue(value);
+            value = nullptr;
+        }
+    }
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / runs;
+}
+
+// Copies the capture with the first request's data size blown up and the
+// tail cut mid record; the reader must skip the one and drop the other.
+static bool readsCorrupt(const std::string &path, size_t records)
+{
+    std::vector<char> bytes;
+    FILE* fp = fopen(path.c_str(), "rb");
+    if(fp == nullptr){
+        return false;
+    }
+    char chunk[65536];
+    size_t got;
+    while((got = fread(chunk, 1, sizeof(chunk), fp)) > 0){
+        bytes.insert(bytes.end(), chunk, chunk + got);
+    }
+    fclose(fp);
+    size_t offset = sizeof(CaptureFileHeader), last = offset;
+    bool corrupted = false;
+    while(offset + sizeof(CaptureRecordHeader) <= bytes.size()){
+        CaptureRecordHeader* header = (CaptureRecordHeader*)(bytes.data() + offset);
+        if(header->kind == CAPTURE_REQUEST && !corrupted){
+            CaptureTensorHeader* tensor = (CaptureTensorHeader*)(header + 1);
+            tensor->data_bytes = ~(uint64_t)0 - 8;
+            corrupted = true;
+        }
+        last = offset;
+        offset += header->bytes;
+    }
+    bytes.resize(last + sizeof(CaptureRecordHeader) + 8);
+
+    std::string corrupt_path = path + ".corrupt";
+    fp = fopen(corrupt_path.c_str(), "wb");
+    if(fp == nullptr || fwrite(bytes.data(), 1, bytes.size(), fp) != bytes.size()){
+        return false;
+    }
+    fclose(fp);
+    CaptureReader reader;
+    bool ok = reader.open(corrupt_path) && reader.size() == records - 2;
+    printf("corrupt copy: %zu of %zu records kept\n", reader.size(), records);
+    remove(corrupt_path.c_str());
+    return ok;
+}
+
+// usage: testCapture [file] [runs]
+int main(int argc, char const *argv[])
+{
+    std::string path = argc > 1 ? argv[1] : "/tmp/onnx_capture.bin";
+    size_t runs = argc > 2 ? (size_t)atol(argv[2]) : 200;
+
+    ONNXWorker *easy = new ONNXWorker(MODEL_PATH_6);
+    ONNXWorker *sr = new ONNXWorker(MODEL_PATH_5);
+    std::vector<int64_t> easy_dims = {1, 1};
+    std::vector<int64_t> sr_dims = {1, 1, 224, 224};
+
+    double plain_ms = runMany(easy, easy_dims, runs);
+
+    CaptureWriter writer;
+    if(!writer.open(path, 4 << 20, 4)){
+        return 1;
+    }
+    easy->setCapture(&writer);
+    sr->setCapture(&writer);
+    double captured_ms = 0.0;
+    std::thread sr_thread(runMany, sr, sr_dims, runs / 10);
+    captured_ms = runMany(easy, easy_dims, runs);
+    sr_thread.join();
+    easy->setCapture(nullptr);
+    sr->setCapture(nullptr);
+    writer.close();
+    printf("easy_example_2 run %.4f ms plain, %.4f ms captured; %llu records, %llu dropped\n", plain_ms, captured_ms,
+           (unsigned long long)writer.records(), (unsigned long long)writer.dropped());
+
+    CaptureReader reader;
+    if(!reader.open(path)){
+        return 1;
+    }
+    // records of one model are in run order, check the values we put in
+    size_t checked[2] = {0, 0}, bad = 0;
+    for(size_t i = 0; i < reader.size(); ++i){
+        const CaptureRecord &record = reader.record(i);
+        int model = reader.modelPath(record.model_id) == MODEL_PATH_5 ? 1 : 0;
+        const CaptureTensor &tensor = record.tensors[0];
+        std::vector<float> expected(tensor.data_bytes / sizeof(float));
+        fill(expected, checked[model]++);
+        if(tensor.dims != (model ? sr_dims : easy_dims) ||
+           memcmp(expected.data(), tensor.data, tensor.data_bytes) != 0 || (uintptr_t)tensor.data % CAPTURE_ALIGN != 0){
+            ++bad;
+        }
+    }
+    printf("read %zu records: easy_example_2 %zu, super_resolution %zu, mismatched %zu\n",
+           reader.size(), checked[0], checked[1], bad);
+
+    // replay the easy_example_2 records straight from the mapping
+    int64_t easy_id = reader.modelId(MODEL_PATH_6);
+    std::vector<OrtValue*> outputs(easy->getOutputsSignature().size(), nullptr);
+    size_t replayed = 0;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < reader.size(); ++i){
+        const CaptureRecord &record = reader.record(i);
+        if((int64_t)record.model_id != easy_id){
+            continue;
+        }
+        const CaptureTensor &tensor = record.tensors[0];
+        std::vector<OrtValue*> inputs(1, easy->createTensor(const_cast<void*>(tensor.data), tensor.data_bytes,
+                                                            tensor.dims, tensor.type));
+        replayed += easy->run(inputs, outputs) ? 1 : 0;
+        easy->releaseValue(inputs[0]);
+        for(OrtValue* &value: outputs){
+            easy->releaseValue(value);
+            value = nullptr;
+        }
+    }
+    printf("replayed %zu requests, %.4f ms per run\n", replayed,
+           std::chrono::duration<double, std::milli>(Clock::now() - start).count() / (replayed ? replayed : 1));
+
+    bool corrupt_ok = readsCorrupt(path, reader.size());
+
+    delete easy;
+    delete sr;
+    return bad == 0 && corrupt_ok ? 0 : 1;
+}
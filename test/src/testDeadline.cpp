@@ -0,0 +1,162 @@
+#include "ONNXWorker.h"
+#include "InferenceQueue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#define MODEL_PATH_5 "/usr/IDAS/ONNX/model/super_resolution.onnx"
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+typedef InferenceQueue::Clock Clock;
+
+static double percentile(std::vector<double> &values, double p)
+{
+    if(values.empty()){
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(p * (values.size() - 1));
+    return values[index];
+}
+
+// Open loop: requests arrive every interval regardless of completions. With a
+// deadline, the completed requests must finish within it plus slack_ms, and no
+// request may start running once its deadline has passed.
+static bool overload(ONNXWorker* worker, std::vector<OrtValue*> &inputs, std::chrono::microseconds interval,
+                     std::chrono::microseconds timeout, double slack_ms, const char* label)
+{
+    InferenceQueue queue(worker, 0);
+    std::vector<std::future<InferenceResult>> futures;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < inputs.size(); ++i){
+        std::this_thread::sleep_until(start + interval * (long)i);
+        Clock::time_point deadline = timeout.count() > 0 ? Clock::now() + timeout : Clock::time_point::max();
+        futures.emplace_back(queue.submit(std::vector<OrtValue*>(1, inputs[i]), deadline));
+    }
+
+    const double timeout_ms = timeout.count() / 1000.0;
+    std::vector<double> latency, ok_latency;
+    size_t counts[5] = {0, 0, 0, 0, 0};
+    size_t late_starts = 0;
+    for(auto &future: futures){
+        InferenceResult result = future.get();
+        ++counts[result.status];
+        latency.emplace_back(result.queue_ms + result.run_ms);
+        if(result.status == REQUEST_OK){
+            ok_latency.emplace_back(result.queue_ms + result.run_ms);
+        }
+        // queue_ms of a run request is the wait until its run began
+        if(timeout.count() > 0 && result.run_ms > 0.0 && result.queue_ms >= timeout_ms){
+            ++late_starts;
+        }
+        for(OrtValue* value: result.outputs){
+            worker->releaseValue(value);
+        }
+    }
+    QueueStats stats = queue.getStats();
+    double p50 = percentile(latency, 0.50), p99 = percentile(latency, 0.99), worst = latency.back();
+    double ok_p99 = percentile(ok_latency, 0.99);
+    const bool pass = timeout.count() <= 0 || (ok_p99 <= timeout_ms + slack_ms && late_starts == 0);
+    printf("%-16s ok %5zu timeout %5zu (queue %llu, in-flight %llu) error %zu | latency p50 %8.2f p99 %8.2f max %8.2f ms\n",
+           label, counts[REQUEST_OK], counts[REQUEST_TIMEOUT],
+           (unsigned long long)stats.expired_in_queue, (unsigned long long)stats.aborted_in_flight,
+           counts[REQUEST_ERROR], p50, p99, worst);
+    if(timeout.count() > 0){
+        printf("%-16s completed p99 %.2f ms (limit %.2f), started after deadline %zu - %s\n",
+               "", ok_p99, timeout_ms + slack_ms, late_starts, pass ? "ok" : "FAIL");
+    }
+    return pass;
+}
+
+// Deadline a quarter of one run. A queue drops a request its service estimate
+// says cannot finish in time, so each request gets a fresh queue, which has no
+// estimate yet: the run starts at once and can only end through the in-flight
+// abort, well before a full run.
+static bool abortInFlight(int requests)
+{
+    ONNXWorker worker(MODEL_PATH_5);
+    std::vector<float> image(224 * 224, 0.5f);
+    std::vector<int64_t> dims = {1, 1, 224, 224};
+    std::vector<OrtValue*> input(1, worker.createTensor(image.data(), image.size() * sizeof(float), dims,
+                                                        ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT));
+    double full_ms = 0.0;
+    {
+        InferenceQueue queue(&worker, 0);
+        InferenceResult full = queue.submit(input, Clock::time_point::max()).get();
+        full_ms = full.run_ms;
+        for(OrtValue* value: full.outputs){
+            worker.releaseValue(value);
+        }
+    }
+    std::chrono::microseconds timeout((long)(full_ms * 250.0) + 1);
+
+    size_t timed_out = 0;
+    uint64_t aborted = 0;
+    double worst_ms = 0.0;
+    for(int i = 0; i < requests; ++i){
+        InferenceQueue queue(&worker, 0);
+        InferenceResult result = queue.submit(input, Clock::now() + timeout).get();
+        timed_out += result.status == REQUEST_TIMEOUT ? 1 : 0;
+        aborted += queue.getStats().aborted_in_flight;
+        worst_ms = std::max(worst_ms, result.queue_ms + result.run_ms);
+        for(OrtValue* value: result.outputs){
+            worker.releaseValue(value);
+        }
+    }
+    worker.releaseValue(input[0]);
+    const bool pass = timed_out == (size_t)requests && aborted == (uint64_t)requests && worst_ms < full_ms;
+    printf("%-16s run %.2f ms, deadline %ld us: timeout %zu of %d, in-flight %llu, max %.2f ms - %s\n", "in-flight abort",
+           full_ms, (long)timeout.count(), timed_out, requests, (unsigned long long)aborted, worst_ms, pass ? "ok" : "FAIL");
+    return pass;
+}
+
+// usage: testDeadline [requests] [overload_factor] [timeout_x_service_time]
+int main(int argc, char const *argv[])
+{
+    size_t requests = argc > 1 ? (size_t)atol(argv[1]) : 2000;
+    double factor = argc > 2 ? atof(argv[2]) : 2.0;
+    double timeout_factor = argc > 3 ? atof(argv[3]) : 10.0;
+    ONNXWorker *worker = new ONNXWorker(MODEL_PATH_6);
+
+    std::vector<float> data(requests);
+    std::vector<OrtValue*> inputs;
+    std::vector<int64_t> dims = {1, 1};
+    for(size_t i = 0; i < requests; ++i){
+        data[i] = 13.0f + (float)(i % 66);
+        inputs.emplace_back(worker->createTensor(&data[i], sizeof(float), dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT));
+    }
+
+    // service time from an unloaded queue
+    double service_ms = 0.0;
+    {
+        InferenceQueue queue(worker, 0);
+        const int probes = 50;
+        for(int i = 0; i < probes; ++i){
+            InferenceResult result = queue.submit(std::vector<OrtValue*>(1, inputs[i % requests]), Clock::time_point::max()).get();
+            service_ms += result.run_ms;
+            for(OrtValue* value: result.outputs){
+                worker->releaseValue(value);
+            }
+        }
+        service_ms /= probes;
+    }
+    std::chrono::microseconds interval((long)(service_ms * 1000.0 / factor) + 1);
+    std::chrono::microseconds timeout((long)(service_ms * 1000.0 * timeout_factor) + 1);
+    printf("service %.3f ms, arrivals every %ld us (%.1fx load), deadline %ld us\n",
+           service_ms, (long)interval.count(), factor, (long)timeout.count());
+
+    // a run that starts just before its deadline can end up to one service
+    // time late if the abort does not land, plus scheduling jitter
+    const double slack_ms = service_ms + 2.0;
+    bool pass = overload(worker, inputs, interval, std::chrono::microseconds(0), slack_ms, "no deadline");
+    pass = overload(worker, inputs, interval, timeout, slack_ms, "with deadline") && pass;
+    pass = abortInFlight(10) && pass;
+
+    for(OrtValue* value: inputs){
+        worker->releaseValue(value);
+    }
+    delete worker;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+#include "ONNXWorker.h"
+#include "InputGenerator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <chrono>
+#include <vector>
+
+#define MODEL_PATH_1 "/usr/IDAS/ONNX/model/easy_example.onnx"
+#define MODEL_PATH_3 "/usr/IDAS/ONNX/model/logreg_iris.onnx"
+#define MODEL_PATH_4 "/usr/IDAS/ONNX/model/mlp.onnx"
+#define MODEL_PATH_5 "/usr/IDAS/ONNX/model/super_resolution.onnx"
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedNs(Clock::time_point start, size_t reps)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / reps;
+}
+
+// what prepareSingleInputTensorData3 used to do per element
+static void fillReseeded(std::vector<float> &data)
+{
+    for(auto &value: data){
+        srand(time(nullptr));
+        value = (float)(rand() % 10);
+    }
+}
+
+static void measure(ONNXWorker* worker, const InputSpec &spec, size_t reps)
+{
+    InputGenerator generator(worker, spec);
+    if(!generator.valid()){
+        return;
+    }
+    size_t elements = 0;
+    printf("%s\n", worker->getModelPath().c_str());
+    for(size_t i = 0; i < worker->getInputsSignature().size(); ++i){
+        const std::vector<int64_t> &dims = generator.dims(i);
+        size_t count = 1;
+        printf("  input %-12s type %2d dims [", worker->getInputsSignature()[i].name.c_str(),
+               (int)worker->getInputsSignature()[i].datatype);
+        for(size_t d = 0; d < dims.size(); ++d){
+            printf(d ? ", %lld" : "%lld", (long long)dims[d]);
+            count *= (size_t)dims[d];
+        }
+        printf("]\n");
+        elements += count;
+    }
+
+    Clock::time_point start = Clock::now();
+    for(size_t r = 0; r < reps; ++r){
+        generator.generate();
+    }
+    double generate_ns = elapsedNs(start, reps);
+
+    std::vector<OrtValue*> outputs(worker->getOutputsSignature().size(), nullptr);
+    start = Clock::now();
+    size_t ok = 0;
+    for(size_t r = 0; r < reps; ++r){
+        ok += worker->run(generator.values(), outputs) ? 1 : 0;
+        for(OrtValue* &value: outputs){
+            worker->releaseValue(value);
+            value = nullptr;
+        }
+    }
+    double run_ns = elapsedNs(start, reps);
+
+    std::vector<float> old_style(elements);
+    size_t old_reps = reps / 10 + 1;
+    start = Clock::now();
+    for(size_t r = 0; r < old_reps; ++r){
+        fillReseeded(old_style);
+    }
+    double reseeded_ns = elapsedNs(start, old_reps);
+
+    printf("  %zu elements: generate %10.1f ns (%.2f ns/elem), srand per element %10.1f ns, run %10.1f ns, %zu/%zu ok\n",
+           elements, generate_ns, generate_ns / elements, reseeded_ns, run_ns, ok, reps);
+}
+
+// default integers spread over their range, out of range values clamp
+static bool checkIntegers()
+{
+    FastRandom &rng = FastRandom::local();
+    std::vector<int64_t> ints(4096);
+    InputGenerator::fill(ints.data(), ints.size(), ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64, InputSpec(), rng);
+    int64_t lowest = ints[0], highest = ints[0];
+    for(int64_t value: ints){
+        lowest = value < lowest ? value : lowest;
+        highest = value > highest ? value : highest;
+    }
+
+    InputSpec negative;
+    negative.int_low = -1000.0;
+    negative.int_high = 1000.0;
+    std::vector<uint8_t> bytes(4096);
+    std::vector<uint32_t> words(4096);
+    InputGenerator::fill(bytes.data(), bytes.size(), ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8, negative, rng);
+    InputGenerator::fill(words.data(), words.size(), ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32, negative, rng);
+    size_t zeros = 0, saturated = 0, bad = 0;
+    for(size_t i = 0; i < bytes.size(); ++i){
+        zeros += bytes[i] == 0 ? 1 : 0;
+        saturated += bytes[i] == 255 ? 1 : 0;
+        bad += words[i] >= 1000 ? 1 : 0;
+    }
+    bool pass = lowest == 0 && highest == 9 && zeros > bytes.size() / 3 && saturated > bytes.size() / 3 && bad == 0;
+    printf("int64 default range [%lld, %lld], uint8 from [-1000, 1000): %zu zeros %zu saturated, uint32 out of range %zu: %s\n",
+           (long long)lowest, (long long)highest, zeros, saturated, bad, pass ? "ok" : "FAIL");
+    return pass;
+}
+
+// usage: testInputGenerator [batch] [reps]
+int main(int argc, char const *argv[])
+{
+    int64_t batch = argc > 1 ? atol(argv[1]) : 1;
+    size_t reps = argc > 2 ? (size_t)atol(argv[2]) : 1000;
+    const char* models[] = {MODEL_PATH_1, MODEL_PATH_3, MODEL_PATH_4, MODEL_PATH_5};
+
+    InputSpec spec;
+    spec.dynamic_dim = batch;
+    for(const char* path: models){
+        ONNXWorker *worker = new ONNXWorker(path);
+        measure(worker, spec, reps);
+        delete worker;
+    }
+    return checkIntegers() ? 0 : 1;
+}
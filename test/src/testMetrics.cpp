@@ -0,0 +1,160 @@
+#include "ONNXWorker.h"
+#include "InferenceQueue.h"
+#include "Scheduler.h"
+#include "Metrics.h"
+#include "MetricsServer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+typedef std::chrono::steady_clock Clock;
+
+// ns per inc() with every thread hitting the same counter
+static double counterCost(MetricCounter* counter, int threads, size_t per_thread)
+{
+    std::vector<std::thread> pool;
+    Clock::time_point start = Clock::now();
+    for(int t = 0; t < threads; ++t){
+        pool.emplace_back([counter, per_thread]{
+            for(size_t i = 0; i < per_thread; ++i){
+                counter->inc();
+            }
+        });
+    }
+    for(auto &thread: pool){
+        thread.join();
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / per_thread;
+}
+
+// what a scraper asking for target sees, over the same socket
+static std::string scrape(const std::string &path, const char* target = "/metrics")
+{
+    std::string response;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if(fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0){
+        printf("cannot connect to %s\n", path.c_str());
+        if(fd >= 0){
+            close(fd);
+        }
+        return response;
+    }
+    const std::string request = std::string("GET ") + target + " HTTP/1.0\r\n\r\n";
+    if(write(fd, request.data(), request.size()) == (ssize_t)request.size()){
+        char buffer[4096];
+        ssize_t got;
+        while((got = read(fd, buffer, sizeof(buffer))) > 0){
+            response.append(buffer, (size_t)got);
+        }
+    }
+    close(fd);
+    return response;
+}
+
+// usage: testMetrics [socket path] [requests] [serve seconds]
+// With serve seconds > 0 the endpoint stays up for an external scraper, e.g.
+// curl --unix-socket /tmp/onnx_metrics.sock http://localhost/metrics
+int main(int argc, char const *argv[])
+{
+    std::string path = argc > 1 ? argv[1] : "/tmp/onnx_metrics.sock";
+    size_t requests = argc > 2 ? (size_t)atol(argv[2]) : 200;
+    int serve_seconds = argc > 3 ? atoi(argv[3]) : 0;
+
+    MetricCounter* counter = MetricsRegistry::instance().counter("test_increments_total", "Counter cost probe.");
+    printf("counter inc: %.1f ns with 1 thread, %.1f ns with 4 threads\n",
+           counterCost(counter, 1, 10000000), counterCost(counter, 4, 10000000));
+
+    MetricsServer server;
+    if(!server.start(path)){
+        return 1;
+    }
+    MetricsRegistry::setEnabled(true);
+
+    ONNXWorker *worker = new ONNXWorker(MODEL_PATH_6);
+    float x = 42.0f;
+    std::vector<int64_t> dims = {1, 1};
+    OrtValue* input = worker->createTensor(&x, sizeof(x), dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+    std::vector<float> rows(8, 1.0f);
+    std::vector<int64_t> batch_dims = {8, 1};
+    OrtValue* batch = worker->createTensor(rows.data(), rows.size() * sizeof(float), batch_dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+
+    // queue: a bounded queue driven in bursts, so some requests are rejected
+    {
+        InferenceQueue queue(worker, 4);
+        std::vector<OrtValue*> inputs(1, input);
+        for(size_t i = 0; i < requests; i += 8){
+            std::vector<std::future<InferenceResult>> futures;
+            for(size_t k = 0; k < 8; ++k){
+                futures.emplace_back(queue.submit(inputs, std::chrono::microseconds(100000)));
+            }
+            for(auto &future: futures){
+                InferenceResult result = future.get();
+                for(OrtValue* value: result.outputs){
+                    worker->releaseValue(value);
+                }
+            }
+        }
+    }
+
+    // scheduler: 8 row requests run as 2 row chunks next to high priority requests
+    {
+        Scheduler scheduler(1, 2, 5.0);
+        int model = scheduler.addModel(worker);
+        int tenant = scheduler.addTenant("tenant", 1.0);
+        std::vector<OrtValue*> batch_inputs(1, batch);
+        std::vector<OrtValue*> inputs(1, input);
+        for(size_t i = 0; i < requests / 4; ++i){
+            std::future<SchedResult> normal = scheduler.submit(model, tenant, SCHED_NORMAL, batch_inputs);
+            std::future<SchedResult> high = scheduler.submit(model, tenant, SCHED_HIGH, inputs);
+            for(std::future<SchedResult>* future: {&high, &normal}){
+                SchedResult result = future->get();
+                for(auto &chunk: result.outputs){
+                    for(OrtValue* value: chunk){
+                        worker->releaseValue(value);
+                    }
+                }
+            }
+        }
+    }
+
+    std::string response = scrape(path);
+    printf("%s", response.c_str());
+    const bool query_ok = scrape(path, "/metrics?name[]=onnx_runs_total").compare(0, 15, "HTTP/1.0 200 OK") == 0;
+    const bool other_ok = scrape(path, "/metricsfoo").compare(0, 22, "HTTP/1.0 404 Not Found") == 0;
+    printf("/metrics?query served: %s, /metricsfoo refused: %s\n", query_ok ? "ok" : "FAIL", other_ok ? "ok" : "FAIL");
+    if(serve_seconds > 0){
+        printf("serving %s for %d s\n", path.c_str(), serve_seconds);
+        std::this_thread::sleep_for(std::chrono::seconds(serve_seconds));
+    }
+    server.stop();
+
+    // a regular file at the socket path is neither bound over nor deleted
+    const std::string file = path + ".file";
+    FILE* fp = fopen(file.c_str(), "w");
+    if(fp != nullptr){
+        fclose(fp);
+    }
+    MetricsServer refused;
+    const bool kept = fp != nullptr && !refused.start(file) && access(file.c_str(), F_OK) == 0;
+    printf("regular file at the socket path: %s\n", kept ? "refused and kept: ok" : "FAIL");
+    unlink(file.c_str());
+
+    worker->releaseValue(input);
+    worker->releaseValue(batch);
+    delete worker;
+    return response.compare(0, 15, "HTTP/1.0 200 OK") == 0 && query_ok && other_ok && kept ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+#include "ModelRewriter.h"
+#include "ProtoWire.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#define MODEL_PATH_2 "/usr/IDAS/ONNX/model/logreg_iris.onnx"
+#define MODEL_PATH_4 "/usr/IDAS/ONNX/model/mlp.onnx"
+#define MODEL_PATH_5 "/usr/IDAS/ONNX/model/super_resolution.onnx"
+
+// ModelProto.graph
+enum{ MODEL_GRAPH = 7 };
+
+static std::string readFile(const std::string &path)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    std::stringstream bytes;
+    bytes << in.rdbuf();
+    return bytes.str();
+}
+
+static std::string tempPath()
+{
+    char path[] = "/tmp/modelRewriteXXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0){
+        return std::string();
+    }
+    close(fd);
+    return path;
+}
+
+// Loading and saving without a rewrite must give the file back byte for byte,
+// and text() of the graph must not lose it once child() has parsed it.
+static bool roundTrip(const std::string &model)
+{
+    const std::string original = readFile(model);
+    ModelRewriter rewriter;
+    const std::string path = tempPath();
+    const bool saved = !original.empty() && !path.empty() && rewriter.load(model) && rewriter.save(path);
+    const std::string copy = saved ? readFile(path) : std::string();
+    unlink(path.c_str());
+    const bool same = saved && copy == original;
+    printf("%s: %zu bytes loaded and saved, %s\n", model.c_str(), original.size(), same ? "identical: ok" : "FAIL");
+
+    ProtoMessage message;
+    bool text_ok = message.parse(original);
+    const std::string graph = message.text(MODEL_GRAPH);
+    ProtoField* field = message.find(MODEL_GRAPH);
+    text_ok = text_ok && field != nullptr && ProtoMessage::child(*field) != nullptr && !graph.empty() &&
+              message.text(MODEL_GRAPH) == graph;
+    printf("graph text after child(): %zu bytes, %s\n", graph.size(), text_ok ? "ok" : "FAIL");
+    return same && text_ok;
+}
+
+// The rewrite must reach the expected node count, and keep it through a
+// save and reload.
+static bool rewrite(const std::string &model, size_t nodes_before, size_t nodes_after)
+{
+    ModelRewriter rewriter;
+    if(!rewriter.load(model)){
+        printf("%s: FAIL, not loaded\n", model.c_str());
+        return false;
+    }
+    const size_t before = rewriter.nodeCount();
+    const int zipmaps = rewriter.removeZipMap();
+    const int casts = rewriter.foldCasts();
+    const size_t after = rewriter.nodeCount();
+
+    const std::string path = tempPath();
+    ModelRewriter reloaded;
+    const bool saved = !path.empty() && rewriter.save(path) && reloaded.load(path);
+    const size_t after_reload = saved ? reloaded.nodeCount() : 0;
+    unlink(path.c_str());
+
+    const bool pass = before == nodes_before && after == nodes_after && after_reload == nodes_after;
+    printf("%s: %zu -> %zu nodes (%d ZipMap, %d Cast), %zu after reload, expect %zu -> %zu: %s\n", model.c_str(),
+           before, after, zipmaps, casts, after_reload, nodes_before, nodes_after, pass ? "ok" : "FAIL");
+    return pass;
+}
+
+int main()
+{
+    bool pass = roundTrip(MODEL_PATH_5);
+    pass = rewrite(MODEL_PATH_4, 19, 14) && pass;
+    pass = rewrite(MODEL_PATH_2, 4, 3) && pass;
+    return pass ? 0 : 1;
+}
@@ -6,7 +6,6 @@
 #define MODEL_PATH_2 "/usr/IDAS/ONNX/model/logreg_iris.onnx"
 #define MODEL_PATH_3 "/usr/IDAS/ONNX/model/super_resolution.onnx"
 #define MODEL_PATH_4 "/usr/IDAS/ONNX/model/mlp.onnx"
-#define MODEL_PATH_5 "/usr/IDAS/ONNX/model/easy_example.onnx"
 #define MODEL_PATH_5 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
 
 int main(int argc, char const *argv[])
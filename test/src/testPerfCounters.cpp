@@ -0,0 +1,107 @@
+#include "ONNXWorker.h"
+#include "InputGenerator.h"
+#include "PerfCounters.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MODEL_PATH_5 "/usr/IDAS/ONNX/model/super_resolution.onnx"
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+// Two loops with known behaviour: dependent multiply-adds (high IPC, no
+// misses) and a random pointer chase over 64 MB (low IPC, a miss per step).
+static void calibrate()
+{
+    const size_t steps = 1 << 22;
+    PerfSample begin, end;
+    if(!PerfCounters::read(begin)){
+        printf("counters unavailable: %s\n", PerfCounters::unavailableReason());
+        return;
+    }
+    volatile uint64_t sink = 1;
+    uint64_t acc = 1;
+    for(size_t i = 0; i < steps; ++i){
+        acc = acc * 6364136223846793005ULL + i;
+    }
+    sink = acc;
+    PerfCounters::read(end);
+    PerfSample compute = PerfCounters::delta(begin, end);
+
+    std::vector<uint32_t> next(1 << 24);
+    for(size_t i = 0; i < next.size(); ++i){
+        next[i] = (uint32_t)i;
+    }
+    // Sattolo: one cycle through every slot
+    uint64_t state = 88172645463325252ULL;
+    for(size_t i = next.size() - 1; i > 0; --i){
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        size_t j = (size_t)(state % i);
+        uint32_t tmp = next[i]; next[i] = next[j]; next[j] = tmp;
+    }
+    uint32_t index = 0;
+    PerfCounters::read(begin);
+    for(size_t i = 0; i < steps; ++i){
+        index = next[index];
+    }
+    sink = index;
+    PerfCounters::read(end);
+    PerfSample chase = PerfCounters::delta(begin, end);
+    (void)sink;
+
+    const PerfSample* samples[2] = {&compute, &chase};
+    const char* names[2] = {"compute loop", "pointer chase"};
+    for(int k = 0; k < 2; ++k){
+        const PerfSample &s = *samples[k];
+        printf("%-14s", names[k]);
+        for(int i = 0; i < PERF_COUNTERS; ++i){
+            if(s.valid & (1u << i)){
+                printf(" %s %llu", PerfCounters::counterName((PerfCounter)i), (unsigned long long)s.values[i]);
+            }
+        }
+        if((s.valid & 3u) == 3u && s.values[PERF_CYCLES] > 0){
+            printf(" IPC %.2f", (double)s.values[PERF_INSTRUCTIONS] / s.values[PERF_CYCLES]);
+        }
+        printf("\n");
+    }
+}
+
+static void serve(const std::string &model, size_t runs)
+{
+    ONNXWorker worker(model);
+    InputGenerator inputs(&worker, InputSpec());
+    if(!inputs.valid()){
+        return;
+    }
+    std::vector<OrtValue*> outputs(worker.getOutputsSignature().size(), nullptr);
+    for(size_t i = 0; i < runs; ++i){
+        worker.run(inputs.values(), outputs);
+        for(OrtValue* &value: outputs){
+            worker.releaseValue(value);
+            value = nullptr;
+        }
+    }
+}
+
+// usage: testPerfCounters [runs]
+int main(int argc, char const *argv[])
+{
+    size_t runs = argc > 1 ? (size_t)atol(argv[1]) : 50;
+    calibrate();
+
+    PerfCounters::setEnabled(true);
+    // two threads per model, each with its own counter group
+    std::vector<std::thread> threads;
+    const char* models[] = {MODEL_PATH_6, MODEL_PATH_5};
+    for(const char* model: models){
+        for(int t = 0; t < 2; ++t){
+            threads.emplace_back(serve, std::string(model), runs);
+        }
+    }
+    for(auto &thread: threads){
+        thread.join();
+    }
+    PerfCounters::report(stdout);
+    return 0;
+}
@@ -0,0 +1,209 @@
+#include "ONNXWorker.h"
+#include "InferenceQueue.h"
+#include "Scheduler.h"
+#include "RequestTrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+typedef std::chrono::steady_clock Clock;
+
+static double runLoop(ONNXWorker* worker, OrtValue* input, size_t runs)
+{
+    std::vector<OrtValue*> inputs(1, input);
+    std::vector<OrtValue*> outputs(1, nullptr);
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < runs; ++i){
+        worker->run(inputs, outputs);
+        worker->releaseValue(outputs[0]);
+        outputs[0] = nullptr;
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / runs;
+}
+
+// the caller's own postprocessing, traced under the request id of the result
+static void postprocess(ONNXWorker* worker, uint64_t trace_id, std::vector<OrtValue*> &outputs)
+{
+    TraceSpan span("postprocess", trace_id);
+    for(OrtValue* &value: outputs){
+        worker->releaseValue(value);
+        value = nullptr;
+    }
+}
+
+struct ParsedEvent{
+    std::string name;
+    double ts;
+    double end;
+};
+
+static bool numberAfter(const char* line, const char* key, double &value)
+{
+    const char* at = strstr(line, key);
+    return at != nullptr && sscanf(at + strlen(key), "%lf", &value) == 1;
+}
+
+// request id -> its events from the export, one event per line
+static bool parseExport(const char* path, std::map<uint64_t, std::vector<ParsedEvent>> &requests)
+{
+    FILE* in = fopen(path, "r");
+    if(in == nullptr){
+        return false;
+    }
+    char line[1024];
+    while(fgets(line, sizeof(line), in) != nullptr){
+        const char* name = strstr(line, "{\"name\":\"");
+        double request = 0.0, dur = 0.0;
+        ParsedEvent event;
+        if(name == nullptr || strstr(line, "\"cat\":\"request\"") == nullptr || !numberAfter(line, "\"ts\":", event.ts) ||
+           !numberAfter(line, "\"request\":", request)){
+            continue;
+        }
+        name += strlen("{\"name\":\"");
+        event.name.assign(name, strcspn(name, "\""));
+        numberAfter(line, "\"dur\":", dur);
+        event.end = event.ts + dur;
+        requests[(uint64_t)request].emplace_back(event);
+    }
+    fclose(in);
+    return true;
+}
+
+// Every request must read enqueue, queue, then batch? run per chunk, then
+// complete, in the order the events ended, each starting no earlier than
+// the one before ended (queue spans from the enqueue time itself);
+// postprocess runs on the caller and may overlap complete.
+static bool checkOrder(const char* path, size_t expected_requests, size_t expected_batched)
+{
+    std::map<uint64_t, std::vector<ParsedEvent>> requests;
+    if(!parseExport(path, requests)){
+        printf("cannot read %s\n", path);
+        return false;
+    }
+    size_t bad = 0, batched = 0;
+    for(auto &entry: requests){
+        std::vector<ParsedEvent> &events = entry.second;
+        events.erase(std::remove_if(events.begin(), events.end(),
+                                    [](const ParsedEvent &event){ return event.name == "postprocess"; }), events.end());
+        std::stable_sort(events.begin(), events.end(), [](const ParsedEvent &a, const ParsedEvent &b){ return a.end < b.end; });
+        std::string sequence;
+        bool monotonic = true;
+        for(size_t i = 0; i < events.size(); ++i){
+            sequence += (i ? " " : "") + events[i].name;
+            if(i > 0 && events[i].name != "queue" && events[i].ts < events[i - 1].end){
+                monotonic = false;
+            }
+        }
+        bool chunked = sequence.find("batch") != std::string::npos;
+        const std::string head = "enqueue queue ", tail = " complete";
+        bool shape = sequence.size() > head.size() + tail.size() && sequence.compare(0, head.size(), head) == 0 &&
+            sequence.compare(sequence.size() - tail.size(), tail.size(), tail) == 0;
+        std::string middle = shape ? sequence.substr(head.size(), sequence.size() - head.size() - tail.size()) : "";
+        std::string step = chunked ? "batch run" : "run";
+        for(size_t at = 0; shape && at < middle.size(); at += step.size() + 1){
+            shape = middle.compare(at, step.size(), step) == 0;
+        }
+        batched += chunked ? 1 : 0;
+        if(!shape || !monotonic){
+            if(bad++ < 5){
+                printf("request %llu: %s%s\n", (unsigned long long)entry.first, sequence.c_str(), monotonic ? "" : " (out of order)");
+            }
+        }
+    }
+    bool pass = bad == 0 && requests.size() == expected_requests && batched == expected_batched;
+    printf("%zu requests traced (expected %zu), %zu batched (expected %zu), %zu out of order: %s\n",
+           requests.size(), expected_requests, batched, expected_batched, bad, pass ? "ok" : "FAIL");
+    return pass;
+}
+
+// usage: testRequestTrace [trace.json] [requests]
+int main(int argc, char const *argv[])
+{
+    char temp[] = "/tmp/requestTraceXXXXXX";
+    const char* path = argc > 1 ? argv[1] : temp;
+    if(argc <= 1){
+        int fd = mkstemp(temp);
+        if(fd < 0){
+            printf("cannot create %s\n", temp);
+            return 1;
+        }
+        close(fd);
+    }
+    size_t requests = argc > 2 ? (size_t)atol(argv[2]) : 200;
+    ONNXWorker *worker = new ONNXWorker(MODEL_PATH_6);
+    float x = 42.0f;
+    std::vector<int64_t> dims = {1, 1};
+    OrtValue* input = worker->createTensor(&x, sizeof(x), dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+    std::vector<float> rows(8, 1.0f);
+    std::vector<int64_t> batch_dims = {8, 1};
+    OrtValue* batch = worker->createTensor(rows.data(), rows.size() * sizeof(float), batch_dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+
+    // cost of the run events
+    RequestTrace::setEnabled(false);
+    double off_ns = runLoop(worker, input, 20000);
+    RequestTrace::setEnabled(true);
+    double on_ns = runLoop(worker, input, 20000);
+    printf("run() %.1f ns without tracing, %.1f ns with, %.1f ns per call\n", off_ns, on_ns, on_ns - off_ns);
+    RequestTrace::clear();
+    // relative ts keep ns resolution in the doubles the checks read back
+    uint64_t origin_wall_ns = RequestTrace::wallNs(RequestTrace::nowNs());
+
+    // queue: bursts of 4 so requests wait behind each other
+    {
+        InferenceQueue queue(worker, 0);
+        std::vector<OrtValue*> inputs(1, input);
+        for(size_t i = 0; i < requests; i += 4){
+            std::vector<std::future<InferenceResult>> futures;
+            for(size_t k = 0; k < 4; ++k){
+                futures.emplace_back(queue.submit(inputs, std::chrono::microseconds(100000)));
+            }
+            for(auto &future: futures){
+                InferenceResult result = future.get();
+                postprocess(worker, result.trace_id, result.outputs);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    // scheduler: an 8 row request run as 2 row batches next to single high priority requests
+    {
+        Scheduler scheduler(1, 2, 5.0);
+        int model = scheduler.addModel(worker);
+        int tenant = scheduler.addTenant("tenant", 1.0);
+        std::vector<OrtValue*> batch_inputs(1, batch);
+        std::vector<OrtValue*> inputs(1, input);
+        for(size_t i = 0; i < requests / 4; ++i){
+            std::future<SchedResult> normal = scheduler.submit(model, tenant, SCHED_NORMAL, batch_inputs);
+            std::future<SchedResult> high = scheduler.submit(model, tenant, SCHED_HIGH, inputs);
+            for(std::future<SchedResult>* future: {&high, &normal}){
+                SchedResult result = future->get();
+                for(auto &chunk: result.outputs){
+                    postprocess(worker, result.trace_id, chunk);
+                }
+            }
+        }
+    }
+
+    bool ok = RequestTrace::exportChrome(path, origin_wall_ns);
+    printf("%s: %llu events recorded, %llu overwritten\n", path, (unsigned long long)RequestTrace::recorded(),
+           (unsigned long long)RequestTrace::overwritten());
+    size_t queued = (requests + 3) / 4 * 4, scheduled = requests / 4;
+    ok = ok && checkOrder(path, queued + 2 * scheduled, scheduled);
+    if(argc <= 1){
+        remove(path);
+    }
+    worker->releaseValue(input);
+    worker->releaseValue(batch);
+    delete worker;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+#include "ONNXWorker.h"
+#include "Scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define MODEL_PATH_5 "/usr/IDAS/ONNX/model/super_resolution.onnx"
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+typedef Scheduler::Clock Clock;
+
+static void releaseResult(ONNXWorker* worker, SchedResult &result)
+{
+    for(auto &chunk: result.outputs){
+        for(OrtValue* value: chunk){
+            worker->releaseValue(value);
+        }
+    }
+}
+
+// One outstanding request at a time until the time is up.
+static void closedLoop(Scheduler* scheduler, ONNXWorker* worker, int model, int tenant, SchedPriority priority,
+                       OrtValue* input, Clock::time_point end, std::atomic<size_t>* done)
+{
+    std::vector<OrtValue*> inputs(1, input);
+    while(Clock::now() < end){
+        SchedResult result = scheduler->submit(model, tenant, priority, inputs).get();
+        releaseResult(worker, result);
+        ++*done;
+    }
+}
+
+// High priority requests wait for at most the one chunk in flight, so their
+// p99 must stay within two chunks plus slack. Over the NORMAL class the 3:1
+// weights must give analytics-a 75% of the Run time, within 10 points.
+static bool scenario(ONNXWorker* easy, ONNXWorker* sr, int64_t chunk_rows, int64_t batch, double seconds,
+                     OrtValue* easy_input, OrtValue* sr_batch)
+{
+    Scheduler scheduler(1, chunk_rows, 5.0);
+    int easy_model = scheduler.addModel(easy);
+    int sr_model = scheduler.addModel(sr);
+    int safety = scheduler.addTenant("safety", 1.0);
+    int analytics_a = scheduler.addTenant("analytics-a", 3.0);
+    int analytics_b = scheduler.addTenant("analytics-b", 1.0);
+    int background = scheduler.addTenant("background", 1.0);
+
+    Clock::time_point end = Clock::now() + std::chrono::microseconds((long long)(seconds * 1e6));
+    std::atomic<size_t> done_a(0), done_b(0), done_bg(0);
+    std::thread thread_a(closedLoop, &scheduler, sr, sr_model, analytics_a, SCHED_NORMAL, sr_batch, end, &done_a);
+    std::thread thread_b(closedLoop, &scheduler, sr, sr_model, analytics_b, SCHED_NORMAL, sr_batch, end, &done_b);
+    std::thread thread_bg(closedLoop, &scheduler, sr, sr_model, background, SCHED_LOW, sr_batch, end, &done_bg);
+
+    // periodic safety requests, 20 Hz
+    std::vector<OrtValue*> inputs(1, easy_input);
+    Clock::time_point next = Clock::now();
+    while(next < end){
+        std::this_thread::sleep_until(next);
+        SchedResult result = scheduler.submit(easy_model, safety, SCHED_HIGH, inputs).get();
+        releaseResult(easy, result);
+        next += std::chrono::milliseconds(50);
+    }
+    thread_a.join();
+    thread_b.join();
+    thread_bg.join();
+
+    printf("chunk_rows %lld\n", (long long)chunk_rows);
+    for(int cls = SCHED_HIGH; cls < SCHED_CLASSES; ++cls){
+        SchedClassStats stats = scheduler.getClassStats((SchedPriority)cls);
+        printf("  %-8s requests %6llu | latency p50 %8.2f p99 %8.2f max %8.2f ms\n", schedPriorityName((SchedPriority)cls),
+               (unsigned long long)stats.count, stats.p50_ms, stats.p99_ms, stats.max_ms);
+    }
+    double normal_ms = scheduler.tenantRunMs(analytics_a) + scheduler.tenantRunMs(analytics_b);
+    int tenant_ids[4] = {safety, analytics_a, analytics_b, background};
+    for(int tenant: tenant_ids){
+        double run_ms = scheduler.tenantRunMs(tenant);
+        printf("  tenant %-12s run %9.1f ms", scheduler.tenantName(tenant).c_str(), run_ms);
+        if(tenant == analytics_a || tenant == analytics_b){
+            printf(" (%4.1f%% of normal class)", normal_ms > 0.0 ? 100.0 * run_ms / normal_ms : 0.0);
+        }
+        printf("\n");
+    }
+    printf("  batches done: analytics-a %zu analytics-b %zu background %zu\n",
+           done_a.load(), done_b.load(), done_bg.load());
+
+    const double batch_ms = scheduler.tenantRunMs(background) + normal_ms;
+    const size_t batches = done_a.load() + done_b.load() + done_bg.load();
+    const int64_t piece = chunk_rows > 0 && chunk_rows < batch ? chunk_rows : batch;
+    const double chunk_ms = batches > 0 ? batch_ms / batches * piece / batch : 0.0;
+    const double bound_ms = 2.0 * chunk_ms + 2.0;
+    const SchedClassStats high = scheduler.getClassStats(SCHED_HIGH);
+    const bool bounded = high.count > 0 && high.p99_ms <= bound_ms;
+    const double share = normal_ms > 0.0 ? scheduler.tenantRunMs(analytics_a) / normal_ms : 0.0;
+    const bool fair = share >= 0.65 && share <= 0.85;
+    printf("  high p99 %.2f ms, bound %.2f ms (chunk %.2f ms): %s\n", high.p99_ms, bound_ms, chunk_ms,
+           bounded ? "ok" : "FAIL");
+    printf("  analytics-a share %.1f%%, expect 75 +- 10%%: %s\n", 100.0 * share, fair ? "ok" : "FAIL");
+    return bounded && fair;
+}
+
+// usage: testScheduler [seconds] [batch] [chunk_rows]
+int main(int argc, char const *argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 5.0;
+    int64_t batch = argc > 2 ? atol(argv[2]) : 8;
+    int64_t chunk_rows = argc > 3 ? atol(argv[3]) : 1;
+
+    ONNXWorker *easy = new ONNXWorker(MODEL_PATH_6);
+    ONNXWorker *sr = new ONNXWorker(MODEL_PATH_5);
+
+    float x = 42.0f;
+    std::vector<int64_t> easy_dims = {1, 1};
+    OrtValue* easy_input = easy->createTensor(&x, sizeof(x), easy_dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+    std::vector<float> images((size_t)batch * 224 * 224, 0.5f);
+    std::vector<int64_t> sr_dims = {batch, 1, 224, 224};
+    OrtValue* sr_batch = sr->createTensor(images.data(), images.size() * sizeof(float), sr_dims,
+                                          ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+
+    bool pass = scenario(easy, sr, 0, batch, seconds, easy_input, sr_batch);
+    pass = scenario(easy, sr, chunk_rows, batch, seconds, easy_input, sr_batch) && pass;
+
+    easy->releaseValue(easy_input);
+    sr->releaseValue(sr_batch);
+    delete easy;
+    delete sr;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#include "ONNXWorker.h"
+#include "InputGenerator.h"
+#include "LatencyHistogram.h"
+#include "Metrics.h"
+#include "ProfileReport.h"
+#include "ShadowProfiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MODEL_PATH_4 "/usr/IDAS/ONNX/model/mlp.onnx"
+
+typedef std::chrono::steady_clock Clock;
+
+// primary path latency over `runs` calls
+static void serve(ONNXWorker* worker, InputGenerator &inputs, size_t runs, const char* label)
+{
+    LatencyHistogram latency;
+    std::vector<OrtValue*> outputs(worker->getOutputsSignature().size(), nullptr);
+    for(size_t i = 0; i < runs; ++i){
+        Clock::time_point begin = Clock::now();
+        worker->run(inputs.values(), outputs);
+        latency.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count());
+        for(OrtValue* &value: outputs){
+            worker->releaseValue(value);
+            value = nullptr;
+        }
+    }
+    latency.printSummary(stdout, label);
+}
+
+// usage: testShadowProfiler [model] [runs] [sample_rate]
+int main(int argc, char const *argv[])
+{
+    std::string model = argc > 1 ? argv[1] : MODEL_PATH_4;
+    size_t runs = argc > 2 ? (size_t)atol(argv[2]) : 5000;
+    double rate = argc > 3 ? atof(argv[3]) : 0.02;
+
+    // the shadow session must stay out of the model's metrics
+    MetricsRegistry::setEnabled(true);
+    const std::string label = MetricsRegistry::modelLabel(model);
+    MetricCounter* counted_runs = MetricsRegistry::instance().counter("onnx_runs_total", "Run calls.", label);
+    MetricGauge* counted_sessions = MetricsRegistry::instance().gauge("onnx_sessions", "Open sessions.", label);
+
+    ONNXWorker *worker = new ONNXWorker(model);
+    std::vector<std::string> files;
+    bool drained = false;
+    bool unseen = false;
+    {
+        InputGenerator inputs(worker, InputSpec());
+        if(!inputs.valid()){
+            return 1;
+        }
+        serve(worker, inputs, runs, "primary, no shadow");
+
+        ShadowConfig config;
+        config.sample_rate = rate;
+        config.runs_per_file = 25;
+        config.seconds_per_file = 2.0;
+        config.max_files = 3;
+        config.prefix = "shadow_profile";
+        ShadowProfiler shadow(model, config);
+        worker->setShadow(&shadow);
+        serve(worker, inputs, runs, "primary, shadow on");
+        worker->setShadow(nullptr);
+        // let the shadow thread drain before the last file is closed
+        Clock::time_point give_up = Clock::now() + std::chrono::seconds(60);
+        ShadowStats stats = shadow.getStats();
+        while(stats.runs + stats.dropped + stats.failed < stats.sampled && Clock::now() < give_up){
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            stats = shadow.getStats();
+        }
+        drained = stats.runs + stats.dropped + stats.failed == stats.sampled;
+        printf("offered %llu sampled %llu dropped %llu failed %llu shadow runs %llu files %llu%s\n",
+               (unsigned long long)stats.offered, (unsigned long long)stats.sampled, (unsigned long long)stats.dropped,
+               (unsigned long long)stats.failed, (unsigned long long)stats.runs, (unsigned long long)stats.files,
+               drained ? "" : ", not drained after 60 s");
+        unseen = counted_runs->value() == 2 * runs && counted_sessions->value() == 1;
+        printf("metrics: %llu runs (expect %llu), %lld sessions (expect 1), shadow %s\n",
+               (unsigned long long)counted_runs->value(), (unsigned long long)(2 * runs),
+               (long long)counted_sessions->value(), unseen ? "not counted: ok" : "counted: FAIL");
+        files = shadow.files();
+    }
+    // the destructor closed one more file, not listed
+    printf("kept:");
+    ProfileReport report;
+    for(const std::string &path: files){
+        printf(" %s", path.c_str());
+    }
+    printf("\n");
+    bool ok = drained && unseen && !files.empty() && report.load(files.back());
+    if(ok){
+        report.print(stdout, 5);
+    }
+    delete worker;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#include "ONNXWorker.h"
+#include "StageTimer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+typedef std::chrono::steady_clock Clock;
+
+static double runLoop(ONNXWorker* worker, OrtValue* input, size_t runs)
+{
+    std::vector<OrtValue*> inputs(1, input);
+    std::vector<OrtValue*> outputs(1, nullptr);
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < runs; ++i){
+        worker->run(inputs, outputs);
+        worker->releaseValue(outputs[0]);
+        outputs[0] = nullptr;
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / runs;
+}
+
+static const StageSummary* find(const std::vector<StageSummary> &stages, RunStage stage)
+{
+    for(const auto &summary: stages){
+        if(summary.name == StageTimer::stageName(stage)){
+            return &summary;
+        }
+    }
+    return nullptr;
+}
+
+// every stamp charges each tick between its first and last mark to exactly
+// one stage, so the stage totals add up to the total
+static bool checkSum(const std::vector<StageSummary> &stages, uint64_t calls)
+{
+    double stage_us = 0.0, total_us = 0.0;
+    uint64_t total_count = 0;
+    for(const auto &summary: stages){
+        if(summary.name == StageTimer::stageName(STAGE_TOTAL)){
+            total_us = summary.mean_us * summary.count;
+            total_count = summary.count;
+        }
+        else{
+            stage_us += summary.mean_us * summary.count;
+        }
+    }
+    bool pass = total_count == calls && total_us > 0.0 && fabs(stage_us - total_us) <= total_us * 1e-6;
+    printf("stages add up to %.1f us of %.1f us total over %llu of %llu calls: %s\n", stage_us, total_us,
+           (unsigned long long)total_count, (unsigned long long)calls, pass ? "ok" : "FAIL");
+    return pass;
+}
+
+// known tick counts into an otherwise unused stage: 90% at 1000 ticks report
+// the top of their bucket (896..1023) as p50, the 10% at 100000 the p99 and max
+static bool checkBuckets()
+{
+    for(int i = 0; i < 1000; ++i){
+        StageTimer::record(STAGE_CAPTURE, i < 900 ? 1000 : 100000);
+    }
+    std::vector<StageSummary> stages;
+    StageTimer::summary(stages);
+    const StageSummary* capture = find(stages, STAGE_CAPTURE);
+    double us_per_tick = StageTimer::nsPerTick() / 1000.0;
+    if(capture == nullptr){
+        printf("capture stage missing: FAIL\n");
+        return false;
+    }
+    double p50 = capture->p50_us / us_per_tick, p99 = capture->p99_us / us_per_tick;
+    double max = capture->max_us / us_per_tick, mean = capture->mean_us / us_per_tick;
+    bool pass = capture->count == 1000 && fabs(p50 - 1023.0) < 1023.0 * 0.01 && fabs(p99 - 100000.0) < 100000.0 * 0.01 &&
+        fabs(max - 100000.0) < 100000.0 * 0.01 && fabs(mean - 10900.0) < 10900.0 * 0.01;
+    printf("buckets: p50 %.0f ticks (expect 1023), p99 %.0f, max %.0f (expect 100000), mean %.0f (expect 10900): %s\n",
+           p50, p99, max, mean, pass ? "ok" : "FAIL");
+    return pass;
+}
+
+// usage: testStageTimer [runs] [threads]
+int main(int argc, char const *argv[])
+{
+    size_t runs = argc > 1 ? (size_t)atol(argv[1]) : 20000;
+    int threads = argc > 2 ? atoi(argv[2]) : 2;
+    ONNXWorker *worker = new ONNXWorker(MODEL_PATH_6);
+    float x = 42.0f;
+    std::vector<int64_t> dims = {1, 1};
+    OrtValue* input = worker->createTensor(&x, sizeof(x), dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+
+    // overhead: same loop with the stamps off and on
+    StageTimer::setEnabled(false);
+    double off_ns = runLoop(worker, input, runs);
+    StageTimer::setEnabled(true);
+    double on_ns = runLoop(worker, input, runs);
+    printf("run() %.1f ns without stamps, %.1f ns with, %.1f ns per call\n", off_ns, on_ns, on_ns - off_ns);
+
+    // per thread blocks under concurrent load, dumped while running
+    StageTimer::startDump(stdout, 500.0);
+    std::vector<std::thread> pool;
+    for(int t = 0; t < threads; ++t){
+        pool.emplace_back(runLoop, worker, input, runs);
+    }
+    for(auto &thread: pool){
+        thread.join();
+    }
+    StageTimer::stopDump();
+
+    // the legacy path with its metadata queries on every call
+    for(int i = 0; i < 20; ++i){
+        worker->getOutputDirect2();
+    }
+
+    printf("\nfinal\n");
+    StageTimer::dump(stdout);
+    std::vector<StageSummary> stages;
+    StageTimer::summary(stages);
+    bool pass = checkSum(stages, runs * (threads + 1) + 20);
+    pass = checkBuckets() && pass;
+    worker->releaseValue(input);
+    delete worker;
+    return pass ? 0 : 1;
+}
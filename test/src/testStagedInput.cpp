@@ -0,0 +1,132 @@
+#include "ONNXWorker.h"
+#include "StagedRunner.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+typedef std::chrono::steady_clock Clock;
+
+// stands in for reading and scaling one sensor sample
+static void produceSample(float* dst, size_t count, long seq, long prep_us)
+{
+    Clock::time_point until = Clock::now() + std::chrono::microseconds(prep_us);
+    for(size_t i = 0; i < count; ++i){
+        dst[i] = 13.0f + (float)((seq * 7 + i) % 66);
+    }
+    while(Clock::now() < until){
+    }
+}
+
+// produceSample() repeats every 66 samples: the expected output of each one
+// from a direct run()
+static std::vector<std::vector<float>> directOutputs(ONNXWorker* worker, size_t count)
+{
+    std::vector<std::vector<float>> expected(66);
+    std::vector<int64_t> dims = worker->getInputsSignature()[0].Dims.second;
+    for(auto &dim: dims){
+        dim = dim > 0 ? dim : 1;
+    }
+    std::vector<float> sample(count);
+    for(long seq = 0; seq < (long)expected.size(); ++seq){
+        produceSample(sample.data(), count, seq, 0);
+        std::vector<OrtValue*> inputs(1, worker->createTensor(sample.data(), count * sizeof(float), dims,
+                                                              ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT));
+        std::vector<OrtValue*> outputs(1, nullptr);
+        if(worker->run(inputs, outputs) && outputs[0] != nullptr){
+            std::vector<int64_t> shape;
+            worker->getTensorShape(outputs[0], shape);
+            size_t elements = 1;
+            for(int64_t d: shape){
+                elements *= (size_t)d;
+            }
+            const float* data = worker->getFloatData(outputs[0]);
+            expected[seq].assign(data, data + elements);
+        }
+        worker->releaseValue(outputs[0]);
+        worker->releaseValue(inputs[0]);
+    }
+    return expected;
+}
+
+// usage: testStagedInput [samples] [producer_us_per_sample]
+int main(int argc, char const *argv[])
+{
+    long samples = argc > 1 ? atol(argv[1]) : 2000;
+    long prep_us = argc > 2 ? atol(argv[2]) : 50;
+    ONNXWorker *worker = new ONNXWorker(MODEL_PATH_6);
+
+    bool pass = true;
+    for(size_t slot_count = 1; slot_count <= 3; ++slot_count){
+        std::atomic<long> done(0);
+        std::atomic<long> mismatches(0);
+        std::atomic<long> reused(0);
+        float last = 0.0f;
+        // sample held by each slot, and whether it is between acquire() and its result
+        std::vector<long> slot_seq(slot_count, -1);
+        std::unique_ptr<std::atomic<bool>[]> in_flight(new std::atomic<bool>[slot_count]);
+        for(size_t s = 0; s < slot_count; ++s){
+            in_flight[s] = false;
+        }
+        std::vector<std::vector<float>> expected;
+        StagedRunner *runner = new StagedRunner(worker, slot_count,
+            [&](int slot, const std::vector<OrtValue*> &outputs, bool ok){
+                const std::vector<float> &want = expected[slot_seq[slot] % expected.size()];
+                bool same = ok && !outputs.empty() && !want.empty();
+                if(same){
+                    std::vector<int64_t> shape;
+                    worker->getTensorShape(outputs[0], shape);
+                    size_t elements = 1;
+                    for(int64_t d: shape){
+                        elements *= (size_t)d;
+                    }
+                    const float* data = worker->getFloatData(outputs[0]);
+                    same = data != nullptr && elements == want.size() &&
+                           std::memcmp(data, want.data(), elements * sizeof(float)) == 0;
+                    last = data != nullptr ? data[0] : 0.0f;
+                }
+                mismatches += same ? 0 : 1;
+                in_flight[slot] = false;
+                ++done;
+            });
+        if(!runner->isReady()){
+            printf("StagedRunner init fail !!!\n");
+            delete runner;
+            pass = false;
+            break;
+        }
+
+        size_t count = runner->inputBytes(0) / sizeof(float);
+        expected = directOutputs(worker, count);
+        Clock::time_point begin = Clock::now();
+        for(long i = 0; i < samples; ++i){
+            int slot = runner->acquire();
+            if(in_flight[slot].exchange(true)){
+                ++reused;
+            }
+            slot_seq[slot] = i;
+            produceSample((float*)runner->inputBuffer(slot, 0), count, i, prep_us);
+            runner->commit(slot);
+        }
+        runner->close();
+        double wall_s = std::chrono::duration<double>(Clock::now() - begin).count();
+        StagingStats stats = runner->getStats();
+        const bool slots_ok = done.load() == samples && mismatches.load() == 0 && reused.load() == 0;
+        printf("slots=%zu: %ld runs in %.3f s (%.0f/s), inference utilization %.1f%%, "
+               "producer waited %.1f ms, last output %f\n",
+               slot_count, done.load(), wall_s, done.load() / wall_s, 100.0 * stats.utilization,
+               stats.producer_wait_ms, last);
+        printf("slots=%zu: %ld outputs differ from a direct run, %ld in-flight slots handed out - %s\n",
+               slot_count, mismatches.load(), reused.load(), slots_ok ? "ok" : "FAIL");
+        pass = slots_ok && pass;
+        delete runner;
+    }
+
+    delete worker;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#include "ONNXWorker.h"
+#include "StreamPipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+// usage: testStreamPipeline [samples] [sensor_hz, 0 = free running] [cpu_acq cpu_pre cpu_inf cpu_post]
+int main(int argc, char const *argv[])
+{
+    long samples = argc > 1 ? atol(argv[1]) : 10000;
+    double rate_hz = argc > 2 ? atof(argv[2]) : 0.0;
+    StreamPipelineConfig config;
+    config.frames = 16;
+    config.ring_capacity = 4;
+    for(int i = 0; i < STREAM_STAGE_NUM; ++i){
+        config.stage_cpu[i] = argc > 3 + i ? atoi(argv[3 + i]) : -1;
+    }
+
+    ONNXWorker *worker = new ONNXWorker(MODEL_PATH_6);
+    StreamPipeline *pipeline = new StreamPipeline(worker, config);
+    if(!pipeline->isReady()){
+        printf("StreamPipeline init fail !!!\n");
+        delete pipeline;
+        delete worker;
+        return 1;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    long produced = 0;
+    long consumed = 0;
+    double latency_sum_us = 0.0;
+
+    // simulated sensor: a noisy sine sampled at rate_hz
+    auto acquire = [&](StreamFrame &frame) -> bool {
+        if(produced >= samples){
+            return false;
+        }
+        if(rate_hz > 0.0){
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds((long long)(produced * 1e9 / rate_hz)));
+        }
+        frame.seq = produced++;
+        frame.raw.resize(1);
+        frame.raw[0] = 45.0f + 33.0f * std::sin(frame.seq * 0.01f) + (rand() % 100) * 0.02f;
+        return true;
+    };
+    // clamp into the range the model was trained on
+    auto preprocess = [](StreamFrame &frame) {
+        for(size_t i = 0; i < frame.input.size(); ++i){
+            float v = i < frame.raw.size() ? frame.raw[i] : 0.0f;
+            frame.input[i] = v < 13.0f ? 13.0f : (v > 79.0f ? 79.0f : v);
+        }
+    };
+    auto postprocess = [&](StreamFrame &frame) {
+        ++consumed;
+        latency_sum_us += std::chrono::duration<double, std::micro>(
+            Clock::now().time_since_epoch()).count() - frame.acquire_ns / 1e3;
+        if(frame.ok && !frame.output.empty() && frame.seq % 1000 == 0){
+            printf("sample %llu: input %f -> %f\n", (unsigned long long)frame.seq, frame.input[0], frame.output[0]);
+        }
+    };
+
+    pipeline->run(acquire, preprocess, postprocess);
+    double wall_s = std::chrono::duration<double>(Clock::now() - start).count();
+    printf("%ld samples in %.3f s (%.0f/s), mean acquire->post latency %.1f us\n",
+           consumed, wall_s, consumed / wall_s, consumed > 0 ? latency_sum_us / consumed : 0.0);
+    pipeline->printStats();
+
+    // a second run on the same pipeline starts from a full set of frames
+    const long first = consumed;
+    samples += 100;
+    rate_hz = 0.0;
+    pipeline->run(acquire, preprocess, postprocess);
+    printf("second run: %ld samples\n", consumed - first);
+
+    delete pipeline;
+    delete worker;
+    return consumed - first == 100 ? 0 : 1;
+}
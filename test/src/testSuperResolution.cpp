@@ -0,0 +1,103 @@
+#include "ONNXWorker.h"
+#include "SuperResolutionPipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#define MODEL_PATH_3 "/usr/IDAS/ONNX/model/super_resolution.onnx"
+
+static void accumulate(SRStageTimes &sum, const SRStageTimes &t)
+{
+    sum.to_ycbcr_ms += t.to_ycbcr_ms;
+    sum.inference_ms += t.inference_ms;
+    sum.chroma_ms += t.chroma_ms;
+    sum.chroma_wait_ms += t.chroma_wait_ms;
+    sum.merge_ms += t.merge_ms;
+    sum.total_ms += t.total_ms;
+}
+
+static void printTimes(const char* label, const SRStageTimes &sum, int frames)
+{
+    printf("%s (avg of %d frames, ms)\n", label, frames);
+    printf("  rgb->ycbcr   : %8.3f\n", sum.to_ycbcr_ms / frames);
+    printf("  inference(Y) : %8.3f\n", sum.inference_ms / frames);
+    printf("  chroma x2    : %8.3f\n", sum.chroma_ms / frames);
+    printf("  chroma stall : %8.3f\n", sum.chroma_wait_ms / frames);
+    printf("  merge->rgb   : %8.3f\n", sum.merge_ms / frames);
+    printf("  total        : %8.3f\n", sum.total_ms / frames);
+}
+
+static void writePPM(const char* path, const uint8_t* rgb, int width, int height)
+{
+    FILE* fp = fopen(path, "wb");
+    if(fp == nullptr){
+        printf("cannot write %s\n", path);
+        return;
+    }
+    fprintf(fp, "P6\n%d %d\n255\n", width, height);
+    fwrite(rgb, 1, (size_t)width * height * 3, fp);
+    fclose(fp);
+}
+
+// usage: testSuperResolution [frames] [out.ppm]
+int main(int argc, char const *argv[])
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 20;
+    if(frames <= 0){
+        frames = 20;
+    }
+    ONNXWorker *worker = new ONNXWorker(MODEL_PATH_3);
+    SuperResolutionPipeline *pipeline = new SuperResolutionPipeline(worker);
+    if(!pipeline->isReady()){
+        printf("SuperResolution pipeline init fail !!!\n");
+        delete pipeline;
+        delete worker;
+        return 1;
+    }
+
+    int in_w = pipeline->inputWidth(), in_h = pipeline->inputHeight();
+    std::vector<uint8_t> frame((size_t)in_w * in_h * 3);
+    std::vector<uint8_t> result((size_t)pipeline->outputWidth() * pipeline->outputHeight() * 3);
+    std::vector<uint8_t> expected(result.size());
+    for(int y = 0; y < in_h; ++y){
+        for(int x = 0; x < in_w; ++x){
+            uint8_t* px = &frame[((size_t)y * in_w + x) * 3];
+            px[0] = (uint8_t)(x * 255 / in_w);
+            px[1] = (uint8_t)(y * 255 / in_h);
+            px[2] = (uint8_t)((x ^ y) & 0xff);
+        }
+    }
+
+    SRStageTimes times;
+    SRStageTimes seq_sum = {0, 0, 0, 0, 0, 0};
+    SRStageTimes pipe_sum = {0, 0, 0, 0, 0, 0};
+    // warm up the session and the helper threads
+    pipeline->process(frame.data(), result.data(), &times);
+    for(int i = 0; i < frames; ++i){
+        if(pipeline->processSequential(frame.data(), expected.data(), &times)){
+            accumulate(seq_sum, times);
+        }
+    }
+    for(int i = 0; i < frames; ++i){
+        if(pipeline->process(frame.data(), result.data(), &times)){
+            accumulate(pipe_sum, times);
+        }
+    }
+    printTimes("sequential", seq_sum, frames);
+    printTimes("pipelined", pipe_sum, frames);
+
+    // both paths run the same kernels on the same frame, the output must not differ
+    size_t differ = 0;
+    for(size_t i = 0; i < result.size(); ++i){
+        differ += result[i] != expected[i] ? 1 : 0;
+    }
+    printf("pipelined vs sequential: %zu of %zu bytes differ\n", differ, result.size());
+
+    if(argc > 2){
+        writePPM(argv[2], result.data(), pipeline->outputWidth(), pipeline->outputHeight());
+    }
+
+    delete pipeline;
+    delete worker;
+    return differ == 0 ? 0 : 1;
+}
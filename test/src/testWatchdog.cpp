@@ -0,0 +1,108 @@
+#include "ONNXWorker.h"
+#include "RunWatchdog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define MODEL_PATH_5 "/usr/IDAS/ONNX/model/super_resolution.onnx"
+#define MODEL_PATH_6 "/usr/IDAS/ONNX/model/easy_example_2.onnx"
+
+typedef std::chrono::steady_clock Clock;
+
+struct LoopResult{
+    size_t ok;
+    size_t failed;
+    double best_ms;
+    double worst_ms;
+};
+
+// Runs one worker in a loop from the calling thread, no run options passed:
+// the watchdog is the only thing that can cut a run short.
+static void runLoop(ONNXWorker* worker, std::vector<OrtValue*> inputs, size_t runs, LoopResult* result)
+{
+    result->ok = 0;
+    result->failed = 0;
+    result->best_ms = 1e30;
+    result->worst_ms = 0.0;
+    std::vector<OrtValue*> outputs(worker->getOutputsSignature().size(), nullptr);
+    for(size_t i = 0; i < runs; ++i){
+        Clock::time_point start = Clock::now();
+        bool ok = worker->run(inputs, outputs);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        result->best_ms = ms < result->best_ms ? ms : result->best_ms;
+        result->worst_ms = ms > result->worst_ms ? ms : result->worst_ms;
+        ok ? ++result->ok : ++result->failed;
+        for(OrtValue* &value: outputs){
+            if(value != nullptr){
+                worker->releaseValue(value);
+                value = nullptr;
+            }
+        }
+    }
+}
+
+// usage: testWatchdog [runs] [easy_limit_ms] [sr_limit_ms]
+int main(int argc, char const *argv[])
+{
+    size_t runs = argc > 1 ? (size_t)atol(argv[1]) : 200;
+    double easy_limit_ms = argc > 2 ? atof(argv[2]) : 50.0;
+    double sr_limit_ms = argc > 3 ? atof(argv[3]) : 2000.0;
+
+    ONNXWorker *easy = new ONNXWorker(MODEL_PATH_6);
+    ONNXWorker *sr = new ONNXWorker(MODEL_PATH_5);
+    easy->setRunTimeLimit(easy_limit_ms);
+    sr->setRunTimeLimit(sr_limit_ms);
+
+    float x = 42.0f;
+    std::vector<int64_t> easy_dims = {1, 1};
+    std::vector<OrtValue*> easy_inputs(1, easy->createTensor(&x, sizeof(x), easy_dims, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT));
+    std::vector<float> image(224 * 224, 0.5f);
+    std::vector<int64_t> sr_dims = {1, 1, 224, 224};
+    std::vector<OrtValue*> sr_inputs(1, sr->createTensor(image.data(), image.size() * sizeof(float), sr_dims,
+                                                         ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT));
+
+    RunWatchdog &watchdog = RunWatchdog::instance();
+    watchdog.start(1000.0, 5.0);
+
+    LoopResult easy_result, sr_result;
+    std::thread easy_thread(runLoop, easy, easy_inputs, runs, &easy_result);
+    std::thread sr_thread(runLoop, sr, sr_inputs, runs / 10 + 1, &sr_result);
+    easy_thread.join();
+    sr_thread.join();
+
+    // a limit of a quarter of the fastest super_resolution run: every run has
+    // to be cut short and show up as an event
+    const size_t tight_runs = 5;
+    const double tight_limit_ms = sr_result.best_ms / 4.0;
+    ONNXWorker *tight = new ONNXWorker(MODEL_PATH_5);
+    tight->setRunTimeLimit(tight_limit_ms);
+    const uint64_t terminations_before = watchdog.terminations();
+    LoopResult tight_result;
+    std::thread tight_thread(runLoop, tight, sr_inputs, tight_runs, &tight_result);
+    tight_thread.join();
+    const uint64_t tight_terminations = watchdog.terminations() - terminations_before;
+    watchdog.stop();
+
+    printf("easy_example_2   limit %8.1f ms | ok %5zu failed %3zu worst %8.2f ms\n",
+           easy_limit_ms, easy_result.ok, easy_result.failed, easy_result.worst_ms);
+    printf("super_resolution limit %8.1f ms | ok %5zu failed %3zu worst %8.2f ms\n",
+           sr_limit_ms, sr_result.ok, sr_result.failed, sr_result.worst_ms);
+    const bool pass = tight_result.failed == tight_runs && tight_terminations == tight_runs &&
+                      tight_result.worst_ms < sr_result.best_ms;
+    printf("super_resolution limit %8.2f ms | ok %5zu failed %3zu worst %8.2f ms, %llu terminated - %s\n",
+           tight_limit_ms, tight_result.ok, tight_result.failed, tight_result.worst_ms,
+           (unsigned long long)tight_terminations, pass ? "ok" : "FAIL");
+    printf("watchdog terminated %llu runs\n", (unsigned long long)watchdog.terminations());
+    for(const WatchdogEvent &event: watchdog.getEvents()){
+        printf("  %-24s %8.2f ms > %8.2f ms  %s\n", event.tag.c_str(), event.elapsed_ms, event.limit_ms, event.model.c_str());
+    }
+
+    easy->releaseValue(easy_inputs[0]);
+    sr->releaseValue(sr_inputs[0]);
+    delete tight;
+    delete easy;
+    delete sr;
+    return pass ? 0 : 1;
+}
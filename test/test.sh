@@ -14,6 +14,12 @@ cmake -S "." -B "./build" -DCMAKE_C_COMPILER="${MYCC}" -DCMAKE_CXX_COMPILER="${M
 make -C "./build"
 
 cp ./build/test* ./bin/
+# benchmark, profiling and validation tools run on the box next to the tests
+TOOLS="coldStart coldStartChild benchPostprocess loadGen profileReport microBench benchCompare \
+       accuracyCheck memoryReport soakTest outputSelect modelRewrite"
+for tool in ${TOOLS}; do
+    cp "./build/${tool}" ./bin/ || exit 1
+done
 
 
 BoxIP="10.0.0.197"
@@ -22,13 +28,41 @@ SourceFolder1="./bin"
 # SourceFolder2="./libs"
 SourceFolder3="./model"
 TargetFolder="/usr/IDAS/ONNX"
+# the new bin is uploaded here and only replaces ${TargetFolder}/bin once the gate passed
+Staging="${TargetFolder}/bin.staging"
 
-echo "This foler - ${SourceFolder1} - is upload the newest file to the target box - ${TargetFolder}"
+echo "This foler - ${SourceFolder1} - is upload the newest file to the target box - ${Staging}"
 # echo "This foler - ${SourceFolder2} - is upload the newest file to the target box - ${TargetFolder}"
 echo "This foler - ${SourceFolder3} - is upload the newest file to the target box - ${TargetFolder}"
 
 
 ssh "${User}@${BoxIP}" "[ -d ${TargetFolder} ] && echo ok || mkdir -p ${TargetFolder}"
-scp -prq "${SourceFolder1}" "${User}@${BoxIP}:${TargetFolder}"
+ssh "${User}@${BoxIP}" "rm -rf ${Staging}" || exit 1
+scp -prq "${SourceFolder1}" "${User}@${BoxIP}:${Staging}" || exit 1
 # scp -prq "${SourceFolder2}" "${User}@${BoxIP}:${TargetFolder}"
-scp -prq "${SourceFolder3}" "${User}@${BoxIP}:${TargetFolder}"
\ No newline at end of file
+scp -prq "${SourceFolder3}" "${User}@${BoxIP}:${TargetFolder}"
+
+# Performance gate: the binaries are cross built, so loadGen and benchCompare
+# run on the box, from the staging bin. A new loadGen -J run is compared
+# against the baseline kept in ${Baseline}; without a baseline the run is
+# fetched back and becomes it. A failing gate leaves the live bin untouched.
+Baseline="./bench/baseline.json"
+Gate="cd ${Staging} && ./loadGen -a closed -c 4 -d 10 -J ${TargetFolder}/candidate.json > /dev/null"
+if [ -f "${Baseline}" ]; then
+    scp -q "${Baseline}" "${User}@${BoxIP}:${TargetFolder}/baseline.json"
+    if ! ssh "${User}@${BoxIP}" "${Gate} && ./benchCompare ${TargetFolder}/baseline.json ${TargetFolder}/candidate.json"; then
+        echo "benchCompare gate failed against ${Baseline}, ${TargetFolder}/bin not replaced"
+        exit 1
+    fi
+else
+    mkdir -p "$(dirname "${Baseline}")"
+    if ! ssh "${User}@${BoxIP}" "${Gate}" || ! scp -q "${User}@${BoxIP}:${TargetFolder}/candidate.json" "${Baseline}"; then
+        echo "no baseline recorded, ${TargetFolder}/bin not replaced"
+        exit 1
+    fi
+    echo "no baseline yet, recorded ${Baseline}"
+fi
+
+# gate passed: swap the staging bin in
+ssh "${User}@${BoxIP}" "cd ${TargetFolder} && rm -rf bin.old && { [ ! -d bin ] || mv bin bin.old; } && mv ${Staging} bin && rm -rf bin.old" || exit 1
+echo "deployed to ${TargetFolder}/bin"